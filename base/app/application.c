@@ -3,6 +3,12 @@
 
 #define PREFIX_TALK_BASE "climate-station-001-base"
 #define PREFIX_TALK_REMOTE "climate-station-001-remote"
+#define TDMA false
+#define TDMA_SUPERFRAME 10000
+#define TDMA_SLOT_LENGTH 60
+#define RADIO_STATS_INTERVAL 60000
+#define RADIO_SURVEY_DWELL 1000
+#define OTA_CHUNK_SIZE 512
 
 // LED instance
 bc_led_t led;
@@ -10,6 +16,98 @@ bc_led_t led;
 // Button instance
 bc_button_t button;
 
+// Remote which is being updated
+uint32_t ota_device_address;
+
+// Payload values of commands, usb_talk binds them while message comes
+typedef struct
+{
+    int channel;
+    int datarate;
+    bool fec;
+    int power;
+
+} radio_profile_values_t;
+
+typedef struct
+{
+    int first;
+    int last;
+    int dwell;
+    bool apply;
+
+} radio_survey_values_t;
+
+typedef struct
+{
+    int mode;
+
+} usb_talk_mode_values_t;
+
+typedef struct
+{
+    int overflow;
+
+} usb_talk_overflow_values_t;
+
+typedef struct
+{
+    int offset;
+    uint8_t data[OTA_CHUNK_SIZE];
+    size_t length;
+
+} ota_data_values_t;
+
+typedef struct
+{
+    char device[9];
+    int length;
+
+} ota_send_values_t;
+
+static const char * const radio_datarates[] = { "9600", "19200", "38400", "100000", NULL };
+static const char * const usb_talk_modes[] = { "text", "binary", NULL };
+static const char * const usb_talk_overflows[] = { "reject", "drop-oldest", NULL };
+
+static const usb_talk_bind_t radio_profile_binds[] = {
+    USB_TALK_BIND_INT("channel", radio_profile_values_t, channel),
+    USB_TALK_BIND_ENUM("datarate", radio_profile_values_t, datarate, radio_datarates),
+    USB_TALK_BIND_BOOL("fec", radio_profile_values_t, fec),
+    USB_TALK_BIND_INT("power", radio_profile_values_t, power)
+};
+
+static const usb_talk_bind_t radio_survey_binds[] = {
+    USB_TALK_BIND_INT("first", radio_survey_values_t, first),
+    USB_TALK_BIND_INT("last", radio_survey_values_t, last),
+    USB_TALK_BIND_INT("dwell", radio_survey_values_t, dwell),
+    USB_TALK_BIND_BOOL("switch", radio_survey_values_t, apply)
+};
+
+static const usb_talk_bind_t usb_talk_mode_binds[] = {
+    USB_TALK_BIND_ENUM(NULL, usb_talk_mode_values_t, mode, usb_talk_modes)
+};
+
+static const usb_talk_bind_t usb_talk_overflow_binds[] = {
+    USB_TALK_BIND_ENUM(NULL, usb_talk_overflow_values_t, overflow, usb_talk_overflows)
+};
+
+static const usb_talk_bind_t ota_data_binds[] = {
+    USB_TALK_BIND_INT("offset", ota_data_values_t, offset),
+    USB_TALK_BIND_DATA("data", ota_data_values_t, data, length)
+};
+
+static const usb_talk_bind_t ota_send_binds[] = {
+    USB_TALK_BIND_STRING("device", ota_send_values_t, device),
+    USB_TALK_BIND_INT("length", ota_send_values_t, length)
+};
+
+static radio_profile_values_t radio_profile_values;
+static radio_survey_values_t radio_survey_values;
+static usb_talk_mode_values_t usb_talk_mode_values;
+static usb_talk_overflow_values_t usb_talk_overflow_values;
+static ota_data_values_t ota_data_values;
+static ota_send_values_t ota_send_values;
+
 void button_event_handler(bc_button_t *self, bc_button_event_t event, void *event_param)
 {
     (void) self;
@@ -19,7 +117,7 @@ void button_event_handler(bc_button_t *self, bc_button_event_t event, void *even
     {
         bc_led_pulse(&led, 100);
         static uint16_t event_counter = 0;
-        usb_talk_publish_push_button(PREFIX_TALK_BASE, &event_counter);
+        usb_talk_publish_push_button(PREFIX_TALK_BASE, NULL, &event_counter);
         event_counter++;
     }
     else if (event == BC_BUTTON_EVENT_HOLD)
@@ -41,49 +139,244 @@ void radio_event_handler(bc_radio_event_t event, void *event_param)
 
         bc_led_set_mode(&led, BC_LED_MODE_OFF);
     }
+    else if (event == BC_RADIO_EVENT_SURVEY_DONE)
+    {
+        bc_radio_survey_t survey;
+
+        bc_radio_get_survey(&survey);
+
+        usb_talk_publish_radio_survey(PREFIX_TALK_BASE, &survey);
+    }
+    else if (event == BC_RADIO_EVENT_BULK_DONE || event == BC_RADIO_EVENT_BULK_FAILURE)
+    {
+        bool success = event == BC_RADIO_EVENT_BULK_DONE;
+
+        usb_talk_publish_ota(PREFIX_TALK_BASE, &ota_device_address, &success);
+    }
 }
 
 void bc_radio_on_push_button(uint32_t *peer_device_address, uint16_t *event_count)
 {
-    (void) peer_device_address;
-
     bc_led_pulse(&led, 1000);
-    usb_talk_publish_push_button(PREFIX_TALK_REMOTE, event_count);
+    usb_talk_publish_push_button(PREFIX_TALK_REMOTE, peer_device_address, event_count);
 }
 
 void bc_radio_on_thermometer(uint32_t *peer_device_address, uint8_t *i2c, float *temperature)
 {
-    (void) peer_device_address;
-
-    usb_talk_publish_thermometer(PREFIX_TALK_REMOTE, i2c, temperature);
+    usb_talk_publish_thermometer(PREFIX_TALK_REMOTE, peer_device_address, i2c, temperature);
 }
 
 void bc_radio_on_lux_meter(uint32_t *peer_device_address, uint8_t *i2c, float *illuminance)
 {
-    (void) peer_device_address;
-
-    usb_talk_publish_lux_meter(PREFIX_TALK_REMOTE, i2c, illuminance);
+    usb_talk_publish_lux_meter(PREFIX_TALK_REMOTE, peer_device_address, i2c, illuminance);
 }
 
 void bc_radio_on_humidity(uint32_t *peer_device_address, uint8_t *i2c, float *percentage)
 {
-    (void) peer_device_address;
-
-    usb_talk_publish_humidity_sensor(PREFIX_TALK_REMOTE, i2c, percentage);
+    usb_talk_publish_humidity_sensor(PREFIX_TALK_REMOTE, peer_device_address, i2c, percentage);
 }
 
 void bc_radio_on_barometer(uint32_t *peer_device_address, uint8_t *i2c, float *pressure, float *altitude)
 {
-    (void) peer_device_address;
-
-    usb_talk_publish_barometer(PREFIX_TALK_REMOTE, i2c, pressure, altitude);
+    usb_talk_publish_barometer(PREFIX_TALK_REMOTE, peer_device_address, i2c, pressure, altitude);
 }
 
 void bc_radio_on_co2(uint32_t *peer_device_address, float *concentration)
 {
-    (void) peer_device_address;
+    usb_talk_publish_co2_concentation(PREFIX_TALK_REMOTE, peer_device_address, concentration);
+}
+
+void bc_radio_on_alarm(uint32_t *peer_device_address, bc_radio_alarm_t *alarm, bool *active, float *value)
+{
+    bc_led_pulse(&led, 1000);
+    usb_talk_publish_alarm(PREFIX_TALK_REMOTE, peer_device_address, alarm, active, value);
+}
 
-    usb_talk_publish_co2_concentation(PREFIX_TALK_REMOTE, concentration);
+void bc_radio_on_replay(uint32_t *peer_device_address, uint32_t *age)
+{
+    usb_talk_publish_replay(PREFIX_TALK_REMOTE, peer_device_address, age);
+}
+
+static void radio_stats_get(usb_talk_payload_t *payload, void *param)
+{
+    (void) payload;
+    (void) param;
+
+    bc_radio_stats_t stats;
+
+    bc_radio_get_stats(&stats);
+
+    usb_talk_publish_radio_stats(PREFIX_TALK_BASE, &stats);
+}
+
+static void radio_stats_reset(usb_talk_payload_t *payload, void *param)
+{
+    (void) payload;
+    (void) param;
+
+    bc_radio_reset_stats();
+}
+
+static void radio_profile_get(usb_talk_payload_t *payload, void *param)
+{
+    (void) payload;
+    (void) param;
+
+    bc_spirit1_profile_t profile;
+
+    bc_radio_get_profile(&profile);
+
+    usb_talk_publish_radio_profile(PREFIX_TALK_BASE, &profile);
+}
+
+static void radio_profile_set(usb_talk_payload_t *payload, void *param)
+{
+    (void) param;
+
+    bc_spirit1_profile_t profile;
+
+    bc_radio_get_profile(&profile);
+
+    // Keys which are not present keep their current value
+    if (usb_talk_payload_is_bound(payload, &radio_profile_values.channel) && radio_profile_values.channel >= 0 && radio_profile_values.channel <= UINT8_MAX)
+    {
+        profile.channel = radio_profile_values.channel;
+    }
+
+    if (usb_talk_payload_is_bound(payload, &radio_profile_values.datarate))
+    {
+        profile.datarate = radio_profile_values.datarate;
+    }
+
+    if (usb_talk_payload_is_bound(payload, &radio_profile_values.fec))
+    {
+        profile.fec = radio_profile_values.fec;
+    }
+
+    if (usb_talk_payload_is_bound(payload, &radio_profile_values.power) && radio_profile_values.power >= BC_SPIRIT1_POWER_MIN && radio_profile_values.power <= BC_SPIRIT1_POWER_MAX)
+    {
+        profile.power = radio_profile_values.power;
+    }
+
+    bc_radio_set_profile(&profile);
+
+    radio_profile_get(NULL, NULL);
+}
+
+static void radio_survey_start(usb_talk_payload_t *payload, void *param)
+{
+    (void) param;
+
+    bc_spirit1_profile_t profile;
+    int first;
+    int last;
+    int dwell = RADIO_SURVEY_DWELL;
+    bool apply = false;
+
+    bc_radio_get_profile(&profile);
+
+    first = profile.channel;
+    last = profile.channel;
+
+    if (usb_talk_payload_is_bound(payload, &radio_survey_values.first))
+    {
+        first = radio_survey_values.first;
+    }
+
+    if (usb_talk_payload_is_bound(payload, &radio_survey_values.last))
+    {
+        last = radio_survey_values.last;
+    }
+
+    if (usb_talk_payload_is_bound(payload, &radio_survey_values.dwell))
+    {
+        dwell = radio_survey_values.dwell;
+    }
+
+    if (usb_talk_payload_is_bound(payload, &radio_survey_values.apply))
+    {
+        apply = radio_survey_values.apply;
+    }
+
+    if (first < 0 || last > UINT8_MAX || dwell <= 0)
+    {
+        return;
+    }
+
+    bc_radio_survey_start(first, last, dwell, apply);
+}
+
+static void usb_talk_mode_set(usb_talk_payload_t *payload, void *param)
+{
+    (void) param;
+
+    // Gateway asks for binary records, answer already comes in mode it asked for
+    if (usb_talk_payload_is_bound(payload, &usb_talk_mode_values.mode))
+    {
+        usb_talk_set_binary(usb_talk_mode_values.mode == 1);
+    }
+
+    usb_talk_publish_mode(PREFIX_TALK_BASE);
+}
+
+static void usb_talk_stats_get(usb_talk_payload_t *payload, void *param)
+{
+    (void) payload;
+    (void) param;
+
+    usb_talk_publish_stats(PREFIX_TALK_BASE);
+}
+
+static void usb_talk_stats_reset(usb_talk_payload_t *payload, void *param)
+{
+    (void) payload;
+    (void) param;
+
+    usb_talk_reset_stats();
+}
+
+static void usb_talk_overflow_set(usb_talk_payload_t *payload, void *param)
+{
+    (void) param;
+
+    // Live readings may be preferred over ones queued while gateway was not reading
+    if (usb_talk_payload_is_bound(payload, &usb_talk_overflow_values.overflow))
+    {
+        usb_talk_set_drop_oldest(usb_talk_overflow_values.overflow == 1);
+    }
+}
+
+static void ota_data(usb_talk_payload_t *payload, void *param)
+{
+    (void) param;
+
+    // Delta is uploaded by parts before it is sent to remote, part is decoded straight into buffer while it comes
+    if (!usb_talk_payload_is_bound(payload, &ota_data_values.offset) || ota_data_values.offset < 0 || !usb_talk_payload_is_bound(payload, &ota_data_values.data))
+    {
+        return;
+    }
+
+    bc_ota_write(ota_data_values.offset, ota_data_values.data, ota_data_values.length);
+}
+
+static void ota_send(usb_talk_payload_t *payload, void *param)
+{
+    (void) param;
+
+    if (!usb_talk_payload_is_bound(payload, &ota_send_values.device) || !usb_talk_payload_is_bound(payload, &ota_send_values.length) || ota_send_values.length <= 0)
+    {
+        return;
+    }
+
+    ota_device_address = strtoul(ota_send_values.device, NULL, 16);
+
+    // Remote hears about transfer in acknowledgement or beacon, result comes with bulk event
+    bool success = bc_radio_bulk_send(ota_device_address, BC_RADIO_BULK_TYPE_OTA, ota_send_values.length, bc_ota_read, NULL);
+
+    if (!success)
+    {
+        usb_talk_publish_ota(PREFIX_TALK_BASE, &ota_device_address, &success);
+    }
 }
 
 void application_init(void) {
@@ -100,10 +393,28 @@ void application_init(void) {
     bc_radio_init();
     bc_radio_set_event_handler(radio_event_handler, NULL);
     bc_radio_listen();
+
+    if (TDMA)
+    {
+        bc_radio_tdma_start(TDMA_SUPERFRAME, TDMA_SLOT_LENGTH);
+    }
+
+    usb_talk_sub(PREFIX_TALK_BASE "/radio/-/stats/get", radio_stats_get, NULL);
+    usb_talk_sub(PREFIX_TALK_BASE "/radio/-/stats/reset", radio_stats_reset, NULL);
+    usb_talk_sub(PREFIX_TALK_BASE "/radio/-/profile/get", radio_profile_get, NULL);
+    usb_talk_sub_bind(PREFIX_TALK_BASE "/radio/-/profile/set", radio_profile_binds, USB_TALK_BIND_COUNT(radio_profile_binds), &radio_profile_values, radio_profile_set, NULL);
+    usb_talk_sub_bind(PREFIX_TALK_BASE "/radio/-/survey/start", radio_survey_binds, USB_TALK_BIND_COUNT(radio_survey_binds), &radio_survey_values, radio_survey_start, NULL);
+    usb_talk_sub_bind(PREFIX_TALK_BASE "/usb-talk/-/mode/set", usb_talk_mode_binds, USB_TALK_BIND_COUNT(usb_talk_mode_binds), &usb_talk_mode_values, usb_talk_mode_set, NULL);
+    usb_talk_sub(PREFIX_TALK_BASE "/usb-talk/-/stats/get", usb_talk_stats_get, NULL);
+    usb_talk_sub(PREFIX_TALK_BASE "/usb-talk/-/stats/reset", usb_talk_stats_reset, NULL);
+    usb_talk_sub_bind(PREFIX_TALK_BASE "/usb-talk/-/overflow/set", usb_talk_overflow_binds, USB_TALK_BIND_COUNT(usb_talk_overflow_binds), &usb_talk_overflow_values, usb_talk_overflow_set, NULL);
+    usb_talk_sub_bind(PREFIX_TALK_BASE "/ota/-/data", ota_data_binds, USB_TALK_BIND_COUNT(ota_data_binds), &ota_data_values, ota_data, NULL);
+    usb_talk_sub_bind(PREFIX_TALK_BASE "/ota/-/send", ota_send_binds, USB_TALK_BIND_COUNT(ota_send_binds), &ota_send_values, ota_send, NULL);
 }
 
 void application_task()
 {
+    radio_stats_get(NULL, NULL);
 
-
-}
\ No newline at end of file
+    bc_scheduler_plan_current_relative(RADIO_STATS_INTERVAL);
+}
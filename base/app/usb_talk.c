@@ -1,38 +1,160 @@
 #include <usb_talk.h>
 #include <bc_scheduler.h>
 #include <bc_usb_cdc.h>
-#include <base64.h>
 #include <application.h>
 
-#define USB_TALK_TOKEN_ARRAY         0
-#define USB_TALK_TOKEN_TOPIC         1
-#define USB_TALK_TOKEN_PAYLOAD       2
-#define USB_TALK_TOKEN_PAYLOAD_KEY   3
-#define USB_TALK_TOKEN_PAYLOAD_VALUE 4
+// Tables are sized by application Makefile for topics it subscribes, subscription which does not fit is refused
+#ifndef USB_TALK_SUBSCRIBES
+#define USB_TALK_SUBSCRIBES 64
+#endif
 
-#define USB_TALK_SUBSCRIBES 16
+// Each distinct segment of subscribed topics takes one node of trie
+#ifndef USB_TALK_TOPIC_NODES
+#define USB_TALK_TOPIC_NODES 128
+#endif
+
+// Topic, key and value other than string or data are collected whole, longer ones are not matched
+#define USB_TALK_TOKEN_SIZE 96
+#define USB_TALK_MATCHES 8
+
+// Record is type, timestamp and peer device address, payload and CRC-16
+#define USB_TALK_RECORD_HEADER_LENGTH 9
+#define USB_TALK_RECORD_CRC_LENGTH 2
+#define USB_TALK_RECORD_MAX_VALUES 2
+
+// Topics of readings are kept formatted up to value, they are looked up by comparing their parts with cached text
+#define USB_TALK_TOPICS 8
+#define USB_TALK_TOPIC_SIZE 72
+#define USB_TALK_CHANNEL_NONE 0xff
+
+// Room reserved after topic for value of reading with rest of message
+#define USB_TALK_VALUE_SIZE 48
+
+// COBS adds one byte per 254 and delimiter
+#define USB_TALK_FRAME_SIZE(length) ((length) + (length) / 254 + 2)
+
+typedef enum
+{
+    _USB_TALK_STATE_ARRAY = 0,
+    _USB_TALK_STATE_TOPIC = 1,
+    _USB_TALK_STATE_TOPIC_STRING = 2,
+    _USB_TALK_STATE_COMMA = 3,
+    _USB_TALK_STATE_VALUE = 4,
+    _USB_TALK_STATE_KEY_FIRST = 5,
+    _USB_TALK_STATE_KEY = 6,
+    _USB_TALK_STATE_KEY_STRING = 7,
+    _USB_TALK_STATE_COLON = 8,
+    _USB_TALK_STATE_MEMBER_END = 9,
+    _USB_TALK_STATE_STRING = 10,
+    _USB_TALK_STATE_PRIMITIVE = 11,
+    _USB_TALK_STATE_NESTED = 12,
+    _USB_TALK_STATE_ARRAY_END = 13,
+    _USB_TALK_STATE_LINE_END = 14,
+    _USB_TALK_STATE_DISCARD = 15
+
+} _usb_talk_state_t;
 
 static struct
 {
-    char tx_buffer[256];
-    char rx_buffer[1024];
-    size_t rx_length;
-    bool rx_error;
+    // Sized for radio statistics with all counters at maximum
+    char tx_buffer[512];
+
+    // Message being written, text reading is written straight to transmit ring of USB and other ones to buffer above
+    char *tx;
+    size_t tx_size;
+    size_t tx_length;
+    bool tx_lost;
+
+    // Input is tokenized by bytes as it comes, values are bound straight into structures of matched subscriptions
+    _usb_talk_state_t rx_state;
+    bool rx_member;
+    bool rx_string;
+    bool rx_escape;
+    size_t rx_depth;
+    char rx_token[USB_TALK_TOKEN_SIZE];
+    size_t rx_token_length;
+
+    // Base64 is decoded by sextets, byte is ready once eight bits are collected
+    uint32_t rx_bits;
+    size_t rx_bit_count;
+    bool rx_padding;
+    bool rx_data_error;
+
+    struct {
+        uint8_t subscribe;
+        const usb_talk_bind_t *bind;
+        size_t length;
+        uint32_t bound;
+
+    } matches[USB_TALK_MATCHES];
+    size_t matches_length;
 
+    // Text message fits into record whole, frame is encoded straight to transmit ring of USB
+    bool binary;
+    uint8_t record[USB_TALK_RECORD_HEADER_LENGTH + 512 + USB_TALK_RECORD_CRC_LENGTH];
+
+    // Subscriptions of same topic are chained, links are index plus one so zero is end
     struct {
         const char *topic;
+        const usb_talk_bind_t *binds;
+        size_t bind_count;
+        void *values;
         usb_talk_sub_callback_t callback;
         void *param;
+        uint8_t next;
 
     } subscribes[USB_TALK_SUBSCRIBES];
     size_t subscribes_length;
 
+    // Trie of topic segments, segment text points into topic string given to subscribe
+    struct {
+        const char *segment;
+        uint8_t length;
+        uint8_t child;
+        uint8_t sibling;
+        uint8_t subscribe;
+
+    } nodes[USB_TALK_TOPIC_NODES];
+    size_t nodes_length;
+    uint8_t root;
+
+    struct {
+        uint8_t channel;
+        size_t length;
+        char text[USB_TALK_TOPIC_SIZE];
+
+    } topics[USB_TALK_TOPICS];
+    size_t topics_next;
+
 } _usb_talk;
 
-static void _usb_talk_task(void *param);
-static void _usb_talk_process_character(char character);
-static void _usb_talk_process_message(char *message, size_t length);
-static bool _usb_talk_token_get_int(const char *buffer, jsmntok_t *token, int *value);
+// Powers of ten for fixed-point readings with up to three decimals
+static const uint32_t _usb_talk_scales[] = { 1, 10, 100, 1000 };
+
+static void _usb_talk_cdc_event_handler(bc_usb_cdc_event_t event, void *event_param);
+static void _usb_talk_receive(char c);
+static void _usb_talk_token_append(char c);
+static void _usb_talk_match(uint8_t node, const char *topic, size_t length);
+static void _usb_talk_match_add(uint8_t subscribe);
+static void _usb_talk_value_begin(bool member);
+static void _usb_talk_value_char(char c);
+static void _usb_talk_value_end(bool string);
+static void _usb_talk_value_skip(void);
+static bool _usb_talk_token_get_int(int *value);
+static void _usb_talk_dispatch(void);
+static void _usb_talk_send_values(usb_talk_record_type_t type, uint32_t *peer_device_address, uint8_t channel, const float *values, size_t count);
+static void _usb_talk_send_record(usb_talk_record_type_t type, uint32_t *peer_device_address, const void *payload, size_t length);
+static uint16_t _usb_talk_crc16(const uint8_t *buffer, size_t length);
+static void _usb_talk_put_begin(size_t size);
+static void _usb_talk_put_topic(const char *prefix, const char *type, uint8_t channel, const char *quantity);
+static bool _usb_talk_topic_match(size_t index, const char *prefix, const char *type, uint8_t channel, const char *quantity);
+static bool _usb_talk_topic_match_part(const char **cursor, const char *end, const char *part, char separator);
+static void _usb_talk_put(const char *buffer, size_t length);
+static void _usb_talk_put_string(const char *string);
+static void _usb_talk_put_uint(uint32_t value);
+static void _usb_talk_put_fixed(float value, unsigned decimals);
+static bool _usb_talk_scale(float value, unsigned decimals, uint32_t *scaled, bool *negative);
+static void _usb_talk_put_end(void);
 
 void usb_talk_init(void)
 {
@@ -40,7 +162,7 @@ void usb_talk_init(void)
 
     bc_usb_cdc_init();
 
-    bc_scheduler_register(_usb_talk_task, NULL, 0);
+    bc_usb_cdc_set_event_handler(_usb_talk_cdc_event_handler, NULL);
 }
 
 void usb_talk_start(void)
@@ -48,20 +170,135 @@ void usb_talk_start(void)
     bc_usb_cdc_start();
 }
 
-void usb_talk_sub(const char *topic, usb_talk_sub_callback_t callback, void *param)
+bool usb_talk_sub(const char *topic, usb_talk_sub_callback_t callback, void *param)
 {
-    if (_usb_talk.subscribes_length >= USB_TALK_SUBSCRIBES){
-        return;
+    return usb_talk_sub_bind(topic, NULL, 0, NULL, callback, param);
+}
+
+bool usb_talk_sub_bind(const char *topic, const usb_talk_bind_t *binds, size_t bind_count, void *values, usb_talk_sub_callback_t callback, void *param)
+{
+    if (_usb_talk.subscribes_length >= USB_TALK_SUBSCRIBES || bind_count > 32)
+    {
+        return false;
+    }
+
+    uint8_t *link = &_usb_talk.root;
+    const char *segment = topic;
+    uint8_t node;
+
+    // New segments hang off the first one, unlinking it takes back whole topic which does not fit
+    uint8_t *attach = NULL;
+    size_t nodes_length = _usb_talk.nodes_length;
+
+    while (true)
+    {
+        const char *end = strchr(segment, '/');
+        size_t length = end != NULL ? (size_t) (end - segment) : strlen(segment);
+
+        for (node = *link; node != 0; node = _usb_talk.nodes[node - 1].sibling)
+        {
+            if (_usb_talk.nodes[node - 1].length == length && memcmp(_usb_talk.nodes[node - 1].segment, segment, length) == 0)
+            {
+                break;
+            }
+
+            link = &_usb_talk.nodes[node - 1].sibling;
+        }
+
+        if (node == 0)
+        {
+            if (_usb_talk.nodes_length >= USB_TALK_TOPIC_NODES || length > UINT8_MAX)
+            {
+                if (attach != NULL)
+                {
+                    *attach = 0;
+                }
+
+                _usb_talk.nodes_length = nodes_length;
+
+                return false;
+            }
+
+            node = ++_usb_talk.nodes_length;
+
+            // New segment goes last, subscriptions are called in order they were made
+            _usb_talk.nodes[node - 1].segment = segment;
+            _usb_talk.nodes[node - 1].length = length;
+
+            *link = node;
+
+            if (attach == NULL)
+            {
+                attach = link;
+            }
+        }
+
+        if (end == NULL)
+        {
+            break;
+        }
+
+        link = &_usb_talk.nodes[node - 1].child;
+        segment = end + 1;
     }
+
     _usb_talk.subscribes[_usb_talk.subscribes_length].topic = topic;
+    _usb_talk.subscribes[_usb_talk.subscribes_length].binds = binds;
+    _usb_talk.subscribes[_usb_talk.subscribes_length].bind_count = bind_count;
+    _usb_talk.subscribes[_usb_talk.subscribes_length].values = values;
     _usb_talk.subscribes[_usb_talk.subscribes_length].callback = callback;
     _usb_talk.subscribes[_usb_talk.subscribes_length].param = param;
+    _usb_talk.subscribes[_usb_talk.subscribes_length].next = 0;
     _usb_talk.subscribes_length++;
+
+    for (link = &_usb_talk.nodes[node - 1].subscribe; *link != 0; link = &_usb_talk.subscribes[*link - 1].next)
+    {
+        continue;
+    }
+
+    *link = _usb_talk.subscribes_length;
+
+    return true;
+}
+
+void usb_talk_set_binary(bool binary)
+{
+    _usb_talk.binary = binary;
+}
+
+bool usb_talk_is_binary(void)
+{
+    return _usb_talk.binary;
+}
+
+void usb_talk_set_drop_oldest(bool drop_oldest)
+{
+    bc_usb_cdc_set_overflow(drop_oldest ? BC_USB_CDC_OVERFLOW_DROP_OLDEST : BC_USB_CDC_OVERFLOW_REJECT);
+}
+
+void usb_talk_reset_stats(void)
+{
+    bc_usb_cdc_reset_stats();
 }
 
 void usb_talk_send_string(const char *buffer)
 {
-    bc_usb_cdc_write(buffer, strlen(buffer));
+    size_t length = strlen(buffer);
+
+    if (!_usb_talk.binary)
+    {
+        bc_usb_cdc_write(buffer, length);
+
+        return;
+    }
+
+    // Message without value of its own travels as text record, line end is left out
+    if (length > 0 && buffer[length - 1] == '\n')
+    {
+        length--;
+    }
+
+    _usb_talk_send_record(USB_TALK_RECORD_TEXT, NULL, buffer, length);
 }
 
 void usb_talk_publish_led(const char *prefix, bool *state)
@@ -73,8 +310,17 @@ void usb_talk_publish_led(const char *prefix, bool *state)
     usb_talk_send_string((const char *) _usb_talk.tx_buffer);
 }
 
-void usb_talk_publish_push_button(const char *prefix, uint16_t *event_count)
+void usb_talk_publish_push_button(const char *prefix, uint32_t *peer_device_address, uint16_t *event_count)
 {
+    if (_usb_talk.binary)
+    {
+        float value = *event_count;
+
+        _usb_talk_send_values(USB_TALK_RECORD_PUSH_BUTTON, peer_device_address, 0, &value, 1);
+
+        return;
+    }
+
     snprintf(_usb_talk.tx_buffer, sizeof(_usb_talk.tx_buffer),
              "[\"%s/push-button/-/event-count\", %" PRIu16 "]\n",
              prefix, *event_count);
@@ -82,19 +328,24 @@ void usb_talk_publish_push_button(const char *prefix, uint16_t *event_count)
     usb_talk_send_string((const char *) _usb_talk.tx_buffer);
 }
 
-void usb_talk_publish_thermometer(const char *prefix, uint8_t *i2c, float *temperature)
+void usb_talk_publish_thermometer(const char *prefix, uint32_t *peer_device_address, uint8_t *i2c, float *temperature)
 {
 
     uint8_t number = (*i2c & ~0x80) == BC_TAG_TEMPERATURE_I2C_ADDRESS_DEFAULT ? 0 : 1;
 
-    snprintf(_usb_talk.tx_buffer, sizeof(_usb_talk.tx_buffer),
-                "[\"%s/thermometer/%d:%d/temperature\", %0.2f]\n",
-                prefix, ((*i2c & 0x80) >> 7), number, *temperature);
+    if (_usb_talk.binary)
+    {
+        _usb_talk_send_values(USB_TALK_RECORD_THERMOMETER, peer_device_address, ((*i2c & 0x80) >> 3) | number, temperature, 1);
 
-    usb_talk_send_string((const char *) _usb_talk.tx_buffer);
+        return;
+    }
+
+    _usb_talk_put_topic(prefix, "thermometer", ((*i2c & 0x80) >> 3) | number, "temperature");
+    _usb_talk_put_fixed(*temperature, 2);
+    _usb_talk_put_end();
 }
 
-void usb_talk_publish_humidity_sensor(const char *prefix, uint8_t *i2c, float *relative_humidity)
+void usb_talk_publish_humidity_sensor(const char *prefix, uint32_t *peer_device_address, uint8_t *i2c, float *relative_humidity)
 {
 
     uint8_t number;
@@ -114,47 +365,67 @@ void usb_talk_publish_humidity_sensor(const char *prefix, uint8_t *i2c, float *r
             number = 0;
     }
 
-    snprintf(_usb_talk.tx_buffer, sizeof(_usb_talk.tx_buffer),
-                "[\"%s/hygrometer/%d:%d/relative-humidity\", %0.1f]\n",
-                prefix, ((*i2c & 0x80) >> 7), number, *relative_humidity);
+    if (_usb_talk.binary)
+    {
+        _usb_talk_send_values(USB_TALK_RECORD_HYGROMETER, peer_device_address, ((*i2c & 0x80) >> 3) | number, relative_humidity, 1);
 
-    usb_talk_send_string((const char *) _usb_talk.tx_buffer);
+        return;
+    }
+
+    _usb_talk_put_topic(prefix, "hygrometer", ((*i2c & 0x80) >> 3) | number, "relative-humidity");
+    _usb_talk_put_fixed(*relative_humidity, 1);
+    _usb_talk_put_end();
 }
 
-void usb_talk_publish_lux_meter(const char *prefix, uint8_t *i2c, float *illuminance)
+void usb_talk_publish_lux_meter(const char *prefix, uint32_t *peer_device_address, uint8_t *i2c, float *illuminance)
 {
 
     uint8_t number = (*i2c & ~0x80) == BC_TAG_LUX_METER_I2C_ADDRESS_DEFAULT ? 0 : 1;
 
-    snprintf(_usb_talk.tx_buffer, sizeof(_usb_talk.tx_buffer),
-                "[\"%s/lux-meter/%d:%d/illuminance\", %0.1f]\n",
-                prefix, ((*i2c & 0x80) >> 7), number, *illuminance);
+    if (_usb_talk.binary)
+    {
+        _usb_talk_send_values(USB_TALK_RECORD_LUX_METER, peer_device_address, ((*i2c & 0x80) >> 3) | number, illuminance, 1);
 
-    usb_talk_send_string((const char *) _usb_talk.tx_buffer);
+        return;
+    }
+
+    _usb_talk_put_topic(prefix, "lux-meter", ((*i2c & 0x80) >> 3) | number, "illuminance");
+    _usb_talk_put_fixed(*illuminance, 1);
+    _usb_talk_put_end();
 }
 
-void usb_talk_publish_barometer(const char *prefix, uint8_t *i2c, float *pressure, float *altitude)
+void usb_talk_publish_barometer(const char *prefix, uint32_t *peer_device_address, uint8_t *i2c, float *pressure, float *altitude)
 {
-    snprintf(_usb_talk.tx_buffer, sizeof(_usb_talk.tx_buffer),
-                "[\"%s/barometer/%d:0/pressure\", %0.2f]\n",
-                prefix, ((*i2c & 0x80) >> 7), *pressure);
+    if (_usb_talk.binary)
+    {
+        float values[2] = { *pressure, *altitude };
 
-    usb_talk_send_string((const char *) _usb_talk.tx_buffer);
+        _usb_talk_send_values(USB_TALK_RECORD_BAROMETER, peer_device_address, (*i2c & 0x80) >> 3, values, 2);
 
-    snprintf(_usb_talk.tx_buffer, sizeof(_usb_talk.tx_buffer),
-                "[\"%s/barometer/%d:0/altitude\", %0.2f]\n",
-                prefix, ((*i2c & 0x80) >> 7), *altitude);
+        return;
+    }
 
-    usb_talk_send_string((const char *) _usb_talk.tx_buffer);
+    _usb_talk_put_topic(prefix, "barometer", (*i2c & 0x80) >> 3, "pressure");
+    _usb_talk_put_fixed(*pressure, 2);
+    _usb_talk_put_end();
+
+    _usb_talk_put_topic(prefix, "barometer", (*i2c & 0x80) >> 3, "altitude");
+    _usb_talk_put_fixed(*altitude, 2);
+    _usb_talk_put_end();
 }
 
-void usb_talk_publish_co2_concentation(const char *prefix, float *concentration)
+void usb_talk_publish_co2_concentation(const char *prefix, uint32_t *peer_device_address, float *concentration)
 {
-    snprintf(_usb_talk.tx_buffer, sizeof(_usb_talk.tx_buffer),
-                "[\"%s/co2-meter/-/concentration\", %0.2f]\n",
-                prefix, *concentration);
+    if (_usb_talk.binary)
+    {
+        _usb_talk_send_values(USB_TALK_RECORD_CO2_METER, peer_device_address, 0, concentration, 1);
 
-    usb_talk_send_string((const char *) _usb_talk.tx_buffer);
+        return;
+    }
+
+    _usb_talk_put_topic(prefix, "co2-meter", USB_TALK_CHANNEL_NONE, "concentration");
+    _usb_talk_put_fixed(*concentration, 2);
+    _usb_talk_put_end();
 }
 
 void usb_talk_publish_light(const char *prefix, bool *state)
@@ -202,390 +473,1193 @@ void usb_talk_publish_led_strip_config(const char *prefix, const char *mode, int
     usb_talk_send_string((const char *) _usb_talk.tx_buffer);
 }
 
-static void _usb_talk_task(void *param)
+void usb_talk_publish_radio_stats(const char *prefix, bc_radio_stats_t *stats)
 {
-    (void) param;
+    snprintf(_usb_talk.tx_buffer, sizeof(_usb_talk.tx_buffer),
+                "[\"%s/radio/-/stats\", {\"queued\": %lu, \"replaced\": %lu, \"tx\": %lu, \"retx\": %lu, \"preempted\": %lu, \"rx\": %lu, \"dup\": %lu, "
+                "\"foreign\": %lu, \"discarded\": %lu, \"dropped\": %lu, \"rejected\": %lu, \"crc-error\": %lu, "
+                "\"overflow\": [%lu, %lu, %lu], \"high-water\": [%u, %u], \"rearm-us\": [%lu, %lu], \"wake-up\": [%lu, %lu], "
+                "\"ack-missed\": %lu, \"log\": [%lu, %lu, %lu, %u], \"tdma-unslotted\": %lu}]\n",
+                prefix, (unsigned long) stats->queued, (unsigned long) stats->pub_replaced,
+                (unsigned long) stats->transmitted,
+                (unsigned long) stats->retransmitted, (unsigned long) stats->preempted,
+                (unsigned long) stats->received,
+                (unsigned long) stats->duplicate, (unsigned long) stats->foreign,
+                (unsigned long) stats->rx_discarded, (unsigned long) stats->rx_dropped,
+                (unsigned long) stats->rx_rejected, (unsigned long) stats->rx_crc_error,
+                (unsigned long) stats->pub_queue_overflow, (unsigned long) stats->rx_queue_overflow,
+                (unsigned long) stats->relay_queue_overflow,
+                (unsigned) stats->pub_queue_high_water, (unsigned) stats->rx_queue_high_water,
+                (unsigned long) stats->rx_rearm_time[0], (unsigned long) stats->rx_rearm_time[1],
+                (unsigned long) stats->wake_up_count, (unsigned long) stats->wake_up_time,
+                (unsigned long) stats->ack_missed, (unsigned long) stats->logged,
+                (unsigned long) stats->replayed, (unsigned long) stats->log_overflow,
+                (unsigned) stats->log_length, (unsigned long) stats->tdma_unslotted);
 
-    while (true)
-    {
-        static uint8_t buffer[16];
+    usb_talk_send_string((const char *) _usb_talk.tx_buffer);
+}
 
-        size_t length = bc_usb_cdc_read(buffer, sizeof(buffer));
+void usb_talk_publish_alarm(const char *prefix, uint32_t *peer_device_address, bc_radio_alarm_t *alarm, bool *active, float *value)
+{
+    if (_usb_talk.binary)
+    {
+        float values[2] = { *active ? 1.0f : 0.0f, *value };
 
-        if (length == 0)
-        {
-            break;
-        }
+        _usb_talk_send_values(USB_TALK_RECORD_ALARM, peer_device_address, *alarm, values, 2);
 
-        for (size_t i = 0; i < length; i++)
-        {
-            _usb_talk_process_character((char) buffer[i]);
-        }
+        return;
     }
 
-    bc_scheduler_plan_current_now();
+    _usb_talk_put_topic(prefix, "alarm", USB_TALK_CHANNEL_NONE, *alarm == BC_RADIO_ALARM_CO2 ? "co2" : "temperature");
+    _usb_talk_put_string(*active ? "{\"active\": true, \"value\": " : "{\"active\": false, \"value\": ");
+    _usb_talk_put_fixed(*value, 2);
+    _usb_talk_put_string("}");
+    _usb_talk_put_end();
 }
 
-static void _usb_talk_process_character(char character)
+void usb_talk_publish_replay(const char *prefix, uint32_t *peer_device_address, uint32_t *age)
 {
-    if (character == '\n')
+    if (_usb_talk.binary)
     {
-        if (!_usb_talk.rx_error && _usb_talk.rx_length > 0)
-        {
-            _usb_talk_process_message(_usb_talk.rx_buffer, _usb_talk.rx_length);
-        }
-
-        _usb_talk.rx_length = 0;
-        _usb_talk.rx_error = false;
+        // Age is sent as integer, end of replay is record without value
+        _usb_talk_send_record(USB_TALK_RECORD_REPLAY, peer_device_address, age, age != NULL ? sizeof(*age) : 0);
 
         return;
     }
 
-    if (_usb_talk.rx_length == sizeof(_usb_talk.rx_buffer))
+    // Readings published until null is sent come from log of remote, age is in milliseconds
+    if (age == NULL)
     {
-        _usb_talk.rx_error = true;
+        snprintf(_usb_talk.tx_buffer, sizeof(_usb_talk.tx_buffer),
+                    "[\"%s/radio/-/replay\", null]\n",
+                    prefix);
     }
     else
     {
-        if (!_usb_talk.rx_error)
-        {
-            _usb_talk.rx_buffer[_usb_talk.rx_length++] = character;
-        }
+        snprintf(_usb_talk.tx_buffer, sizeof(_usb_talk.tx_buffer),
+                    "[\"%s/radio/-/replay\", %lu]\n",
+                    prefix, (unsigned long) *age);
     }
+
+    usb_talk_send_string((const char *) _usb_talk.tx_buffer);
 }
 
-static void _usb_talk_process_message(char *message, size_t length)
+void usb_talk_publish_mode(const char *prefix)
 {
-    static jsmn_parser parser;
-    static jsmntok_t tokens[16];
+    snprintf(_usb_talk.tx_buffer, sizeof(_usb_talk.tx_buffer),
+                "[\"%s/usb-talk/-/mode\", \"%s\"]\n",
+                prefix, _usb_talk.binary ? "binary" : "text");
 
-    jsmn_init(&parser);
+    usb_talk_send_string((const char *) _usb_talk.tx_buffer);
+}
 
-    int token_count = jsmn_parse(&parser, (const char *) message, length, tokens, sizeof(tokens));
+void usb_talk_publish_stats(const char *prefix)
+{
+    bc_usb_cdc_stats_t stats;
 
-    if (token_count < 3)
-    {
-        return;
-    }
+    bc_usb_cdc_get_stats(&stats);
 
-    if (tokens[USB_TALK_TOKEN_ARRAY].type != JSMN_ARRAY || tokens[USB_TALK_TOKEN_ARRAY].size != 2)
-    {
-        return;
-    }
+    // Messages refused for lack of room in transmit ring and bytes of queued messages dropped for newer ones
+    snprintf(_usb_talk.tx_buffer, sizeof(_usb_talk.tx_buffer),
+                "[\"%s/usb-talk/-/stats\", {\"written\": %lu, \"rejected\": %lu, \"dropped\": %lu, \"high-water\": %u}]\n",
+                prefix, (unsigned long) stats.written, (unsigned long) stats.rejected,
+                (unsigned long) stats.dropped, (unsigned) stats.high_water);
 
-    if (tokens[USB_TALK_TOKEN_TOPIC].type != JSMN_STRING || tokens[USB_TALK_TOKEN_TOPIC].size != 0)
-    {
-        return;
-    }
+    usb_talk_send_string((const char *) _usb_talk.tx_buffer);
+}
 
-    for (size_t i = 0; i < _usb_talk.subscribes_length; i++)
-    {
-        if (usb_talk_is_string_token_equal(message, &tokens[USB_TALK_TOKEN_TOPIC], _usb_talk.subscribes[i].topic))
-        {
-            usb_talk_payload_t payload = {
-                    message,
-                    token_count - USB_TALK_TOKEN_PAYLOAD,
-                    tokens + USB_TALK_TOKEN_PAYLOAD
-            };
-            _usb_talk.subscribes[i].callback(&payload, _usb_talk.subscribes[i].param);
-        }
-    }
+void usb_talk_publish_ota(const char *prefix, uint32_t *device_address, bool *success)
+{
+    snprintf(_usb_talk.tx_buffer, sizeof(_usb_talk.tx_buffer),
+                "[\"%s/ota/-/result\", {\"device\": \"%08lx\", \"success\": %s}]\n",
+                prefix, (unsigned long) *device_address, *success ? "true" : "false");
+
+    usb_talk_send_string((const char *) _usb_talk.tx_buffer);
 }
 
-bool usb_talk_payload_get_bool(usb_talk_payload_t *payload, bool *value)
+void usb_talk_publish_radio_profile(const char *prefix, bc_spirit1_profile_t *profile)
 {
-    if (usb_talk_is_string_token_equal(payload->buffer, &payload->tokens[0], "true"))
-    {
-        *value = true;
-        return true;
-    }
-    else if (usb_talk_is_string_token_equal(payload->buffer, &payload->tokens[0], "false"))
-    {
-        *value = false;
-        return true;
-    }
-    return false;
+    static const unsigned long datarates[BC_SPIRIT1_DATARATE_COUNT] = { 9600, 19200, 38400, 100000 };
+
+    snprintf(_usb_talk.tx_buffer, sizeof(_usb_talk.tx_buffer),
+                "[\"%s/radio/-/profile\", {\"channel\": %u, \"datarate\": %lu, \"fec\": %s, \"power\": %d}]\n",
+                prefix, (unsigned) profile->channel, datarates[profile->datarate],
+                profile->fec ? "true" : "false", (int) profile->power);
+
+    usb_talk_send_string((const char *) _usb_talk.tx_buffer);
 }
 
-bool usb_talk_payload_get_key_bool(usb_talk_payload_t *payload, const char *key, bool *value)
+void usb_talk_publish_radio_survey(const char *prefix, bc_radio_survey_t *survey)
 {
-    if (payload->tokens[0].type != JSMN_OBJECT)
+    _usb_talk_put_begin(0);
+
+    _usb_talk_put_string("[\"");
+    _usb_talk_put_string(prefix);
+    _usb_talk_put_string("/radio/-/survey\", {\"quietest\": ");
+    _usb_talk_put_uint(survey->quietest);
+    _usb_talk_put_string(", \"channels\": [");
+
+    // Every channel is channel number, percentage of busy samples, average and maximum level in dBm
+    for (size_t i = 0; i < survey->count; i++)
     {
-        return false;
+        bc_radio_survey_channel_t *channel = &survey->channels[i];
+
+        unsigned busy = channel->samples != 0 ? (100U * channel->busy + channel->samples / 2) / channel->samples : 0;
+
+        _usb_talk_put_string(i == 0 ? "[" : ", [");
+        _usb_talk_put_uint(channel->channel);
+        _usb_talk_put_string(", ");
+        _usb_talk_put_uint(busy);
+        _usb_talk_put_string(", ");
+        _usb_talk_put_fixed(channel->rssi_average, 1);
+        _usb_talk_put_string(", ");
+        _usb_talk_put_fixed(channel->rssi_max, 1);
+        _usb_talk_put_string("]");
     }
 
-    for (int i = 1; i + 1 < payload->token_count; i += 2)
+    _usb_talk_put_string("]}");
+    _usb_talk_put_end();
+}
+
+static void _usb_talk_send_values(usb_talk_record_type_t type, uint32_t *peer_device_address, uint8_t channel, const float *values, size_t count)
+{
+    uint8_t payload[1 + USB_TALK_RECORD_MAX_VALUES * sizeof(int32_t)];
+
+    payload[0] = channel;
+
+    // Values are hundredths of unit scaled in integers the same way as text, pressure in pascals stays exact without float arithmetic
+    for (size_t i = 0; i < count; i++)
     {
-        if (usb_talk_is_string_token_equal(payload->buffer, &payload->tokens[i], key))
+        uint32_t scaled;
+        bool negative;
+        int32_t value;
+
+        // Lowest integer stands for value which has no number
+        if (!_usb_talk_scale(values[i], 2, &scaled, &negative) || scaled > INT32_MAX)
         {
-            if (usb_talk_is_string_token_equal(payload->buffer, &payload->tokens[i + 1], "true"))
-            {
-                *value = true;
-                return true;
-            }
-            else if (usb_talk_is_string_token_equal(payload->buffer, &payload->tokens[i + 1], "false"))
-            {
-                *value = false;
-                return true;
-            }
-            else
-            {
-                return false;
-            }
+            value = INT32_MIN;
+        }
+        else
+        {
+            value = negative ? -(int32_t) scaled : (int32_t) scaled;
         }
+
+        memcpy(&payload[1 + i * sizeof(value)], &value, sizeof(value));
     }
-    return false;
+
+    _usb_talk_send_record(type, peer_device_address, payload, 1 + count * sizeof(int32_t));
 }
 
-bool usb_talk_payload_get_data(usb_talk_payload_t *payload, uint8_t *buffer, size_t *length)
+static void _usb_talk_send_record(usb_talk_record_type_t type, uint32_t *peer_device_address, const void *payload, size_t length)
 {
-    if (payload->tokens[0].type != JSMN_STRING)
+    uint8_t *record = _usb_talk.record;
+    uint32_t timestamp = bc_tick_get();
+    uint32_t peer = peer_device_address != NULL ? *peer_device_address : 0;
+
+    if (USB_TALK_RECORD_HEADER_LENGTH + length + USB_TALK_RECORD_CRC_LENGTH > sizeof(_usb_talk.record))
     {
-        return false;
+        return;
     }
 
-    uint32_t input_length = payload->tokens[0].end - payload->tokens[0].start;
+    record[0] = type;
+    memcpy(&record[1], &timestamp, sizeof(timestamp));
+    memcpy(&record[5], &peer, sizeof(peer));
+    memcpy(&record[USB_TALK_RECORD_HEADER_LENGTH], payload, length);
 
-    size_t data_length = base64_calculate_decode_length(&payload->buffer[payload->tokens[0].start], input_length);
+    length += USB_TALK_RECORD_HEADER_LENGTH;
 
-    if (data_length > *length)
-    {
-        return false;
-    }
+    uint16_t crc = _usb_talk_crc16(record, length);
 
-    return base64_decode(&payload->buffer[payload->tokens[0].start], input_length, buffer, (uint32_t *)length);
-}
+    memcpy(&record[length], &crc, sizeof(crc));
 
-bool usb_talk_payload_get_key_data(usb_talk_payload_t *payload, const char *key, uint8_t *buffer, size_t *length)
-{
-    if (payload->tokens[0].type != JSMN_OBJECT)
+    length += sizeof(crc);
+
+    // COBS replaces every zero by distance to next one, so zero only ends frame
+    uint8_t *frame = bc_usb_cdc_write_reserve(USB_TALK_FRAME_SIZE(length));
+
+    if (frame == NULL)
     {
-        return false;
+        return;
     }
 
-    for (int i = 1; i + 1 < payload->token_count; i += 2)
+    size_t code_index = 0;
+    size_t frame_length = 1;
+    uint8_t code = 1;
+
+    for (size_t i = 0; i < length; i++)
     {
-        if (usb_talk_is_string_token_equal(payload->buffer, &payload->tokens[i], key))
+        if (record[i] != 0)
         {
-            if (payload->tokens[i + 1].type != JSMN_STRING)
-            {
-                return false;
-            }
+            frame[frame_length++] = record[i];
 
-            uint32_t input_length = payload->tokens[i + 1].end - payload->tokens[i + 1].start;
+            code++;
+        }
 
-            size_t data_length = base64_calculate_decode_length(&payload->buffer[payload->tokens[i + 1].start], input_length);
+        if (record[i] == 0 || code == 0xff)
+        {
+            frame[code_index] = code;
 
-            if (data_length > *length)
-            {
-                return false;
-            }
+            code_index = frame_length++;
 
-            return base64_decode(&payload->buffer[payload->tokens[i + 1].start], input_length, buffer, (uint32_t *)length);
+            code = 1;
         }
     }
-    return false;
+
+    frame[code_index] = code;
+    frame[frame_length++] = 0;
+
+    bc_usb_cdc_write_commit(frame_length);
 }
 
-bool usb_talk_payload_get_enum(usb_talk_payload_t *payload, int *value, ...)
+static uint16_t _usb_talk_crc16(const uint8_t *buffer, size_t length)
 {
-    char temp[11];
-    char *str;
-    int j = 0;
+    uint16_t crc = 0xffff;
 
-    jsmntok_t *token = &payload->tokens[0];
-
-    if (token->type != JSMN_STRING)
+    // CRC-16/CCITT-FALSE, same as binascii.crc_hqx with initial value 0xffff
+    for (size_t i = 0; i < length; i++)
     {
-        return false;
+        crc ^= (uint16_t) buffer[i] << 8;
+
+        for (int bit = 0; bit < 8; bit++)
+        {
+            crc = (crc & 0x8000) != 0 ? (crc << 1) ^ 0x1021 : crc << 1;
+        }
     }
 
-    size_t length = token->end - token->start;
+    return crc;
+}
+
+static void _usb_talk_put_begin(size_t size)
+{
+    _usb_talk.tx = _usb_talk.tx_buffer;
+    _usb_talk.tx_size = sizeof(_usb_talk.tx_buffer);
+    _usb_talk.tx_length = 0;
+    _usb_talk.tx_lost = false;
 
-    if (length > (sizeof(temp) - 1))
+    // Message of unknown size and message wrapped into record later are copied once they are complete
+    if (size == 0 || _usb_talk.binary)
     {
-        return false;
+        return;
     }
 
-    memset(temp, 0x00, sizeof(temp));
+    char *reserved = bc_usb_cdc_write_reserve(size);
 
-    strncpy(temp, payload->buffer + token->start, length);
-
-    va_list vl;
-    va_start(vl, value);
-    str = va_arg(vl, char*);
-    while (str != NULL)
+    // Message which does not fit is written to buffer all the same and thrown away, USB counts it as rejected
+    if (reserved == NULL)
     {
-        if (strcmp(str, temp) == 0)
-        {
-            *value = j;
-            return true;
-        }
-        str = va_arg(vl, char*);
-        j++;
+        _usb_talk.tx_lost = true;
+
+        return;
     }
-    va_end(vl);
 
-    return false;
+    _usb_talk.tx = reserved;
+    _usb_talk.tx_size = size;
 }
 
-bool usb_talk_payload_get_key_enum(usb_talk_payload_t *payload, const char *key, int *value, ...)
+static void _usb_talk_put_topic(const char *prefix, const char *type, uint8_t channel, const char *quantity)
 {
-    char temp[11];
-    char *str;
-    int j = 0;
+    const char *text = _usb_talk.tx_buffer;
+    int length = -1;
 
-    if (payload->tokens[0].type != JSMN_OBJECT)
+    for (size_t i = 0; i < USB_TALK_TOPICS; i++)
     {
-        return false;
+        if (_usb_talk_topic_match(i, prefix, type, channel, quantity))
+        {
+            text = _usb_talk.topics[i].text;
+            length = _usb_talk.topics[i].length;
+
+            break;
+        }
     }
 
-    for (int i = 1; i + 1 < payload->token_count; i += 2)
+    if (length < 0)
     {
-        if (usb_talk_is_string_token_equal(payload->buffer, &payload->tokens[i], key))
+        if (channel == USB_TALK_CHANNEL_NONE)
+        {
+            length = snprintf(_usb_talk.tx_buffer, sizeof(_usb_talk.tx_buffer), "[\"%s/%s/-/%s\", ", prefix, type, quantity);
+        }
+        else
         {
+            length = snprintf(_usb_talk.tx_buffer, sizeof(_usb_talk.tx_buffer), "[\"%s/%s/%u:%u/%s\", ",
+                        prefix, type, (unsigned) (channel >> 4), (unsigned) (channel & 0x0f), quantity);
+        }
 
-            jsmntok_t *token = &payload->tokens[i + 1];
-            size_t length = token->end - token->start;
+        if (length < 0 || (size_t) length > sizeof(_usb_talk.tx_buffer) - USB_TALK_VALUE_SIZE)
+        {
+            length = 0;
+        }
 
-            if (length > (sizeof(temp) - 1))
-            {
-                return false;
-            }
+        // Topic too long for cache is formatted every time, entries are replaced in turn as there are fewer topics
+        // than entries with usual set of tags
+        if (length != 0 && (size_t) length <= USB_TALK_TOPIC_SIZE)
+        {
+            size_t i = _usb_talk.topics_next;
 
-            memset(temp, 0x00, sizeof(temp));
+            _usb_talk.topics_next = (i + 1) % USB_TALK_TOPICS;
 
-            strncpy(temp, payload->buffer + token->start, length);
+            _usb_talk.topics[i].channel = channel;
+            _usb_talk.topics[i].length = length;
 
-            va_list vl;
-            va_start(vl, value);
-            str = va_arg(vl, char*);
-            while (str != NULL)
-            {
-                if (strcmp(str, temp) == 0)
-                {
-                    *value = j;
-                    return true;
+            memcpy(_usb_talk.topics[i].text, _usb_talk.tx_buffer, length);
+        }
+    }
+
+    // Size of message is known well enough once topic is, so it is reserved right away
+    _usb_talk_put_begin(length + USB_TALK_VALUE_SIZE);
+
+    _usb_talk_put(text, length);
+}
+
+static bool _usb_talk_topic_match(size_t index, const char *prefix, const char *type, uint8_t channel, const char *quantity)
+{
+    // Parts are compared by content, caller may format them into buffer which it reuses
+    const char *cursor = _usb_talk.topics[index].text + 2;
+    const char *end = _usb_talk.topics[index].text + _usb_talk.topics[index].length;
+
+    if (_usb_talk.topics[index].length == 0 || _usb_talk.topics[index].channel != channel)
+    {
+        return false;
+    }
+
+    if (!_usb_talk_topic_match_part(&cursor, end, prefix, '/') || !_usb_talk_topic_match_part(&cursor, end, type, '/'))
+    {
+        return false;
+    }
+
+    // Channel was compared as number, its segment is skipped
+    cursor = memchr(cursor, '/', end - cursor);
+
+    if (cursor == NULL)
+    {
+        return false;
+    }
+
+    cursor++;
+
+    // Text ends with quote, comma and space
+    return _usb_talk_topic_match_part(&cursor, end, quantity, '"') && end - cursor == 2;
+}
+
+static bool _usb_talk_topic_match_part(const char **cursor, const char *end, const char *part, char separator)
+{
+    size_t length = strlen(part);
+
+    if ((size_t) (end - *cursor) <= length || memcmp(*cursor, part, length) != 0 || (*cursor)[length] != separator)
+    {
+        return false;
+    }
+
+    *cursor += length + 1;
+
+    return true;
+}
+
+static void _usb_talk_put(const char *buffer, size_t length)
+{
+    // Room is left for end of message, message which does not fit is cut
+    size_t size = _usb_talk.tx_size - sizeof("]\n");
+
+    if (_usb_talk.tx_length + length > size)
+    {
+        length = size - _usb_talk.tx_length;
+    }
+
+    // Topic formatted to buffer may be put to the same place
+    memmove(&_usb_talk.tx[_usb_talk.tx_length], buffer, length);
+
+    _usb_talk.tx_length += length;
+}
+
+static void _usb_talk_put_string(const char *string)
+{
+    _usb_talk_put(string, strlen(string));
+}
+
+static void _usb_talk_put_uint(uint32_t value)
+{
+    char digits[10];
+    size_t i = sizeof(digits);
+
+    do
+    {
+        digits[--i] = '0' + value % 10;
+
+        value /= 10;
+    }
+    while (value != 0);
+
+    _usb_talk_put(&digits[i], sizeof(digits) - i);
+}
+
+static void _usb_talk_put_fixed(float value, unsigned decimals)
+{
+    uint32_t scaled;
+    bool negative;
+
+    // Infinity, NaN and value out of range have no JSON number
+    if (!_usb_talk_scale(value, decimals, &scaled, &negative))
+    {
+        _usb_talk_put_string("null");
+
+        return;
+    }
+
+    if (negative && scaled != 0)
+    {
+        _usb_talk_put_string("-");
+    }
+
+    _usb_talk_put_uint(scaled / _usb_talk_scales[decimals]);
+
+    if (decimals == 0)
+    {
+        return;
+    }
+
+    char fraction[4] = { '.' };
+    uint32_t remainder = scaled % _usb_talk_scales[decimals];
+
+    for (unsigned i = decimals; i > 0; i--)
+    {
+        fraction[i] = '0' + remainder % 10;
+
+        remainder /= 10;
+    }
+
+    _usb_talk_put(fraction, decimals + 1);
+}
+
+static bool _usb_talk_scale(float value, unsigned decimals, uint32_t *scaled, bool *negative)
+{
+    uint32_t bits;
+
+    memcpy(&bits, &value, sizeof(bits));
+
+    // Float is mantissa times power of two, it is scaled and rounded in integers so no float formatting is linked in
+    int exponent = (int) ((bits >> 23) & 0xff);
+    uint64_t mantissa = bits & 0x7fffff;
+
+    // Infinity and NaN have no number
+    if (exponent == 0xff || decimals >= sizeof(_usb_talk_scales) / sizeof(_usb_talk_scales[0]))
+    {
+        return false;
+    }
+
+    if (exponent == 0)
+    {
+        exponent = 1;
+    }
+    else
+    {
+        mantissa |= 0x800000;
+    }
+
+    exponent -= 150;
+    mantissa *= _usb_talk_scales[decimals];
+
+    uint64_t result;
+
+    if (exponent >= 0)
+    {
+        result = exponent < 8 ? mantissa << exponent : UINT64_MAX;
+    }
+    else if (exponent > -64)
+    {
+        // Tie is rounded to even the way printf does it
+        uint64_t half = (uint64_t) 1 << (-exponent - 1);
+        uint64_t remainder = mantissa & ((half << 1) - 1);
+
+        result = mantissa >> -exponent;
+
+        if (remainder > half || (remainder == half && (result & 1) != 0))
+        {
+            result++;
+        }
+    }
+    else
+    {
+        result = 0;
+    }
+
+    // Readings are far below this, larger value would need 64-bit division
+    if (result > UINT32_MAX)
+    {
+        return false;
+    }
+
+    *scaled = (uint32_t) result;
+    *negative = (bits & 0x80000000) != 0;
+
+    return true;
+}
+
+static void _usb_talk_put_end(void)
+{
+    memcpy(&_usb_talk.tx[_usb_talk.tx_length], "]\n", sizeof("]\n"));
+
+    if (_usb_talk.tx != _usb_talk.tx_buffer)
+    {
+        bc_usb_cdc_write_commit(_usb_talk.tx_length + sizeof("]\n") - 1);
+    }
+    else if (!_usb_talk.tx_lost)
+    {
+        usb_talk_send_string((const char *) _usb_talk.tx_buffer);
+    }
+}
+
+static void _usb_talk_cdc_event_handler(bc_usb_cdc_event_t event, void *event_param)
+{
+    (void) event_param;
+
+    if (event != BC_USB_CDC_EVENT_RECEIVE)
+    {
+        return;
+    }
+
+    const void *span;
+    size_t length;
+
+    while ((length = bc_usb_cdc_read_peek(&span)) != 0)
+    {
+        const char *data = span;
+
+        for (size_t i = 0; i < length; i++)
+        {
+            _usb_talk_receive(data[i]);
+        }
+
+        bc_usb_cdc_read_consume(length);
+    }
+}
+
+static void _usb_talk_receive(char c)
+{
+    // Every line is parsed anew, message is taken only if line ends right after it
+    if (c == '\n')
+    {
+        if (_usb_talk.rx_state == _USB_TALK_STATE_LINE_END)
+        {
+            _usb_talk_dispatch();
+        }
+
+        _usb_talk.rx_state = _USB_TALK_STATE_ARRAY;
+
+        return;
+    }
+
+    bool space = c == ' ' || c == '\t' || c == '\r';
+
+    switch (_usb_talk.rx_state)
+    {
+        case _USB_TALK_STATE_ARRAY:
+        {
+            if (!space)
+            {
+                _usb_talk.rx_state = c == '[' ? _USB_TALK_STATE_TOPIC : _USB_TALK_STATE_DISCARD;
+            }
+
+            break;
+        }
+        case _USB_TALK_STATE_TOPIC:
+        {
+            if (!space)
+            {
+                _usb_talk.rx_token_length = 0;
+
+                _usb_talk.rx_state = c == '"' ? _USB_TALK_STATE_TOPIC_STRING : _USB_TALK_STATE_DISCARD;
+            }
+
+            break;
+        }
+        case _USB_TALK_STATE_TOPIC_STRING:
+        {
+            if (c == '\\')
+            {
+                _usb_talk.rx_state = _USB_TALK_STATE_DISCARD;
+            }
+            else if (c != '"')
+            {
+                _usb_talk_token_append(c);
+            }
+            else
+            {
+                _usb_talk.matches_length = 0;
+
+                if (_usb_talk.rx_token_length < USB_TALK_TOKEN_SIZE)
+                {
+                    _usb_talk_match(_usb_talk.root, _usb_talk.rx_token, _usb_talk.rx_token_length);
                 }
-                str = va_arg(vl, char*);
-                j++;
+
+                // Rest of message nobody listens to is not parsed
+                _usb_talk.rx_state = _usb_talk.matches_length != 0 ? _USB_TALK_STATE_COMMA : _USB_TALK_STATE_DISCARD;
             }
-            va_end(vl);
 
-            return false;
+            break;
+        }
+        case _USB_TALK_STATE_COMMA:
+        {
+            if (!space)
+            {
+                _usb_talk_value_begin(false);
+
+                _usb_talk.rx_state = c == ',' ? _USB_TALK_STATE_VALUE : _USB_TALK_STATE_DISCARD;
+            }
+
+            break;
+        }
+        case _USB_TALK_STATE_VALUE:
+        {
+            if (space)
+            {
+                break;
+            }
+
+            if (c == '"')
+            {
+                _usb_talk.rx_escape = false;
+
+                _usb_talk.rx_state = _USB_TALK_STATE_STRING;
+            }
+            else if (c == '{' && !_usb_talk.rx_member)
+            {
+                _usb_talk_value_skip();
+
+                _usb_talk.rx_state = _USB_TALK_STATE_KEY_FIRST;
+            }
+            else if (c == '{' || c == '[')
+            {
+                _usb_talk_value_skip();
+
+                _usb_talk.rx_depth = 1;
+                _usb_talk.rx_string = false;
+                _usb_talk.rx_escape = false;
+
+                _usb_talk.rx_state = _USB_TALK_STATE_NESTED;
+            }
+            else if (c == ',' || c == '}' || c == ']')
+            {
+                _usb_talk.rx_state = _USB_TALK_STATE_DISCARD;
+            }
+            else
+            {
+                _usb_talk_token_append(c);
+
+                _usb_talk.rx_state = _USB_TALK_STATE_PRIMITIVE;
+            }
+
+            break;
+        }
+        case _USB_TALK_STATE_KEY_FIRST:
+        case _USB_TALK_STATE_KEY:
+        {
+            if (space)
+            {
+                break;
+            }
+
+            if (c == '"')
+            {
+                _usb_talk.rx_token_length = 0;
+                _usb_talk.rx_escape = false;
+
+                _usb_talk.rx_state = _USB_TALK_STATE_KEY_STRING;
+            }
+            else if (c == '}' && _usb_talk.rx_state == _USB_TALK_STATE_KEY_FIRST)
+            {
+                _usb_talk.rx_member = false;
+
+                _usb_talk.rx_state = _USB_TALK_STATE_ARRAY_END;
+            }
+            else
+            {
+                _usb_talk.rx_state = _USB_TALK_STATE_DISCARD;
+            }
+
+            break;
+        }
+        case _USB_TALK_STATE_KEY_STRING:
+        {
+            if (c == '"' && !_usb_talk.rx_escape)
+            {
+                _usb_talk_value_begin(true);
+
+                _usb_talk.rx_state = _USB_TALK_STATE_COLON;
+            }
+            else
+            {
+                _usb_talk.rx_escape = c == '\\' && !_usb_talk.rx_escape;
+
+                _usb_talk_token_append(c);
+            }
+
+            break;
+        }
+        case _USB_TALK_STATE_COLON:
+        {
+            if (!space)
+            {
+                _usb_talk.rx_state = c == ':' ? _USB_TALK_STATE_VALUE : _USB_TALK_STATE_DISCARD;
+            }
+
+            break;
+        }
+        case _USB_TALK_STATE_MEMBER_END:
+        {
+            if (space)
+            {
+                break;
+            }
+
+            if (c == ',')
+            {
+                _usb_talk.rx_state = _USB_TALK_STATE_KEY;
+            }
+            else if (c == '}')
+            {
+                _usb_talk.rx_member = false;
+
+                _usb_talk.rx_state = _USB_TALK_STATE_ARRAY_END;
+            }
+            else
+            {
+                _usb_talk.rx_state = _USB_TALK_STATE_DISCARD;
+            }
+
+            break;
+        }
+        case _USB_TALK_STATE_STRING:
+        {
+            // Escape sequence is kept as it is written, it only must not end string
+            if (c == '"' && !_usb_talk.rx_escape)
+            {
+                _usb_talk_value_end(true);
+
+                _usb_talk.rx_state = _usb_talk.rx_member ? _USB_TALK_STATE_MEMBER_END : _USB_TALK_STATE_ARRAY_END;
+            }
+            else
+            {
+                _usb_talk.rx_escape = c == '\\' && !_usb_talk.rx_escape;
+
+                _usb_talk_value_char(c);
+            }
+
+            break;
+        }
+        case _USB_TALK_STATE_PRIMITIVE:
+        {
+            if (space || c == ',' || c == '}' || c == ']')
+            {
+                _usb_talk_value_end(false);
+
+                _usb_talk.rx_state = _usb_talk.rx_member ? _USB_TALK_STATE_MEMBER_END : _USB_TALK_STATE_ARRAY_END;
+
+                _usb_talk_receive(c);
+            }
+            else
+            {
+                _usb_talk_token_append(c);
+            }
+
+            break;
+        }
+        case _USB_TALK_STATE_NESTED:
+        {
+            if (_usb_talk.rx_string)
+            {
+                if (c == '"' && !_usb_talk.rx_escape)
+                {
+                    _usb_talk.rx_string = false;
+                }
+
+                _usb_talk.rx_escape = c == '\\' && !_usb_talk.rx_escape;
+            }
+            else if (c == '"')
+            {
+                _usb_talk.rx_string = true;
+            }
+            else if (c == '{' || c == '[')
+            {
+                _usb_talk.rx_depth++;
+            }
+            else if ((c == '}' || c == ']') && --_usb_talk.rx_depth == 0)
+            {
+                _usb_talk.rx_state = _usb_talk.rx_member ? _USB_TALK_STATE_MEMBER_END : _USB_TALK_STATE_ARRAY_END;
+            }
+
+            break;
+        }
+        case _USB_TALK_STATE_ARRAY_END:
+        {
+            if (!space)
+            {
+                _usb_talk.rx_state = c == ']' ? _USB_TALK_STATE_LINE_END : _USB_TALK_STATE_DISCARD;
+            }
+
+            break;
+        }
+        case _USB_TALK_STATE_LINE_END:
+        {
+            if (!space)
+            {
+                _usb_talk.rx_state = _USB_TALK_STATE_DISCARD;
+            }
+
+            break;
+        }
+        case _USB_TALK_STATE_DISCARD:
+        default:
+        {
+            break;
         }
     }
-    return false;
 }
 
-bool usb_talk_payload_get_int(usb_talk_payload_t *payload, int *value)
+static void _usb_talk_token_append(char c)
 {
-    return _usb_talk_token_get_int(payload->buffer, &payload->tokens[0], value);
+    // Length goes on past size so that too long token is recognized
+    if (_usb_talk.rx_token_length < USB_TALK_TOKEN_SIZE)
+    {
+        _usb_talk.rx_token[_usb_talk.rx_token_length] = c;
+    }
+
+    if (_usb_talk.rx_token_length <= USB_TALK_TOKEN_SIZE)
+    {
+        _usb_talk.rx_token_length++;
+    }
 }
 
-bool usb_talk_payload_get_key_int(usb_talk_payload_t *payload, const char *key, int *value)
+static void _usb_talk_match(uint8_t node, const char *topic, size_t length)
 {
-    for (int i = 1; i + 1 < payload->token_count; i += 2)
+    // Topic is matched segment by segment against siblings of one level, only wildcards make more than one path
+    const char *end = memchr(topic, '/', length);
+    size_t segment_length = end != NULL ? (size_t) (end - topic) : length;
+
+    for (; node != 0; node = _usb_talk.nodes[node - 1].sibling)
     {
-        if (usb_talk_is_string_token_equal(payload->buffer, &payload->tokens[i], key))
+        const char *segment = _usb_talk.nodes[node - 1].segment;
+        uint8_t count = _usb_talk.nodes[node - 1].length;
+
+        // Multi-level wildcard takes this segment and all following ones
+        if (count == 1 && segment[0] == '#')
+        {
+            _usb_talk_match_add(_usb_talk.nodes[node - 1].subscribe);
+
+            continue;
+        }
+
+        if (!(count == 1 && segment[0] == '+') && (count != segment_length || memcmp(segment, topic, count) != 0))
+        {
+            continue;
+        }
+
+        if (end != NULL)
+        {
+            _usb_talk_match(_usb_talk.nodes[node - 1].child, end + 1, length - segment_length - 1);
+
+            continue;
+        }
+
+        _usb_talk_match_add(_usb_talk.nodes[node - 1].subscribe);
+
+        // Multi-level wildcard matches also its parent level, "a/#" takes "a"
+        for (uint8_t child = _usb_talk.nodes[node - 1].child; child != 0; child = _usb_talk.nodes[child - 1].sibling)
         {
-            return _usb_talk_token_get_int(payload->buffer, &payload->tokens[i + 1], value);
+            if (_usb_talk.nodes[child - 1].length == 1 && _usb_talk.nodes[child - 1].segment[0] == '#')
+            {
+                _usb_talk_match_add(_usb_talk.nodes[child - 1].subscribe);
+            }
         }
     }
-    return false;
 }
 
-bool usb_talk_payload_get_string(usb_talk_payload_t *payload, char *buffer, size_t *length)
+static void _usb_talk_match_add(uint8_t subscribe)
 {
-    if (payload->tokens[0].type != JSMN_STRING)
+    for (; subscribe != 0 && _usb_talk.matches_length < USB_TALK_MATCHES; subscribe = _usb_talk.subscribes[subscribe - 1].next)
     {
-        return false;
+        _usb_talk.matches[_usb_talk.matches_length].subscribe = subscribe;
+        _usb_talk.matches[_usb_talk.matches_length].bound = 0;
+        _usb_talk.matches_length++;
     }
-    uint32_t token_length = payload->tokens[0].end - payload->tokens[0].start;
-    if (token_length > *length)
+}
+
+static void _usb_talk_value_begin(bool member)
+{
+    bool known = !member || _usb_talk.rx_token_length < USB_TALK_TOKEN_SIZE;
+
+    // Key is looked up once in binds of each subscription, its value then goes straight to bound member
+    for (size_t i = 0; i < _usb_talk.matches_length; i++)
     {
-        return false;
+        const usb_talk_bind_t *binds = _usb_talk.subscribes[_usb_talk.matches[i].subscribe - 1].binds;
+        size_t bind_count = _usb_talk.subscribes[_usb_talk.matches[i].subscribe - 1].bind_count;
+
+        _usb_talk.matches[i].bind = NULL;
+        _usb_talk.matches[i].length = 0;
+
+        for (size_t j = 0; j < bind_count && known; j++)
+        {
+            if (member ? (binds[j].key != NULL && strlen(binds[j].key) == _usb_talk.rx_token_length && memcmp(binds[j].key, _usb_talk.rx_token, _usb_talk.rx_token_length) == 0) : binds[j].key == NULL)
+            {
+                _usb_talk.matches[i].bind = &binds[j];
+
+                break;
+            }
+        }
     }
-    strncpy(buffer, &payload->buffer[payload->tokens[0].start], token_length);
-    *length = token_length;
-    return true;
+
+    _usb_talk.rx_member = member;
+    _usb_talk.rx_token_length = 0;
+    _usb_talk.rx_bits = 0;
+    _usb_talk.rx_bit_count = 0;
+    _usb_talk.rx_padding = false;
+    _usb_talk.rx_data_error = false;
 }
 
-bool usb_talk_payload_get_key_string(usb_talk_payload_t *payload, const char *key, char *buffer, size_t *length)
+static void _usb_talk_value_char(char c)
 {
-    for (int i = 1; i + 1 < payload->token_count; i += 2)
+    int sextet = -1;
+    int byte = -1;
+
+    _usb_talk_token_append(c);
+
+    if (c >= 'A' && c <= 'Z')
+    {
+        sextet = c - 'A';
+    }
+    else if (c >= 'a' && c <= 'z')
+    {
+        sextet = c - 'a' + 26;
+    }
+    else if (c >= '0' && c <= '9')
+    {
+        sextet = c - '0' + 52;
+    }
+    else if (c == '+')
+    {
+        sextet = 62;
+    }
+    else if (c == '/')
+    {
+        sextet = 63;
+    }
+
+    // Padding ends data, bits left over from last byte are dropped
+    if (c == '=')
+    {
+        _usb_talk.rx_bits = 0;
+        _usb_talk.rx_bit_count = 0;
+        _usb_talk.rx_padding = true;
+    }
+    else if (sextet < 0 || _usb_talk.rx_padding)
+    {
+        _usb_talk.rx_data_error = true;
+    }
+    else
+    {
+        _usb_talk.rx_bits = (_usb_talk.rx_bits << 6) | sextet;
+        _usb_talk.rx_bit_count += 6;
+
+        if (_usb_talk.rx_bit_count >= 8)
+        {
+            _usb_talk.rx_bit_count -= 8;
+
+            byte = (_usb_talk.rx_bits >> _usb_talk.rx_bit_count) & 0xff;
+
+            _usb_talk.rx_bits &= (1 << _usb_talk.rx_bit_count) - 1;
+        }
+    }
+
+    for (size_t i = 0; i < _usb_talk.matches_length; i++)
     {
-        if (usb_talk_is_string_token_equal(payload->buffer, &payload->tokens[i], key))
+        const usb_talk_bind_t *bind = _usb_talk.matches[i].bind;
+        uint8_t *values = _usb_talk.subscribes[_usb_talk.matches[i].subscribe - 1].values;
+
+        if (bind == NULL)
         {
-            if (payload->tokens[i + 1].type != JSMN_STRING)
+            continue;
+        }
+
+        if (bind->type == USB_TALK_TYPE_STRING)
+        {
+            // Room is kept for terminating character
+            if (_usb_talk.matches[i].length + 1 >= bind->size)
             {
-                return false;
+                _usb_talk.matches[i].bind = NULL;
+
+                continue;
             }
-            uint32_t token_length = payload->tokens[i + 1].end - payload->tokens[i + 1].start;
-            if (token_length > *length)
+
+            values[bind->offset + _usb_talk.matches[i].length++] = c;
+        }
+        else if (bind->type == USB_TALK_TYPE_DATA)
+        {
+            if (_usb_talk.rx_data_error || (byte >= 0 && _usb_talk.matches[i].length >= bind->size))
             {
-                return false;
+                _usb_talk.matches[i].bind = NULL;
+
+                continue;
+            }
+
+            if (byte >= 0)
+            {
+                values[bind->offset + _usb_talk.matches[i].length++] = byte;
             }
-            strncpy(buffer, &payload->buffer[payload->tokens[i + 1].start], token_length);
-            *length = token_length;
-            return true;
+        }
+        else if (bind->type != USB_TALK_TYPE_ENUM)
+        {
+            _usb_talk.matches[i].bind = NULL;
         }
     }
-    return false;
 }
 
-bool usb_talk_is_string_token_equal(const char *buffer, jsmntok_t *token, const char *string)
+static void _usb_talk_value_end(bool string)
 {
-    size_t token_length;
-
-    token_length = (size_t) (token->end - token->start);
+    bool complete = _usb_talk.rx_token_length < USB_TALK_TOKEN_SIZE;
 
-    if (strlen(string) != token_length)
+    if (complete)
     {
-        return false;
+        _usb_talk.rx_token[_usb_talk.rx_token_length] = '\0';
     }
 
-    if (strncmp(string, &buffer[token->start], token_length) != 0)
+    for (size_t i = 0; i < _usb_talk.matches_length; i++)
     {
-        return false;
+        const usb_talk_bind_t *bind = _usb_talk.matches[i].bind;
+        uint8_t *values = _usb_talk.subscribes[_usb_talk.matches[i].subscribe - 1].values;
+        bool bound = false;
+
+        if (bind == NULL)
+        {
+            continue;
+        }
+
+        if (bind->type == USB_TALK_TYPE_BOOL && !string && complete)
+        {
+            bound = strcmp(_usb_talk.rx_token, "true") == 0 || strcmp(_usb_talk.rx_token, "false") == 0;
+
+            if (bound)
+            {
+                *(bool *) &values[bind->offset] = _usb_talk.rx_token[0] == 't';
+            }
+        }
+        else if (bind->type == USB_TALK_TYPE_INT && !string && complete)
+        {
+            int value;
+
+            bound = _usb_talk_token_get_int(&value);
+
+            if (bound)
+            {
+                memcpy(&values[bind->offset], &value, sizeof(value));
+            }
+        }
+        else if (bind->type == USB_TALK_TYPE_ENUM && string && complete)
+        {
+            for (int j = 0; bind->names[j] != NULL && !bound; j++)
+            {
+                bound = strcmp(bind->names[j], _usb_talk.rx_token) == 0;
+
+                if (bound)
+                {
+                    memcpy(&values[bind->offset], &j, sizeof(j));
+                }
+            }
+        }
+        else if (bind->type == USB_TALK_TYPE_STRING && string)
+        {
+            values[bind->offset + _usb_talk.matches[i].length] = '\0';
+
+            bound = true;
+        }
+        else if (bind->type == USB_TALK_TYPE_DATA && string)
+        {
+            memcpy(&values[bind->length_offset], &_usb_talk.matches[i].length, sizeof(size_t));
+
+            bound = true;
+        }
+
+        if (bound)
+        {
+            _usb_talk.matches[i].bound |= (uint32_t) 1 << (bind - _usb_talk.subscribes[_usb_talk.matches[i].subscribe - 1].binds);
+        }
+
+        _usb_talk.matches[i].bind = NULL;
     }
+}
 
-    return true;
+static void _usb_talk_value_skip(void)
+{
+    for (size_t i = 0; i < _usb_talk.matches_length; i++)
+    {
+        _usb_talk.matches[i].bind = NULL;
+    }
 }
 
-static bool _usb_talk_token_get_int(const char *buffer, jsmntok_t *token, int *value)
+static bool _usb_talk_token_get_int(int *value)
 {
-    if (token->type != JSMN_PRIMITIVE)
+    char *end;
+
+    if (!(isdigit((unsigned char) _usb_talk.rx_token[0]) || (_usb_talk.rx_token[0] == '-' && isdigit((unsigned char) _usb_talk.rx_token[1]))))
     {
         return false;
     }
 
-    size_t length = (size_t) (token->end - token->start);
+    long long number = strtoll(_usb_talk.rx_token, &end, 10);
+
+    // Number with fraction or exponent is truncated
+    if (*end == '.' || *end == 'e' || *end == 'E')
+    {
+        float real = strtof(_usb_talk.rx_token, &end);
+
+        if (!(real > INT32_MIN - 1.0f && real < INT32_MAX + 1.0f))
+        {
+            return false;
+        }
 
-    char str[10 + 1];
+        number = (long long) real;
+    }
 
-    if (length > sizeof(str))
+    if (*end != '\0' || number < INT32_MIN || number > INT32_MAX)
     {
         return false;
     }
 
-    memset(str, 0, sizeof(str));
+    *value = (int) number;
 
-    strncpy(str, buffer + token->start, length);
+    return true;
+}
 
-    if (strncmp(str, "null", sizeof(str)) == 0)
+static void _usb_talk_dispatch(void)
+{
+    for (size_t i = 0; i < _usb_talk.matches_length; i++)
     {
-        return USB_TALK_INT_VALUE_NULL;
+        uint8_t subscribe = _usb_talk.matches[i].subscribe;
+
+        usb_talk_payload_t payload = {
+                _usb_talk.subscribes[subscribe - 1].values,
+                _usb_talk.subscribes[subscribe - 1].binds,
+                _usb_talk.subscribes[subscribe - 1].bind_count,
+                _usb_talk.matches[i].bound
+        };
+
+        _usb_talk.subscribes[subscribe - 1].callback(&payload, _usb_talk.subscribes[subscribe - 1].param);
     }
+}
 
-    if (strchr(str, 'e'))
+bool usb_talk_payload_is_bound(usb_talk_payload_t *payload, const void *member)
+{
+    if (payload == NULL)
     {
-        *value = (int) strtof(str, NULL);
+        return false;
     }
-    else
+
+    size_t offset = (const uint8_t *) member - (const uint8_t *) payload->values;
+
+    for (size_t i = 0; i < payload->bind_count; i++)
     {
-        *value = (int) strtol(str, NULL, 10);
+        if (payload->binds[i].offset == offset)
+        {
+            return (payload->bound & ((uint32_t) 1 << i)) != 0;
+        }
     }
 
-    return true;
-}
\ No newline at end of file
+    return false;
+}
@@ -2,48 +2,115 @@
 #define _USB_TALK_H
 
 #include <bc_common.h>
-#include <jsmn.h>
 #include <bc_module_relay.h>
+#include <bc_radio.h>
 
-#define USB_TALK_INT_VALUE_NULL INT32_MIN
+typedef enum
+{
+    USB_TALK_TYPE_BOOL = 0,
+    USB_TALK_TYPE_INT = 1,
+
+    // Value is index of string in list of names terminated by NULL
+    USB_TALK_TYPE_ENUM = 2,
+
+    // String is copied as it is written in message and terminated
+    USB_TALK_TYPE_STRING = 3,
+
+    // Base64 string is decoded, count of bytes is stored to size_t member at length offset
+    USB_TALK_TYPE_DATA = 4
+
+} usb_talk_type_t;
+
+typedef struct
+{
+    // Key of payload object, NULL binds payload itself
+    const char *key;
+    usb_talk_type_t type;
+    size_t offset;
+    size_t size;
+    const char * const *names;
+    size_t length_offset;
+
+} usb_talk_bind_t;
 
 typedef struct
 {
-    const char *buffer;
-    int token_count;
-    jsmntok_t *tokens;
+    void *values;
+    const usb_talk_bind_t *binds;
+    size_t bind_count;
+
+    // Bit for each bind whose value came in message
+    uint32_t bound;
 
 } usb_talk_payload_t;
 
+#define USB_TALK_BIND_BOOL(key, type, member) { (key), USB_TALK_TYPE_BOOL, offsetof(type, member), sizeof(bool), NULL, 0 }
+#define USB_TALK_BIND_INT(key, type, member) { (key), USB_TALK_TYPE_INT, offsetof(type, member), sizeof(int), NULL, 0 }
+#define USB_TALK_BIND_ENUM(key, type, member, names) { (key), USB_TALK_TYPE_ENUM, offsetof(type, member), sizeof(int), (names), 0 }
+#define USB_TALK_BIND_STRING(key, type, member) { (key), USB_TALK_TYPE_STRING, offsetof(type, member), sizeof(((type *) 0)->member), NULL, 0 }
+#define USB_TALK_BIND_DATA(key, type, member, length) { (key), USB_TALK_TYPE_DATA, offsetof(type, member), sizeof(((type *) 0)->member), NULL, offsetof(type, length) }
+#define USB_TALK_BIND_COUNT(binds) (sizeof(binds) / sizeof((binds)[0]))
+
 typedef void (*usb_talk_sub_callback_t)(usb_talk_payload_t *payload, void *param);
 
+// Binary mode sends every message as COBS frame ended by zero byte, frame holds record with type, timestamp in milliseconds,
+// peer device address (zero for base itself), payload and CRC-16/CCITT of all before it, multibyte fields are little endian.
+// Payload of reading is channel and signed 32-bit values in hundredths of unit, channel is bus in bit 4 and sensor number below it.
+typedef enum
+{
+    // JSON message as it would be sent in text mode
+    USB_TALK_RECORD_TEXT = 0,
+    USB_TALK_RECORD_PUSH_BUTTON = 1,
+    USB_TALK_RECORD_THERMOMETER = 2,
+    USB_TALK_RECORD_HYGROMETER = 3,
+    USB_TALK_RECORD_LUX_METER = 4,
+
+    // Pressure and altitude
+    USB_TALK_RECORD_BAROMETER = 5,
+    USB_TALK_RECORD_CO2_METER = 6,
+
+    // Channel is alarm, values are active flag and reading
+    USB_TALK_RECORD_ALARM = 7,
+
+    // Payload is age in milliseconds as unsigned 32-bit integer, it is empty at end of replay
+    USB_TALK_RECORD_REPLAY = 8
+
+} usb_talk_record_type_t;
+
 void usb_talk_init(void);
 void usb_talk_start(void);
-void usb_talk_sub(const char *topic, usb_talk_sub_callback_t callback, void *param);
+// Topic is kept by pointer and must stay valid, segment "+" matches any one level and "#" as last segment matches rest of topic,
+// false is returned if subscription or its new segments do not fit tables sized by USB_TALK_SUBSCRIBES and USB_TALK_TOPIC_NODES
+bool usb_talk_sub(const char *topic, usb_talk_sub_callback_t callback, void *param);
+
+// Payload values are written to members of given structure while message comes, callback is called once line ends,
+// at most 32 binds are taken
+bool usb_talk_sub_bind(const char *topic, const usb_talk_bind_t *binds, size_t bind_count, void *values, usb_talk_sub_callback_t callback, void *param);
+void usb_talk_set_binary(bool binary);
+bool usb_talk_is_binary(void);
+void usb_talk_set_drop_oldest(bool drop_oldest);
+void usb_talk_reset_stats(void);
 void usb_talk_send_string(const char *buffer);
 void usb_talk_publish_led(const char *prefix, bool *state);
-void usb_talk_publish_push_button(const char *prefix, uint16_t *event_count);
-void usb_talk_publish_thermometer(const char *prefix, uint8_t *i2c, float *temperature);
-void usb_talk_publish_humidity_sensor(const char *prefix, uint8_t *i2c, float *relative_humidity);
-void usb_talk_publish_lux_meter(const char *prefix, uint8_t *i2c, float *illuminance);
-void usb_talk_publish_barometer(const char *prefix, uint8_t *i2c, float *pascal, float *altitude);
-void usb_talk_publish_co2_concentation(const char *prefix, float *concentration);
+void usb_talk_publish_push_button(const char *prefix, uint32_t *peer_device_address, uint16_t *event_count);
+void usb_talk_publish_thermometer(const char *prefix, uint32_t *peer_device_address, uint8_t *i2c, float *temperature);
+void usb_talk_publish_humidity_sensor(const char *prefix, uint32_t *peer_device_address, uint8_t *i2c, float *relative_humidity);
+void usb_talk_publish_lux_meter(const char *prefix, uint32_t *peer_device_address, uint8_t *i2c, float *illuminance);
+void usb_talk_publish_barometer(const char *prefix, uint32_t *peer_device_address, uint8_t *i2c, float *pascal, float *altitude);
+void usb_talk_publish_co2_concentation(const char *prefix, uint32_t *peer_device_address, float *concentration);
 void usb_talk_publish_light(const char *prefix, bool *state);
 void usb_talk_publish_relay(const char *prefix, bool *state);
 void usb_talk_publish_module_relay(const char *prefix, uint8_t *number, bc_module_relay_state_t *state);
 void usb_talk_publish_led_strip_config(const char *prefix, const char *mode, int *count);
+void usb_talk_publish_radio_stats(const char *prefix, bc_radio_stats_t *stats);
+void usb_talk_publish_alarm(const char *prefix, uint32_t *peer_device_address, bc_radio_alarm_t *alarm, bool *active, float *value);
+void usb_talk_publish_replay(const char *prefix, uint32_t *peer_device_address, uint32_t *age);
+void usb_talk_publish_mode(const char *prefix);
+void usb_talk_publish_stats(const char *prefix);
+void usb_talk_publish_ota(const char *prefix, uint32_t *device_address, bool *success);
+void usb_talk_publish_radio_profile(const char *prefix, bc_spirit1_profile_t *profile);
+void usb_talk_publish_radio_survey(const char *prefix, bc_radio_survey_t *survey);
 
-bool usb_talk_payload_get_bool(usb_talk_payload_t *payload, bool *value);
-bool usb_talk_payload_get_key_bool(usb_talk_payload_t *payload, const char *key, bool *value);
-bool usb_talk_payload_get_data(usb_talk_payload_t *payload, uint8_t *buffer, size_t *length);
-bool usb_talk_payload_get_key_data(usb_talk_payload_t *payload, const char *key, uint8_t *buffer, size_t *length);
-bool usb_talk_payload_get_enum(usb_talk_payload_t *payload, int *value, ...);
-bool usb_talk_payload_get_key_enum(usb_talk_payload_t *payload, const char *key, int *value, ...);
-bool usb_talk_payload_get_int(usb_talk_payload_t *payload, int *value);
-bool usb_talk_payload_get_key_int(usb_talk_payload_t *payload, const char *key, int *value);
-bool usb_talk_payload_get_string(usb_talk_payload_t *payload, char *buffer, size_t *length);
-bool usb_talk_payload_get_key_string(usb_talk_payload_t *payload, const char *key, char *buffer, size_t *length);
-
-bool usb_talk_is_string_token_equal(const char *buffer, jsmntok_t *token, const char *string);
+bool usb_talk_payload_is_bound(usb_talk_payload_t *payload, const void *member);
 
 #endif /* _USB_TALK_H */
\ No newline at end of file
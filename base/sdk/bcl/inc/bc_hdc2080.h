@@ -33,7 +33,8 @@ typedef enum
     BC_HDC2080_STATE_INITIALIZE = 0,
     BC_HDC2080_STATE_MEASURE = 1,
     BC_HDC2080_STATE_READ = 2,
-    BC_HDC2080_STATE_UPDATE = 3
+    BC_HDC2080_STATE_RESULT = 3,
+    BC_HDC2080_STATE_UPDATE = 4
 
 } bc_hdc2080_state_t;
 
@@ -50,6 +51,8 @@ struct bc_hdc2080_t
     bool _humidity_valid;
     uint16_t _reg_temperature;
     uint16_t _reg_humidity;
+    bc_i2c_transaction_t _transaction[3];
+    uint8_t _buffer[5];
 };
 
 //! @endcond
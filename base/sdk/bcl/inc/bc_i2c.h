@@ -46,13 +46,85 @@ typedef struct
 
 } bc_i2c_tranfer_t;
 
+//! @brief I2C transaction direction
+
+typedef enum
+{
+    BC_I2C_DIRECTION_WRITE = 0, //!< Buffer is written to device memory
+    BC_I2C_DIRECTION_READ = 1   //!< Device memory is read to buffer
+
+} bc_i2c_direction_t;
+
+//! @brief I2C transaction events
+
+typedef enum
+{
+    BC_I2C_EVENT_DONE = 0, //!< Whole chain of transactions has been transferred
+    BC_I2C_EVENT_ERROR = 1 //!< Transaction of chain has failed, rest of chain has not been started
+
+} bc_i2c_event_t;
+
+//! @brief I2C transaction, it is owned by driver from submit until its event handler is called
+
+typedef struct bc_i2c_transaction_t bc_i2c_transaction_t;
+
+struct bc_i2c_transaction_t
+{
+    //! @brief Direction of transfer
+    bc_i2c_direction_t direction;
+
+    //! @brief Transfer parameters
+    bc_i2c_tranfer_t transfer;
+
+    //! @brief Next transaction of chain (NULL ends chain), it starts right after this one without giving bus to other chains
+    bc_i2c_transaction_t *chain;
+
+    //! @brief Handler called from scheduler task once chain is finished, it is taken from first transaction of chain (can be NULL)
+    void (*event_handler)(bc_i2c_transaction_t *, bc_i2c_event_t, void *);
+
+    //! @brief Optional event parameter
+    void *event_param;
+
+    //! @cond
+
+    bc_i2c_transaction_t *_next;
+    volatile bool _busy;
+    bc_i2c_event_t _event;
+
+    //! @endcond
+};
+
 //! @brief Initialize I2C channel
 //! @param[in] channel I2C channel
 //! @param[in] speed I2C communication speed
 
 void bc_i2c_init(bc_i2c_channel_t channel, bc_i2c_speed_t speed);
 
-//! @brief Write to I2C channel
+//! @brief Set up transaction which transfers buffer to or from device memory, it ends chain and has no event handler
+//! @param[in] transaction Pointer to transaction which is not queued
+//! @param[in] direction Direction of transfer
+//! @param[in] device_address 7-bit I2C device address
+//! @param[in] memory_address 8-bit I2C memory address (it can be extended to 16-bit format if OR-ed with BC_I2C_MEMORY_ADDRESS_16_BIT)
+//! @param[in] buffer Pointer to buffer which is being written or read
+//! @param[in] length Length of buffer
+
+void bc_i2c_transaction_init(bc_i2c_transaction_t *transaction, bc_i2c_direction_t direction, uint8_t device_address, uint32_t memory_address, void *buffer, size_t length);
+
+//! @brief Queue transaction or chain of them on I2C channel, it is transferred by interrupts while program goes on
+//! @param[in] channel I2C channel
+//! @param[in] transaction Pointer to first transaction of chain, chain and buffers must stay valid until it is finished
+//! @return true if transaction is queued
+//! @return false if channel is not initialized, transaction is empty or it is still queued
+
+bool bc_i2c_submit(bc_i2c_channel_t channel, bc_i2c_transaction_t *transaction);
+
+//! @brief Check if transaction chain is still queued or being transferred
+//! @param[in] transaction Pointer to first transaction of chain
+//! @return true if chain is not finished yet
+
+bool bc_i2c_is_busy(bc_i2c_transaction_t *transaction);
+
+//! @brief Write to I2C channel and wait until it is done, transactions queued before are transferred first
 //! @param[in] channel I2C channel
 //! @param[in] transfer Pointer to I2C transfer parameters instance
 //! @return true on success
@@ -60,7 +132,7 @@ void bc_i2c_init(bc_i2c_channel_t channel, bc_i2c_speed_t speed);
 
 bool bc_i2c_write(bc_i2c_channel_t channel, const bc_i2c_tranfer_t *transfer);
 
-//! @brief Read from I2C channel
+//! @brief Read from I2C channel and wait until it is done, transactions queued before are transferred first
 //! @param[in] channel I2C channel
 //! @param[in] transfer Pointer to I2C transfer parameters instance
 //! @return true on success
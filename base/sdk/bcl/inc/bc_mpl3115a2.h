@@ -2,7 +2,7 @@
 #define _BC_MPL3115A2_H
 
 #include <bc_i2c.h>
-#include <bc_tick.h>
+#include <bc_scheduler.h>
 
 //! @addtogroup bc_mpl3115a2 bc_mpl3115a2
 //! @brief Driver for MPL3115A2
@@ -32,9 +32,11 @@ typedef enum
     BC_MPL3115A2_STATE_INITIALIZE = 0,
     BC_MPL3115A2_STATE_MEASURE_ALTITUDE = 1,
     BC_MPL3115A2_STATE_READ_ALTITUDE = 2,
-    BC_MPL3115A2_STATE_MEASURE_PRESSURE = 3,
-    BC_MPL3115A2_STATE_READ_PRESSURE = 4,
-    BC_MPL3115A2_STATE_UPDATE = 5
+    BC_MPL3115A2_STATE_RESULT_ALTITUDE = 3,
+    BC_MPL3115A2_STATE_MEASURE_PRESSURE = 4,
+    BC_MPL3115A2_STATE_READ_PRESSURE = 5,
+    BC_MPL3115A2_STATE_RESULT_PRESSURE = 6,
+    BC_MPL3115A2_STATE_UPDATE = 7
 
 } bc_mpl3115a2_state_t;
 
@@ -44,6 +46,7 @@ struct bc_mpl3115a2_t
     uint8_t _i2c_address;
     void (*_event_handler)(bc_mpl3115a2_t *, bc_mpl3115a2_event_t, void *);
     void *_event_param;
+    bc_scheduler_task_id_t _task_id;
     bc_tick_t _update_interval;
     bc_mpl3115a2_state_t _state;
     bool _altitude_valid;
@@ -58,6 +61,8 @@ struct bc_mpl3115a2_t
     uint8_t _reg_out_p_lsb_pressure;
     uint8_t _reg_out_t_msb_pressure;
     uint8_t _reg_out_t_lsb_pressure;
+    bc_i2c_transaction_t _transaction[3];
+    uint8_t _buffer[6];
 };
 
 //! @endcond
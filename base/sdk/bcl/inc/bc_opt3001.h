@@ -2,7 +2,7 @@
 #define _BC_OPT3001_H
 
 #include <bc_i2c.h>
-#include <bc_tick.h>
+#include <bc_scheduler.h>
 
 //! @addtogroup bc_opt3001 bc_opt3001
 //! @brief Driver for OPT3001 ambient light sensor
@@ -32,7 +32,8 @@ typedef enum
     BC_OPT3001_STATE_INITIALIZE = 0,
     BC_OPT3001_STATE_MEASURE = 1,
     BC_OPT3001_STATE_READ = 2,
-    BC_OPT3001_STATE_UPDATE = 3
+    BC_OPT3001_STATE_RESULT = 3,
+    BC_OPT3001_STATE_UPDATE = 4
 
 } bc_opt3001_state_t;
 
@@ -42,10 +43,13 @@ struct bc_opt3001_t
     uint8_t _i2c_address;
     void (*_event_handler)(bc_opt3001_t *, bc_opt3001_event_t, void *);
     void *_event_param;
+    bc_scheduler_task_id_t _task_id;
     bc_tick_t _update_interval;
     bc_opt3001_state_t _state;
     bool _luminosity_valid;
     uint16_t _reg_result;
+    bc_i2c_transaction_t _transaction[2];
+    uint8_t _buffer[4];
 };
 
 //! @endcond
@@ -2,7 +2,7 @@
 #define _BC_TMP112_H
 
 #include <bc_i2c.h>
-#include <bc_tick.h>
+#include <bc_scheduler.h>
 
 //! @addtogroup bc_tmp112 bc_tmp112
 //! @brief Driver for TMP112 temperature sensor
@@ -28,7 +28,8 @@ typedef enum
     BC_TMP112_STATE_ERROR = -1,
     BC_TMP112_STATE_MEASURE = 0,
     BC_TMP112_STATE_READ = 1,
-    BC_TMP112_STATE_UPDATE = 2
+    BC_TMP112_STATE_RESULT = 2,
+    BC_TMP112_STATE_UPDATE = 3
 
 } bc_tmp112_state_t;
 
@@ -40,10 +41,13 @@ struct bc_tmp112_t
     uint8_t _i2c_address;
     void (*_event_handler)(bc_tmp112_t *, bc_tmp112_event_t, void *);
     void *_event_param;
+    bc_scheduler_task_id_t _task_id;
     bc_tick_t _update_interval;
     bc_tmp112_state_t _state;
     bool _temperature_valid;
     uint16_t _reg_temperature;
+    bc_i2c_transaction_t _transaction[2];
+    uint8_t _buffer[3];
 };
 
 //! @endcond
@@ -6,6 +6,7 @@
 #include <bc_ir_rx.h>
 #include <bc_irq.h>
 #include <bc_led_strip.h>
+#include <bc_ota.h>
 #include <bc_radio.h>
 
 // Peripheral drivers
@@ -13,6 +14,7 @@
 #include <bc_button.h>
 #include <bc_dac.h>
 #include <bc_eeprom.h>
+#include <bc_flash.h>
 #include <bc_gpio.h>
 #include <bc_i2c.h>
 #include <bc_led.h>
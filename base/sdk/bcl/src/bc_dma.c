@@ -0,0 +1,93 @@
+#include <bc_dma.h>
+#include <bc_irq.h>
+#include <stm32l0xx.h>
+
+static struct
+{
+    void (*callback)(bc_dma_channel_t, void *);
+    void *param;
+
+} _bc_dma[7];
+
+static void _bc_dma_irq_handler(bc_dma_channel_t first, bc_dma_channel_t last);
+
+void bc_dma_register(bc_dma_channel_t channel, void (*callback)(bc_dma_channel_t, void *), void *param)
+{
+    // Disable interrupts
+    bc_irq_disable();
+
+    // Store callback function
+    _bc_dma[channel].callback = callback;
+
+    // Store callback parameter
+    _bc_dma[channel].param = param;
+
+    // Enable clock for DMA1
+    RCC->AHBENR |= RCC_AHBENR_DMA1EN;
+
+    // Enable interrupt request of vector shared by channel
+    if (channel == BC_DMA_CHANNEL_1)
+    {
+        NVIC_EnableIRQ(DMA1_Channel1_IRQn);
+    }
+    else if (channel <= BC_DMA_CHANNEL_3)
+    {
+        NVIC_EnableIRQ(DMA1_Channel2_3_IRQn);
+    }
+    else
+    {
+        NVIC_EnableIRQ(DMA1_Channel4_5_6_7_IRQn);
+    }
+
+    // Enable interrupts
+    bc_irq_enable();
+}
+
+void bc_dma_unregister(bc_dma_channel_t channel)
+{
+    // Disable interrupts
+    bc_irq_disable();
+
+    _bc_dma[channel].callback = NULL;
+
+    // Enable interrupts
+    bc_irq_enable();
+}
+
+static void _bc_dma_irq_handler(bc_dma_channel_t first, bc_dma_channel_t last)
+{
+    for (int channel = first; channel <= (int) last; channel++)
+    {
+        uint32_t mask = DMA_ISR_GIF1 << (channel * 4);
+
+        if ((DMA1->ISR & mask) == 0)
+        {
+            continue;
+        }
+
+        if (_bc_dma[channel].callback != NULL)
+        {
+            _bc_dma[channel].callback((bc_dma_channel_t) channel, _bc_dma[channel].param);
+        }
+        else
+        {
+            // Clear flags of channel nobody listens to
+            DMA1->IFCR = DMA_IFCR_CGIF1 << (channel * 4);
+        }
+    }
+}
+
+void DMA1_Channel1_IRQHandler(void)
+{
+    _bc_dma_irq_handler(BC_DMA_CHANNEL_1, BC_DMA_CHANNEL_1);
+}
+
+void DMA1_Channel2_3_IRQHandler(void)
+{
+    _bc_dma_irq_handler(BC_DMA_CHANNEL_2, BC_DMA_CHANNEL_3);
+}
+
+void DMA1_Channel4_5_6_7_IRQHandler(void)
+{
+    _bc_dma_irq_handler(BC_DMA_CHANNEL_4, BC_DMA_CHANNEL_7);
+}
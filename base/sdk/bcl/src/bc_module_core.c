@@ -270,6 +270,11 @@ void bc_module_core_deep_sleep_disable()
 
 void bc_module_core_pll_enable()
 {
+    // Radio interrupt may use PLL as well, so keep it away while clock is being changed
+    uint32_t primask = __get_PRIMASK();
+
+    __disable_irq();
+
     if (_bc_module_core_pll_enable_semaphore == 0)
     {
         // Set regulator range to 1.8V
@@ -305,10 +310,16 @@ void bc_module_core_pll_enable()
 
     _bc_module_core_pll_enable_semaphore++;
     bc_scheduler_disable_sleep();
+
+    __set_PRIMASK(primask);
 }
 
 void bc_module_core_pll_disable()
 {
+    uint32_t primask = __get_PRIMASK();
+
+    __disable_irq();
+
     _bc_module_core_pll_enable_semaphore--;
     bc_scheduler_enable_sleep();
 
@@ -343,6 +354,8 @@ void bc_module_core_pll_disable()
         // Set regulator range to 1.2V
         PWR->CR |= PWR_CR_VOS;
     }
+
+    __set_PRIMASK(primask);
 }
 
 uint32_t bc_module_core_get_clk()
@@ -31,6 +31,8 @@ typedef struct bc_module_lcd_t
 
 bc_module_lcd_t _bc_module_lcd;
 
+bc_module_lcd_framebuffer_t _bc_module_lcd_framebuffer;
+
 uint8_t reverse2(uint32_t b) {
 
 	return __RBIT(b) >> 24;
@@ -1,11 +1,11 @@
 #include <bc_mpl3115a2.h>
-#include <bc_scheduler.h>
 
 #define BC_MPL3115A2_DELAY_RUN 1500
 #define BC_MPL3115A2_DELAY_RESET 1500
 #define BC_MPL3115A2_DELAY_MEASUREMENT 1500
 
 static void _bc_mpl3115a2_task(void *param);
+static void _bc_mpl3115a2_i2c_event_handler(bc_i2c_transaction_t *transaction, bc_i2c_event_t event, void *event_param);
 
 void bc_mpl3115a2_init(bc_mpl3115a2_t *self, bc_i2c_channel_t i2c_channel, uint8_t i2c_address)
 {
@@ -16,7 +16,7 @@ void bc_mpl3115a2_init(bc_mpl3115a2_t *self, bc_i2c_channel_t i2c_channel, uint8
 
     bc_i2c_init(self->_i2c_channel, BC_I2C_SPEED_400_KHZ);
 
-    bc_scheduler_register(_bc_mpl3115a2_task, self, BC_MPL3115A2_DELAY_RUN);
+    self->_task_id = bc_scheduler_register(_bc_mpl3115a2_task, self, BC_MPL3115A2_DELAY_RUN);
 }
 
 void bc_mpl3115a2_set_event_handler(bc_mpl3115a2_t *self, void (*event_handler)(bc_mpl3115a2_t *, bc_mpl3115a2_event_t, void *), void *event_param)
@@ -96,17 +96,24 @@ start:
         {
             self->_state = BC_MPL3115A2_STATE_ERROR;
 
-            if (!bc_i2c_write_8b(self->_i2c_channel, self->_i2c_address, 0x26, 0xb8))
+            if (bc_i2c_is_busy(&self->_transaction[0]))
             {
                 goto start;
             }
 
-            if (!bc_i2c_write_8b(self->_i2c_channel, self->_i2c_address, 0x13, 0x07))
-            {
-                goto start;
-            }
+            // Failed write shows in status register read back after conversion
+            self->_buffer[0] = 0xb8;
+            self->_buffer[1] = 0x07;
+            self->_buffer[2] = 0xba;
+
+            bc_i2c_transaction_init(&self->_transaction[0], BC_I2C_DIRECTION_WRITE, self->_i2c_address, 0x26, &self->_buffer[0], 1);
+            bc_i2c_transaction_init(&self->_transaction[1], BC_I2C_DIRECTION_WRITE, self->_i2c_address, 0x13, &self->_buffer[1], 1);
+            bc_i2c_transaction_init(&self->_transaction[2], BC_I2C_DIRECTION_WRITE, self->_i2c_address, 0x26, &self->_buffer[2], 1);
+
+            self->_transaction[0].chain = &self->_transaction[1];
+            self->_transaction[1].chain = &self->_transaction[2];
 
-            if (!bc_i2c_write_8b(self->_i2c_channel, self->_i2c_address, 0x26, 0xba))
+            if (!bc_i2c_submit(self->_i2c_channel, &self->_transaction[0]))
             {
                 goto start;
             }
@@ -121,37 +128,42 @@ start:
         {
             self->_state = BC_MPL3115A2_STATE_ERROR;
 
-            uint8_t reg_status;
-
-            if (!bc_i2c_read_8b(self->_i2c_channel, self->_i2c_address, 0x00, &reg_status))
+            if (bc_i2c_is_busy(&self->_transaction[0]))
             {
                 goto start;
             }
 
-            if (reg_status != 0x0e)
+            // Status and output registers are read in one chain by interrupts, task goes on once it is finished
+            bc_i2c_transaction_init(&self->_transaction[0], BC_I2C_DIRECTION_READ, self->_i2c_address, 0x00, &self->_buffer[0], 1);
+            bc_i2c_transaction_init(&self->_transaction[1], BC_I2C_DIRECTION_READ, self->_i2c_address, 0x01, &self->_buffer[1], 5);
+
+            self->_transaction[0].chain = &self->_transaction[1];
+            self->_transaction[0].event_handler = _bc_mpl3115a2_i2c_event_handler;
+            self->_transaction[0].event_param = self;
+
+            if (!bc_i2c_submit(self->_i2c_channel, &self->_transaction[0]))
             {
                 goto start;
             }
 
-            uint8_t buffer[5];
-
-            bc_i2c_tranfer_t transfer;
+            self->_state = BC_MPL3115A2_STATE_RESULT_ALTITUDE;
 
-            transfer.device_address = self->_i2c_address;
-            transfer.memory_address = 0x01;
-            transfer.buffer = buffer;
-            transfer.length = 5;
+            return;
+        }
+        case BC_MPL3115A2_STATE_RESULT_ALTITUDE:
+        {
+            self->_state = BC_MPL3115A2_STATE_ERROR;
 
-            if (!bc_i2c_read(self->_i2c_channel, &transfer))
+            if (self->_buffer[0] != 0x0e)
             {
                 goto start;
             }
 
-            self->_reg_out_p_msb_altitude = buffer[0];
-            self->_reg_out_p_csb_altitude = buffer[1];
-            self->_reg_out_p_lsb_altitude = buffer[2];
-            self->_reg_out_t_msb_altitude = buffer[3];
-            self->_reg_out_t_lsb_altitude = buffer[4];
+            self->_reg_out_p_msb_altitude = self->_buffer[1];
+            self->_reg_out_p_csb_altitude = self->_buffer[2];
+            self->_reg_out_p_lsb_altitude = self->_buffer[3];
+            self->_reg_out_t_msb_altitude = self->_buffer[4];
+            self->_reg_out_t_lsb_altitude = self->_buffer[5];
 
             self->_altitude_valid = true;
 
@@ -163,17 +175,24 @@ start:
         {
             self->_state = BC_MPL3115A2_STATE_ERROR;
 
-            if (!bc_i2c_write_8b(self->_i2c_channel, self->_i2c_address, 0x26, 0x38))
+            if (bc_i2c_is_busy(&self->_transaction[0]))
             {
                 goto start;
             }
 
-            if (!bc_i2c_write_8b(self->_i2c_channel, self->_i2c_address, 0x13, 0x07))
-            {
-                goto start;
-            }
+            // Failed write shows in status register read back after conversion
+            self->_buffer[0] = 0x38;
+            self->_buffer[1] = 0x07;
+            self->_buffer[2] = 0x3a;
+
+            bc_i2c_transaction_init(&self->_transaction[0], BC_I2C_DIRECTION_WRITE, self->_i2c_address, 0x26, &self->_buffer[0], 1);
+            bc_i2c_transaction_init(&self->_transaction[1], BC_I2C_DIRECTION_WRITE, self->_i2c_address, 0x13, &self->_buffer[1], 1);
+            bc_i2c_transaction_init(&self->_transaction[2], BC_I2C_DIRECTION_WRITE, self->_i2c_address, 0x26, &self->_buffer[2], 1);
 
-            if (!bc_i2c_write_8b(self->_i2c_channel, self->_i2c_address, 0x26, 0x3a))
+            self->_transaction[0].chain = &self->_transaction[1];
+            self->_transaction[1].chain = &self->_transaction[2];
+
+            if (!bc_i2c_submit(self->_i2c_channel, &self->_transaction[0]))
             {
                 goto start;
             }
@@ -188,37 +207,41 @@ start:
         {
             self->_state = BC_MPL3115A2_STATE_ERROR;
 
-            uint8_t reg_status;
-
-            if (!bc_i2c_read_8b(self->_i2c_channel, self->_i2c_address, 0x00, &reg_status))
+            if (bc_i2c_is_busy(&self->_transaction[0]))
             {
                 goto start;
             }
 
-            if (reg_status != 0x0e)
+            bc_i2c_transaction_init(&self->_transaction[0], BC_I2C_DIRECTION_READ, self->_i2c_address, 0x00, &self->_buffer[0], 1);
+            bc_i2c_transaction_init(&self->_transaction[1], BC_I2C_DIRECTION_READ, self->_i2c_address, 0x01, &self->_buffer[1], 5);
+
+            self->_transaction[0].chain = &self->_transaction[1];
+            self->_transaction[0].event_handler = _bc_mpl3115a2_i2c_event_handler;
+            self->_transaction[0].event_param = self;
+
+            if (!bc_i2c_submit(self->_i2c_channel, &self->_transaction[0]))
             {
                 goto start;
             }
 
-            uint8_t buffer[5];
-
-            bc_i2c_tranfer_t transfer;
+            self->_state = BC_MPL3115A2_STATE_RESULT_PRESSURE;
 
-            transfer.device_address = self->_i2c_address;
-            transfer.memory_address = 0x01;
-            transfer.buffer = buffer;
-            transfer.length = 5;
+            return;
+        }
+        case BC_MPL3115A2_STATE_RESULT_PRESSURE:
+        {
+            self->_state = BC_MPL3115A2_STATE_ERROR;
 
-            if (!bc_i2c_read(self->_i2c_channel, &transfer))
+            if (self->_buffer[0] != 0x0e)
             {
                 goto start;
             }
 
-            self->_reg_out_p_msb_pressure = buffer[0];
-            self->_reg_out_p_csb_pressure = buffer[1];
-            self->_reg_out_p_lsb_pressure = buffer[2];
-            self->_reg_out_t_msb_pressure = buffer[3];
-            self->_reg_out_t_lsb_pressure = buffer[4];
+            self->_reg_out_p_msb_pressure = self->_buffer[1];
+            self->_reg_out_p_csb_pressure = self->_buffer[2];
+            self->_reg_out_p_lsb_pressure = self->_buffer[3];
+            self->_reg_out_t_msb_pressure = self->_buffer[4];
+            self->_reg_out_t_lsb_pressure = self->_buffer[5];
 
             self->_pressure_valid = true;
 
@@ -247,3 +270,17 @@ start:
         }
     }
 }
+
+static void _bc_mpl3115a2_i2c_event_handler(bc_i2c_transaction_t *transaction, bc_i2c_event_t event, void *event_param)
+{
+    (void) transaction;
+
+    bc_mpl3115a2_t *self = event_param;
+
+    if (event == BC_I2C_EVENT_ERROR)
+    {
+        self->_state = BC_MPL3115A2_STATE_ERROR;
+    }
+
+    bc_scheduler_plan_now(self->_task_id);
+}
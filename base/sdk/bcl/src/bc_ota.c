@@ -0,0 +1,305 @@
+#include <bc_ota.h>
+#include <stm32l0xx.h>
+
+#define _BC_OTA_MAGIC 0x31444342
+#define _BC_OTA_HEADER_LENGTH 20
+#define _BC_OTA_BANK_SIZE (BC_FLASH_BANK2_END - BC_FLASH_BANK2_ADDRESS)
+
+#if BC_OTA_DELTA_IN_FLASH
+
+#define _BC_OTA_DELTA ((const uint8_t *) BC_OTA_DELTA_ADDRESS)
+#define _BC_OTA_IMAGE_SIZE (BC_OTA_DELTA_ADDRESS - BC_OTA_IMAGE_ADDRESS)
+
+#else
+
+#define _BC_OTA_DELTA ((const uint8_t *) _bc_ota.delta)
+#define _BC_OTA_IMAGE_SIZE _BC_OTA_BANK_SIZE
+
+#endif
+
+typedef enum
+{
+    _BC_OTA_OPERATION_LITERAL = 0,
+    _BC_OTA_OPERATION_COPY = 1
+
+} _bc_ota_operation_t;
+
+static struct
+{
+#if !BC_OTA_DELTA_IN_FLASH
+    uint8_t delta[BC_OTA_DELTA_SIZE];
+#endif
+
+    // Image is written to second bank by whole pages
+    uint8_t page[BC_FLASH_PAGE_SIZE];
+    size_t page_length;
+    uint32_t address;
+
+    bool ready;
+
+} _bc_ota;
+
+static bool _bc_ota_varint(size_t length, size_t *offset, uint32_t *value);
+static bool _bc_ota_output(const uint8_t *source, size_t length);
+static bool _bc_ota_flush(void);
+static uint32_t _bc_ota_crc32(const uint8_t *buffer, size_t length);
+
+bool bc_ota_write(uint32_t offset, const void *buffer, size_t length)
+{
+    if (offset + length > BC_OTA_DELTA_SIZE)
+    {
+        return false;
+    }
+
+    // Image built from previous delta is no longer valid
+    _bc_ota.ready = false;
+
+#if BC_OTA_DELTA_IN_FLASH
+    // Delta starts over with its first part
+    if (offset == 0 && !bc_flash_erase(BC_OTA_DELTA_ADDRESS, BC_OTA_DELTA_SIZE))
+    {
+        return false;
+    }
+
+    size_t aligned = length & ~(sizeof(uint32_t) - 1);
+
+    if (aligned != 0 && !bc_flash_write(BC_OTA_DELTA_ADDRESS + offset, buffer, aligned))
+    {
+        return false;
+    }
+
+    // Last part is padded to whole word, padding stays erased
+    if (aligned != length)
+    {
+        uint32_t word = 0;
+
+        memcpy(&word, (const uint8_t *) buffer + aligned, length - aligned);
+
+        return bc_flash_write(BC_OTA_DELTA_ADDRESS + offset + aligned, &word, sizeof(word));
+    }
+#else
+    memcpy(&_bc_ota.delta[offset], buffer, length);
+#endif
+
+    return true;
+}
+
+bool bc_ota_read(uint32_t offset, void *buffer, size_t length, void *param)
+{
+    (void) param;
+
+    if (offset + length > BC_OTA_DELTA_SIZE)
+    {
+        return false;
+    }
+
+    memcpy(buffer, &_BC_OTA_DELTA[offset], length);
+
+    return true;
+}
+
+bool bc_ota_finish(size_t length)
+{
+    uint32_t header[_BC_OTA_HEADER_LENGTH / sizeof(uint32_t)];
+
+    _bc_ota.ready = false;
+
+    if (length < _BC_OTA_HEADER_LENGTH || length > BC_OTA_DELTA_SIZE)
+    {
+        return false;
+    }
+
+    memcpy(header, _BC_OTA_DELTA, sizeof(header));
+
+    uint32_t base_length = header[1];
+    uint32_t image_length = header[3];
+
+    if (header[0] != _BC_OTA_MAGIC || base_length > _BC_OTA_BANK_SIZE || image_length == 0 || image_length > _BC_OTA_IMAGE_SIZE)
+    {
+        return false;
+    }
+
+    // Delta applies only to firmware it was made against
+    if (_bc_ota_crc32((const uint8_t *) FLASH_BASE, base_length) != header[2])
+    {
+        return false;
+    }
+
+    if (!bc_flash_erase(BC_OTA_IMAGE_ADDRESS, image_length))
+    {
+        return false;
+    }
+
+    _bc_ota.address = BC_OTA_IMAGE_ADDRESS;
+    _bc_ota.page_length = 0;
+
+    size_t offset = _BC_OTA_HEADER_LENGTH;
+    uint32_t position = 0;
+
+    while (offset < length)
+    {
+        uint8_t operation = _BC_OTA_DELTA[offset++];
+        uint32_t count;
+        const uint8_t *source;
+
+        if (!_bc_ota_varint(length, &offset, &count) || count > image_length - position)
+        {
+            return false;
+        }
+
+        if (operation == _BC_OTA_OPERATION_LITERAL)
+        {
+            if (count > length - offset)
+            {
+                return false;
+            }
+
+            source = &_BC_OTA_DELTA[offset];
+
+            offset += count;
+        }
+        else if (operation == _BC_OTA_OPERATION_COPY)
+        {
+            uint32_t zigzag;
+
+            if (!_bc_ota_varint(length, &offset, &zigzag))
+            {
+                return false;
+            }
+
+            // Source moves together with position, code shifted by insertion keeps same distance
+            int64_t start = (int64_t) position + (int32_t) ((zigzag >> 1) ^ -(zigzag & 1));
+
+            if (start < 0 || start + count > base_length)
+            {
+                return false;
+            }
+
+            source = (const uint8_t *) FLASH_BASE + start;
+        }
+        else
+        {
+            return false;
+        }
+
+        if (!_bc_ota_output(source, count))
+        {
+            return false;
+        }
+
+        position += count;
+    }
+
+    if (position != image_length || !_bc_ota_flush())
+    {
+        return false;
+    }
+
+    if (_bc_ota_crc32((const uint8_t *) BC_OTA_IMAGE_ADDRESS, image_length) != header[4])
+    {
+        return false;
+    }
+
+    _bc_ota.ready = true;
+
+    return true;
+}
+
+void bc_ota_install(void)
+{
+    if (!_bc_ota.ready)
+    {
+        return;
+    }
+
+    // Image built by bc_ota_finish starts at BC_OTA_IMAGE_ADDRESS, which is start of bank booted next
+    bc_flash_install();
+}
+
+static bool _bc_ota_varint(size_t length, size_t *offset, uint32_t *value)
+{
+    *value = 0;
+
+    // Seven bits in each byte, lowest first, highest bit tells that another byte follows
+    for (int shift = 0; shift < 32; shift += 7)
+    {
+        if (*offset >= length)
+        {
+            return false;
+        }
+
+        uint8_t byte = _BC_OTA_DELTA[(*offset)++];
+
+        *value |= (uint32_t) (byte & 0x7f) << shift;
+
+        if ((byte & 0x80) == 0)
+        {
+            return true;
+        }
+    }
+
+    return false;
+}
+
+static bool _bc_ota_output(const uint8_t *source, size_t length)
+{
+    while (length > 0)
+    {
+        size_t size = BC_FLASH_PAGE_SIZE - _bc_ota.page_length;
+
+        if (size > length)
+        {
+            size = length;
+        }
+
+        memcpy(&_bc_ota.page[_bc_ota.page_length], source, size);
+
+        _bc_ota.page_length += size;
+
+        source += size;
+        length -= size;
+
+        if (_bc_ota.page_length == BC_FLASH_PAGE_SIZE && !_bc_ota_flush())
+        {
+            return false;
+        }
+    }
+
+    return true;
+}
+
+static bool _bc_ota_flush(void)
+{
+    // Last page is padded to whole word, padding stays erased
+    size_t length = (_bc_ota.page_length + sizeof(uint32_t) - 1) & ~(sizeof(uint32_t) - 1);
+
+    memset(&_bc_ota.page[_bc_ota.page_length], 0, length - _bc_ota.page_length);
+
+    if (length != 0 && !bc_flash_write(_bc_ota.address, _bc_ota.page, length))
+    {
+        return false;
+    }
+
+    _bc_ota.address += length;
+    _bc_ota.page_length = 0;
+
+    return true;
+}
+
+static uint32_t _bc_ota_crc32(const uint8_t *buffer, size_t length)
+{
+    uint32_t crc = 0xffffffff;
+
+    // Bitwise CRC-32 as used by zlib, table would take more program memory than update saves in time
+    for (size_t i = 0; i < length; i++)
+    {
+        crc ^= buffer[i];
+
+        for (int bit = 0; bit < 8; bit++)
+        {
+            crc = (crc >> 1) ^ (0xedb88320 & -(crc & 1));
+        }
+    }
+
+    return ~crc;
+}
@@ -2,6 +2,7 @@
 #include <bc_scheduler.h>
 #include <bc_exti.h>
 #include <bc_module_core.h>
+#include <bc_dma.h>
 #include <stm32l0xx.h>
 #include "SPIRIT_Config.h"
 #include "SDK_Configuration_Common.h"
@@ -15,6 +16,26 @@ typedef enum
 
 } bc_spirit1_state_t;
 
+typedef enum
+{
+    BC_SPIRIT1_TRANSFER_STEP_IDLE = 0,
+    BC_SPIRIT1_TRANSFER_STEP_SETUP = 1,
+    BC_SPIRIT1_TRANSFER_STEP_DATA = 2,
+    BC_SPIRIT1_TRANSFER_STEP_HOLD = 3,
+    BC_SPIRIT1_TRANSFER_STEP_RELEASE = 4
+
+} bc_spirit1_transfer_step_t;
+
+// Configuration registers are cached, status registers and FIFO above them are not
+#define BC_SPIRIT1_SHADOW_SIZE 0xc0
+
+// State machine is polled in these steps until crystal starts up, datasheet gives typically 1 ms
+#define BC_SPIRIT1_WAKE_UP_POLL 50
+#define BC_SPIRIT1_WAKE_UP_TIMEOUT 10000
+
+// Receiver settles and averages signal level over this time in microseconds before it is read
+#define BC_SPIRIT1_RSSI_SETTLE_TIME 1000
+
 typedef struct
 {
     void (*event_handler)(bc_spirit1_event_t, void *);
@@ -22,12 +43,72 @@ typedef struct
     bc_scheduler_task_id_t task_id;
     bc_spirit1_state_t desired_state;
     bc_spirit1_state_t current_state;
+    uint8_t address;
+    bc_spirit1_profile_t profile;
+    bool profile_pending;
     uint8_t tx_buffer[BC_SPIRIT1_MAX_PACKET_SIZE];
     size_t tx_length;
-    uint8_t  rx_buffer[BC_SPIRIT1_MAX_PACKET_SIZE];
-    size_t rx_length;
+    size_t tx_offset;
+    struct
+    {
+        uint8_t buffer[BC_SPIRIT1_MAX_PACKET_SIZE];
+        size_t length;
+
+    } rx_pool[BC_SPIRIT1_RX_POOL_SIZE];
+    volatile size_t rx_head;
+    volatile size_t rx_tail;
+    size_t rx_offset;
+    bool rx_overflow;
+    volatile bool rx_armed;
+    volatile uint32_t rx_discarded;
+    volatile uint32_t rx_dropped;
+    volatile uint32_t rx_rejected;
+    volatile uint32_t rx_crc_error;
     bc_tick_t rx_timeout;
     bc_tick_t rx_tick_timeout;
+    volatile bool irq_pending;
+    volatile int spi_lock;
+
+    struct
+    {
+        volatile bool busy;
+        volatile bool done;
+        volatile bc_spirit1_transfer_step_t step;
+        bool dma;
+        uint8_t *buffer;
+        size_t length;
+        void (*callback)(void);
+        uint8_t dummy_rx;
+
+    } transfer;
+
+    struct
+    {
+        // TIM21 count at nIRQ and longest time until receiver was armed again, for interrupt and deferred path
+        volatile uint16_t start;
+        volatile uint16_t max[2];
+
+    } rearm;
+
+    struct
+    {
+        uint8_t value[BC_SPIRIT1_SHADOW_SIZE];
+        uint8_t valid[BC_SPIRIT1_SHADOW_SIZE / 8];
+        uint16_t status;
+        uint32_t bytes_transferred;
+        uint32_t bytes_saved;
+
+    } shadow;
+
+    struct
+    {
+        bc_spirit1_sleep_mode_t mode;
+        bool shutdown;
+        uint8_t image[BC_SPIRIT1_SHADOW_SIZE / 8];
+        uint32_t wake_up_count;
+        uint32_t wake_up_time;
+
+    } sleep;
 
 } bc_spirit1_t;
 
@@ -35,6 +116,32 @@ static bc_spirit1_t _bc_spirit1;
 
 #define XTAL_FREQUENCY 50000000
 
+#define BC_SPIRIT1_FIFO_SIZE 96
+
+// Frames longer than FIFO are streamed, interrupt comes while half of FIFO can still be served
+#define BC_SPIRIT1_FIFO_THRESHOLD 48
+
+// Bytes sent before the payload: 4 B preamble and 4 B sync word
+#define BC_SPIRIT1_FRAME_PREAMBLE (4 + 4)
+
+// Bytes sent around the payload, FEC doubles them together with payload: 1 B length field, 1 B address and 2 B CRC
+#define BC_SPIRIT1_FRAME_OVERHEAD (1 + 1 + 2)
+
+// Frequency deviation and receiver bandwidth follow data rate so that modulation index stays about one
+static const struct
+{
+    uint32_t datarate;
+    uint32_t deviation;
+    uint32_t bandwidth;
+
+} _bc_spirit1_datarates[BC_SPIRIT1_DATARATE_COUNT] =
+{
+    [BC_SPIRIT1_DATARATE_9600] = { 9600, 10000, 58000 },
+    [BC_SPIRIT1_DATARATE_19200] = { 19200, 20000, 100000 },
+    [BC_SPIRIT1_DATARATE_38400] = { 38400, 20000, 100000 },
+    [BC_SPIRIT1_DATARATE_100000] = { 100000, 50000, 200000 }
+};
+
 SRadioInit xRadioInit = {
   XTAL_OFFSET_PPM,
   BASE_FREQUENCY,
@@ -80,6 +187,23 @@ static void _bc_spirit1_check_state_tx(void);
 static void _bc_spirit1_enter_state_rx(void);
 static void _bc_spirit1_check_state_rx(void);
 static void _bc_spirit1_enter_state_sleep(void);
+static void _bc_spirit1_configure(void);
+static void _bc_spirit1_apply_profile(void);
+static void _bc_spirit1_shutdown(void);
+static void _bc_spirit1_wake_up(void);
+static bool _bc_spirit1_wait_state(SpiritState state);
+static uint32_t _bc_spirit1_lse_to_us(uint16_t ticks);
+static void _bc_spirit1_write_tx_fifo(void (*callback)(void));
+static void _bc_spirit1_tx_start(void);
+static void _bc_spirit1_rx_service(void);
+static void _bc_spirit1_rx_drain(void);
+static void _bc_spirit1_rx_restart(void);
+static void _bc_spirit1_rx_deliver(void);
+static void _bc_spirit1_fifo_transfer(uint8_t *buffer, size_t length, void (*callback)(void));
+static void _bc_spirit1_dma_irq(bc_dma_channel_t channel, void *param);
+static void _bc_spirit1_shadow_invalidate(void);
+static bool _bc_spirit1_shadow_match(uint8_t address, uint8_t value);
+static void _bc_spirit1_shadow_update(uint8_t address, const uint8_t *buffer, size_t length);
 
 void bc_spirit1_hal_chip_select_low(void);
 void bc_spirit1_hal_chip_select_high(void);
@@ -87,6 +211,8 @@ uint8_t bc_spirit1_hal_transfer_byte(uint8_t value);
 static void bc_spirit1_hal_init_gpio(void);
 static void bc_spirit1_hal_init_spi(void);
 static void bc_spirit1_hal_init_timer(void);
+static void bc_spirit1_hal_start_timer_it(void);
+static void bc_spirit1_hal_delay(uint16_t microseconds);
 
 static void _bc_spirit1_task(void *param);
 static void _bc_spirit1_interrupt(bc_exti_line_t line, void *param);
@@ -98,20 +224,14 @@ void bc_spirit1_init(void)
     SpiritRadioSetXtalFrequency(XTAL_FREQUENCY);
     SpiritSpiInit();
 
-    /* Spirit ON */
-    SpiritEnterShutdown();
-    SpiritExitShutdown();
-    SpiritManagementWaExtraCurrent();
-
-    /* Spirit IRQ config */
-    SpiritGpioInit(&xGpioIRQ);
+    _bc_spirit1_configure();
 
-    /* Spirit Radio config */
-    SpiritRadioInit(&xRadioInit);
-
-    /* Spirit Packet config */
-    SpiritPktBasicInit(&xBasicInit);
-    SpiritPktBasicAddressesInit(&xAddressInit);
+    // Compile-time configuration is default profile
+    _bc_spirit1.profile.channel = CHANNEL_NUMBER;
+    _bc_spirit1.profile.datarate = BC_SPIRIT1_DATARATE_19200;
+    _bc_spirit1.profile.fec = EN_FEC == S_ENABLE;
+    _bc_spirit1.profile.power = BC_SPIRIT1_POWER_MAX;
+    _bc_spirit1.profile_pending = true;
 
     _bc_spirit1.task_id = bc_scheduler_register(_bc_spirit1_task, NULL, BC_TICK_INFINITY);
 }
@@ -134,17 +254,180 @@ void bc_spirit1_set_tx_length(size_t length)
 
 void *bc_spirit1_get_rx_buffer(void)
 {
-    return _bc_spirit1.rx_buffer;
+    return _bc_spirit1.rx_pool[_bc_spirit1.rx_tail].buffer;
 }
 
 size_t bc_spirit1_get_rx_length(void)
 {
-    return _bc_spirit1.rx_length;
+    return _bc_spirit1.rx_pool[_bc_spirit1.rx_tail].length;
 }
 
 void bc_spirit1_set_rx_timeout(bc_tick_t timeout)
 {
     _bc_spirit1.rx_timeout = timeout;
+
+    // Apply new timeout also to reception which is already running
+    if (_bc_spirit1.current_state == BC_SPIRIT1_STATE_RX)
+    {
+        if (timeout == 0 || timeout == BC_TICK_INFINITY)
+        {
+            _bc_spirit1.rx_tick_timeout = BC_TICK_INFINITY;
+        }
+        else
+        {
+            _bc_spirit1.rx_tick_timeout = bc_tick_get() + timeout;
+        }
+
+        bc_scheduler_plan_now(_bc_spirit1.task_id);
+    }
+}
+
+uint32_t bc_spirit1_get_spi_bytes_transferred(void)
+{
+    return _bc_spirit1.shadow.bytes_transferred;
+}
+
+uint32_t bc_spirit1_get_spi_bytes_saved(void)
+{
+    return _bc_spirit1.shadow.bytes_saved;
+}
+
+void bc_spirit1_set_sleep_mode(bc_spirit1_sleep_mode_t mode)
+{
+    _bc_spirit1.sleep.mode = mode;
+
+    // Radio which already sleeps is moved to new mode right away
+    if (_bc_spirit1.current_state == BC_SPIRIT1_STATE_SLEEP && _bc_spirit1.desired_state == BC_SPIRIT1_STATE_SLEEP)
+    {
+        if (mode == BC_SPIRIT1_SLEEP_MODE_SHUTDOWN && !_bc_spirit1.sleep.shutdown)
+        {
+            _bc_spirit1_enter_state_sleep();
+        }
+        else if (mode == BC_SPIRIT1_SLEEP_MODE_STANDBY && _bc_spirit1.sleep.shutdown)
+        {
+            _bc_spirit1_wake_up();
+
+            SpiritCmdStrobeStandby();
+        }
+    }
+}
+
+bool bc_spirit1_set_profile(const bc_spirit1_profile_t *profile)
+{
+    if (profile->datarate >= BC_SPIRIT1_DATARATE_COUNT || profile->power < BC_SPIRIT1_POWER_MIN || profile->power > BC_SPIRIT1_POWER_MAX)
+    {
+        return false;
+    }
+
+    _bc_spirit1.profile = *profile;
+    _bc_spirit1.profile_pending = true;
+
+    // Reception which is already running is restarted with new profile
+    bc_scheduler_plan_now(_bc_spirit1.task_id);
+
+    return true;
+}
+
+void bc_spirit1_get_profile(bc_spirit1_profile_t *profile)
+{
+    *profile = _bc_spirit1.profile;
+}
+
+bool bc_spirit1_measure_rssi(uint8_t channel, float *rssi)
+{
+    // Radio is borrowed only when nothing else uses it
+    if (_bc_spirit1.current_state != BC_SPIRIT1_STATE_SLEEP || _bc_spirit1.desired_state != BC_SPIRIT1_STATE_SLEEP || _bc_spirit1.transfer.busy)
+    {
+        return false;
+    }
+
+    if (_bc_spirit1.sleep.shutdown)
+    {
+        _bc_spirit1_wake_up();
+    }
+
+    if (_bc_spirit1.profile_pending)
+    {
+        _bc_spirit1_apply_profile();
+    }
+
+    SpiritRadioSetChannel(channel);
+
+    SpiritCmdStrobeReady();
+    SpiritCmdStrobeRx();
+
+    bc_spirit1_hal_delay(BC_SPIRIT1_RSSI_SETTLE_TIME);
+
+    // Signal level is captured when reception is aborted
+    SpiritCmdStrobeSabort();
+
+    *rssi = SpiritQiGetRssidBm();
+
+    SpiritRadioSetChannel(_bc_spirit1.profile.channel);
+
+    _bc_spirit1_enter_state_sleep();
+
+    return true;
+}
+
+uint32_t bc_spirit1_get_wake_up_count(void)
+{
+    return _bc_spirit1.sleep.wake_up_count;
+}
+
+uint32_t bc_spirit1_get_wake_up_time(void)
+{
+    return _bc_spirit1.sleep.wake_up_time;
+}
+
+uint32_t bc_spirit1_get_rx_rearm_time(bool deferred)
+{
+    return _bc_spirit1_lse_to_us(_bc_spirit1.rearm.max[deferred ? 1 : 0]);
+}
+
+void bc_spirit1_reset_rx_rearm_time(void)
+{
+    _bc_spirit1.rearm.max[0] = 0;
+    _bc_spirit1.rearm.max[1] = 0;
+}
+
+uint32_t bc_spirit1_get_rx_discarded(void)
+{
+    return _bc_spirit1.rx_discarded;
+}
+
+uint32_t bc_spirit1_get_rx_dropped(void)
+{
+    return _bc_spirit1.rx_dropped;
+}
+
+void bc_spirit1_set_address(uint8_t address)
+{
+    // Filter is written on next entry to reception, destination on next transmission
+    _bc_spirit1.address = address;
+}
+
+uint8_t bc_spirit1_get_address(void)
+{
+    return _bc_spirit1.address;
+}
+
+uint32_t bc_spirit1_get_rx_rejected(void)
+{
+    return _bc_spirit1.rx_rejected;
+}
+
+uint32_t bc_spirit1_get_rx_crc_error(void)
+{
+    return _bc_spirit1.rx_crc_error;
+}
+
+bc_tick_t bc_spirit1_get_airtime(size_t length)
+{
+    uint32_t datarate = _bc_spirit1_datarates[_bc_spirit1.profile.datarate].datarate;
+    size_t bytes = BC_SPIRIT1_FRAME_PREAMBLE + (_bc_spirit1.profile.fec ? 2 : 1) * (BC_SPIRIT1_FRAME_OVERHEAD + length);
+
+    return ((bytes * 8 * 1000) + datarate - 1) / datarate;
 }
 
 void bc_spirit1_tx(void)
@@ -172,6 +455,38 @@ static void _bc_spirit1_task(void *param)
 {
     (void) param;
 
+    // Frames were already taken out of FIFO in interrupt
+    _bc_spirit1_rx_deliver();
+
+    // Task is planned again once FIFO transfer completes
+    if (_bc_spirit1.transfer.busy)
+    {
+        return;
+    }
+
+    if (_bc_spirit1.transfer.done)
+    {
+        _bc_spirit1.transfer.done = false;
+
+        if (_bc_spirit1.transfer.dma)
+        {
+            bc_module_core_pll_disable();
+        }
+
+        if (_bc_spirit1.transfer.callback != NULL)
+        {
+            _bc_spirit1.transfer.callback();
+        }
+
+        // Interrupt or state change might have come during transfer
+        if (_bc_spirit1.irq_pending || _bc_spirit1.desired_state != _bc_spirit1.current_state)
+        {
+            bc_scheduler_plan_current_now();
+        }
+
+        return;
+    }
+
     if (_bc_spirit1.desired_state != _bc_spirit1.current_state)
     {
         if (_bc_spirit1.desired_state == BC_SPIRIT1_STATE_TX)
@@ -212,159 +527,571 @@ static void _bc_spirit1_task(void *param)
 
 static void _bc_spirit1_enter_state_tx(void)
 {
+    _bc_spirit1.rx_armed = false;
+
+    if (_bc_spirit1.sleep.shutdown)
+    {
+        _bc_spirit1_wake_up();
+    }
+
     _bc_spirit1.current_state = BC_SPIRIT1_STATE_TX;
 
     SpiritCmdStrobeSabort();
     SpiritCmdStrobeReady();
     SpiritCmdStrobeFlushTxFifo();
 
-    SpiritIrqDeInit(NULL);
-    SpiritIrqClearStatus();
-    SpiritIrq(TX_DATA_SENT, S_ENABLE);
+    if (_bc_spirit1.profile_pending)
+    {
+        _bc_spirit1_apply_profile();
+    }
+
+    SpiritIrqDeInit(NULL);
+    SpiritIrqClearStatus();
+    SpiritIrq(TX_DATA_SENT, S_ENABLE);
+
+    if (_bc_spirit1.tx_length > BC_SPIRIT1_FIFO_SIZE)
+    {
+        SpiritLinearFifoSetAlmostEmptyThresholdTx(BC_SPIRIT1_FIFO_THRESHOLD);
+
+        SpiritIrq(TX_FIFO_ALMOST_EMPTY, S_ENABLE);
+        SpiritIrq(TX_FIFO_ERROR, S_ENABLE);
+    }
+
+    SpiritPktBasicSetPayloadLength(_bc_spirit1.tx_length);
+
+    // Receivers of other networks discard frame by this address
+    SpiritPktBasicSetDestinationAddress(_bc_spirit1.address);
+
+    _bc_spirit1.tx_offset = 0;
+
+    _bc_spirit1.irq_pending = false;
+
+    _bc_spirit1_write_tx_fifo(_bc_spirit1_tx_start);
+}
+
+static void _bc_spirit1_tx_start(void)
+{
+    bc_exti_register(BC_EXTI_LINE_PA7, BC_EXTI_EDGE_FALLING, _bc_spirit1_interrupt, NULL);
+
+    SpiritCmdStrobeTx();
+}
+
+static void _bc_spirit1_check_state_tx(void)
+{
+    SpiritIrqs xIrqStatus;
+
+    _bc_spirit1.irq_pending = false;
+
+    SpiritIrqGetStatus(&xIrqStatus);
+
+    if (xIrqStatus.IRQ_TX_FIFO_ALMOST_EMPTY && !xIrqStatus.IRQ_TX_DATA_SENT && !xIrqStatus.IRQ_TX_FIFO_ERROR)
+    {
+        _bc_spirit1_write_tx_fifo(NULL);
+
+        return;
+    }
+
+    // Underflow means FIFO was not refilled in time, frame is lost as if it collided
+    if (xIrqStatus.IRQ_TX_DATA_SENT || xIrqStatus.IRQ_TX_FIFO_ERROR)
+    {
+        SpiritIrqClearStatus();
+
+        _bc_spirit1.desired_state = BC_SPIRIT1_STATE_SLEEP;
+
+        if (_bc_spirit1.event_handler != NULL)
+        {
+            _bc_spirit1.event_handler(BC_SPIRIT1_EVENT_TX_DONE, _bc_spirit1.event_param);
+        }
+
+        if (_bc_spirit1.desired_state == BC_SPIRIT1_STATE_RX)
+        {
+            _bc_spirit1_enter_state_rx();
+        }
+        else if (_bc_spirit1.desired_state == BC_SPIRIT1_STATE_SLEEP)
+        {
+            _bc_spirit1_enter_state_sleep();
+        }
+    }
+}
+
+static void _bc_spirit1_enter_state_rx(void)
+{
+    _bc_spirit1.rx_armed = false;
+
+    if (_bc_spirit1.sleep.shutdown)
+    {
+        _bc_spirit1_wake_up();
+    }
+
+    _bc_spirit1.current_state = BC_SPIRIT1_STATE_RX;
+
+    if (_bc_spirit1.profile_pending)
+    {
+        SpiritCmdStrobeSabort();
+
+        _bc_spirit1_apply_profile();
+    }
+
+    if (_bc_spirit1.rx_timeout == 0 || _bc_spirit1.rx_timeout == BC_TICK_INFINITY)
+    {
+        _bc_spirit1.rx_tick_timeout = BC_TICK_INFINITY;
+    }
+    else
+    {
+        _bc_spirit1.rx_tick_timeout = bc_tick_get() + _bc_spirit1.rx_timeout;
+    }
+
+    SpiritIrqs xIrqStatus;
+
+    SpiritIrqDeInit(&xIrqStatus);
+    SpiritIrq(RX_DATA_DISC, S_ENABLE);
+    SpiritIrq(RX_TIMEOUT, S_ENABLE);
+    SpiritIrq(CRC_ERROR, S_ENABLE);
+    SpiritIrq(RX_DATA_READY, S_ENABLE);
+    SpiritIrq(RX_FIFO_ALMOST_FULL, S_ENABLE);
+    SpiritIrq(RX_FIFO_ERROR, S_ENABLE);
+
+    SpiritLinearFifoSetAlmostFullThresholdRx(BC_SPIRIT1_FIFO_SIZE - BC_SPIRIT1_FIFO_THRESHOLD);
+
+    /* payload length config */
+    SpiritPktBasicSetPayloadLength(BC_SPIRIT1_MAX_PACKET_SIZE);
+
+    // Frame sent to other address is discarded right after its address field, payload is never read out
+    SpiritPktBasicSetMyAddress(_bc_spirit1.address);
+    SpiritPktBasicFilterOnMyAddress(_bc_spirit1.address != 0 ? S_ENABLE : S_DISABLE);
+
+    /* enable SQI check */
+    SpiritQiSetSqiThreshold(SQI_TH_0);
+    SpiritQiSqiCheck(S_ENABLE);
+
+    /* RX timeout config */
+    SpiritTimerSetRxTimeoutMs(1000.0);
+    SpiritTimerSetRxTimeoutStopCondition(SQI_ABOVE_THRESHOLD);
+
+    /* IRQ registers blanking */
+    SpiritIrqClearStatus();
+
+    _bc_spirit1.irq_pending = false;
+
+    _bc_spirit1.rx_offset = 0;
+    _bc_spirit1.rx_overflow = false;
+
+    bc_exti_register(BC_EXTI_LINE_PA7, BC_EXTI_EDGE_FALLING, _bc_spirit1_interrupt, NULL);
+
+    /* RX command */
+    SpiritCmdStrobeRx();
+
+    // From now on interrupt serves FIFO by itself
+    _bc_spirit1.rx_armed = true;
+
+    bc_scheduler_plan_current_absolute(_bc_spirit1.rx_tick_timeout);
+}
+
+static void _bc_spirit1_check_state_rx(void)
+{
+    if (bc_tick_get() >= _bc_spirit1.rx_tick_timeout)
+    {
+        _bc_spirit1.rx_tick_timeout = BC_TICK_INFINITY;
+
+        if (_bc_spirit1.event_handler != NULL)
+        {
+            _bc_spirit1.event_handler(BC_SPIRIT1_EVENT_RX_TIMEOUT, _bc_spirit1.event_param);
+        }
+
+        if (_bc_spirit1.desired_state != BC_SPIRIT1_STATE_RX)
+        {
+            return;
+        }
+    }
+
+    if (_bc_spirit1.profile_pending && !_bc_spirit1.irq_pending)
+    {
+        _bc_spirit1_enter_state_rx();
+
+        return;
+    }
+
+    // Task may be also planned to check timeout only
+    if (!_bc_spirit1.irq_pending)
+    {
+        bc_scheduler_plan_current_absolute(_bc_spirit1.rx_tick_timeout);
+
+        return;
+    }
+
+    _bc_spirit1.irq_pending = false;
+
+    // Interrupt came while SPI was in use, serve it here and keep interrupt away meanwhile
+    _bc_spirit1.spi_lock++;
+
+    _bc_spirit1_rx_service();
+
+    _bc_spirit1.spi_lock--;
+
+    _bc_spirit1_rx_deliver();
+
+    if (_bc_spirit1.irq_pending)
+    {
+        bc_scheduler_plan_current_now();
+
+        return;
+    }
+
+    if (_bc_spirit1.desired_state == BC_SPIRIT1_STATE_RX)
+    {
+        bc_scheduler_plan_current_absolute(_bc_spirit1.rx_tick_timeout);
+    }
+}
+
+static void _bc_spirit1_rx_service(void)
+{
+    SpiritIrqs xIrqStatus;
+
+    /* Get the IRQ status */
+    SpiritIrqGetStatus(&xIrqStatus);
+
+    // Receiver stops when no frame starts within RX timeout and raises RX_DATA_DISC with it, nothing was received
+    if (xIrqStatus.IRQ_RX_TIMEOUT)
+    {
+        _bc_spirit1.rx_offset = 0;
+        _bc_spirit1.rx_overflow = false;
+
+        _bc_spirit1_rx_restart();
+    }
+    else if (xIrqStatus.IRQ_RX_DATA_DISC || xIrqStatus.IRQ_RX_FIFO_ERROR)
+    {
+        // Filtering discards frame either for its CRC or for its address
+        if (xIrqStatus.IRQ_CRC_ERROR)
+        {
+            _bc_spirit1.rx_crc_error++;
+        }
+        else if (xIrqStatus.IRQ_RX_DATA_DISC)
+        {
+            _bc_spirit1.rx_rejected++;
+        }
+        else
+        {
+            _bc_spirit1.rx_discarded++;
+        }
+
+        _bc_spirit1.rx_offset = 0;
+        _bc_spirit1.rx_overflow = false;
+
+        _bc_spirit1_rx_restart();
+    }
+    else if (xIrqStatus.IRQ_RX_DATA_READY)
+    {
+        _bc_spirit1_rx_drain();
+
+        size_t head = (_bc_spirit1.rx_head + 1) % BC_SPIRIT1_RX_POOL_SIZE;
+
+        // Frame is dropped if task has not yet taken all previous ones
+        if (_bc_spirit1.rx_overflow)
+        {
+            _bc_spirit1.rx_discarded++;
+        }
+        else if (head == _bc_spirit1.rx_tail)
+        {
+            _bc_spirit1.rx_dropped++;
+        }
+        else
+        {
+            _bc_spirit1.rx_pool[_bc_spirit1.rx_head].length = _bc_spirit1.rx_offset;
+            _bc_spirit1.rx_head = head;
+        }
+
+        _bc_spirit1.rx_offset = 0;
+        _bc_spirit1.rx_overflow = false;
+
+        // Receiver is ready for next frame before this one is processed
+        _bc_spirit1_rx_restart();
+
+        bc_scheduler_plan_now(_bc_spirit1.task_id);
+    }
+    else if (xIrqStatus.IRQ_RX_FIFO_ALMOST_FULL)
+    {
+        // Drain FIFO while frame is still being received
+        _bc_spirit1_rx_drain();
+    }
+}
+
+static void _bc_spirit1_rx_drain(void)
+{
+    uint8_t length = SpiritLinearFifoReadNumElementsRxFifo();
+
+    // Frame longer than buffer is read out and discarded
+    if (_bc_spirit1.rx_overflow || _bc_spirit1.rx_offset + length > BC_SPIRIT1_MAX_PACKET_SIZE)
+    {
+        uint8_t dummy[BC_SPIRIT1_FIFO_SIZE];
+
+        _bc_spirit1.rx_overflow = true;
+
+        bc_spirit1_read(0xff, dummy, length);
+
+        return;
+    }
+
+    bc_spirit1_read(0xff, &_bc_spirit1.rx_pool[_bc_spirit1.rx_head].buffer[_bc_spirit1.rx_offset], length);
+
+    _bc_spirit1.rx_offset += length;
+}
+
+static void _bc_spirit1_rx_restart(void)
+{
+    /* Flush the RX FIFO */
+    SpiritCmdStrobeFlushRxFifo();
+
+    /* RX command - to ensure the device will be ready for the next reception */
+    SpiritCmdStrobeRx();
+
+    // Task holds SPI lock while it serves interrupt which came during its transfer
+    int path = _bc_spirit1.spi_lock != 0 ? 1 : 0;
+
+    uint16_t elapsed = TIM21->CNT - _bc_spirit1.rearm.start;
+
+    if (elapsed > _bc_spirit1.rearm.max[path])
+    {
+        _bc_spirit1.rearm.max[path] = elapsed;
+    }
+}
+
+static void _bc_spirit1_rx_deliver(void)
+{
+    while (_bc_spirit1.rx_tail != _bc_spirit1.rx_head)
+    {
+        if (_bc_spirit1.event_handler != NULL)
+        {
+            _bc_spirit1.event_handler(BC_SPIRIT1_EVENT_RX_DONE, _bc_spirit1.event_param);
+        }
+
+        _bc_spirit1.rx_tail = (_bc_spirit1.rx_tail + 1) % BC_SPIRIT1_RX_POOL_SIZE;
+    }
+}
+
+static void _bc_spirit1_write_tx_fifo(void (*callback)(void))
+{
+    size_t length = _bc_spirit1.tx_length - _bc_spirit1.tx_offset;
+    size_t space = BC_SPIRIT1_FIFO_SIZE - SpiritLinearFifoReadNumElementsTxFifo();
+
+    if (length > space)
+    {
+        length = space;
+    }
+
+    uint8_t *buffer = &_bc_spirit1.tx_buffer[_bc_spirit1.tx_offset];
+
+    _bc_spirit1.tx_offset += length;
+
+    // Nothing more to refill
+    if (_bc_spirit1.tx_length > BC_SPIRIT1_FIFO_SIZE && _bc_spirit1.tx_offset == _bc_spirit1.tx_length)
+    {
+        SpiritIrq(TX_FIFO_ALMOST_EMPTY, S_DISABLE);
+    }
+
+    _bc_spirit1_fifo_transfer(buffer, length, callback);
+}
+
+// Only TX FIFO is filled by DMA, RX FIFO is drained by blocking reads in interrupt where receiver is re-armed without waiting for task
+static void _bc_spirit1_fifo_transfer(uint8_t *buffer, size_t length, void (*callback)(void))
+{
+    _bc_spirit1.transfer.callback = callback;
+    _bc_spirit1.transfer.done = true;
+
+    // DMA channel 2 is shared with WS2812B driver, fall back to blocking transfer while it is in use
+    if (length == 0 || (DMA1_Channel2->CCR & DMA_CCR_EN) != 0)
+    {
+        _bc_spirit1.transfer.dma = false;
+
+        bc_spirit1_write(0xff, buffer, length);
+
+        bc_scheduler_plan_now(_bc_spirit1.task_id);
+
+        return;
+    }
+
+    // PLL stays enabled until completion is handled in task
+    bc_module_core_pll_enable();
+
+    _bc_spirit1.transfer.done = false;
+    _bc_spirit1.transfer.dma = true;
+    _bc_spirit1.transfer.buffer = buffer;
+    _bc_spirit1.transfer.length = length;
+    _bc_spirit1.transfer.busy = true;
+
+    bc_dma_register(BC_DMA_CHANNEL_2, _bc_spirit1_dma_irq, NULL);
+
+    // Set CS pin to log. 0, data phase starts after setup time in timer interrupt
+    GPIOA->BSRR = GPIO_BSRR_BR_15;
+
+    _bc_spirit1.transfer.step = BC_SPIRIT1_TRANSFER_STEP_SETUP;
+
+    bc_spirit1_hal_start_timer_it();
+}
+
+static void _bc_spirit1_enter_state_sleep(void)
+{
+    _bc_spirit1.rx_armed = false;
+
+    _bc_spirit1.current_state = BC_SPIRIT1_STATE_SLEEP;
+
+    SpiritCmdStrobeSabort();
+    SpiritCmdStrobeReady();
+    SpiritIrqDeInit(NULL);
+    SpiritIrqClearStatus();
+
+    if (_bc_spirit1.sleep.mode == BC_SPIRIT1_SLEEP_MODE_SHUTDOWN)
+    {
+        _bc_spirit1_shutdown();
+
+        return;
+    }
+
+    SpiritCmdStrobeStandby();
+}
+
+static void _bc_spirit1_configure(void)
+{
+    /* Spirit ON */
+    SpiritEnterShutdown();
+    SpiritExitShutdown();
+    SpiritManagementWaExtraCurrent();
+
+    /* Spirit IRQ config */
+    SpiritGpioInit(&xGpioIRQ);
 
-    SpiritPktBasicSetPayloadLength(_bc_spirit1.tx_length);
+    /* Spirit Radio config (includes VCO calibration) */
+    SpiritRadioInit(&xRadioInit);
 
-    // TODO Why needed?
-    SpiritPktBasicSetDestinationAddress(0x35);
+    /* Spirit Packet config */
+    SpiritPktBasicInit(&xBasicInit);
+    SpiritPktBasicAddressesInit(&xAddressInit);
+}
 
-    SpiritSpiWriteLinearFifo(_bc_spirit1.tx_length, _bc_spirit1.tx_buffer);
+static void _bc_spirit1_apply_profile(void)
+{
+    _bc_spirit1.profile_pending = false;
 
-    bc_exti_register(BC_EXTI_LINE_PA7, BC_EXTI_EDGE_FALLING, _bc_spirit1_interrupt, NULL);
+    // Registers go through shadow, so they are also restored after shutdown
+    SpiritRadioSetChannel(_bc_spirit1.profile.channel);
+    SpiritRadioSetDatarate(_bc_spirit1_datarates[_bc_spirit1.profile.datarate].datarate);
+    SpiritRadioSetFrequencyDev(_bc_spirit1_datarates[_bc_spirit1.profile.datarate].deviation);
+    SpiritRadioSetChannelBW(_bc_spirit1_datarates[_bc_spirit1.profile.datarate].bandwidth);
+    SpiritPktBasicFec(_bc_spirit1.profile.fec ? S_ENABLE : S_DISABLE);
 
-    SpiritCmdStrobeTx();
+    SpiritRadioSetPALeveldBm(0, _bc_spirit1.profile.power);
+    SpiritRadioSetPALevelMaxIndex(0);
 }
 
-static void _bc_spirit1_check_state_tx(void)
+static void _bc_spirit1_shutdown(void)
 {
-    SpiritIrqs xIrqStatus;
+    // Shadow holds every register configured so far, remember which ones to write back on wake up
+    memcpy(_bc_spirit1.sleep.image, _bc_spirit1.shadow.valid, sizeof(_bc_spirit1.sleep.image));
 
-    SpiritIrqGetStatus(&xIrqStatus);
-
-    if (xIrqStatus.IRQ_TX_DATA_SENT)
-    {
-        SpiritIrqClearStatus();
+    _bc_spirit1_shadow_invalidate();
 
-        _bc_spirit1.desired_state = BC_SPIRIT1_STATE_SLEEP;
+    // Output log. 0 on CS pin
+    GPIOA->BSRR = GPIO_BSRR_BR_15;
 
-        if (_bc_spirit1.event_handler != NULL)
-        {
-            _bc_spirit1.event_handler(BC_SPIRIT1_EVENT_TX_DONE, _bc_spirit1.event_param);
-        }
+    // Output log. 1 on SDN pin
+    GPIOB->BSRR = GPIO_BSRR_BS_7;
 
-        if (_bc_spirit1.desired_state == BC_SPIRIT1_STATE_RX)
-        {
-            _bc_spirit1_enter_state_rx();
-        }
-        else if (_bc_spirit1.desired_state == BC_SPIRIT1_STATE_SLEEP)
-        {
-            _bc_spirit1_enter_state_sleep();
-        }
-    }
+    _bc_spirit1.sleep.shutdown = true;
 }
 
-static void _bc_spirit1_enter_state_rx(void)
+static void _bc_spirit1_wake_up(void)
 {
-    _bc_spirit1.current_state = BC_SPIRIT1_STATE_RX;
+    _bc_spirit1.sleep.shutdown = false;
 
-    if (_bc_spirit1.rx_timeout == 0)
-    {
-        _bc_spirit1.rx_tick_timeout = BC_TICK_INFINITY;
-    }
-    else
-    {
-        _bc_spirit1.rx_tick_timeout = bc_tick_get() + _bc_spirit1.rx_timeout;
-    }
+    // Delays below are timed from PLL clock
+    bc_module_core_pll_enable();
 
-    SpiritIrqs xIrqStatus;
+    // Output log. 1 on CS pin
+    GPIOA->BSRR = GPIO_BSRR_BS_15;
 
-    SpiritIrqDeInit(&xIrqStatus);
-    SpiritIrq(RX_DATA_DISC, S_ENABLE);
-    SpiritIrq(RX_DATA_READY, S_ENABLE);
+    // Wake up is timed from SDN release until chip is ready for TX or RX strobe with configuration restored
+    uint16_t start = TIM21->CNT;
 
-    /* payload length config */
-    SpiritPktBasicSetPayloadLength(20);
+    // Output log. 0 on SDN pin
+    GPIOB->BSRR = GPIO_BSRR_BR_7;
 
-    /* enable SQI check */
-    SpiritQiSetSqiThreshold(SQI_TH_0);
-    SpiritQiSqiCheck(S_ENABLE);
+    if (!_bc_spirit1_wait_state(MC_STATE_READY))
+    {
+        bc_module_core_pll_disable();
 
-    /* RX timeout config */
-    SpiritTimerSetRxTimeoutMs(1000.0);
-    SpiritTimerSetRxTimeoutStopCondition(SQI_ABOVE_THRESHOLD);
+        // Chip did not come up, start over including VCO calibration, profile is applied on top of it as after init
+        _bc_spirit1_configure();
 
-    /* IRQ registers blanking */
-    SpiritIrqClearStatus();
+        _bc_spirit1.profile_pending = true;
 
-    bc_exti_register(BC_EXTI_LINE_PA7, BC_EXTI_EDGE_FALLING, _bc_spirit1_interrupt, NULL);
+        return;
+    }
 
-    /* RX command */
-    SpiritCmdStrobeRx();
+    // Clock divider may be changed in STANDBY only, same as SpiritRadioInit does
+    SpiritCmdStrobeStandby();
 
-    bc_scheduler_plan_current_absolute(_bc_spirit1.rx_tick_timeout);
-}
+    _bc_spirit1_wait_state(MC_STATE_STANDBY);
 
-static void _bc_spirit1_check_state_rx(void)
-{
-    if (bc_tick_get() >= _bc_spirit1.rx_tick_timeout)
+    // Write back register image in bursts, VCO calibration words are part of it so calibration is not run again
+    size_t address = 0;
+
+    while (address < BC_SPIRIT1_SHADOW_SIZE)
     {
-        if (_bc_spirit1.event_handler != NULL)
+        if ((_bc_spirit1.sleep.image[address >> 3] & (1 << (address & 7))) == 0)
         {
-            _bc_spirit1.event_handler(BC_SPIRIT1_EVENT_RX_TIMEOUT, _bc_spirit1.event_param);
-        }
-    }
+            address++;
 
-    SpiritIrqs xIrqStatus;
+            continue;
+        }
 
-    /* Get the IRQ status */
-    SpiritIrqGetStatus(&xIrqStatus);
+        size_t end = address + 1;
 
-    /* Check the SPIRIT RX_DATA_DISC IRQ flag */
-    if (xIrqStatus.IRQ_RX_DATA_DISC)
-    {
-      /* RX command - to ensure the device will be ready for the next reception */
-      SpiritCmdStrobeRx();
-    }
+        while (end < BC_SPIRIT1_SHADOW_SIZE && (_bc_spirit1.sleep.image[end >> 3] & (1 << (end & 7))) != 0)
+        {
+            end++;
+        }
 
-    /* Check the SPIRIT RX_DATA_READY IRQ flag */
-    if (xIrqStatus.IRQ_RX_DATA_READY)
-    {
-      /* Get the RX FIFO size */
-      uint8_t cRxData = SpiritLinearFifoReadNumElementsRxFifo();
+        bc_spirit1_write(address, &_bc_spirit1.shadow.value[address], end - address);
 
-      if (cRxData <= BC_SPIRIT1_MAX_PACKET_SIZE)
-      {
-          /* Read the RX FIFO */
-          SpiritSpiReadLinearFifo(cRxData, _bc_spirit1.rx_buffer);
+        address = end;
+    }
 
-          _bc_spirit1.rx_length = cRxData;
+    SpiritCmdStrobeReady();
 
-          if (_bc_spirit1.event_handler != NULL)
-          {
-              _bc_spirit1.event_handler(BC_SPIRIT1_EVENT_RX_DONE, _bc_spirit1.event_param);
-          }
-      }
-    }
+    _bc_spirit1_wait_state(MC_STATE_READY);
 
-    /* Flush the RX FIFO */
-    SpiritCmdStrobeFlushRxFifo();
+    _bc_spirit1.sleep.wake_up_count++;
+    _bc_spirit1.sleep.wake_up_time = _bc_spirit1_lse_to_us(TIM21->CNT - start);
 
-    /* RX command - to ensure the device will be ready for the next reception */
-    SpiritCmdStrobeRx();
+    bc_module_core_pll_disable();
 }
 
-static void _bc_spirit1_enter_state_sleep(void)
+static bool _bc_spirit1_wait_state(SpiritState state)
 {
-    _bc_spirit1.current_state = BC_SPIRIT1_STATE_SLEEP;
+    for (uint32_t time = 0; time < BC_SPIRIT1_WAKE_UP_TIMEOUT; time += BC_SPIRIT1_WAKE_UP_POLL)
+    {
+        SpiritRefreshStatus();
 
-    SpiritCmdStrobeSabort();
-    SpiritCmdStrobeReady();
-    SpiritIrqDeInit(NULL);
-    SpiritIrqClearStatus();
-    SpiritCmdStrobeStandby();
+        if (g_xStatus.MC_STATE == state)
+        {
+            return true;
+        }
+
+        bc_spirit1_hal_delay(BC_SPIRIT1_WAKE_UP_POLL);
+    }
+
+    return false;
 }
 
 bc_spirit_status_t bc_spirit1_command(uint8_t command)
 {
+    // Wait for FIFO transfer in progress
+    while (_bc_spirit1.transfer.busy)
+    {
+        continue;
+    }
+
+    _bc_spirit1.spi_lock++;
+
     // Enable PLL
     bc_module_core_pll_enable();
 
@@ -383,12 +1110,65 @@ bc_spirit_status_t bc_spirit1_command(uint8_t command)
     // Disable PLL
     bc_module_core_pll_disable();
 
+    _bc_spirit1.spi_lock--;
+
+    _bc_spirit1.shadow.status = status;
+    _bc_spirit1.shadow.bytes_transferred += 2;
+
+    // Reset brings registers to default values
+    if (command == COMMAND_SRES)
+    {
+        _bc_spirit1_shadow_invalidate();
+    }
+
     // TODO Why this cast?
     return *((bc_spirit_status_t *) &status);
 }
 
 bc_spirit_status_t bc_spirit1_write(uint8_t address, const void *buffer, size_t length)
 {
+    // Wait for FIFO transfer in progress
+    while (_bc_spirit1.transfer.busy)
+    {
+        continue;
+    }
+
+    if ((size_t) address + length <= BC_SPIRIT1_SHADOW_SIZE)
+    {
+        const uint8_t *p = buffer;
+
+        size_t start = 0;
+        size_t end = length;
+
+        // Trim bytes which already hold written value
+        while (start < end && _bc_spirit1_shadow_match(address + start, p[start]))
+        {
+            start++;
+        }
+
+        while (end > start && _bc_spirit1_shadow_match(address + end - 1, p[end - 1]))
+        {
+            end--;
+        }
+
+        if (start == end)
+        {
+            _bc_spirit1.shadow.bytes_saved += 2 + length;
+
+            return *((bc_spirit_status_t *) &_bc_spirit1.shadow.status);
+        }
+
+        _bc_spirit1.shadow.bytes_saved += length - (end - start);
+
+        _bc_spirit1_shadow_update(address + start, p + start, end - start);
+
+        address += start;
+        buffer = p + start;
+        length = end - start;
+    }
+
+    _bc_spirit1.spi_lock++;
+
     // Enable PLL
     bc_module_core_pll_enable();
 
@@ -414,12 +1194,25 @@ bc_spirit_status_t bc_spirit1_write(uint8_t address, const void *buffer, size_t
     // Disable PLL
     bc_module_core_pll_disable();
 
+    _bc_spirit1.spi_lock--;
+
+    _bc_spirit1.shadow.status = status;
+    _bc_spirit1.shadow.bytes_transferred += 2 + length;
+
     // TODO Why this cast?
     return *((bc_spirit_status_t *) &status);
 }
 
 bc_spirit_status_t bc_spirit1_read(uint8_t address, void *buffer, size_t length)
 {
+    // Wait for FIFO transfer in progress
+    while (_bc_spirit1.transfer.busy)
+    {
+        continue;
+    }
+
+    _bc_spirit1.spi_lock++;
+
     // Enable PLL
     bc_module_core_pll_enable();
 
@@ -445,10 +1238,51 @@ bc_spirit_status_t bc_spirit1_read(uint8_t address, void *buffer, size_t length)
     // Disable PLL
     bc_module_core_pll_disable();
 
+    _bc_spirit1.spi_lock--;
+
+    _bc_spirit1.shadow.status = status;
+    _bc_spirit1.shadow.bytes_transferred += 2 + length;
+
+    // Keep shadow in sync with values read from chip
+    if ((size_t) address + length <= BC_SPIRIT1_SHADOW_SIZE)
+    {
+        _bc_spirit1_shadow_update(address, buffer, length);
+    }
+
     // TODO Why this cast?
     return *((bc_spirit_status_t *) &status);
 }
 
+static uint32_t _bc_spirit1_lse_to_us(uint16_t ticks)
+{
+    // TIM21 counts periods of 32768 Hz LSE
+    return ((uint32_t) ticks * 15625) / 512;
+}
+
+static void _bc_spirit1_shadow_invalidate(void)
+{
+    memset(_bc_spirit1.shadow.valid, 0, sizeof(_bc_spirit1.shadow.valid));
+}
+
+static bool _bc_spirit1_shadow_match(uint8_t address, uint8_t value)
+{
+    if ((_bc_spirit1.shadow.valid[address >> 3] & (1 << (address & 7))) == 0)
+    {
+        return false;
+    }
+
+    return _bc_spirit1.shadow.value[address] == value;
+}
+
+static void _bc_spirit1_shadow_update(uint8_t address, const uint8_t *buffer, size_t length)
+{
+    for (size_t i = 0; i < length; i++, address++)
+    {
+        _bc_spirit1.shadow.value[address] = buffer[i];
+        _bc_spirit1.shadow.valid[address >> 3] |= 1 << (address & 7);
+    }
+}
+
 void bc_spirit1_hal_init(void)
 {
     // Initialize timer
@@ -495,6 +1329,9 @@ void bc_spirit1_hal_shutdown_low(void)
 
 void bc_spirit1_hal_shutdown_high(void)
 {
+    // Registers are lost in shutdown
+    _bc_spirit1_shadow_invalidate();
+
     // Enable PLL
     bc_module_core_pll_enable();
 
@@ -670,6 +1507,145 @@ static void bc_spirit1_hal_init_timer(void)
 
     // Enable one-pulse mode
     TIM7->CR1 |= TIM_CR1_OPM;
+
+    // Enable interrupt requests (used by FIFO transfers only)
+    NVIC_EnableIRQ(TIM7_IRQn);
+
+    // Enable clock for TIM21
+    RCC->APB2ENR |= RCC_APB2ENR_TIM21EN;
+
+    // Errata workaround
+    RCC->APB2ENR;
+
+    // TIM21 counts LSE on ETR so that receiver re-arm is timed across PLL switching
+    TIM21->OR = TIM21_OR_ETR_RMP_1;
+    TIM21->SMCR = TIM_SMCR_ECE;
+    TIM21->PSC = 0;
+    TIM21->ARR = 0xffff;
+    TIM21->EGR = TIM_EGR_UG;
+    TIM21->CR1 |= TIM_CR1_CEN;
+}
+
+static void bc_spirit1_hal_start_timer_it(void)
+{
+    // Set prescaler
+    TIM7->PSC = 0;
+
+    // Set auto-reload register - period 4 us
+    TIM7->ARR = 64 - 1;
+
+    // Generate update of registers
+    TIM7->EGR = TIM_EGR_UG;
+
+    // Clear update flag caused by register update
+    TIM7->SR = 0;
+
+    // Enable update interrupt
+    TIM7->DIER |= TIM_DIER_UIE;
+
+    // Enable counter
+    TIM7->CR1 |= TIM_CR1_CEN;
+}
+
+static void bc_spirit1_hal_delay(uint16_t microseconds)
+{
+    // Set prescaler - 1 us at 32 MHz
+    TIM7->PSC = 32 - 1;
+
+    // Set auto-reload register
+    TIM7->ARR = microseconds - 1;
+
+    // Generate update of registers
+    TIM7->EGR = TIM_EGR_UG;
+
+    // Enable counter
+    TIM7->CR1 |= TIM_CR1_CEN;
+
+    // Wait until update event occurs
+    while ((TIM7->CR1 & TIM_CR1_CEN) != 0)
+    {
+        continue;
+    }
+}
+
+void TIM7_IRQHandler(void)
+{
+    // Clear update flag
+    TIM7->SR = 0;
+
+    if (_bc_spirit1.transfer.step == BC_SPIRIT1_TRANSFER_STEP_SETUP)
+    {
+        // Write header byte and memory map address (FIFO)
+        bc_spirit1_hal_transfer_byte(0);
+        bc_spirit1_hal_transfer_byte(0xff);
+
+        // Select SPI1 requests on channels 2 (RX) and 3 (TX)
+        DMA1_CSELR->CSELR = (DMA1_CSELR->CSELR & ~(DMA_CSELR_C2S | DMA_CSELR_C3S)) | (1 << DMA_CSELR_C2S_Pos) | (1 << DMA_CSELR_C3S_Pos);
+
+        // Clear flags of both channels
+        DMA1->IFCR = DMA_IFCR_CGIF2 | DMA_IFCR_CGIF3;
+
+        // Received bytes are discarded, channel 2 only tells when last one was clocked in
+        DMA1_Channel2->CPAR = (uint32_t) &SPI1->DR;
+        DMA1_Channel2->CNDTR = _bc_spirit1.transfer.length;
+        DMA1_Channel2->CMAR = (uint32_t) &_bc_spirit1.transfer.dummy_rx;
+        DMA1_Channel2->CCR = DMA_CCR_TCIE;
+
+        DMA1_Channel3->CPAR = (uint32_t) &SPI1->DR;
+        DMA1_Channel3->CNDTR = _bc_spirit1.transfer.length;
+        DMA1_Channel3->CMAR = (uint32_t) _bc_spirit1.transfer.buffer;
+        DMA1_Channel3->CCR = DMA_CCR_DIR | DMA_CCR_MINC;
+
+        _bc_spirit1.transfer.step = BC_SPIRIT1_TRANSFER_STEP_DATA;
+
+        // Enable RX request first so that no received byte is missed
+        SPI1->CR2 |= SPI_CR2_RXDMAEN;
+
+        DMA1_Channel2->CCR |= DMA_CCR_EN;
+        DMA1_Channel3->CCR |= DMA_CCR_EN;
+
+        SPI1->CR2 |= SPI_CR2_TXDMAEN;
+    }
+    else if (_bc_spirit1.transfer.step == BC_SPIRIT1_TRANSFER_STEP_HOLD)
+    {
+        // Set CS pin to log. 1
+        GPIOA->BSRR = GPIO_BSRR_BS_15;
+
+        _bc_spirit1.transfer.step = BC_SPIRIT1_TRANSFER_STEP_RELEASE;
+
+        bc_spirit1_hal_start_timer_it();
+    }
+    else if (_bc_spirit1.transfer.step == BC_SPIRIT1_TRANSFER_STEP_RELEASE)
+    {
+        // Disable update interrupt, blocking transfers poll the timer
+        TIM7->DIER &= ~TIM_DIER_UIE;
+
+        _bc_spirit1.transfer.step = BC_SPIRIT1_TRANSFER_STEP_IDLE;
+
+        _bc_spirit1.transfer.busy = false;
+        _bc_spirit1.transfer.done = true;
+
+        bc_scheduler_plan_now(_bc_spirit1.task_id);
+    }
+}
+
+static void _bc_spirit1_dma_irq(bc_dma_channel_t channel, void *param)
+{
+    (void) channel;
+    (void) param;
+
+    // Last byte has been received, so SPI is idle
+    DMA1->IFCR = DMA_IFCR_CGIF2 | DMA_IFCR_CGIF3;
+
+    SPI1->CR2 &= ~(SPI_CR2_RXDMAEN | SPI_CR2_TXDMAEN);
+
+    DMA1_Channel2->CCR &= ~DMA_CCR_EN;
+    DMA1_Channel3->CCR &= ~DMA_CCR_EN;
+
+    // Keep CS low for hold time
+    _bc_spirit1.transfer.step = BC_SPIRIT1_TRANSFER_STEP_HOLD;
+
+    bc_spirit1_hal_start_timer_it();
 }
 
 static void _bc_spirit1_interrupt(bc_exti_line_t line, void *param)
@@ -677,5 +1653,21 @@ static void _bc_spirit1_interrupt(bc_exti_line_t line, void *param)
     (void) line;
     (void) param;
 
+    // Deferred interrupt is timed from the first one
+    if (!_bc_spirit1.irq_pending)
+    {
+        _bc_spirit1.rearm.start = TIM21->CNT;
+    }
+
+    // Serve reception right away unless SPI or radio state is being changed by task
+    if (_bc_spirit1.rx_armed && _bc_spirit1.spi_lock == 0 && !_bc_spirit1.transfer.busy)
+    {
+        _bc_spirit1_rx_service();
+
+        return;
+    }
+
+    _bc_spirit1.irq_pending = true;
+
     bc_scheduler_plan_now(_bc_spirit1.task_id);
 }
@@ -5,6 +5,7 @@
 #define BC_TMP112_DELAY_READ 50
 
 static void _bc_tmp112_task(void *param);
+static void _bc_tmp112_i2c_event_handler(bc_i2c_transaction_t *transaction, bc_i2c_event_t event, void *event_param);
 
 void bc_tmp112_init(bc_tmp112_t *self, bc_i2c_channel_t i2c_channel, uint8_t i2c_address)
 {
@@ -15,7 +16,7 @@ void bc_tmp112_init(bc_tmp112_t *self, bc_i2c_channel_t i2c_channel, uint8_t i2c
 
     bc_i2c_init(self->_i2c_channel, BC_I2C_SPEED_400_KHZ);
 
-    bc_scheduler_register(_bc_tmp112_task, self, BC_TMP112_DELAY_RUN);
+    self->_task_id = bc_scheduler_register(_bc_tmp112_task, self, BC_TMP112_DELAY_RUN);
 }
 
 void bc_tmp112_set_event_handler(bc_tmp112_t *self, void (*event_handler)(bc_tmp112_t *, bc_tmp112_event_t, void *), void *event_param)
@@ -115,7 +116,17 @@ start:
         {
             self->_state = BC_TMP112_STATE_ERROR;
 
-            if (!bc_i2c_write_8b(self->_i2c_channel, self->_i2c_address, 0x01, 0x81))
+            if (bc_i2c_is_busy(&self->_transaction[0]))
+            {
+                goto start;
+            }
+
+            // Failed write shows in configuration read back after conversion
+            self->_buffer[0] = 0x81;
+
+            bc_i2c_transaction_init(&self->_transaction[0], BC_I2C_DIRECTION_WRITE, self->_i2c_address, 0x01, &self->_buffer[0], 1);
+
+            if (!bc_i2c_submit(self->_i2c_channel, &self->_transaction[0]))
             {
                 goto start;
             }
@@ -130,23 +141,39 @@ start:
         {
             self->_state = BC_TMP112_STATE_ERROR;
 
-            uint8_t reg_configuration;
-
-            if (!bc_i2c_read_8b(self->_i2c_channel, self->_i2c_address, 0x01, &reg_configuration))
+            if (bc_i2c_is_busy(&self->_transaction[0]))
             {
                 goto start;
             }
 
-            if ((reg_configuration & 0x81) != 0x81)
+            // Configuration and temperature are read in one chain by interrupts, task goes on once it is finished
+            bc_i2c_transaction_init(&self->_transaction[0], BC_I2C_DIRECTION_READ, self->_i2c_address, 0x01, &self->_buffer[0], 1);
+            bc_i2c_transaction_init(&self->_transaction[1], BC_I2C_DIRECTION_READ, self->_i2c_address, 0x00, &self->_buffer[1], 2);
+
+            self->_transaction[0].chain = &self->_transaction[1];
+            self->_transaction[0].event_handler = _bc_tmp112_i2c_event_handler;
+            self->_transaction[0].event_param = self;
+
+            if (!bc_i2c_submit(self->_i2c_channel, &self->_transaction[0]))
             {
                 goto start;
             }
 
-            if (!bc_i2c_read_16b(self->_i2c_channel, self->_i2c_address, 0x00, &self->_reg_temperature))
+            self->_state = BC_TMP112_STATE_RESULT;
+
+            return;
+        }
+        case BC_TMP112_STATE_RESULT:
+        {
+            self->_state = BC_TMP112_STATE_ERROR;
+
+            if ((self->_buffer[0] & 0x81) != 0x81)
             {
                 goto start;
             }
 
+            self->_reg_temperature = self->_buffer[1] << 8 | self->_buffer[2];
+
             self->_temperature_valid = true;
 
             self->_state = BC_TMP112_STATE_UPDATE;
@@ -174,3 +201,17 @@ start:
         }
     }
 }
+
+static void _bc_tmp112_i2c_event_handler(bc_i2c_transaction_t *transaction, bc_i2c_event_t event, void *event_param)
+{
+    (void) transaction;
+
+    bc_tmp112_t *self = event_param;
+
+    if (event == BC_I2C_EVENT_ERROR)
+    {
+        self->_state = BC_TMP112_STATE_ERROR;
+    }
+
+    bc_scheduler_plan_now(self->_task_id);
+}
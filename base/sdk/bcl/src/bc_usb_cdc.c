@@ -14,8 +14,29 @@ static struct
 {
     bc_fifo_t receive_fifo;
     uint8_t receive_buffer[1024];
-    uint8_t transmit_buffer[512];
-    size_t transmit_length;
+    volatile bool receive_event;
+    volatile bool receive_paused;
+
+    void (*event_handler)(bc_usb_cdc_event_t, void *);
+    void *event_param;
+
+    // Messages are queued in ring and USB sends them from it, chunk in flight stays in place until it is confirmed,
+    // head which does not fit at top starts again from beginning and top data then end at wrap
+    uint8_t transmit_buffer[BC_USB_CDC_TRANSMIT_SIZE];
+    size_t transmit_head;
+    size_t transmit_tail;
+    size_t transmit_wrap;
+    size_t transmit_flight;
+    size_t reserve_length;
+    bool reserve_wrap;
+
+    // Lengths of queued messages not yet in flight, oldest first, so that drop oldest policy discards whole messages
+    uint16_t transmit_lengths[BC_USB_CDC_TRANSMIT_MESSAGES];
+    size_t transmit_first;
+    size_t transmit_count;
+
+    bc_usb_cdc_overflow_t overflow;
+    bc_usb_cdc_stats_t stats;
     bc_scheduler_task_id_t task_id;
 
 } _bc_usb_cdc;
@@ -25,6 +46,9 @@ USBD_HandleTypeDef hUsbDeviceFS;
 static void _bc_usb_cdc_task_start(void *param);
 static void _bc_usb_cdc_task(void *param);
 static void _bc_usb_cdc_init_hsi48();
+static void *_bc_usb_cdc_reserve(size_t length);
+static bool _bc_usb_cdc_drop(void);
+static size_t _bc_usb_cdc_get_queued(void);
 
 void bc_usb_cdc_init(void)
 {
@@ -45,50 +69,170 @@ void bc_usb_cdc_init(void)
 
 bool bc_usb_cdc_write(const void *buffer, size_t length)
 {
-    if (length > (sizeof(_bc_usb_cdc.transmit_buffer) - _bc_usb_cdc.transmit_length))
+    void *reserved = bc_usb_cdc_write_reserve(length);
+
+    if (reserved == NULL)
     {
         return false;
     }
 
-    memcpy(&_bc_usb_cdc.transmit_buffer[_bc_usb_cdc.transmit_length], buffer, length);
+    memcpy(reserved, buffer, length);
+
+    bc_usb_cdc_write_commit(length);
+
+    return true;
+}
 
-    _bc_usb_cdc.transmit_length += length;
+void *bc_usb_cdc_write_reserve(size_t length)
+{
+    void *reserved = _bc_usb_cdc_reserve(length);
+
+    // Oldest messages are discarded one at a time only until new one fits
+    while (reserved == NULL && _bc_usb_cdc.overflow == BC_USB_CDC_OVERFLOW_DROP_OLDEST && _bc_usb_cdc_drop())
+    {
+        reserved = _bc_usb_cdc_reserve(length);
+    }
+
+    if (reserved == NULL)
+    {
+        _bc_usb_cdc.stats.rejected++;
+    }
+
+    return reserved;
+}
+
+void bc_usb_cdc_write_commit(size_t length)
+{
+    if (length > _bc_usb_cdc.reserve_length)
+    {
+        length = _bc_usb_cdc.reserve_length;
+    }
+
+    _bc_usb_cdc.reserve_length = 0;
+
+    if (length == 0)
+    {
+        return;
+    }
+
+    if (_bc_usb_cdc.reserve_wrap)
+    {
+        _bc_usb_cdc.transmit_wrap = _bc_usb_cdc.transmit_head;
+        _bc_usb_cdc.transmit_head = 0;
+    }
+
+    _bc_usb_cdc.transmit_head += length;
+
+    _bc_usb_cdc.transmit_lengths[(_bc_usb_cdc.transmit_first + _bc_usb_cdc.transmit_count) % BC_USB_CDC_TRANSMIT_MESSAGES] = length;
+    _bc_usb_cdc.transmit_count++;
+
+    _bc_usb_cdc.stats.written++;
+
+    size_t queued = _bc_usb_cdc_get_queued();
+
+    if (queued > _bc_usb_cdc.stats.high_water)
+    {
+        _bc_usb_cdc.stats.high_water = queued;
+    }
 
     bc_scheduler_plan_now(_bc_usb_cdc.task_id);
+}
 
-    return true;
+void bc_usb_cdc_set_overflow(bc_usb_cdc_overflow_t overflow)
+{
+    _bc_usb_cdc.overflow = overflow;
+}
+
+void bc_usb_cdc_get_stats(bc_usb_cdc_stats_t *stats)
+{
+    *stats = _bc_usb_cdc.stats;
+}
+
+void bc_usb_cdc_reset_stats(void)
+{
+    memset(&_bc_usb_cdc.stats, 0, sizeof(_bc_usb_cdc.stats));
+}
+
+void bc_usb_cdc_set_event_handler(void (*event_handler)(bc_usb_cdc_event_t, void *), void *event_param)
+{
+    _bc_usb_cdc.event_handler = event_handler;
+    _bc_usb_cdc.event_param = event_param;
 }
 
 size_t bc_usb_cdc_read(void *buffer, size_t length)
 {
     size_t bytes_read = 0;
 
-    while (length != 0)
+    // At most two spans as data may wrap over end of ring
+    while (bytes_read < length)
     {
-        uint8_t value;
+        const void *span;
+        size_t span_length = bc_usb_cdc_read_peek(&span);
 
-        if (bc_fifo_read(&_bc_usb_cdc.receive_fifo, &value, 1) == 1)
+        if (span_length == 0)
         {
-            *(uint8_t *) buffer = value;
-
-            buffer = (uint8_t *) buffer + 1;
-
-            bytes_read++;
+            break;
         }
-        else
+
+        if (span_length > length - bytes_read)
         {
-            break;
+            span_length = length - bytes_read;
         }
 
-        length--;
+        memcpy((uint8_t *) buffer + bytes_read, span, span_length);
+
+        bc_usb_cdc_read_consume(span_length);
+
+        bytes_read += span_length;
     }
 
     return bytes_read;
 }
 
-void bc_usb_cdc_received_data(const void *buffer, size_t length)
+size_t bc_usb_cdc_read_peek(const void **buffer)
+{
+    return bc_fifo_peek(&_bc_usb_cdc.receive_fifo, (void **) buffer);
+}
+
+void bc_usb_cdc_read_consume(size_t length)
+{
+    bc_fifo_consume(&_bc_usb_cdc.receive_fifo, length);
+
+    // Reception stopped by full ring goes on once whole packet fits again
+    if (_bc_usb_cdc.receive_paused && bc_fifo_get_free(&_bc_usb_cdc.receive_fifo) >= CDC_DATA_FS_MAX_PACKET_SIZE)
+    {
+        HAL_NVIC_DisableIRQ(USB_IRQn);
+
+        _bc_usb_cdc.receive_paused = false;
+
+        // Device which is no longer configured has no class data, reception starts over with next configuration
+        if (hUsbDeviceFS.pClassData != NULL)
+        {
+            CDC_Receive_Resume_FS();
+        }
+
+        HAL_NVIC_EnableIRQ(USB_IRQn);
+    }
+}
+
+void bc_usb_cdc_received_reset(void)
+{
+    // Class arms its endpoint by itself when configured, reception held off before is not resumed again
+    _bc_usb_cdc.receive_paused = false;
+}
+
+bool bc_usb_cdc_received_data(const void *buffer, size_t length)
 {
     bc_fifo_irq_write(&_bc_usb_cdc.receive_fifo, (uint8_t *) buffer, length);
+
+    // Reader is woken only when data comes instead of polling ring
+    _bc_usb_cdc.receive_event = true;
+
+    bc_scheduler_plan_now(_bc_usb_cdc.task_id);
+
+    _bc_usb_cdc.receive_paused = bc_fifo_get_free(&_bc_usb_cdc.receive_fifo) < CDC_DATA_FS_MAX_PACKET_SIZE;
+
+    return !_bc_usb_cdc.receive_paused;
 }
 
 static void _bc_usb_cdc_task_start(void *param)
@@ -106,23 +250,194 @@ static void _bc_usb_cdc_task(void *param)
 {
     (void) param;
 
-    if (_bc_usb_cdc.transmit_length == 0)
+    // Flag is cleared first so that data coming during handler plans task again
+    if (_bc_usb_cdc.receive_event)
     {
-        return;
+        _bc_usb_cdc.receive_event = false;
+
+        if (_bc_usb_cdc.event_handler != NULL)
+        {
+            _bc_usb_cdc.event_handler(BC_USB_CDC_EVENT_RECEIVE, _bc_usb_cdc.event_param);
+        }
+    }
+
+    USBD_CDC_HandleTypeDef *hcdc = (USBD_CDC_HandleTypeDef *) hUsbDeviceFS.pClassData;
+
+    if (_bc_usb_cdc.transmit_flight != 0)
+    {
+        // Chunk in flight is kept until USB is done with it, device which is no longer configured will not send it
+        if (hcdc != NULL && hcdc->TxState != 0)
+        {
+            bc_scheduler_plan_current_now();
+
+            return;
+        }
+
+        _bc_usb_cdc.transmit_tail += _bc_usb_cdc.transmit_flight;
+        _bc_usb_cdc.transmit_flight = 0;
+
+        if (_bc_usb_cdc.transmit_wrap != 0 && _bc_usb_cdc.transmit_tail == _bc_usb_cdc.transmit_wrap)
+        {
+            _bc_usb_cdc.transmit_tail = 0;
+            _bc_usb_cdc.transmit_wrap = 0;
+        }
+
+        // Empty ring starts from beginning so that long messages fit in one piece
+        if (_bc_usb_cdc.transmit_wrap == 0 && _bc_usb_cdc.transmit_tail == _bc_usb_cdc.transmit_head)
+        {
+            _bc_usb_cdc.transmit_tail = 0;
+            _bc_usb_cdc.transmit_head = 0;
+        }
     }
 
-    HAL_NVIC_DisableIRQ(USB_IRQn);
+    // Everything queued up to end of contiguous data goes in one chunk, writers fill rest of ring meanwhile
+    size_t end = _bc_usb_cdc.transmit_wrap != 0 ? _bc_usb_cdc.transmit_wrap : _bc_usb_cdc.transmit_head;
 
-    if (CDC_Transmit_FS(_bc_usb_cdc.transmit_buffer, _bc_usb_cdc.transmit_length) == USBD_OK)
+    if (_bc_usb_cdc.transmit_tail == end)
     {
-        _bc_usb_cdc.transmit_length = 0;
+        return;
     }
 
-    HAL_NVIC_EnableIRQ(USB_IRQn);
+    if (hcdc != NULL)
+    {
+        HAL_NVIC_DisableIRQ(USB_IRQn);
+
+        if (CDC_Transmit_FS(&_bc_usb_cdc.transmit_buffer[_bc_usb_cdc.transmit_tail], end - _bc_usb_cdc.transmit_tail) == USBD_OK)
+        {
+            _bc_usb_cdc.transmit_flight = end - _bc_usb_cdc.transmit_tail;
+
+            // Messages handed to USB can no longer be dropped, chunk always ends at message boundary
+            size_t flight = 0;
+
+            while (flight < _bc_usb_cdc.transmit_flight)
+            {
+                flight += _bc_usb_cdc.transmit_lengths[_bc_usb_cdc.transmit_first];
+
+                _bc_usb_cdc.transmit_first = (_bc_usb_cdc.transmit_first + 1) % BC_USB_CDC_TRANSMIT_MESSAGES;
+                _bc_usb_cdc.transmit_count--;
+            }
+        }
+
+        HAL_NVIC_EnableIRQ(USB_IRQn);
+    }
 
     bc_scheduler_plan_current_now();
 }
 
+static void *_bc_usb_cdc_reserve(size_t length)
+{
+    _bc_usb_cdc.reserve_length = 0;
+    _bc_usb_cdc.reserve_wrap = false;
+
+    size_t head = _bc_usb_cdc.transmit_head;
+    size_t tail = _bc_usb_cdc.transmit_tail;
+
+    // Ring is also full once it holds as many messages as their lengths can be kept for
+    if (_bc_usb_cdc.transmit_count == BC_USB_CDC_TRANSMIT_MESSAGES)
+    {
+        return NULL;
+    }
+
+    if (_bc_usb_cdc.transmit_wrap == 0)
+    {
+        if (BC_USB_CDC_TRANSMIT_SIZE - head >= length)
+        {
+            _bc_usb_cdc.reserve_length = length;
+
+            return &_bc_usb_cdc.transmit_buffer[head];
+        }
+
+        // Head starting again from beginning must stay behind tail, equal positions mean empty ring
+        if (length < tail)
+        {
+            _bc_usb_cdc.reserve_length = length;
+            _bc_usb_cdc.reserve_wrap = true;
+
+            return _bc_usb_cdc.transmit_buffer;
+        }
+    }
+    else if (tail - head > length)
+    {
+        _bc_usb_cdc.reserve_length = length;
+
+        return &_bc_usb_cdc.transmit_buffer[head];
+    }
+
+    return NULL;
+}
+
+static bool _bc_usb_cdc_drop(void)
+{
+    if (_bc_usb_cdc.transmit_count == 0)
+    {
+        return false;
+    }
+
+    size_t length = _bc_usb_cdc.transmit_lengths[_bc_usb_cdc.transmit_first];
+
+    _bc_usb_cdc.transmit_first = (_bc_usb_cdc.transmit_first + 1) % BC_USB_CDC_TRANSMIT_MESSAGES;
+    _bc_usb_cdc.transmit_count--;
+
+    _bc_usb_cdc.stats.dropped += length;
+
+    uint8_t *buffer = _bc_usb_cdc.transmit_buffer;
+
+    // Without chunk in flight oldest message lies at tail which just moves over it
+    if (_bc_usb_cdc.transmit_flight == 0)
+    {
+        _bc_usb_cdc.transmit_tail += length;
+
+        if (_bc_usb_cdc.transmit_wrap != 0 && _bc_usb_cdc.transmit_tail == _bc_usb_cdc.transmit_wrap)
+        {
+            _bc_usb_cdc.transmit_tail = 0;
+            _bc_usb_cdc.transmit_wrap = 0;
+        }
+
+        if (_bc_usb_cdc.transmit_wrap == 0 && _bc_usb_cdc.transmit_tail == _bc_usb_cdc.transmit_head)
+        {
+            _bc_usb_cdc.transmit_tail = 0;
+            _bc_usb_cdc.transmit_head = 0;
+        }
+
+        return true;
+    }
+
+    // Chunk in flight must stay in place, newer messages of the same segment move over oldest one after it
+    size_t start = _bc_usb_cdc.transmit_tail + _bc_usb_cdc.transmit_flight;
+
+    if (_bc_usb_cdc.transmit_wrap == 0)
+    {
+        memmove(&buffer[start], &buffer[start + length], _bc_usb_cdc.transmit_head - start - length);
+
+        _bc_usb_cdc.transmit_head -= length;
+    }
+    else if (start != _bc_usb_cdc.transmit_wrap)
+    {
+        memmove(&buffer[start], &buffer[start + length], _bc_usb_cdc.transmit_wrap - start - length);
+
+        _bc_usb_cdc.transmit_wrap -= length;
+    }
+    else
+    {
+        // Chunk in flight ends at wrap so oldest queued message starts again from beginning
+        memmove(buffer, &buffer[length], _bc_usb_cdc.transmit_head - length);
+
+        _bc_usb_cdc.transmit_head -= length;
+    }
+
+    return true;
+}
+
+static size_t _bc_usb_cdc_get_queued(void)
+{
+    if (_bc_usb_cdc.transmit_wrap != 0)
+    {
+        return _bc_usb_cdc.transmit_wrap - _bc_usb_cdc.transmit_tail + _bc_usb_cdc.transmit_head;
+    }
+
+    return _bc_usb_cdc.transmit_head - _bc_usb_cdc.transmit_tail;
+}
+
 static void _bc_usb_cdc_init_hsi48()
 {
     bc_module_core_pll_enable();
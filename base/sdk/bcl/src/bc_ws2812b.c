@@ -2,6 +2,7 @@
 #include <bc_ws2812b.h>
 #include <bc_module_core.h>
 #include <bc_scheduler.h>
+#include <bc_dma.h>
 
 #define _BC_WS2812_TIMER_PERIOD 40               // 32000000 / 800000 = 20; 0,125us period (10 times lower the 1,25us period to have fixed math below)
 #define _BC_WS2812_TIMER_RESET_PULSE_PERIOD 1666 // 60us just to be sure = (32000000 / (320 * 60))
@@ -50,6 +51,7 @@ const uint32_t _bc_ws2812b_pulse_tab[] =
 
 static void _bc_ws2812b_dma_transfer_complete_handler(DMA_HandleTypeDef *dma_handle);
 static void _bc_ws2812b_task(void *param);
+static void _bc_ws2812b_dma_irq(bc_dma_channel_t channel, void *param);
 
 bool bc_ws2812b_init(const bc_led_strip_buffer_t *led_strip)
 {
@@ -94,7 +96,8 @@ bool bc_ws2812b_init(const bc_led_strip_buffer_t *led_strip)
     HAL_DMA_Init(&_bc_ws2812b_dma_update);
 
     HAL_NVIC_SetPriority(DMA1_Channel2_3_IRQn, 0, 0);
-    HAL_NVIC_EnableIRQ(DMA1_Channel2_3_IRQn);
+
+    bc_dma_register(BC_DMA_CHANNEL_2, _bc_ws2812b_dma_irq, NULL);
 
     HAL_DMA_Start_IT(&_bc_ws2812b_dma_update, (uint32_t) _bc_ws2812b.dma_bit_buffer, (uint32_t) &(TIM2->CCR2), dma_bit_buffer_size);
 
@@ -194,6 +197,11 @@ bool bc_ws2812b_write(void)
     HAL_TIM_Base_Stop(&_bc_ws2812b_timer2_handle);
     (&_bc_ws2812b_timer2_handle)->Instance->CR1 &= ~((0x1U << (0U)));
 
+    // DMA channel 2 is shared with SPIRIT1 driver, take it back
+    DMA1_CSELR->CSELR = (DMA1_CSELR->CSELR & ~DMA_CSELR_C2S) | (DMA_REQUEST_8 << DMA_CSELR_C2S_Pos);
+
+    bc_dma_register(BC_DMA_CHANNEL_2, _bc_ws2812b_dma_irq, NULL);
+
     // clear all DMA flags
     __HAL_DMA_CLEAR_FLAG(&_bc_ws2812b_dma_update, DMA_FLAG_TC2 | DMA_FLAG_HT2 | DMA_FLAG_TE2);
 
@@ -284,8 +292,11 @@ void HAL_TIM_PeriodElapsedCallback(TIM_HandleTypeDef *htim)
     bc_scheduler_plan_now(_bc_ws2812b.task_id);
 }
 
-void DMA1_Channel2_3_IRQHandler(void)
+static void _bc_ws2812b_dma_irq(bc_dma_channel_t channel, void *param)
 {
+    (void) channel;
+    (void) param;
+
     HAL_DMA_IRQHandler(&_bc_ws2812b_dma_update);
 }
 
@@ -110,6 +110,7 @@ extern USBD_CDC_ItfTypeDef  USBD_Interface_fops_FS;
 uint8_t CDC_Transmit_FS(uint8_t* Buf, uint16_t Len);
 
 /* USER CODE BEGIN EXPORTED_FUNCTIONS */
+void CDC_Receive_Resume_FS(void);
 /* USER CODE END EXPORTED_FUNCTIONS */
 /**
   * @}
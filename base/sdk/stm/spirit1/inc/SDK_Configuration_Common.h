@@ -84,7 +84,7 @@
 #define BASE_FREQUENCY              868.0e6
 #endif
 
-#define CHANNEL_SPACE               20e3
+#define CHANNEL_SPACE               200e3
 #define CHANNEL_NUMBER              0
 #define MODULATION_SELECT           GFSK_BT1
 #define DATARATE                    19200
@@ -101,9 +101,9 @@
 #define SYNC_WORD                   0x88888888
 #define LENGTH_TYPE                 PKT_LENGTH_VAR
 #define LENGTH_WIDTH                8
-#define CRC_MODE                    PKT_CRC_MODE_8BITS
+#define CRC_MODE                    PKT_CRC_MODE_16BITS_1
 #define CONTROL_LENGTH              PKT_CONTROL_LENGTH_0BYTES
-#define EN_ADDRESS                  S_DISABLE
+#define EN_ADDRESS                  S_ENABLE
 #define EN_FEC                      S_DISABLE
 #define EN_WHITENING                S_ENABLE
 
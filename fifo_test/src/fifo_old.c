@@ -0,0 +1,103 @@
+#include <fifo_old.h>
+
+// Interrupts are masked around every call on target, host benchmark runs in one thread so masking costs nothing here
+static inline void bc_irq_disable(void)
+{
+}
+
+static inline void bc_irq_enable(void)
+{
+}
+
+static void _fifo_old_init(bc_fifo_t *fifo, void *buffer, size_t size)
+{
+    fifo->buffer = buffer;
+    fifo->size = size;
+    fifo->head = 0;
+    fifo->tail = 0;
+}
+
+static size_t _fifo_old_write(bc_fifo_t *fifo, const void *buffer, size_t length)
+{
+    // Disable interrupts
+    bc_irq_disable();
+
+    // For each byte in buffer...
+    for (size_t i = 0; i < length; i++)
+    {
+        if ((fifo->head + 1) == fifo->tail)
+        {
+            // Enable interrupts
+            bc_irq_enable();
+
+            // Return number of bytes written
+            return i;
+        }
+
+        if (((fifo->head + 1) == fifo->size) && (fifo->tail == 0))
+        {
+            // Enable interrupts
+            bc_irq_enable();
+
+            // Return number of bytes written
+            return i;
+        }
+
+        *((uint8_t *) fifo->buffer + fifo->head) = *(uint8_t *) buffer;
+
+        buffer = (uint8_t *) buffer + 1;
+
+        fifo->head++;
+
+        if (fifo->head == fifo->size)
+        {
+            fifo->head = 0;
+        }
+    }
+
+    // Enable interrupts
+    bc_irq_enable();
+
+    // Return number of bytes written
+    return length;
+}
+
+static size_t _fifo_old_read(bc_fifo_t *fifo, void *buffer, size_t length)
+{
+    // Disable interrupts
+    bc_irq_disable();
+
+    // For desired number of bytes...
+    for (size_t i = 0; i < length; i++)
+    {
+        if (fifo->tail != fifo->head)
+        {
+            *(uint8_t *) buffer = *((uint8_t *) fifo->buffer + fifo->tail);
+
+            buffer = (uint8_t *) buffer + 1;
+
+            fifo->tail++;
+
+            if (fifo->tail == fifo->size)
+            {
+                fifo->tail = 0;
+            }
+        }
+        else
+        {
+            // Enable interrupts
+            bc_irq_enable();
+
+            // Return number of bytes read
+            return i;
+        }
+    }
+
+    // Enable interrupts
+    bc_irq_enable();
+
+    // Return number of bytes read
+    return length;
+}
+
+const fifo_api_t fifo_old_api = { _fifo_old_init, _fifo_old_write, _fifo_old_read };
@@ -0,0 +1,18 @@
+#ifndef _FIFO_OLD_H
+#define _FIFO_OLD_H
+
+#include <bc_fifo.h>
+
+// Functions benchmark drives, so that current and previous implementation run the same loop
+typedef struct
+{
+    void (*init)(bc_fifo_t *fifo, void *buffer, size_t size);
+    size_t (*write)(bc_fifo_t *fifo, const void *buffer, size_t length);
+    size_t (*read)(bc_fifo_t *fifo, void *buffer, size_t length);
+
+} fifo_api_t;
+
+// Byte by byte FIFO with masked interrupts which bc_fifo replaced
+extern const fifo_api_t fifo_old_api;
+
+#endif // _FIFO_OLD_H
@@ -0,0 +1,356 @@
+#include <bc_fifo.h>
+#include <fifo_old.h>
+
+#include <pthread.h>
+#include <time.h>
+#include <unistd.h>
+
+// Model check runs on small FIFO so that wrapping happens often, requests go past its size
+#define FIFO_MODEL_SIZE 64
+#define FIFO_MODEL_STEPS 2000000
+#define FIFO_MODEL_MAX_LENGTH 80
+
+#define FIFO_STRESS_SIZE 1024
+#define FIFO_STRESS_MAX_LENGTH 300
+
+#define FIFO_BENCH_SIZE 1024
+#define FIFO_BENCH_TOTAL (64u << 20)
+
+static unsigned long _fifo_failures;
+
+static void _fifo_usage(const char *name);
+static void _fifo_check(bool condition, const char *text, int line);
+static uint32_t _fifo_random(uint32_t *state);
+static uint8_t _fifo_pattern(uint32_t sequence);
+static void _fifo_model(void);
+static void _fifo_stress(uint32_t total);
+static void *_fifo_stress_writer(void *param);
+static void _fifo_bench(const char *name, size_t chunk, const fifo_api_t *api);
+static double _fifo_now(void);
+
+#define _FIFO_CHECK(condition) _fifo_check((condition), #condition, __LINE__)
+
+static const fifo_api_t _fifo_new_api = { bc_fifo_init, bc_fifo_write, bc_fifo_read };
+
+static struct
+{
+    bc_fifo_t fifo;
+    uint8_t buffer[FIFO_STRESS_SIZE];
+    uint32_t total;
+
+} _fifo_stress_state;
+
+int main(int argc, char **argv)
+{
+    uint32_t stress = 1u << 24;
+    bool bench = false;
+
+    int option;
+
+    while ((option = getopt(argc, argv, "s:bh")) != -1)
+    {
+        switch (option)
+        {
+            case 's':
+            {
+                stress = strtoul(optarg, NULL, 10);
+                break;
+            }
+            case 'b':
+            {
+                bench = true;
+                break;
+            }
+            case 'h':
+            default:
+            {
+                _fifo_usage(argv[0]);
+
+                return option == 'h' ? EXIT_SUCCESS : EXIT_FAILURE;
+            }
+        }
+    }
+
+    if (bench)
+    {
+        static const size_t chunks[] = { 1, 16, 64, 512 };
+
+        for (size_t i = 0; i < sizeof(chunks) / sizeof(chunks[0]); i++)
+        {
+            _fifo_bench("old", chunks[i], &fifo_old_api);
+            _fifo_bench("new", chunks[i], &_fifo_new_api);
+        }
+
+        return EXIT_SUCCESS;
+    }
+
+    _fifo_model();
+
+    _fifo_stress(stress);
+
+    printf("%lu failures\n", _fifo_failures);
+
+    return _fifo_failures == 0 ? EXIT_SUCCESS : EXIT_FAILURE;
+}
+
+static void _fifo_usage(const char *name)
+{
+    fprintf(stderr,
+        "Usage: %s [options]\n"
+        "  -s N      bytes passed between writer and reader thread in stress test (default 16777216)\n"
+        "  -b        compare throughput with previous implementation instead of testing\n"
+        "  -h        show this help\n",
+        name);
+}
+
+static void _fifo_check(bool condition, const char *text, int line)
+{
+    if (condition)
+    {
+        return;
+    }
+
+    // Only first failures are printed, the rest usually follows from them
+    if (_fifo_failures++ < 10)
+    {
+        printf("FAIL line %d: %s\n", line, text);
+    }
+}
+
+static uint32_t _fifo_random(uint32_t *state)
+{
+    *state = *state * 1103515245 + 12345;
+
+    return *state >> 16;
+}
+
+static uint8_t _fifo_pattern(uint32_t sequence)
+{
+    return (uint8_t) ((sequence * 2654435761u) >> 24);
+}
+
+static void _fifo_model(void)
+{
+    // Reference is plain array indexed by free running counters, FIFO has to agree with it after every call
+    static uint8_t buffer[FIFO_MODEL_SIZE];
+    static uint8_t reference[FIFO_MODEL_SIZE];
+    static uint8_t data[FIFO_MODEL_MAX_LENGTH];
+
+    bc_fifo_t fifo;
+    bc_fifo_init(&fifo, buffer, sizeof(buffer));
+
+    size_t head = 0;
+    size_t tail = 0;
+    uint32_t state = 1;
+
+    for (long step = 0; step < FIFO_MODEL_STEPS; step++)
+    {
+        size_t length = _fifo_random(&state) % FIFO_MODEL_MAX_LENGTH;
+        size_t used = head - tail;
+
+        switch (_fifo_random(&state) % 4)
+        {
+            case 0:
+            {
+                for (size_t i = 0; i < length; i++)
+                {
+                    data[i] = _fifo_pattern(head + i);
+                }
+
+                size_t written = bc_fifo_write(&fifo, data, length);
+
+                _FIFO_CHECK(written == (length < FIFO_MODEL_SIZE - used ? length : FIFO_MODEL_SIZE - used));
+
+                for (size_t i = 0; i < written; i++)
+                {
+                    reference[(head + i) % FIFO_MODEL_SIZE] = data[i];
+                }
+
+                head += written;
+
+                break;
+            }
+            case 1:
+            {
+                size_t read = bc_fifo_read(&fifo, data, length);
+
+                _FIFO_CHECK(read == (length < used ? length : used));
+
+                for (size_t i = 0; i < read; i++)
+                {
+                    _FIFO_CHECK(data[i] == reference[(tail + i) % FIFO_MODEL_SIZE]);
+                }
+
+                tail += read;
+
+                break;
+            }
+            case 2:
+            {
+                // Span ends at head or at end of buffer, rest of it may be consumed later
+                void *span;
+                size_t span_length = bc_fifo_peek(&fifo, &span);
+                size_t offset = tail % FIFO_MODEL_SIZE;
+
+                _FIFO_CHECK(span_length == (used < FIFO_MODEL_SIZE - offset ? used : FIFO_MODEL_SIZE - offset));
+                _FIFO_CHECK(span == buffer + offset);
+
+                size_t consumed = span_length != 0 ? _fifo_random(&state) % (span_length + 1) : 0;
+
+                for (size_t i = 0; i < consumed; i++)
+                {
+                    _FIFO_CHECK(((uint8_t *) span)[i] == reference[(tail + i) % FIFO_MODEL_SIZE]);
+                }
+
+                bc_fifo_consume(&fifo, consumed);
+
+                tail += consumed;
+
+                break;
+            }
+            default:
+            {
+                _FIFO_CHECK(bc_fifo_get_free(&fifo) == FIFO_MODEL_SIZE - used);
+
+                break;
+            }
+        }
+    }
+
+    // Size which is not power of two is rounded down
+    bc_fifo_init(&fifo, buffer, 48);
+
+    _FIFO_CHECK(fifo.size == 32);
+    _FIFO_CHECK(bc_fifo_get_free(&fifo) == 32);
+
+    printf("model %d steps\n", FIFO_MODEL_STEPS);
+}
+
+static void _fifo_stress(uint32_t total)
+{
+    // Writer thread stands for interrupt, reader mixes copying read with peek and consume of spans in place
+    bc_fifo_init(&_fifo_stress_state.fifo, _fifo_stress_state.buffer, sizeof(_fifo_stress_state.buffer));
+
+    _fifo_stress_state.total = total;
+
+    pthread_t writer;
+
+    if (pthread_create(&writer, NULL, _fifo_stress_writer, NULL) != 0)
+    {
+        _FIFO_CHECK(false);
+
+        return;
+    }
+
+    uint8_t data[FIFO_STRESS_MAX_LENGTH];
+    uint32_t sequence = 0;
+    uint32_t state = 2;
+
+    while (sequence < total)
+    {
+        size_t length;
+        const uint8_t *received;
+
+        if (_fifo_random(&state) & 1)
+        {
+            void *span;
+
+            length = bc_fifo_peek(&_fifo_stress_state.fifo, &span);
+
+            received = span;
+        }
+        else
+        {
+            length = bc_fifo_read(&_fifo_stress_state.fifo, data, 1 + _fifo_random(&state) % FIFO_STRESS_MAX_LENGTH);
+
+            received = data;
+        }
+
+        for (size_t i = 0; i < length; i++)
+        {
+            if (received[i] != _fifo_pattern(sequence + i))
+            {
+                _FIFO_CHECK(received[i] == _fifo_pattern(sequence + i));
+
+                break;
+            }
+        }
+
+        if (received != data)
+        {
+            bc_fifo_consume(&_fifo_stress_state.fifo, length);
+        }
+
+        sequence += length;
+    }
+
+    pthread_join(writer, NULL);
+
+    printf("stress %" PRIu32 " bytes through two threads\n", total);
+}
+
+static void *_fifo_stress_writer(void *param)
+{
+    (void) param;
+
+    uint8_t data[FIFO_STRESS_MAX_LENGTH];
+    uint32_t sequence = 0;
+    uint32_t state = 3;
+
+    while (sequence < _fifo_stress_state.total)
+    {
+        size_t length = 1 + _fifo_random(&state) % FIFO_STRESS_MAX_LENGTH;
+
+        if (length > _fifo_stress_state.total - sequence)
+        {
+            length = _fifo_stress_state.total - sequence;
+        }
+
+        for (size_t i = 0; i < length; i++)
+        {
+            data[i] = _fifo_pattern(sequence + i);
+        }
+
+        // Full FIFO takes only part of it, rest is retried as reader makes room
+        for (size_t written = 0; written < length; )
+        {
+            written += bc_fifo_write(&_fifo_stress_state.fifo, data + written, length - written);
+        }
+
+        sequence += length;
+    }
+
+    return NULL;
+}
+
+static void _fifo_bench(const char *name, size_t chunk, const fifo_api_t *api)
+{
+    static uint8_t buffer[FIFO_BENCH_SIZE];
+    static uint8_t data[FIFO_BENCH_SIZE];
+
+    bc_fifo_t fifo;
+    api->init(&fifo, buffer, sizeof(buffer));
+
+    size_t total = 0;
+    double start = _fifo_now();
+
+    while (total < FIFO_BENCH_TOTAL)
+    {
+        size_t length = api->write(&fifo, data, chunk);
+
+        api->read(&fifo, data, length);
+
+        total += length;
+    }
+
+    printf("%-4s chunk %4zu  %8.1f MB/s\n", name, chunk, total / (_fifo_now() - start) / 1e6);
+}
+
+static double _fifo_now(void)
+{
+    struct timespec now;
+
+    clock_gettime(CLOCK_MONOTONIC, &now);
+
+    return now.tv_sec + now.tv_nsec * 1e-9;
+}
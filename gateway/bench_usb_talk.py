@@ -0,0 +1,105 @@
+import os
+import sys
+import time
+import tty
+import json
+import struct
+import select
+import argparse
+import threading
+import usb_talk
+
+# Readings of one remote as base forwards them after every report
+PEER = 0x2c4b3a19
+READINGS = (
+    (usb_talk.RECORD_THERMOMETER, 0x10, (21.37,), '["%s/thermometer/1:0/temperature", %0.2f]\n'),
+    (usb_talk.RECORD_HYGROMETER, 0x00, (45.6,), '["%s/hygrometer/0:0/relative-humidity", %0.1f]\n'),
+    (usb_talk.RECORD_LUX_METER, 0x00, (312.5,), '["%s/lux-meter/0:0/illuminance", %0.1f]\n'),
+    (usb_talk.RECORD_BAROMETER, 0x00, (98213.25, 261.8), '["%s/barometer/0:0/pressure", %0.2f]\n["%s/barometer/0:0/altitude", %0.2f]\n'),
+    (usb_talk.RECORD_CO2_METER, 0x00, (612.0,), '["%s/co2-meter/-/concentration", %0.0f]\n'),
+)
+
+def message(binary, index):
+    type, channel, values, format = READINGS[index % len(READINGS)]
+    if binary:
+        payload = bytes([channel]) + struct.pack('<%di' % len(values), *[int(round(value * 100)) for value in values])
+        return usb_talk.encode_record(type, index & 0xffffffff, PEER, payload)
+    if len(values) == 1:
+        return (format % (usb_talk.PREFIX_REMOTE, values[0])).encode()
+    return (format % (usb_talk.PREFIX_REMOTE, values[0], usb_talk.PREFIX_REMOTE, values[1])).encode()
+
+def talks(index):
+    return 2 if READINGS[index % len(READINGS)][0] == usb_talk.RECORD_BAROMETER else 1
+
+def device(fd, messages, interval, sent):
+    # Fake base writes messages back to back, or one by one with given spacing
+    for data in messages:
+        sent.append(time.perf_counter())
+        os.write(fd, data)
+        if interval:
+            deadline = sent[-1] + interval
+            while time.perf_counter() < deadline:
+                continue
+
+def run(binary, count, interval):
+    master, slave = os.openpty()
+    tty.setraw(master)
+    tty.setraw(slave)
+
+    # Messages are encoded in advance, on base this is done by firmware and only decoding runs on gateway
+    messages = [message(binary, index) for index in range(count)]
+    expected = sum(talks(index) for index in range(count))
+    sent = []
+    received = []
+    size = 0
+
+    thread = threading.Thread(target=device, args=(master, messages, interval, sent))
+    start = time.perf_counter()
+    thread.start()
+
+    decoder = usb_talk.Decoder()
+    while len(received) < expected:
+        select.select([slave], [], [], 1.0)
+        data = os.read(slave, 65536)
+        size += len(data)
+        now = time.perf_counter()
+        received += [now] * len(decoder.feed(data))
+
+    elapsed = time.perf_counter() - start
+    thread.join()
+    os.close(master)
+    os.close(slave)
+
+    # Latency is taken for last talk of every message, barometer sends two of them
+    latencies = []
+    position = 0
+    for index in range(count):
+        position += talks(index)
+        latencies.append(received[position - 1] - sent[index])
+    latencies.sort()
+
+    return {
+        'messages': count / elapsed,
+        'bytes': size / count,
+        'median': latencies[len(latencies) // 2] * 1e6,
+        'p99': latencies[len(latencies) * 99 // 100] * 1e6,
+    }
+
+def main():
+    parser = argparse.ArgumentParser(description='Compare text and binary mode of usb_talk against fake base on pseudo terminal')
+    parser.add_argument('--count', type=int, default=50000, help='messages sent in throughput run')
+    parser.add_argument('--paced', type=int, default=2000, help='messages sent in latency run')
+    parser.add_argument('--interval', type=float, default=0.001, help='seconds between messages in latency run')
+    args = parser.parse_args()
+
+    print('mode    messages/s  bytes/message  latency median  latency p99')
+    for binary in (False, True):
+        burst = run(binary, args.count, 0)
+        paced = run(binary, args.paced, args.interval)
+        print('%-6s  %10.0f  %13.1f  %11.0f us  %8.0f us' % ('binary' if binary else 'text', burst['messages'], burst['bytes'], paced['median'], paced['p99']))
+
+if __name__ == '__main__':
+    try:
+        main()
+    except KeyboardInterrupt:
+        sys.exit(0)
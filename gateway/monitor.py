@@ -6,8 +6,11 @@ import json
 import logging as log
 from logging import DEBUG, INFO
 import datetime
+import argparse
+import usb_talk
 
 DEFAULT_DEVICE = '/dev/tty.usbmodem1451'
+DEFAULT_PREFIX = 'climate-station-001-base'
 LOG_FORMAT = '%(asctime)s %(levelname)s: %(message)s'
 
 def processTalk(influx_client, talk):
@@ -31,14 +34,39 @@ def processTalk(influx_client, talk):
 
     influx_client.write_points(json_body)
 
+def monitorBinary(serial, client, prefix):
+    serial.write((json.dumps([prefix + '/usb-talk/-/mode/set', 'binary']) + '\n').encode())
+
+    # Lines which were on their way before base switched are decoded as well
+    decoder = usb_talk.Decoder()
+
+    while True:
+        data = serial.read(serial.in_waiting or 1)
+        for timestamp, peer, talk in decoder.feed(data):
+            log.info(talk)
+            try:
+                processTalk(client, talk)
+
+            except Exception as e:
+                log.error('Received malformed message: %s', talk)
+
 def main():
     log.basicConfig(level=INFO, format=LOG_FORMAT)
 
-    serial = Serial(DEFAULT_DEVICE, timeout=3.0)
+    parser = argparse.ArgumentParser(description='Store messages of base in InfluxDB')
+    parser.add_argument('--port', default=DEFAULT_DEVICE, help='serial port of base')
+    parser.add_argument('--prefix', default=DEFAULT_PREFIX, help='topic prefix of base')
+    parser.add_argument('--binary', action='store_true', help='ask base for COBS framed records instead of JSON lines')
+    args = parser.parse_args()
+
+    serial = Serial(args.port, timeout=3.0)
     serial.write(b'\n')
 
     client = InfluxDBClient('localhost', 8086, '', '', 'uclClimateStation')
 
+    if args.binary:
+        monitorBinary(serial, client, args.prefix)
+
     while True:
         line = serial.readline()
         if line:
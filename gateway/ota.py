@@ -0,0 +1,155 @@
+import sys
+import time
+import json
+import base64
+import struct
+import zlib
+import argparse
+import logging as log
+from logging import INFO
+from serial import Serial
+
+DEFAULT_DEVICE = '/dev/tty.usbmodem1451'
+DEFAULT_PREFIX = 'climate-station-001-base'
+LOG_FORMAT = '%(asctime)s %(levelname)s: %(message)s'
+
+# Same values as in bc_ota.c and bc_ota.h
+MAGIC = 0x31444342
+DELTA_SIZE = 4096
+OPERATION_LITERAL = 0
+OPERATION_COPY = 1
+
+# Shorter match costs about as much as literal bytes it replaces
+BLOCK = 8
+MAX_CANDIDATES = 16
+CHUNK = 512
+
+def varint(value):
+    out = bytearray()
+    while True:
+        byte = value & 0x7f
+        value >>= 7
+        if value:
+            out.append(byte | 0x80)
+        else:
+            out.append(byte)
+            return out
+
+def zigzag(value):
+    return (value << 1) if value >= 0 else ((-value << 1) - 1)
+
+def match_length(old, old_position, new, new_position):
+    length = 0
+    while old_position + length < len(old) and new_position + length < len(new) and old[old_position + length] == new[new_position + length]:
+        length += 1
+    return length
+
+def encode(old, new):
+    index = {}
+    for position in range(len(old) - BLOCK + 1):
+        index.setdefault(old[position:position + BLOCK], []).append(position)
+
+    delta = bytearray(struct.pack('<IIIII', MAGIC, len(old), zlib.crc32(old), len(new), zlib.crc32(new)))
+    literal = bytearray()
+    shift = 0
+    position = 0
+
+    def flush():
+        if literal:
+            delta.extend(bytes([OPERATION_LITERAL]) + varint(len(literal)) + literal)
+            literal.clear()
+
+    while position < len(new):
+        # Code after insertion is shifted by same distance, so previous one is tried first
+        best_length = 0
+        best_source = 0
+
+        if 0 <= position + shift < len(old):
+            best_length = match_length(old, position + shift, new, position)
+            best_source = position + shift
+
+        for source in index.get(new[position:position + BLOCK], [])[-MAX_CANDIDATES:]:
+            length = match_length(old, source, new, position)
+            if length > best_length:
+                best_length = length
+                best_source = source
+
+        if best_length >= BLOCK:
+            flush()
+            shift = best_source - position
+            delta.extend(bytes([OPERATION_COPY]) + varint(best_length) + varint(zigzag(shift)))
+            position += best_length
+        else:
+            literal.append(new[position])
+            position += 1
+
+    flush()
+
+    return bytes(delta)
+
+def publish(serial, topic, payload):
+    serial.write((json.dumps([topic, payload]) + '\n').encode())
+
+def upload(serial, prefix, device, delta):
+    for offset in range(0, len(delta), CHUNK):
+        publish(serial, prefix + '/ota/-/data', {'offset': offset, 'data': base64.b64encode(delta[offset:offset + CHUNK]).decode()})
+        time.sleep(0.1)
+
+    publish(serial, prefix + '/ota/-/send', {'device': device, 'length': len(delta)})
+
+    # Remote gets transfer once it wakes up, this may take several report periods
+    while True:
+        line = serial.readline()
+        if not line:
+            continue
+        try:
+            talk = json.loads(line.decode())
+        except ValueError:
+            continue
+        if talk[0] == prefix + '/ota/-/result':
+            return talk[1]['success']
+
+def main():
+    log.basicConfig(level=INFO, format=LOG_FORMAT)
+
+    parser = argparse.ArgumentParser(description='Update remote over the air with delta against its running firmware')
+    parser.add_argument('old', help='firmware running on remote')
+    parser.add_argument('new', help='new firmware')
+    parser.add_argument('device', help='device address of remote, hexadecimal')
+    parser.add_argument('--port', default=DEFAULT_DEVICE, help='serial port of base')
+    parser.add_argument('--prefix', default=DEFAULT_PREFIX, help='topic prefix of base')
+    parser.add_argument('--output', help='write delta to file and do not upload it')
+    args = parser.parse_args()
+
+    with open(args.old, 'rb') as f:
+        old = f.read()
+    with open(args.new, 'rb') as f:
+        new = f.read()
+
+    delta = encode(old, new)
+
+    log.info('Delta has %d bytes for image of %d bytes', len(delta), len(new))
+
+    if len(delta) > DELTA_SIZE:
+        log.error('Delta is larger than %d bytes reserved for it', DELTA_SIZE)
+        sys.exit(1)
+
+    if args.output:
+        with open(args.output, 'wb') as f:
+            f.write(delta)
+        return
+
+    serial = Serial(args.port, timeout=3.0)
+    serial.write(b'\n')
+
+    if upload(serial, args.prefix, args.device, delta):
+        log.info('Remote %s received update and installs it', args.device)
+    else:
+        log.error('Update of remote %s failed', args.device)
+        sys.exit(1)
+
+if __name__ == '__main__':
+    try:
+        main()
+    except KeyboardInterrupt:
+        sys.exit(0)
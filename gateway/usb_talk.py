@@ -0,0 +1,156 @@
+import json
+import struct
+import binascii
+
+# Same values as usb_talk_record_type_t in usb_talk.h
+RECORD_TEXT = 0
+RECORD_PUSH_BUTTON = 1
+RECORD_THERMOMETER = 2
+RECORD_HYGROMETER = 3
+RECORD_LUX_METER = 4
+RECORD_BAROMETER = 5
+RECORD_CO2_METER = 6
+RECORD_ALARM = 7
+RECORD_REPLAY = 8
+
+HEADER_LENGTH = 9
+CRC_LENGTH = 2
+NO_VALUE = -2 ** 31
+
+PREFIX_BASE = 'climate-station-001-base'
+PREFIX_REMOTE = 'climate-station-001-remote'
+
+ALARMS = ('co2', 'temperature')
+
+def crc16(data):
+    # CRC-16/CCITT-FALSE as computed by base
+    return binascii.crc_hqx(data, 0xffff)
+
+def cobs_encode(data):
+    out = bytearray([0])
+    code_index = 0
+    code = 1
+    for byte in data:
+        if byte != 0:
+            out.append(byte)
+            code += 1
+        if byte == 0 or code == 0xff:
+            out[code_index] = code
+            code_index = len(out)
+            out.append(0)
+            code = 1
+    out[code_index] = code
+    out.append(0)
+    return bytes(out)
+
+def cobs_decode(frame):
+    out = bytearray()
+    i = 0
+    while i < len(frame):
+        code = frame[i]
+        if code == 0 or i + code > len(frame):
+            return None
+        out += frame[i + 1:i + code]
+        i += code
+        if code < 0xff and i < len(frame):
+            out.append(0)
+    return bytes(out)
+
+def encode_record(type, timestamp, peer, payload):
+    record = struct.pack('<BII', type, timestamp, peer) + payload
+    return cobs_encode(record + struct.pack('<H', crc16(record)))
+
+def decode_record(frame):
+    '''Return tuple of type, timestamp, peer and payload, or None if frame is damaged'''
+    record = cobs_decode(frame)
+    if record is None or len(record) < HEADER_LENGTH + CRC_LENGTH:
+        return None
+    if struct.unpack_from('<H', record, len(record) - CRC_LENGTH)[0] != crc16(record[:-CRC_LENGTH]):
+        return None
+    type, timestamp, peer = struct.unpack_from('<BII', record)
+    return type, timestamp, peer, record[HEADER_LENGTH:-CRC_LENGTH]
+
+def record_to_talks(type, peer, payload):
+    '''Translate record to messages of text mode, list of topic and value pairs'''
+    if type == RECORD_TEXT:
+        return [json.loads(payload.decode())]
+
+    node = PREFIX_REMOTE if peer != 0 else PREFIX_BASE
+
+    if type == RECORD_REPLAY:
+        age = struct.unpack('<I', payload)[0] if payload else None
+        return [['%s/radio/-/replay' % node, age]]
+
+    channel = payload[0]
+    # Lowest integer stands for value which base could not scale
+    values = [value / 100 if value != NO_VALUE else None for value in struct.unpack('<%di' % ((len(payload) - 1) // 4), payload[1:])]
+    sensor = '%d:%d' % (channel >> 4, channel & 0x0f)
+
+    if type == RECORD_PUSH_BUTTON:
+        return [['%s/push-button/-/event-count' % node, int(values[0])]]
+    if type == RECORD_THERMOMETER:
+        return [['%s/thermometer/%s/temperature' % (node, sensor), values[0]]]
+    if type == RECORD_HYGROMETER:
+        return [['%s/hygrometer/%s/relative-humidity' % (node, sensor), values[0]]]
+    if type == RECORD_LUX_METER:
+        return [['%s/lux-meter/%s/illuminance' % (node, sensor), values[0]]]
+    if type == RECORD_BAROMETER:
+        return [['%s/barometer/%s/pressure' % (node, sensor), values[0]], ['%s/barometer/%s/altitude' % (node, sensor), values[1]]]
+    if type == RECORD_CO2_METER:
+        return [['%s/co2-meter/-/concentration' % node, values[0]]]
+    if type == RECORD_ALARM:
+        return [['%s/alarm/-/%s' % (node, ALARMS[channel]), {'active': values[0] != 0, 'value': values[1]}]]
+
+    return []
+
+class Decoder:
+    '''Splits stream of base into messages, lines of text mode and frames of binary mode may follow one another'''
+
+    def __init__(self):
+        self.buffer = bytearray()
+        # Partial frame may hold newline, so lines are looked for only until first frame comes
+        self.binary = False
+
+    def feed(self, data):
+        '''Return list of tuples of timestamp, peer and message, timestamp and peer are None for text lines'''
+        self.buffer += data
+        messages = []
+
+        while True:
+            end = self.buffer.find(b'\0')
+            if end < 0:
+                break
+            chunk = bytes(self.buffer[:end])
+            del self.buffer[:end + 1]
+
+            # Lines sent before mode was switched lead frame
+            start = 0
+            while True:
+                record = decode_record(chunk[start:])
+                if record is not None:
+                    self.binary = True
+                    messages += self._lines(chunk[:start])
+                    type, timestamp, peer, payload = record
+                    messages += [(timestamp, peer, talk) for talk in record_to_talks(type, peer, payload)]
+                    break
+                newline = chunk.find(b'\n', start)
+                if newline < 0:
+                    break
+                start = newline + 1
+
+        newline = self.buffer.rfind(b'\n')
+        if newline >= 0 and not self.binary:
+            messages += self._lines(bytes(self.buffer[:newline + 1]))
+            del self.buffer[:newline + 1]
+
+        return messages
+
+    def _lines(self, data):
+        messages = []
+        for line in data.split(b'\n'):
+            if line.strip():
+                try:
+                    messages.append((None, None, json.loads(line.decode())))
+                except ValueError:
+                    pass
+        return messages
@@ -5,6 +5,14 @@
 #define PREFIX_TALK_REMOTE "climate-station-001-remote"
 #define DEBUG false
 #define MEASUREMENT_DELAY 10000
+#define TDMA false
+#define RELAY false
+#define SHUTDOWN true
+#define ALARM_CO2_THRESHOLD 1500.0f
+#define ALARM_CO2_HYSTERESIS 100.0f
+#define ALARM_TEMPERATURE_THRESHOLD 30.0f
+#define ALARM_TEMPERATURE_HYSTERESIS 0.5f
+#define OTA_INSTALL_DELAY 1000
 
 // LED instance
 bc_led_t led;
@@ -12,6 +20,27 @@ bc_led_t led;
 // Button instance
 bc_button_t button;
 
+// Payload values of profile command, usb_talk binds them while message comes
+typedef struct
+{
+    int channel;
+    int datarate;
+    bool fec;
+    int power;
+
+} radio_profile_values_t;
+
+static const char * const radio_datarates[] = { "9600", "19200", "38400", "100000", NULL };
+
+static const usb_talk_bind_t radio_profile_binds[] = {
+    USB_TALK_BIND_INT("channel", radio_profile_values_t, channel),
+    USB_TALK_BIND_ENUM("datarate", radio_profile_values_t, datarate, radio_datarates),
+    USB_TALK_BIND_BOOL("fec", radio_profile_values_t, fec),
+    USB_TALK_BIND_INT("power", radio_profile_values_t, power)
+};
+
+static radio_profile_values_t radio_profile_values;
+
 void button_event_handler(bc_button_t *self, bc_button_event_t event, void *event_param)
 {
     (void) self;
@@ -23,7 +52,7 @@ void button_event_handler(bc_button_t *self, bc_button_event_t event, void *even
         static uint16_t event_counter = 0;
         event_counter++;
         if (DEBUG) {
-            usb_talk_publish_push_button(PREFIX_TALK_REMOTE, &event_counter);
+            usb_talk_publish_push_button(PREFIX_TALK_REMOTE, NULL, &event_counter);
         } else { 
             bc_radio_pub_push_button(&event_counter);
         }
@@ -35,6 +64,106 @@ void button_event_handler(bc_button_t *self, bc_button_event_t event, void *even
     }
 }
 
+static void ota_install_task(void *param)
+{
+    size_t length = (size_t) param;
+
+    // Delta made against other firmware leaves running one in place
+    if (bc_ota_finish(length))
+    {
+        bc_ota_install();
+    }
+
+    bc_scheduler_unregister(bc_scheduler_get_current_task_id());
+}
+
+void bc_radio_on_bulk(uint32_t *peer_device_address, uint32_t *offset, void *buffer, size_t *length)
+{
+    (void) peer_device_address;
+
+    // Only transfer opened as firmware update is taken as delta, other data must not overwrite it nor trigger install
+    if (bc_radio_bulk_get_type() != BC_RADIO_BULK_TYPE_OTA)
+    {
+        return;
+    }
+
+    if (buffer != NULL)
+    {
+        bc_ota_write(*offset, buffer, *length);
+
+        return;
+    }
+
+    // Whole delta has come, last acknowledgement is let out before image is built and installed
+    bc_scheduler_register(ota_install_task, (void *) (size_t) *offset, bc_tick_get() + OTA_INSTALL_DELAY);
+}
+
+static void radio_profile_get(usb_talk_payload_t *payload, void *param)
+{
+    (void) payload;
+    (void) param;
+
+    bc_spirit1_profile_t profile;
+
+    bc_radio_get_profile(&profile);
+
+    usb_talk_publish_radio_profile(PREFIX_TALK_REMOTE, &profile);
+}
+
+static void radio_stats_get(usb_talk_payload_t *payload, void *param)
+{
+    (void) payload;
+    (void) param;
+
+    bc_radio_stats_t stats;
+
+    bc_radio_get_stats(&stats);
+
+    usb_talk_publish_radio_stats(PREFIX_TALK_REMOTE, &stats);
+}
+
+static void radio_stats_reset(usb_talk_payload_t *payload, void *param)
+{
+    (void) payload;
+    (void) param;
+
+    bc_radio_reset_stats();
+}
+
+static void radio_profile_set(usb_talk_payload_t *payload, void *param)
+{
+    (void) param;
+
+    bc_spirit1_profile_t profile;
+
+    bc_radio_get_profile(&profile);
+
+    // Keys which are not present keep their current value
+    if (usb_talk_payload_is_bound(payload, &radio_profile_values.channel) && radio_profile_values.channel >= 0 && radio_profile_values.channel <= UINT8_MAX)
+    {
+        profile.channel = radio_profile_values.channel;
+    }
+
+    if (usb_talk_payload_is_bound(payload, &radio_profile_values.datarate))
+    {
+        profile.datarate = radio_profile_values.datarate;
+    }
+
+    if (usb_talk_payload_is_bound(payload, &radio_profile_values.fec))
+    {
+        profile.fec = radio_profile_values.fec;
+    }
+
+    if (usb_talk_payload_is_bound(payload, &radio_profile_values.power) && radio_profile_values.power >= BC_SPIRIT1_POWER_MIN && radio_profile_values.power <= BC_SPIRIT1_POWER_MAX)
+    {
+        profile.power = radio_profile_values.power;
+    }
+
+    bc_radio_set_profile(&profile);
+
+    radio_profile_get(NULL, NULL);
+}
+
 void application_init(void) {
     usb_talk_init();
 
@@ -48,6 +177,39 @@ void application_init(void) {
     // Initialize radio
     bc_radio_init();
 
+    // Profile is set over USB before deployment, base and its remotes have to share it
+    usb_talk_sub(PREFIX_TALK_REMOTE "/radio/-/profile/get", radio_profile_get, NULL);
+    usb_talk_sub_bind(PREFIX_TALK_REMOTE "/radio/-/profile/set", radio_profile_binds, USB_TALK_BIND_COUNT(radio_profile_binds), &radio_profile_values, radio_profile_set, NULL);
+
+    // Wake ups of radio from shutdown are counted and timed in stats
+    usb_talk_sub(PREFIX_TALK_REMOTE "/radio/-/stats/get", radio_stats_get, NULL);
+    usb_talk_sub(PREFIX_TALK_REMOTE "/radio/-/stats/reset", radio_stats_reset, NULL);
+
+    // Only latest reading of each sensor waits for transmission, button events are all kept
+    bc_radio_set_pub_replace_latest(true);
+
+    // Alarm does not wait for repetitions of readings sent before it
+    bc_radio_set_preemption(true);
+
+    // Readings which base does not acknowledge are kept in EEPROM and replayed later
+    bc_radio_set_store_and_forward(true);
+
+    if (TDMA)
+    {
+        bc_radio_tdma_join();
+    }
+
+    if (RELAY)
+    {
+        bc_radio_relay_start();
+    }
+
+    // Relay keeps receiving, there is nothing to gain from shutdown between its frames
+    if (SHUTDOWN && !RELAY)
+    {
+        bc_spirit1_set_sleep_mode(BC_SPIRIT1_SLEEP_MODE_SHUTDOWN);
+    }
+
     // Initialize climate module
     bc_module_climate_init();
     bc_module_climate_set_update_interval_thermometer(MEASUREMENT_DELAY);
@@ -62,6 +224,24 @@ void application_init(void) {
     bc_module_co2_set_event_handler(co2_event_handler, NULL);
 }
 
+static void alarm_check(bc_radio_alarm_t alarm, bool *active, float value, float threshold, float hysteresis)
+{
+    if (!*active && value >= threshold)
+    {
+        *active = true;
+    }
+    else if (*active && value < threshold - hysteresis)
+    {
+        *active = false;
+    }
+    else
+    {
+        return;
+    }
+
+    bc_radio_pub_alarm(alarm, *active, &value);
+}
+
 void climate_event_handler(bc_module_climate_event_t event, void *event_param)
 {
     (void) event_param;
@@ -72,6 +252,7 @@ void climate_event_handler(bc_module_climate_event_t event, void *event_param)
     static uint8_t i2c_lux_meter = 0x44;
     static uint8_t i2c_hygrometer = 0x40;
     static uint8_t i2c_barometer = 0x60;
+    static bool alarm_temperature = false;
 
     switch (event)
     {
@@ -79,8 +260,9 @@ void climate_event_handler(bc_module_climate_event_t event, void *event_param)
             if (bc_module_climate_get_temperature_celsius(&value))
             {
                 if (DEBUG) {
-                    usb_talk_publish_thermometer(PREFIX_TALK_REMOTE, &i2c_thermometer, &value);
+                    usb_talk_publish_thermometer(PREFIX_TALK_REMOTE, NULL, &i2c_thermometer, &value);
                 } else { 
+                    alarm_check(BC_RADIO_ALARM_TEMPERATURE, &alarm_temperature, value, ALARM_TEMPERATURE_THRESHOLD, ALARM_TEMPERATURE_HYSTERESIS);
                     bc_radio_pub_thermometer(i2c_thermometer, &value);
                 }
             }
@@ -90,7 +272,7 @@ void climate_event_handler(bc_module_climate_event_t event, void *event_param)
             if (bc_module_climate_get_luminosity_lux(&value))
             {
                 if (DEBUG) {
-                    usb_talk_publish_lux_meter(PREFIX_TALK_REMOTE, &i2c_lux_meter, &value);
+                    usb_talk_publish_lux_meter(PREFIX_TALK_REMOTE, NULL, &i2c_lux_meter, &value);
                 } else {
                     bc_radio_pub_luminosity(i2c_lux_meter, &value);
                 }
@@ -101,7 +283,7 @@ void climate_event_handler(bc_module_climate_event_t event, void *event_param)
             if (bc_module_climate_get_humidity_percentage(&value))
             {
                 if (DEBUG) {
-                    usb_talk_publish_humidity_sensor(PREFIX_TALK_REMOTE, &i2c_hygrometer, &value);
+                    usb_talk_publish_humidity_sensor(PREFIX_TALK_REMOTE, NULL, &i2c_hygrometer, &value);
                 } else {
                     bc_radio_pub_humidity(i2c_hygrometer, &value);
                 }
@@ -112,7 +294,7 @@ void climate_event_handler(bc_module_climate_event_t event, void *event_param)
             if (bc_module_climate_get_altitude_meter(&meter) && bc_module_climate_get_pressure_pascal(&pascal))
             {
                 if (DEBUG) {
-                    usb_talk_publish_barometer(PREFIX_TALK_REMOTE, &i2c_barometer, &pascal, &meter);
+                    usb_talk_publish_barometer(PREFIX_TALK_REMOTE, NULL, &i2c_barometer, &pascal, &meter);
                 } else {
                     bc_radio_pub_barometer(i2c_barometer, &pascal, &meter);
                 }
@@ -131,6 +313,7 @@ void co2_event_handler(bc_module_co2_event_t event, void *event_param)
 {
     (void) event_param;
     float value;
+    static bool alarm_co2 = false;
 
     switch (event)
     {
@@ -138,8 +321,9 @@ void co2_event_handler(bc_module_co2_event_t event, void *event_param)
             if (bc_module_co2_get_concentration(&value)) 
             {
                 if (DEBUG) {
-                    usb_talk_publish_co2_concentation(PREFIX_TALK_REMOTE, &value);
+                    usb_talk_publish_co2_concentation(PREFIX_TALK_REMOTE, NULL, &value);
                 } else {
+                    alarm_check(BC_RADIO_ALARM_CO2, &alarm_co2, value, ALARM_CO2_THRESHOLD, ALARM_CO2_HYSTERESIS);
                     bc_radio_pub_co2(&value);
                 }
             }
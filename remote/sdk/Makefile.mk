@@ -137,6 +137,7 @@ LDFLAGS += -static
 LDFLAGS += -Wl,-Map=$(MAP)
 LDFLAGS += -Wl,--gc-sections
 LDFLAGS += --specs=nosys.specs
+LDFLAGS += --specs=nano.specs
 
 ################################################################################
 # Create list of files for compilation                                         #
@@ -0,0 +1,51 @@
+#ifndef _BC_DMA_H
+#define _BC_DMA_H
+
+#include <bc_common.h>
+
+//! @addtogroup bc_dma bc_dma
+//! @brief Driver for DMA channel interrupts (channels sharing one interrupt vector)
+//! @{
+
+//! @brief DMA channels
+
+typedef enum
+{
+    //! @brief DMA channel 1
+    BC_DMA_CHANNEL_1 = 0,
+
+    //! @brief DMA channel 2
+    BC_DMA_CHANNEL_2 = 1,
+
+    //! @brief DMA channel 3
+    BC_DMA_CHANNEL_3 = 2,
+
+    //! @brief DMA channel 4
+    BC_DMA_CHANNEL_4 = 3,
+
+    //! @brief DMA channel 5
+    BC_DMA_CHANNEL_5 = 4,
+
+    //! @brief DMA channel 6
+    BC_DMA_CHANNEL_6 = 5,
+
+    //! @brief DMA channel 7
+    BC_DMA_CHANNEL_7 = 6
+
+} bc_dma_channel_t;
+
+//! @brief Enable DMA channel interrupt request and register callback function
+//! @param[in] channel DMA channel
+//! @param[in] callback Function address (called when interrupt occurs, callback is responsible for clearing flags)
+//! @param[in] param Optional parameter being passed to callback function (can be NULL)
+
+void bc_dma_register(bc_dma_channel_t channel, void (*callback)(bc_dma_channel_t, void *), void *param);
+
+//! @brief Unregister callback function of DMA channel
+//! @param[in] channel DMA channel
+
+void bc_dma_unregister(bc_dma_channel_t channel);
+
+//! @}
+
+#endif // _BC_DMA_H
@@ -7,6 +7,10 @@
 //! @brief Driver for internal EEPROM memory
 //! @{
 
+//! @brief Size of EEPROM area in bytes (both banks of STM32L083)
+
+#define BC_EEPROM_SIZE 6144
+
 //! @brief Write buffer to EEPROM area and verify it
 //! @param[in] address EEPROM start address (starts at 0)
 //! @param[in] buffer Pointer to source buffer
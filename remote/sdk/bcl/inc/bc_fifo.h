@@ -5,6 +5,7 @@
 
 //! @addtogroup bc_fifo bc_fifo
 //! @brief FIFO buffer implementation
+//! @details FIFO is lock-free for one writer and one reader, either of them may run in interrupt
 //! @{
 
 //! @brief Structure of FIFO instance
@@ -12,16 +13,16 @@
 typedef struct
 {
     void *buffer; //!< Pointer to buffer where FIFO holds data
-    size_t size;  //!< Size of buffer where FIFO holds data
-    size_t head;  //!< Position of FIFO's head
-    size_t tail;  //!< Position of FIFO's tail
+    size_t size;  //!< Size of buffer where FIFO holds data, power of two
+    size_t head;  //!< Count of bytes written, wraps around
+    size_t tail;  //!< Count of bytes read, wraps around
 
 } bc_fifo_t;
 
 //! @brief Initialize FIFO buffer
 //! @param[in] fifo FIFO instance
 //! @param[in] buffer Pointer to buffer where FIFO holds data
-//! @param[in] size Size of buffer where FIFO holds data
+//! @param[in] size Size of buffer where FIFO holds data, it is rounded down to power of two
 
 void bc_fifo_init(bc_fifo_t *fifo, void *buffer, size_t size);
 
@@ -41,7 +42,7 @@ size_t bc_fifo_write(bc_fifo_t *fifo, const void *buffer, size_t length);
 
 size_t bc_fifo_read(bc_fifo_t *fifo, void *buffer, size_t length);
 
-//! @brief Write data to FIFO from interrupt
+//! @brief Write data to FIFO from interrupt, same as bc_fifo_write
 //! @param[in] fifo FIFO instance
 //! @param[in] buffer Pointer to buffer from which data will be written
 //! @param[in] length Number of requested bytes to be written
@@ -49,7 +50,7 @@ size_t bc_fifo_read(bc_fifo_t *fifo, void *buffer, size_t length);
 
 size_t bc_fifo_irq_write(bc_fifo_t *fifo, const void *buffer, size_t length);
 
-//! @brief Read data from FIFO from interrupt
+//! @brief Read data from FIFO from interrupt, same as bc_fifo_read
 //! @param[in] fifo FIFO instance
 //! @param[out] buffer Pointer to buffer where data will be read
 //! @param[in] length Number of requested bytes to be read
@@ -57,6 +58,25 @@ size_t bc_fifo_irq_write(bc_fifo_t *fifo, const void *buffer, size_t length);
 
 size_t bc_fifo_irq_read(bc_fifo_t *fifo, void *buffer, size_t length);
 
+//! @brief Get contiguous span of data at FIFO's tail without reading it
+//! @param[in] fifo FIFO instance
+//! @param[out] buffer Pointer to start of span
+//! @return Number of bytes in span, data which wraps over end of buffer follows in next span
+
+size_t bc_fifo_peek(bc_fifo_t *fifo, void **buffer);
+
+//! @brief Release data returned by bc_fifo_peek
+//! @param[in] fifo FIFO instance
+//! @param[in] length Number of bytes to be released, at most length of span
+
+void bc_fifo_consume(bc_fifo_t *fifo, size_t length);
+
+//! @brief Get number of bytes which can be written to FIFO
+//! @param[in] fifo FIFO instance
+//! @return Number of free bytes
+
+size_t bc_fifo_get_free(bc_fifo_t *fifo);
+
 //! @}
 
 #endif /* _BC_FIFO_H */
@@ -0,0 +1,49 @@
+#ifndef _BC_FLASH_H
+#define _BC_FLASH_H
+
+#include <bc_common.h>
+
+//! @addtogroup bc_flash bc_flash
+//! @brief Driver for internal program memory
+//! @{
+
+//! @brief Size of erase page in bytes
+
+#define BC_FLASH_PAGE_SIZE 128
+
+//! @brief Start of second bank, it is the only part which can be erased and written while program runs
+//! @details Bank which does not run program is always mapped here, banks are swapped once program boots from the other one
+
+#define BC_FLASH_BANK2_ADDRESS 0x08018000
+
+//! @brief End of second bank (exclusive)
+
+#define BC_FLASH_BANK2_END 0x08030000
+
+//! @brief Erase pages of second bank, erased memory reads as zeros
+//! @param[in] address Start address, aligned to page
+//! @param[in] length Number of bytes to be erased, rounded up to whole pages
+//! @return true on success
+//! @return false on failure
+
+bool bc_flash_erase(uint32_t address, size_t length);
+
+//! @brief Write buffer to erased area of second bank and verify it
+//! @param[in] address Start address, aligned to word
+//! @param[in] buffer Pointer to source buffer
+//! @param[in] length Number of bytes to be written, multiple of word
+//! @return true on success
+//! @return false on failure
+
+bool bc_flash_write(uint32_t address, const void *buffer, size_t length);
+
+//! @brief Boot image in second bank by toggling BFB2 option bit and reset the CPU
+//! @details Running program is not touched, power loss at any moment boots either old or new program.
+//!          Image is booted without any check, it has to be verified before.
+//! @return false if option byte could not be written, function does not return otherwise
+
+bool bc_flash_install(void);
+
+//! @}
+
+#endif // _BC_FLASH_H
@@ -39,7 +39,7 @@ typedef enum
 
 } bc_module_lcd_rotation_t;
 
-bc_module_lcd_framebuffer_t _bc_module_lcd_framebuffer;
+extern bc_module_lcd_framebuffer_t _bc_module_lcd_framebuffer;
 
 //! @brief Initialize lcd
 //! @param[in] bc_module_lcd_framebuffer_t framebuffer
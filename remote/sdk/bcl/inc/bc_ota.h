@@ -0,0 +1,68 @@
+#ifndef _BC_OTA_H
+#define _BC_OTA_H
+
+#include <bc_flash.h>
+
+//! @addtogroup bc_ota bc_ota
+//! @brief Firmware update from delta against running firmware
+//! @details Delta is kept in RAM, new image is built from it and running firmware in second bank of program memory
+//!          which is booted once image is verified, running firmware stays in first bank until then. Delta starts with header of five 32-bit words:
+//!          magic, length and CRC-32 of firmware it was made against, length and CRC-32 of new image. Operations follow,
+//!          each one is byte with its kind, varint length and for copy zigzag varint distance of source in running
+//!          firmware from current position in new image. Literal operation is followed by its bytes.
+//! @{
+
+//! @brief Maximum length of delta, RAM of this size is reserved for it
+
+#ifndef BC_OTA_DELTA_SIZE
+#define BC_OTA_DELTA_SIZE 4096
+#endif
+
+//! @brief Keep delta at end of second bank instead of RAM, parts have to come at offsets aligned to word and each word is written once,
+//!        it suits node which receives delta in order and only passes it on
+
+#ifndef BC_OTA_DELTA_IN_FLASH
+#define BC_OTA_DELTA_IN_FLASH 0
+#endif
+
+//! @brief Address of delta kept in second bank, image built from it has to end below
+
+#define BC_OTA_DELTA_ADDRESS (BC_FLASH_BANK2_END - BC_OTA_DELTA_SIZE)
+
+//! @brief Address of new image in second bank
+
+#define BC_OTA_IMAGE_ADDRESS BC_FLASH_BANK2_ADDRESS
+
+//! @brief Store part of delta, parts can come in any order
+//! @param[in] offset Offset of part in delta
+//! @param[in] buffer Pointer to part
+//! @param[in] length Length of part
+//! @return true on success
+//! @return false if part lies beyond maximum length
+
+bool bc_ota_write(uint32_t offset, const void *buffer, size_t length);
+
+//! @brief Read part of stored delta, suits as source of bc_radio_bulk_send
+//! @param[in] offset Offset of part in delta
+//! @param[out] buffer Pointer to destination buffer
+//! @param[in] length Length of part
+//! @param[in] param Unused
+//! @return true on success
+//! @return false if part lies beyond maximum length
+
+bool bc_ota_read(uint32_t offset, void *buffer, size_t length, void *param);
+
+//! @brief Build new image from stored delta and verify it
+//! @param[in] length Length of delta
+//! @return true if image is ready to be installed
+//! @return false if delta was made against other firmware or image does not match its CRC-32
+
+bool bc_ota_finish(size_t length);
+
+//! @brief Boot image built by bc_ota_finish, function returns only if there is no image or it could not be selected for boot
+
+void bc_ota_install(void);
+
+//! @}
+
+#endif // _BC_OTA_H
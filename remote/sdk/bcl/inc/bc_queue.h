@@ -13,6 +13,10 @@ typedef struct
 
 void bc_queue_init(bc_queue_t *queue, void *buffer, size_t size);
 bool bc_queue_put(bc_queue_t *queue, const void *buffer, size_t length);
+bool bc_queue_put_latest(bc_queue_t *queue, const void *buffer, size_t length, size_t key_length);
 bool bc_queue_get(bc_queue_t *queue, void *buffer, size_t *length);
+bool bc_queue_peek(bc_queue_t *queue, void *buffer, size_t *length);
+bool bc_queue_is_empty(bc_queue_t *queue);
+size_t bc_queue_get_length(bc_queue_t *queue);
 
 #endif // _BC_QUEUE_H
@@ -2,14 +2,134 @@
 #define _BC_RADIO_H
 
 #include <bc_common.h>
+#include <bc_tick.h>
+#include <bc_spirit1.h>
+
+// Node keeps only few peers, gateway of large fleet raises this in its build (EEPROM has room for 768)
+#ifndef BC_RADIO_MAX_PEERS
+#define BC_RADIO_MAX_PEERS 8
+#endif
+
+// Address of network put into every frame, SPIRIT1 discards frames of other networks
+#ifndef BC_RADIO_NETWORK_ADDRESS
+#define BC_RADIO_NETWORK_ADDRESS 0x35
+#endif
+
+#ifndef BC_RADIO_BUFFER_MAX_SIZE
+#define BC_RADIO_BUFFER_MAX_SIZE 1024
+#endif
+
+#ifndef BC_RADIO_SURVEY_MAX_CHANNELS
+#define BC_RADIO_SURVEY_MAX_CHANNELS 16
+#endif
 
 typedef enum
 {
     BC_RADIO_EVENT_PAIR_SUCCESS = 0,
-    BC_RADIO_EVENT_PAIR_FAILURE = 1
+    BC_RADIO_EVENT_PAIR_FAILURE = 1,
+    BC_RADIO_EVENT_SURVEY_DONE = 2,
+    BC_RADIO_EVENT_BULK_DONE = 3,
+    BC_RADIO_EVENT_BULK_FAILURE = 4
 
 } bc_radio_event_t;
 
+typedef enum
+{
+    BC_RADIO_PRIORITY_NORMAL = 0,
+    BC_RADIO_PRIORITY_HIGH = 1
+
+} bc_radio_priority_t;
+
+typedef enum
+{
+    BC_RADIO_ALARM_CO2 = 0,
+    BC_RADIO_ALARM_TEMPERATURE = 1
+
+} bc_radio_alarm_t;
+
+// Type is sent when transfer is opened so that receiver knows what the data are
+typedef enum
+{
+    BC_RADIO_BULK_TYPE_DATA = 0,
+    BC_RADIO_BULK_TYPE_OTA = 1
+
+} bc_radio_bulk_type_t;
+
+typedef struct
+{
+    uint32_t queued;
+
+    // Readings which overwrote older queued reading of same sensor
+    uint32_t pub_replaced;
+
+    uint32_t transmitted;
+    uint32_t retransmitted;
+
+    // Repetition trains of normal frames cut short by urgent frame
+    uint32_t preempted;
+
+    uint32_t received;
+    uint32_t duplicate;
+    uint32_t foreign;
+    uint32_t rx_queue_overflow;
+    uint32_t pub_queue_overflow;
+    uint32_t relay_queue_overflow;
+
+    // Frames discarded by SPIRIT1 for FIFO error or longer than buffer
+    uint32_t rx_discarded;
+
+    // Frames of other networks discarded by address filter of SPIRIT1 before payload was read
+    uint32_t rx_rejected;
+    uint32_t rx_crc_error;
+
+    // Frames dropped by driver because all RX buffers were in use
+    uint32_t rx_dropped;
+
+    // Wake ups of SPIRIT1 from shutdown and duration of last one in microseconds
+    uint32_t wake_up_count;
+    uint32_t wake_up_time;
+
+    // Longest receiver dead time after frame in microseconds, when served in interrupt and when deferred to task
+    uint32_t rx_rearm_time[2];
+
+    // Frames with readings which gateway did not acknowledge
+    uint32_t ack_missed;
+
+    // Enrolled peers which gateway running TDMA has no slot for, they use random access
+    uint32_t tdma_unslotted;
+
+    // Readings stored to EEPROM log, replayed from it and lost by log overwrite
+    uint32_t logged;
+    uint32_t replayed;
+    uint32_t log_overflow;
+
+    size_t pub_queue_high_water;
+    size_t rx_queue_high_water;
+    size_t log_length;
+
+} bc_radio_stats_t;
+
+typedef struct
+{
+    uint8_t channel;
+    uint16_t samples;
+
+    // Samples with signal above busy threshold
+    uint16_t busy;
+
+    float rssi_average;
+    float rssi_max;
+
+} bc_radio_survey_channel_t;
+
+typedef struct
+{
+    size_t count;
+    uint8_t quietest;
+    bc_radio_survey_channel_t channels[BC_RADIO_SURVEY_MAX_CHANNELS];
+
+} bc_radio_survey_t;
+
 void bc_radio_init(void);
 
 void bc_radio_set_event_handler(void (*event_handler)(bc_radio_event_t, void *), void *event_param);
@@ -18,12 +138,62 @@ void bc_radio_listen(void);
 
 void bc_radio_sleep(void);
 
+void bc_radio_set_network(uint8_t address);
+
+// Profile is stored in EEPROM and used again after restart
+bool bc_radio_set_profile(const bc_spirit1_profile_t *profile);
+
+void bc_radio_get_profile(bc_spirit1_profile_t *profile);
+
+// Radio stops receiving during survey, result is announced by BC_RADIO_EVENT_SURVEY_DONE
+bool bc_radio_survey_start(uint8_t first, uint8_t last, bc_tick_t dwell, bool apply);
+
+void bc_radio_get_survey(bc_radio_survey_t *survey);
+
+// Source is read chunk by chunk as frames are sent, result is announced by BC_RADIO_EVENT_BULK_DONE or BC_RADIO_EVENT_BULK_FAILURE,
+// transfer without device address goes to gateway, transfer for given node waits until it hears notice in acknowledgement or beacon
+bool bc_radio_bulk_send(uint32_t device_address, bc_radio_bulk_type_t type, uint32_t length, bool (*read)(uint32_t offset, void *buffer, size_t length, void *param), void *param);
+
+// Type of transfer being received, bc_radio_on_bulk uses it to tell firmware update from other data
+bc_radio_bulk_type_t bc_radio_bulk_get_type(void);
+
+// Received bulk data is also written to EEPROM at given address, larger transfers are refused
+void bc_radio_bulk_set_sink(uint32_t address, uint32_t size);
+
 void bc_radio_enroll_to_gateway(void);
 
 void bc_radio_enrollment_start(void);
 
 void bc_radio_enrollment_stop(void);
 
+void bc_radio_relay_start(void);
+
+void bc_radio_relay_stop(void);
+
+// Gateway gives enrolled peers slots in order of enrollment, false is returned if some of them got none because
+// superframe has too few slots, they keep random access; enrollment is refused once all slots are taken
+bool bc_radio_tdma_start(bc_tick_t superframe, bc_tick_t slot_length);
+
+void bc_radio_tdma_stop(void);
+
+// Node asks gateway for its slot and uses random access with fewer repetitions until it gets one, request is repeated
+// with growing backoff while gateway does not answer and after three missed beacons
+void bc_radio_tdma_join(void);
+
+void bc_radio_tdma_leave(void);
+
+bool bc_radio_tdma_is_synced(void);
+
+void bc_radio_get_stats(bc_radio_stats_t *stats);
+
+void bc_radio_reset_stats(void);
+
+void bc_radio_set_pub_replace_latest(bool enable);
+
+void bc_radio_set_preemption(bool enable);
+
+void bc_radio_set_store_and_forward(bool enable);
+
 bool bc_radio_pub_push_button(uint16_t *event_count);
 
 bool bc_radio_pub_thermometer(uint8_t i2c, float *temperature);
@@ -36,6 +206,8 @@ bool bc_radio_pub_barometer(uint8_t i2c, float *pascal, float *meter);
 
 bool bc_radio_pub_co2(float *concentration);
 
+bool bc_radio_pub_alarm(bc_radio_alarm_t alarm, bool active, float *value);
+
 bool bc_radio_pub_buffer(void *buffer, size_t length);
 
 #endif // _BC_RADIO_H
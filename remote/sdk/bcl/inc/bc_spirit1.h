@@ -3,7 +3,11 @@
 
 #include <bc_tick.h>
 
-#define BC_SPIRIT1_MAX_PACKET_SIZE 64
+#define BC_SPIRIT1_MAX_PACKET_SIZE 128
+
+#ifndef BC_SPIRIT1_RX_POOL_SIZE
+#define BC_SPIRIT1_RX_POOL_SIZE 4
+#endif
 
 typedef enum
 {
@@ -13,6 +17,41 @@ typedef enum
 
 } bc_spirit1_event_t;
 
+typedef enum
+{
+    BC_SPIRIT1_SLEEP_MODE_STANDBY = 0,
+
+    // Lowest current, configuration is restored from cache on wake up
+    BC_SPIRIT1_SLEEP_MODE_SHUTDOWN = 1
+
+} bc_spirit1_sleep_mode_t;
+
+typedef enum
+{
+    BC_SPIRIT1_DATARATE_9600 = 0,
+    BC_SPIRIT1_DATARATE_19200 = 1,
+    BC_SPIRIT1_DATARATE_38400 = 2,
+    BC_SPIRIT1_DATARATE_100000 = 3,
+    BC_SPIRIT1_DATARATE_COUNT = 4
+
+} bc_spirit1_datarate_t;
+
+typedef struct
+{
+    // Channels are 200 kHz apart upwards from 868.0 MHz, channels 0 to 2 fit into 868.0 - 868.6 MHz sub-band
+    uint8_t channel;
+
+    bc_spirit1_datarate_t datarate;
+    bool fec;
+
+    // Output power in dBm
+    int8_t power;
+
+} bc_spirit1_profile_t;
+
+#define BC_SPIRIT1_POWER_MIN -30
+#define BC_SPIRIT1_POWER_MAX 11
+
 void bc_spirit1_init(void);
 
 void bc_spirit1_set_event_handler(void (*event_handler)(bc_spirit1_event_t, void *), void *event_param);
@@ -27,6 +66,47 @@ size_t bc_spirit1_get_rx_length(void);
 
 void bc_spirit1_set_rx_timeout(bc_tick_t timeout);
 
+uint32_t bc_spirit1_get_spi_bytes_transferred(void);
+
+uint32_t bc_spirit1_get_spi_bytes_saved(void);
+
+void bc_spirit1_set_sleep_mode(bc_spirit1_sleep_mode_t mode);
+
+// Profile is applied on next entry to transmission or reception, all nodes of network have to use same one
+bool bc_spirit1_set_profile(const bc_spirit1_profile_t *profile);
+
+void bc_spirit1_get_profile(bc_spirit1_profile_t *profile);
+
+// Radio which is idle in sleep listens briefly on channel and returns signal level in dBm
+bool bc_spirit1_measure_rssi(uint8_t channel, float *rssi);
+
+uint32_t bc_spirit1_get_wake_up_count(void);
+
+// Time from SDN release until chip is ready with configuration restored in microseconds (31 us resolution), measured on last wake up
+// It is the latency which shutdown adds in front of each transmission
+uint32_t bc_spirit1_get_wake_up_time(void);
+
+// Longest time from nIRQ of received frame until receiver is armed again in microseconds (31 us resolution), next frame starting sooner is lost
+// Deferred time covers interrupts which came while task used SPI and were served by task
+uint32_t bc_spirit1_get_rx_rearm_time(bool deferred);
+
+void bc_spirit1_reset_rx_rearm_time(void);
+
+uint32_t bc_spirit1_get_rx_discarded(void);
+
+uint32_t bc_spirit1_get_rx_dropped(void);
+
+// Frames are sent to this address and frames sent to other address are discarded by SPIRIT1, zero disables filtering
+void bc_spirit1_set_address(uint8_t address);
+
+uint8_t bc_spirit1_get_address(void);
+
+uint32_t bc_spirit1_get_rx_rejected(void);
+
+uint32_t bc_spirit1_get_rx_crc_error(void);
+
+bc_tick_t bc_spirit1_get_airtime(size_t length);
+
 void bc_spirit1_tx(void);
 
 void bc_spirit1_rx(void);
@@ -3,9 +3,61 @@
 
 #include <bc_common.h>
 
+#ifndef BC_USB_CDC_TRANSMIT_SIZE
+#define BC_USB_CDC_TRANSMIT_SIZE 1024
+#endif
+
+// Most messages waiting in transmit ring, their lengths are kept so that drop oldest policy discards whole messages
+#ifndef BC_USB_CDC_TRANSMIT_MESSAGES
+#define BC_USB_CDC_TRANSMIT_MESSAGES 48
+#endif
+
+typedef enum
+{
+    // Data came from host, handler is called from task
+    BC_USB_CDC_EVENT_RECEIVE = 0
+
+} bc_usb_cdc_event_t;
+
+typedef enum
+{
+    // Message which does not fit is refused, writer learns it from return value
+    BC_USB_CDC_OVERFLOW_REJECT = 0,
+
+    // Oldest whole messages not yet handed to USB are discarded one by one until new one fits
+    BC_USB_CDC_OVERFLOW_DROP_OLDEST = 1
+
+} bc_usb_cdc_overflow_t;
+
+typedef struct
+{
+    uint32_t written;
+    uint32_t rejected;
+
+    // Bytes of queued messages discarded by drop oldest policy
+    uint32_t dropped;
+
+    size_t high_water;
+
+} bc_usb_cdc_stats_t;
+
 void bc_usb_cdc_init(void);
 void bc_usb_cdc_start(void);
 bool bc_usb_cdc_write(const void *buffer, size_t length);
+
+// Reserve contiguous space for message which is formatted in place and handed over by commit with its final length,
+// NULL is returned if message of given length does not fit, only one reservation may be open at a time
+void *bc_usb_cdc_write_reserve(size_t length);
+void bc_usb_cdc_write_commit(size_t length);
+
+void bc_usb_cdc_set_overflow(bc_usb_cdc_overflow_t overflow);
+void bc_usb_cdc_get_stats(bc_usb_cdc_stats_t *stats);
+void bc_usb_cdc_reset_stats(void);
+void bc_usb_cdc_set_event_handler(void (*event_handler)(bc_usb_cdc_event_t, void *), void *event_param);
 size_t bc_usb_cdc_read(void *buffer, size_t length);
 
+// Received data is taken in contiguous spans in place, host is held off by NAK while there is no room for next packet
+size_t bc_usb_cdc_read_peek(const void **buffer);
+void bc_usb_cdc_read_consume(size_t length);
+
 #endif /* _BC_USB_CDC_H */
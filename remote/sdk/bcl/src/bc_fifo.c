@@ -1,8 +1,18 @@
 #include <bc_fifo.h>
-#include <bc_irq.h>
+
+// Each index is written by one side only, it is loaded with acquire before data it guards is touched
+// and stored with release after data it hands over, so neither side needs to mask interrupts
+#define _BC_FIFO_LOAD(index) __atomic_load_n(&(index), __ATOMIC_ACQUIRE)
+#define _BC_FIFO_STORE(index, value) __atomic_store_n(&(index), (value), __ATOMIC_RELEASE)
 
 void bc_fifo_init(bc_fifo_t *fifo, void *buffer, size_t size)
 {
+    // Indices run freely and are masked by size, so it is taken down to power of two
+    while ((size & (size - 1)) != 0)
+    {
+        size &= size - 1;
+    }
+
     fifo->buffer = buffer;
     fifo->size = size;
     fifo->head = 0;
@@ -11,143 +21,95 @@ void bc_fifo_init(bc_fifo_t *fifo, void *buffer, size_t size)
 
 size_t bc_fifo_write(bc_fifo_t *fifo, const void *buffer, size_t length)
 {
-    // Disable interrupts
-    bc_irq_disable();
+    size_t head = fifo->head;
+    size_t free = fifo->size - (head - _BC_FIFO_LOAD(fifo->tail));
 
-    // For each byte in buffer...
-    for (size_t i = 0; i < length; i++)
+    if (length > free)
     {
-        if ((fifo->head + 1) == fifo->tail)
-        {
-            // Enable interrupts
-            bc_irq_enable();
-
-            // Return number of bytes written
-            return i;
-        }
-
-        if (((fifo->head + 1) == fifo->size) && (fifo->tail == 0))
-        {
-            // Enable interrupts
-            bc_irq_enable();
-
-            // Return number of bytes written
-            return i;
-        }
+        length = free;
+    }
 
-        *((uint8_t *) fifo->buffer + fifo->head) = *(uint8_t *) buffer;
+    // Data is copied in two chunks at most, second one when it wraps over end of buffer
+    size_t offset = head & (fifo->size - 1);
+    size_t chunk = fifo->size - offset;
 
-        buffer = (uint8_t *) buffer + 1;
+    if (chunk > length)
+    {
+        chunk = length;
+    }
 
-        fifo->head++;
+    memcpy((uint8_t *) fifo->buffer + offset, buffer, chunk);
 
-        if (fifo->head == fifo->size)
-        {
-            fifo->head = 0;
-        }
+    if (length > chunk)
+    {
+        memcpy(fifo->buffer, (const uint8_t *) buffer + chunk, length - chunk);
     }
 
-    // Enable interrupts
-    bc_irq_enable();
+    _BC_FIFO_STORE(fifo->head, head + length);
 
-    // Return number of bytes written
     return length;
 }
 
 size_t bc_fifo_read(bc_fifo_t *fifo, void *buffer, size_t length)
 {
-    // Disable interrupts
-    bc_irq_disable();
+    size_t tail = fifo->tail;
+    size_t used = _BC_FIFO_LOAD(fifo->head) - tail;
+
+    if (length > used)
+    {
+        length = used;
+    }
+
+    size_t offset = tail & (fifo->size - 1);
+    size_t chunk = fifo->size - offset;
+
+    if (chunk > length)
+    {
+        chunk = length;
+    }
+
+    memcpy(buffer, (const uint8_t *) fifo->buffer + offset, chunk);
 
-    // For desired number of bytes...
-    for (size_t i = 0; i < length; i++)
+    if (length > chunk)
     {
-        if (fifo->tail != fifo->head)
-        {
-            *(uint8_t *) buffer = *((uint8_t *) fifo->buffer + fifo->tail);
-
-            buffer = (uint8_t *) buffer + 1;
-
-            fifo->tail++;
-
-            if (fifo->tail == fifo->size)
-            {
-                fifo->tail = 0;
-            }
-        }
-        else
-        {
-            // Enable interrupts
-            bc_irq_enable();
-
-            // Return number of bytes read
-            return i;
-        }
+        memcpy((uint8_t *) buffer + chunk, fifo->buffer, length - chunk);
     }
 
-    // Enable interrupts
-    bc_irq_enable();
+    _BC_FIFO_STORE(fifo->tail, tail + length);
 
-    // Return number of bytes read
     return length;
 }
 
 size_t bc_fifo_irq_write(bc_fifo_t *fifo, const void *buffer, size_t length)
 {
-    for (size_t i = 0; i < length; i++)
-    {
-        if ((fifo->head + 1) == fifo->tail)
-        {
-            // Return number of bytes written
-            return i;
-        }
-
-        if (((fifo->head + 1) == fifo->size) && (fifo->tail == 0))
-        {
-            // Return number of bytes written
-            return i;
-        }
+    return bc_fifo_write(fifo, buffer, length);
+}
 
-        *((uint8_t *) fifo->buffer + fifo->head) = *(uint8_t *) buffer;
+size_t bc_fifo_irq_read(bc_fifo_t *fifo, void *buffer, size_t length)
+{
+    return bc_fifo_read(fifo, buffer, length);
+}
 
-        buffer = (uint8_t *) buffer + 1;
+size_t bc_fifo_peek(bc_fifo_t *fifo, void **buffer)
+{
+    size_t tail = fifo->tail;
+    size_t used = _BC_FIFO_LOAD(fifo->head) - tail;
+    size_t offset = tail & (fifo->size - 1);
 
-        fifo->head++;
+    *buffer = (uint8_t *) fifo->buffer + offset;
 
-        if (fifo->head == fifo->size)
-        {
-            fifo->head = 0;
-        }
-    }
+    // Span ends at head or at end of buffer, whichever comes first
+    return used < fifo->size - offset ? used : fifo->size - offset;
+}
 
-    // Return number of bytes written
-    return length;
+void bc_fifo_consume(bc_fifo_t *fifo, size_t length)
+{
+    _BC_FIFO_STORE(fifo->tail, fifo->tail + length);
 }
 
-size_t bc_fifo_irq_read(bc_fifo_t *fifo, void *buffer, size_t length)
+size_t bc_fifo_get_free(bc_fifo_t *fifo)
 {
-    for (size_t i = 0; i < length; i++)
-    {
-        if (fifo->tail != fifo->head)
-        {
-            *(uint8_t *) buffer = *((uint8_t *) fifo->buffer + fifo->tail);
-
-            buffer = (uint8_t *) buffer + 1;
-
-            fifo->tail++;
-
-            if (fifo->tail == fifo->size)
-            {
-                fifo->tail = 0;
-            }
-        }
-        else
-        {
-            // Return number of bytes read
-            return i;
-        }
-    }
+    size_t tail = _BC_FIFO_LOAD(fifo->tail);
 
-    // Return number of bytes read
-    return length;
+    return fifo->size - (_BC_FIFO_LOAD(fifo->head) - tail);
 }
@@ -0,0 +1,214 @@
+#include <bc_flash.h>
+#include <bc_irq.h>
+#include <stm32l0xx.h>
+
+#define _BC_FLASH_HALF_PAGE_SIZE (BC_FLASH_PAGE_SIZE / 2)
+#define _BC_FLASH_SR_ERRORS (FLASH_SR_WRPERR | FLASH_SR_PGAERR | FLASH_SR_SIZERR | FLASH_SR_NOTZEROERR)
+
+// Function is copied to RAM with initialized data, it runs while program memory is busy and must not call anything in it
+#define _BC_FLASH_RAMFUNC __attribute__((section(".data.ramfunc"), noinline, long_call))
+
+static void _bc_flash_unlock(void);
+static void _bc_flash_lock(void);
+static bool _bc_flash_wait(void);
+_BC_FLASH_RAMFUNC static void _bc_flash_program_half_page(uint32_t address, const uint32_t *words);
+
+bool bc_flash_erase(uint32_t address, size_t length)
+{
+    // If user attempts to erase outside of second bank or from middle of page...
+    if (address < BC_FLASH_BANK2_ADDRESS || (address + length) > BC_FLASH_BANK2_END || (address % BC_FLASH_PAGE_SIZE) != 0)
+    {
+        // Indicate failure
+        return false;
+    }
+
+    bool success = true;
+
+    _bc_flash_unlock();
+
+    // For every page in area
+    for (uint32_t page = address; success && page < address + length; page += BC_FLASH_PAGE_SIZE)
+    {
+        FLASH->PECR |= FLASH_PECR_ERASE | FLASH_PECR_PROG;
+
+        // Writing any word of page starts its erase
+        *((volatile uint32_t *) page) = 0;
+
+        success = _bc_flash_wait();
+
+        FLASH->PECR &= ~(FLASH_PECR_ERASE | FLASH_PECR_PROG);
+    }
+
+    _bc_flash_lock();
+
+    return success;
+}
+
+bool bc_flash_write(uint32_t address, const void *buffer, size_t length)
+{
+    // If user attempts to write outside of second bank or by parts of word...
+    if (address < BC_FLASH_BANK2_ADDRESS || (address + length) > BC_FLASH_BANK2_END || (address % sizeof(uint32_t)) != 0 || (length % sizeof(uint32_t)) != 0)
+    {
+        // Indicate failure
+        return false;
+    }
+
+    uint32_t words[_BC_FLASH_HALF_PAGE_SIZE / sizeof(uint32_t)];
+    bool success = true;
+    size_t offset = 0;
+
+    _bc_flash_unlock();
+
+    while (success && offset < length)
+    {
+        size_t size;
+
+        // Half page takes as long to program as single word
+        if (((address + offset) % _BC_FLASH_HALF_PAGE_SIZE) == 0 && length - offset >= _BC_FLASH_HALF_PAGE_SIZE)
+        {
+            size = _BC_FLASH_HALF_PAGE_SIZE;
+
+            memcpy(words, (uint8_t *) buffer + offset, size);
+
+            bc_irq_disable();
+
+            _bc_flash_program_half_page(address + offset, words);
+
+            bc_irq_enable();
+        }
+        else
+        {
+            size = sizeof(uint32_t);
+
+            memcpy(words, (uint8_t *) buffer + offset, size);
+
+            *((volatile uint32_t *) (address + offset)) = words[0];
+        }
+
+        success = _bc_flash_wait();
+
+        offset += size;
+    }
+
+    _bc_flash_lock();
+
+    // If we do not read what we wrote...
+    if (!success || memcmp(buffer, (void *) address, length) != 0)
+    {
+        // Indicate failure
+        return false;
+    }
+
+    // Indicate success
+    return true;
+}
+
+bool bc_flash_install(void)
+{
+    // Enable clock for SYSCFG
+    RCC->APB2ENR |= RCC_APB2ENR_SYSCFGEN;
+
+    // Errata workaround
+    RCC->APB2ENR;
+
+    // User option byte is in lower half of word, upper half holds its complement
+    uint32_t user = OB->USER & 0xffff;
+
+    // Bootloader maps booted bank at start of program memory, other bank is the one at BC_FLASH_BANK2_ADDRESS
+    if ((SYSCFG->CFGR1 & SYSCFG_CFGR1_UFB) != 0)
+    {
+        user &= ~(FLASH_OPTR_BFB2 >> 16);
+    }
+    else
+    {
+        user |= FLASH_OPTR_BFB2 >> 16;
+    }
+
+    _bc_flash_unlock();
+
+    // Unlock option bytes
+    FLASH->OPTKEYR = FLASH_OPTKEY1;
+    FLASH->OPTKEYR = FLASH_OPTKEY2;
+
+    OB->USER = (~user << 16) | user;
+
+    if (!_bc_flash_wait())
+    {
+        _bc_flash_lock();
+
+        return false;
+    }
+
+    // Loading of option bytes resets the CPU, running program stays intact in its bank until then
+    FLASH->PECR |= FLASH_PECR_OBL_LAUNCH;
+
+    for (;;)
+    {
+        continue;
+    }
+}
+
+static void _bc_flash_unlock(void)
+{
+    // Disable interrupts
+    bc_irq_disable();
+
+    // Unlock FLASH_PECR register
+    FLASH->PEKEYR = FLASH_PEKEY1;
+    FLASH->PEKEYR = FLASH_PEKEY2;
+
+    // Unlock program memory
+    FLASH->PRGKEYR = FLASH_PRGKEY1;
+    FLASH->PRGKEYR = FLASH_PRGKEY2;
+
+    // Enable interrupts
+    bc_irq_enable();
+}
+
+static void _bc_flash_lock(void)
+{
+    // Disable interrupts
+    bc_irq_disable();
+
+    // Lock option bytes, program memory and FLASH_PECR register
+    FLASH->PECR |= FLASH_PECR_OPTLOCK;
+    FLASH->PECR |= FLASH_PECR_PRGLOCK;
+    FLASH->PECR |= FLASH_PECR_PELOCK;
+
+    // Enable interrupts
+    bc_irq_enable();
+}
+
+static bool _bc_flash_wait(void)
+{
+    // While memory interface busy flag is set...
+    while ((FLASH->SR & FLASH_SR_BSY) != 0UL)
+    {
+        continue;
+    }
+
+    uint32_t errors = FLASH->SR & _BC_FLASH_SR_ERRORS;
+
+    // Error flags are cleared by writing them back
+    FLASH->SR = errors;
+
+    return errors == 0;
+}
+
+static void _bc_flash_program_half_page(uint32_t address, const uint32_t *words)
+{
+    FLASH->PECR |= FLASH_PECR_FPRG | FLASH_PECR_PROG;
+
+    // All words are written to first address of half page one after another
+    for (size_t i = 0; i < _BC_FLASH_HALF_PAGE_SIZE / sizeof(uint32_t); i++)
+    {
+        *((volatile uint32_t *) address) = words[i];
+    }
+
+    while ((FLASH->SR & FLASH_SR_BSY) != 0UL)
+    {
+        continue;
+    }
+
+    FLASH->PECR &= ~(FLASH_PECR_FPRG | FLASH_PECR_PROG);
+}
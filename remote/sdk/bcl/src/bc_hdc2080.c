@@ -6,6 +6,7 @@
 #define BC_HDC2080_DELAY_MEASUREMENT 50
 
 static void _bc_hdc2080_task(void *param);
+static void _bc_hdc2080_i2c_event_handler(bc_i2c_transaction_t *transaction, bc_i2c_event_t event, void *event_param);
 
 void bc_hdc2080_init(bc_hdc2080_t *self, bc_i2c_channel_t i2c_channel, uint8_t i2c_address)
 {
@@ -129,7 +130,17 @@ start:
         {
             self->_state = BC_HDC2080_STATE_ERROR;
 
-            if (!bc_i2c_write_8b(self->_i2c_channel, self->_i2c_address, 0x0f, 0x07))
+            if (bc_i2c_is_busy(&self->_transaction[0]))
+            {
+                goto start;
+            }
+
+            // Failed write shows in interrupt register read back after conversion
+            self->_buffer[0] = 0x07;
+
+            bc_i2c_transaction_init(&self->_transaction[0], BC_I2C_DIRECTION_WRITE, self->_i2c_address, 0x0f, &self->_buffer[0], 1);
+
+            if (!bc_i2c_submit(self->_i2c_channel, &self->_transaction[0]))
             {
                 goto start;
             }
@@ -144,31 +155,43 @@ start:
         {
             self->_state = BC_HDC2080_STATE_ERROR;
 
-            uint8_t reg_interrupt;
-
-            if (!bc_i2c_read_8b(self->_i2c_channel, self->_i2c_address, 0x04, &reg_interrupt))
+            if (bc_i2c_is_busy(&self->_transaction[0]))
             {
                 goto start;
             }
 
-            if ((reg_interrupt & 0x80) == 0)
-            {
-                goto start;
-            }
+            // Interrupt, humidity and temperature registers are read in one chain by interrupts, task goes on once it is finished
+            bc_i2c_transaction_init(&self->_transaction[0], BC_I2C_DIRECTION_READ, self->_i2c_address, 0x04, &self->_buffer[0], 1);
+            bc_i2c_transaction_init(&self->_transaction[1], BC_I2C_DIRECTION_READ, self->_i2c_address, 0x02, &self->_buffer[1], 2);
+            bc_i2c_transaction_init(&self->_transaction[2], BC_I2C_DIRECTION_READ, self->_i2c_address, 0x00, &self->_buffer[3], 2);
 
-            if (!bc_i2c_read_16b(self->_i2c_channel, self->_i2c_address, 0x02, &self->_reg_humidity))
+            self->_transaction[0].chain = &self->_transaction[1];
+            self->_transaction[1].chain = &self->_transaction[2];
+            self->_transaction[0].event_handler = _bc_hdc2080_i2c_event_handler;
+            self->_transaction[0].event_param = self;
+
+            if (!bc_i2c_submit(self->_i2c_channel, &self->_transaction[0]))
             {
                 goto start;
             }
 
-            if (!bc_i2c_read_16b(self->_i2c_channel, self->_i2c_address, 0x00, &self->_reg_temperature))
+            self->_state = BC_HDC2080_STATE_RESULT;
+
+            return;
+        }
+        case BC_HDC2080_STATE_RESULT:
+        {
+            self->_state = BC_HDC2080_STATE_ERROR;
+
+            if ((self->_buffer[0] & 0x80) == 0)
             {
                 goto start;
             }
 
-            self->_reg_temperature = self->_reg_temperature << 8 | self->_reg_temperature >> 8;
+            // Sensor sends low byte first
+            self->_reg_humidity = self->_buffer[1] | self->_buffer[2] << 8;
 
-            self->_reg_humidity = self->_reg_humidity << 8 | self->_reg_humidity >> 8;
+            self->_reg_temperature = self->_buffer[3] | self->_buffer[4] << 8;
 
             self->_temperature_valid = true;
 
@@ -199,3 +222,17 @@ start:
         }
     }
 }
+
+static void _bc_hdc2080_i2c_event_handler(bc_i2c_transaction_t *transaction, bc_i2c_event_t event, void *event_param)
+{
+    (void) transaction;
+
+    bc_hdc2080_t *self = event_param;
+
+    if (event == BC_I2C_EVENT_ERROR)
+    {
+        self->_state = BC_HDC2080_STATE_ERROR;
+    }
+
+    bc_scheduler_plan_now(self->_task_id);
+}
@@ -1,7 +1,49 @@
 #include <bc_i2c.h>
 #include <bc_module_core.h>
+#include <bc_scheduler.h>
+#include <bc_irq.h>
 #include <stm32l0xx.h>
 
+// Transaction which does not finish in this time is aborted, bus is watched from task so it may take up to twice as long
+#define _BC_I2C_TIMEOUT 100
+
+// Byte count of one NBYTES load, longer transfer is continued by reload
+#define _BC_I2C_NBYTES_MAX 255
+
+#define _BC_I2C_CR1_IT (I2C_CR1_TXIE | I2C_CR1_RXIE | I2C_CR1_TCIE | I2C_CR1_STOPIE | I2C_CR1_NACKIE | I2C_CR1_ERRIE)
+
+typedef struct
+{
+    I2C_TypeDef *instance;
+
+    // Queue of chains, chain at head is on bus with its current transaction
+    bc_i2c_transaction_t *head;
+    bc_i2c_transaction_t *tail;
+    bc_i2c_transaction_t *current;
+
+    // Memory address goes first in both directions, read restarts in other direction once it is sent
+    uint8_t address[2];
+    size_t address_length;
+    size_t address_index;
+    uint8_t *buffer;
+    size_t index;
+    size_t remaining;
+    bool read_phase;
+    bool nack;
+
+    // Finished chains whose handler is called from task
+    bc_i2c_transaction_t *done_head;
+    bc_i2c_transaction_t *done_tail;
+
+    bc_scheduler_task_id_t task_id;
+
+    // Every start on bus is counted, so transaction submitted again at same address still gets its own deadline
+    uint32_t started;
+    uint32_t watched;
+    bc_tick_t deadline;
+
+} _bc_i2c_bus_t;
+
 static struct
 {
     bool i2c0_initialized;
@@ -10,12 +52,24 @@ static struct
     I2C_HandleTypeDef handle_i2c0;
     I2C_HandleTypeDef handle_i2c1;
 
+    _bc_i2c_bus_t bus[2];
+
 } bc_i2c =
 {
     .i2c0_initialized = false,
     .i2c1_initialized = false
 };
 
+static void _bc_i2c_bus_init(bc_i2c_channel_t channel, I2C_TypeDef *instance, IRQn_Type irq);
+static bool _bc_i2c_transfer(bc_i2c_channel_t channel, bc_i2c_direction_t direction, const bc_i2c_tranfer_t *transfer);
+static void _bc_i2c_task(void *param);
+static void _bc_i2c_watch(bc_i2c_channel_t channel);
+static void _bc_i2c_start(_bc_i2c_bus_t *bus);
+static void _bc_i2c_phase(_bc_i2c_bus_t *bus, bool read, size_t count, bool last);
+static uint32_t _bc_i2c_nbytes(_bc_i2c_bus_t *bus, bool last);
+static void _bc_i2c_finish(_bc_i2c_bus_t *bus, bool success);
+static void _bc_i2c_irq(_bc_i2c_bus_t *bus);
+
 void bc_i2c_init(bc_i2c_channel_t channel, bc_i2c_speed_t speed)
 {
     if (channel == BC_I2C_I2C0)
@@ -75,6 +129,8 @@ void bc_i2c_init(bc_i2c_channel_t channel, bc_i2c_speed_t speed)
             for (;;);
         }
 
+        _bc_i2c_bus_init(BC_I2C_I2C0, I2C2, I2C2_IRQn);
+
         bc_i2c.i2c0_initialized = true;
     }
     else
@@ -134,108 +190,89 @@ void bc_i2c_init(bc_i2c_channel_t channel, bc_i2c_speed_t speed)
             for (;;);
         }
 
+        _bc_i2c_bus_init(BC_I2C_I2C1, I2C1, I2C1_IRQn);
+
         bc_i2c.i2c1_initialized = true;
     }
 }
 
-bool bc_i2c_write(bc_i2c_channel_t channel, const bc_i2c_tranfer_t *transfer)
+void bc_i2c_transaction_init(bc_i2c_transaction_t *transaction, bc_i2c_direction_t direction, uint8_t device_address, uint32_t memory_address, void *buffer, size_t length)
 {
-    if (channel == BC_I2C_I2C0)
-    {
-        if (!bc_i2c.i2c0_initialized)
-        {
-            return false;
-        }
-
-        // Enable PLL and disable sleep
-        bc_module_core_pll_enable();
-
-        if (HAL_I2C_Mem_Write(&bc_i2c.handle_i2c0, transfer->device_address << 1, transfer->memory_address, (transfer->memory_address & BC_I2C_MEMORY_ADDRESS_16_BIT) != 0 ? I2C_MEMADD_SIZE_16BIT : I2C_MEMADD_SIZE_8BIT, transfer->buffer, transfer->length, 0xFFFFFFFF) != HAL_OK)
-        {
-            // Disable PLL and enable sleep
-            bc_module_core_pll_disable();
-
-            return false;
-        }
-
-        // Disable PLL and enable sleep
-        bc_module_core_pll_disable();
+    transaction->direction = direction;
+    transaction->transfer.device_address = device_address;
+    transaction->transfer.memory_address = memory_address;
+    transaction->transfer.buffer = buffer;
+    transaction->transfer.length = length;
+    transaction->chain = NULL;
+    transaction->event_handler = NULL;
+    transaction->event_param = NULL;
+}
 
-        return true;
-    }
-    else
+bool bc_i2c_submit(bc_i2c_channel_t channel, bc_i2c_transaction_t *transaction)
+{
+    if (channel == BC_I2C_I2C0 ? !bc_i2c.i2c0_initialized : !bc_i2c.i2c1_initialized)
     {
-        if (!bc_i2c.i2c1_initialized)
-        {
-            return false;
-        }
-
-        // Enable PLL and disable sleep
-        bc_module_core_pll_enable();
-
-        if (HAL_I2C_Mem_Write(&bc_i2c.handle_i2c1, transfer->device_address << 1, transfer->memory_address, (transfer->memory_address & BC_I2C_MEMORY_ADDRESS_16_BIT) != 0 ? I2C_MEMADD_SIZE_16BIT : I2C_MEMADD_SIZE_8BIT, transfer->buffer, transfer->length, 0xFFFFFFFF) != HAL_OK)
-        {
-            // Disable PLL and enable sleep
-            bc_module_core_pll_disable();
-
-            return false;
-        }
-
-        // Disable PLL and enable sleep
-        bc_module_core_pll_disable();
+        return false;
+    }
 
-        return true;
+    if (transaction->_busy)
+    {
+        return false;
     }
-}
 
-bool bc_i2c_read(bc_i2c_channel_t channel, const bc_i2c_tranfer_t *transfer)
-{
-    if (channel == BC_I2C_I2C0)
+    for (bc_i2c_transaction_t *t = transaction; t != NULL; t = t->chain)
     {
-        if (!bc_i2c.i2c0_initialized)
+        if (t->transfer.length == 0)
         {
             return false;
         }
+    }
 
-        // Enable PLL and disable sleep
-        bc_module_core_pll_enable();
+    _bc_i2c_bus_t *bus = &bc_i2c.bus[channel];
 
-        if (HAL_I2C_Mem_Read(&bc_i2c.handle_i2c0, transfer->device_address << 1, transfer->memory_address, (transfer->memory_address & BC_I2C_MEMORY_ADDRESS_16_BIT) != 0 ? I2C_MEMADD_SIZE_16BIT : I2C_MEMADD_SIZE_8BIT, transfer->buffer, transfer->length, 0xFFFFFFFF) != HAL_OK)
-        {
-            // Disable PLL and enable sleep
-            bc_module_core_pll_disable();
+    transaction->_next = NULL;
+    transaction->_busy = true;
 
-            return false;
-        }
+    // Enable PLL and disable sleep, they are given back when chain is finished
+    bc_module_core_pll_enable();
 
-        // Disable PLL and enable sleep
-        bc_module_core_pll_disable();
+    bc_irq_disable();
 
-        return true;
+    if (bus->head == NULL)
+    {
+        bus->head = transaction;
+        bus->tail = transaction;
+        bus->current = transaction;
+
+        _bc_i2c_start(bus);
     }
     else
     {
-        if (!bc_i2c.i2c1_initialized)
-        {
-            return false;
-        }
+        bus->tail->_next = transaction;
+        bus->tail = transaction;
+    }
 
-        // Enable PLL and disable sleep
-        bc_module_core_pll_enable();
+    bc_irq_enable();
 
-        if (HAL_I2C_Mem_Read(&bc_i2c.handle_i2c1, transfer->device_address << 1, transfer->memory_address, (transfer->memory_address & BC_I2C_MEMORY_ADDRESS_16_BIT) != 0 ? I2C_MEMADD_SIZE_16BIT : I2C_MEMADD_SIZE_8BIT, transfer->buffer, transfer->length, 0xFFFFFFFF) != HAL_OK)
-        {
-            // Disable PLL and enable sleep
-            bc_module_core_pll_disable();
+    // Task keeps watch over bus while it is busy
+    bc_scheduler_plan_now(bus->task_id);
 
-            return false;
-        }
+    return true;
+}
 
-        // Disable PLL and enable sleep
-        bc_module_core_pll_disable();
+bool bc_i2c_is_busy(bc_i2c_transaction_t *transaction)
+{
+    return transaction->_busy;
+}
 
-        return true;
-    }
+bool bc_i2c_write(bc_i2c_channel_t channel, const bc_i2c_tranfer_t *transfer)
+{
+    return _bc_i2c_transfer(channel, BC_I2C_DIRECTION_WRITE, transfer);
+}
+
+bool bc_i2c_read(bc_i2c_channel_t channel, const bc_i2c_tranfer_t *transfer)
+{
+    return _bc_i2c_transfer(channel, BC_I2C_DIRECTION_READ, transfer);
 }
 
 bool bc_i2c_write_8b(bc_i2c_channel_t channel, uint8_t device_address, uint32_t memory_address, uint8_t data)
@@ -299,3 +336,315 @@ bool bc_i2c_read_16b(bc_i2c_channel_t channel, uint8_t device_address, uint32_t
 
     return true;
 }
+
+void I2C1_IRQHandler(void)
+{
+    _bc_i2c_irq(&bc_i2c.bus[BC_I2C_I2C1]);
+}
+
+void I2C2_IRQHandler(void)
+{
+    _bc_i2c_irq(&bc_i2c.bus[BC_I2C_I2C0]);
+}
+
+static void _bc_i2c_bus_init(bc_i2c_channel_t channel, I2C_TypeDef *instance, IRQn_Type irq)
+{
+    _bc_i2c_bus_t *bus = &bc_i2c.bus[channel];
+
+    memset(bus, 0, sizeof(*bus));
+
+    bus->instance = instance;
+    bus->task_id = bc_scheduler_register(_bc_i2c_task, (void *) channel, BC_TICK_INFINITY);
+
+    // Flags raise interrupt only while transfer is going on, so they stay enabled
+    instance->CR1 |= _BC_I2C_CR1_IT;
+
+    NVIC_EnableIRQ(irq);
+}
+
+static bool _bc_i2c_transfer(bc_i2c_channel_t channel, bc_i2c_direction_t direction, const bc_i2c_tranfer_t *transfer)
+{
+    bc_i2c_transaction_t transaction;
+
+    memset(&transaction, 0, sizeof(transaction));
+
+    transaction.direction = direction;
+    transaction.transfer = *transfer;
+
+    if (!bc_i2c_submit(channel, &transaction))
+    {
+        return false;
+    }
+
+    // Scheduler does not run while caller waits, so timeout is watched here
+    while (transaction._busy)
+    {
+        _bc_i2c_watch(channel);
+    }
+
+    return transaction._event == BC_I2C_EVENT_DONE;
+}
+
+static void _bc_i2c_task(void *param)
+{
+    bc_i2c_channel_t channel = (bc_i2c_channel_t) param;
+    _bc_i2c_bus_t *bus = &bc_i2c.bus[channel];
+
+    while (true)
+    {
+        bc_irq_disable();
+
+        bc_i2c_transaction_t *transaction = bus->done_head;
+
+        if (transaction != NULL)
+        {
+            bus->done_head = transaction->_next;
+        }
+
+        bc_irq_enable();
+
+        if (transaction == NULL)
+        {
+            break;
+        }
+
+        // Handler may submit same chain again
+        transaction->_busy = false;
+
+        transaction->event_handler(transaction, transaction->_event, transaction->event_param);
+    }
+
+    _bc_i2c_watch(channel);
+
+    if (bus->current != NULL)
+    {
+        bc_scheduler_plan_current_absolute(bus->deadline);
+    }
+}
+
+static void _bc_i2c_watch(bc_i2c_channel_t channel)
+{
+    _bc_i2c_bus_t *bus = &bc_i2c.bus[channel];
+
+    bc_tick_t now = bc_tick_get();
+
+    bc_irq_disable();
+
+    if (bus->current == NULL)
+    {
+        bus->watched = bus->started;
+    }
+    else if (bus->started != bus->watched)
+    {
+        bus->watched = bus->started;
+        bus->deadline = now + _BC_I2C_TIMEOUT;
+    }
+    else if (now >= bus->deadline)
+    {
+        // Peripheral reset releases lines and clears flags, chains behind go on
+        bus->instance->CR1 &= ~I2C_CR1_PE;
+
+        while ((bus->instance->CR1 & I2C_CR1_PE) != 0)
+        {
+            continue;
+        }
+
+        bus->instance->CR1 |= I2C_CR1_PE;
+
+        _bc_i2c_finish(bus, false);
+    }
+
+    bc_irq_enable();
+}
+
+static void _bc_i2c_start(_bc_i2c_bus_t *bus)
+{
+    bc_i2c_transaction_t *transaction = bus->current;
+    uint32_t memory_address = transaction->transfer.memory_address;
+
+    bus->started++;
+
+    if ((memory_address & BC_I2C_MEMORY_ADDRESS_16_BIT) != 0)
+    {
+        bus->address[0] = memory_address >> 8;
+        bus->address[1] = memory_address;
+        bus->address_length = 2;
+    }
+    else
+    {
+        bus->address[0] = memory_address;
+        bus->address_length = 1;
+    }
+
+    bus->address_index = 0;
+    bus->buffer = transaction->transfer.buffer;
+    bus->index = 0;
+    bus->read_phase = false;
+    bus->nack = false;
+
+    if (transaction->direction == BC_I2C_DIRECTION_WRITE)
+    {
+        _bc_i2c_phase(bus, false, bus->address_length + transaction->transfer.length, true);
+    }
+    else
+    {
+        _bc_i2c_phase(bus, false, bus->address_length, false);
+    }
+}
+
+static void _bc_i2c_phase(_bc_i2c_bus_t *bus, bool read, size_t count, bool last)
+{
+    bus->remaining = count;
+
+    uint32_t cr2 = (uint32_t) bus->current->transfer.device_address << 1;
+
+    if (read)
+    {
+        cr2 |= I2C_CR2_RD_WRN;
+    }
+
+    bus->instance->CR2 = cr2 | _bc_i2c_nbytes(bus, last) | I2C_CR2_START;
+}
+
+static uint32_t _bc_i2c_nbytes(_bc_i2c_bus_t *bus, bool last)
+{
+    size_t count = bus->remaining > _BC_I2C_NBYTES_MAX ? _BC_I2C_NBYTES_MAX : bus->remaining;
+
+    bus->remaining -= count;
+
+    // Stop follows last byte of whole transaction, memory address of read is followed by restart instead
+    if (bus->remaining != 0)
+    {
+        return (count << I2C_CR2_NBYTES_Pos) | I2C_CR2_RELOAD;
+    }
+
+    return (count << I2C_CR2_NBYTES_Pos) | (last ? I2C_CR2_AUTOEND : 0);
+}
+
+static void _bc_i2c_finish(_bc_i2c_bus_t *bus, bool success)
+{
+    // Rest of chain goes on without giving bus away
+    if (success && bus->current->chain != NULL)
+    {
+        bus->current = bus->current->chain;
+
+        _bc_i2c_start(bus);
+
+        return;
+    }
+
+    bc_i2c_transaction_t *transaction = bus->head;
+
+    bus->head = transaction->_next;
+
+    transaction->_next = NULL;
+    transaction->_event = success ? BC_I2C_EVENT_DONE : BC_I2C_EVENT_ERROR;
+
+    if (transaction->event_handler != NULL)
+    {
+        if (bus->done_head == NULL)
+        {
+            bus->done_head = transaction;
+        }
+        else
+        {
+            bus->done_tail->_next = transaction;
+        }
+
+        bus->done_tail = transaction;
+
+        bc_scheduler_plan_now(bus->task_id);
+    }
+    else
+    {
+        // Waiting caller owns transaction again once this is cleared
+        transaction->_busy = false;
+    }
+
+    bc_module_core_pll_disable();
+
+    bus->current = bus->head;
+
+    if (bus->current != NULL)
+    {
+        _bc_i2c_start(bus);
+    }
+}
+
+static void _bc_i2c_irq(_bc_i2c_bus_t *bus)
+{
+    I2C_TypeDef *instance = bus->instance;
+    uint32_t isr = instance->ISR;
+
+    if (bus->current == NULL)
+    {
+        instance->ICR = I2C_ICR_STOPCF | I2C_ICR_NACKCF | I2C_ICR_BERRCF | I2C_ICR_ARLOCF | I2C_ICR_OVRCF;
+
+        return;
+    }
+
+    // Bus error or lost arbitration leaves peripheral in unknown state, it is reset
+    if ((isr & (I2C_ISR_BERR | I2C_ISR_ARLO | I2C_ISR_OVR)) != 0)
+    {
+        instance->CR1 &= ~I2C_CR1_PE;
+
+        while ((instance->CR1 & I2C_CR1_PE) != 0)
+        {
+            continue;
+        }
+
+        instance->CR1 |= I2C_CR1_PE;
+
+        _bc_i2c_finish(bus, false);
+
+        return;
+    }
+
+    if ((isr & I2C_ISR_NACKF) != 0)
+    {
+        instance->ICR = I2C_ICR_NACKCF;
+
+        bus->nack = true;
+
+        // Stop is generated by hardware only with automatic end
+        if ((instance->CR2 & I2C_CR2_AUTOEND) == 0)
+        {
+            instance->CR2 |= I2C_CR2_STOP;
+        }
+    }
+    else if ((isr & I2C_ISR_TXIS) != 0)
+    {
+        if (bus->address_index < bus->address_length)
+        {
+            instance->TXDR = bus->address[bus->address_index++];
+        }
+        else
+        {
+            instance->TXDR = bus->buffer[bus->index++];
+        }
+    }
+    else if ((isr & I2C_ISR_RXNE) != 0)
+    {
+        bus->buffer[bus->index++] = instance->RXDR;
+    }
+    else if ((isr & I2C_ISR_TCR) != 0)
+    {
+        instance->CR2 = (instance->CR2 & ~(I2C_CR2_NBYTES | I2C_CR2_RELOAD | I2C_CR2_AUTOEND)) | _bc_i2c_nbytes(bus, true);
+    }
+    else if ((isr & I2C_ISR_TC) != 0 && !bus->read_phase)
+    {
+        bus->read_phase = true;
+
+        _bc_i2c_phase(bus, true, bus->current->transfer.length, true);
+    }
+
+    if ((isr & I2C_ISR_STOPF) != 0)
+    {
+        instance->ICR = I2C_ICR_STOPCF;
+
+        // Byte left in transmit register after not acknowledged write is flushed
+        instance->ISR = I2C_ISR_TXE;
+
+        _bc_i2c_finish(bus, !bus->nack);
+    }
+}
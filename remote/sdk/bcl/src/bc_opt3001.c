@@ -6,6 +6,7 @@
 #define BC_OPT3001_DELAY_MEASUREMENT 1000
 
 static void _bc_opt3001_task(void *param);
+static void _bc_opt3001_i2c_event_handler(bc_i2c_transaction_t *transaction, bc_i2c_event_t event, void *event_param);
 
 void bc_opt3001_init(bc_opt3001_t *self, bc_i2c_channel_t i2c_channel, uint8_t i2c_address)
 {
@@ -16,7 +17,7 @@ void bc_opt3001_init(bc_opt3001_t *self, bc_i2c_channel_t i2c_channel, uint8_t i
 
     bc_i2c_init(self->_i2c_channel, BC_I2C_SPEED_400_KHZ);
 
-    bc_scheduler_register(_bc_opt3001_task, self, BC_OPT3001_DELAY_RUN);
+    self->_task_id = bc_scheduler_register(_bc_opt3001_task, self, BC_OPT3001_DELAY_RUN);
 }
 
 void bc_opt3001_set_event_handler(bc_opt3001_t *self, void (*event_handler)(bc_opt3001_t *, bc_opt3001_event_t, void *), void *event_param)
@@ -98,7 +99,18 @@ start:
         {
             self->_state = BC_OPT3001_STATE_ERROR;
 
-            if (!bc_i2c_write_16b(self->_i2c_channel, self->_i2c_address, 0x01, 0xca10))
+            if (bc_i2c_is_busy(&self->_transaction[0]))
+            {
+                goto start;
+            }
+
+            // Failed write shows in configuration read back after conversion
+            self->_buffer[0] = 0xca;
+            self->_buffer[1] = 0x10;
+
+            bc_i2c_transaction_init(&self->_transaction[0], BC_I2C_DIRECTION_WRITE, self->_i2c_address, 0x01, &self->_buffer[0], 2);
+
+            if (!bc_i2c_submit(self->_i2c_channel, &self->_transaction[0]))
             {
                 goto start;
             }
@@ -113,23 +125,41 @@ start:
         {
             self->_state = BC_OPT3001_STATE_ERROR;
 
-            uint16_t reg_configuration;
-
-            if (!bc_i2c_read_16b(self->_i2c_channel, self->_i2c_address, 0x01, &reg_configuration))
+            if (bc_i2c_is_busy(&self->_transaction[0]))
             {
                 goto start;
             }
 
-            if ((reg_configuration & 0x0680) != 0x0080)
+            // Configuration and result are read in one chain by interrupts, task goes on once it is finished
+            bc_i2c_transaction_init(&self->_transaction[0], BC_I2C_DIRECTION_READ, self->_i2c_address, 0x01, &self->_buffer[0], 2);
+            bc_i2c_transaction_init(&self->_transaction[1], BC_I2C_DIRECTION_READ, self->_i2c_address, 0x00, &self->_buffer[2], 2);
+
+            self->_transaction[0].chain = &self->_transaction[1];
+            self->_transaction[0].event_handler = _bc_opt3001_i2c_event_handler;
+            self->_transaction[0].event_param = self;
+
+            if (!bc_i2c_submit(self->_i2c_channel, &self->_transaction[0]))
             {
                 goto start;
             }
 
-            if (!bc_i2c_read_16b(self->_i2c_channel, self->_i2c_address, 0x00, &self->_reg_result))
+            self->_state = BC_OPT3001_STATE_RESULT;
+
+            return;
+        }
+        case BC_OPT3001_STATE_RESULT:
+        {
+            self->_state = BC_OPT3001_STATE_ERROR;
+
+            uint16_t reg_configuration = self->_buffer[0] << 8 | self->_buffer[1];
+
+            if ((reg_configuration & 0x0680) != 0x0080)
             {
                 goto start;
             }
 
+            self->_reg_result = self->_buffer[2] << 8 | self->_buffer[3];
+
             self->_luminosity_valid = true;
 
             self->_state = BC_OPT3001_STATE_UPDATE;
@@ -157,3 +187,17 @@ start:
         }
     }
 }
+
+static void _bc_opt3001_i2c_event_handler(bc_i2c_transaction_t *transaction, bc_i2c_event_t event, void *event_param)
+{
+    (void) transaction;
+
+    bc_opt3001_t *self = event_param;
+
+    if (event == BC_I2C_EVENT_ERROR)
+    {
+        self->_state = BC_OPT3001_STATE_ERROR;
+    }
+
+    bc_scheduler_plan_now(self->_task_id);
+}
@@ -42,6 +42,38 @@ bool bc_queue_put(bc_queue_t *queue, const void *buffer, size_t length)
     return true;
 }
 
+bool bc_queue_put_latest(bc_queue_t *queue, const void *buffer, size_t length, size_t key_length)
+{
+    if (key_length == 0 || key_length > length)
+    {
+        return bc_queue_put(queue, buffer, length);
+    }
+
+    uint8_t *p = queue->_buffer;
+    uint8_t *end = p + queue->_length;
+
+    // Item of same length starting with same key is overwritten in place and keeps its position
+    while (p < end)
+    {
+        size_t item_length;
+
+        memcpy(&item_length, p, sizeof(item_length));
+
+        p += sizeof(item_length);
+
+        if (item_length == length && memcmp(p, buffer, key_length) == 0)
+        {
+            memcpy(p, buffer, length);
+
+            return true;
+        }
+
+        p += item_length;
+    }
+
+    return bc_queue_put(queue, buffer, length);
+}
+
 bool bc_queue_get(bc_queue_t *queue, void *buffer, size_t *length)
 {
     if (queue->_length == 0)
@@ -66,3 +98,34 @@ bool bc_queue_get(bc_queue_t *queue, void *buffer, size_t *length)
 
     return true;
 }
+
+bool bc_queue_peek(bc_queue_t *queue, void *buffer, size_t *length)
+{
+    if (queue->_length == 0)
+    {
+        return false;
+    }
+
+    uint8_t *p = queue->_buffer;
+
+    memcpy(length, p, sizeof(*length));
+
+    p += sizeof(*length);
+
+    if (buffer != NULL)
+    {
+        memcpy(buffer, p, *length);
+    }
+
+    return true;
+}
+
+bool bc_queue_is_empty(bc_queue_t *queue)
+{
+    return queue->_length == 0;
+}
+
+size_t bc_queue_get_length(bc_queue_t *queue)
+{
+    return queue->_length;
+}
@@ -5,8 +5,113 @@
 #include <bc_spirit1.h>
 #include <bc_eeprom.h>
 
-#define BC_RADIO_EEPROM_PEER_DEVICE_ADDRESS 0x00
-
+// EEPROM areas do not depend on build options, firmware built with other peer count or log length finds records of previous one
+#define BC_RADIO_EEPROM_PEER_DEVICE_ADDRESS 0x0000
+#define BC_RADIO_EEPROM_PEER_SIZE 0x0c00
+#define BC_RADIO_EEPROM_LOG 0x0c00
+#define BC_RADIO_EEPROM_LOG_SIZE 0x0b00
+#define BC_RADIO_EEPROM_PROFILE 0x1700
+
+// Channel, data rate, FEC, power and check byte
+#define BC_RADIO_PROFILE_RECORD_SIZE 5
+
+#define BC_RADIO_TRANSMIT_COUNT 10
+
+// Frames are sent collision-free in own slot, so no blind repetitions are needed
+#define BC_RADIO_TDMA_TRANSMIT_COUNT 0
+#define BC_RADIO_TDMA_RETRANSMIT_DELAY 10
+#define BC_RADIO_TDMA_URGENT_TRANSMIT_COUNT 3
+
+// Guard time at both ends of slot (tick resolution is 10 ms)
+#define BC_RADIO_TDMA_GUARD 10
+
+// Uncompensated clock error assumed when widening beacon window
+#define BC_RADIO_TDMA_DRIFT_MARGIN_PPM 200
+#define BC_RADIO_TDMA_MAX_DRIFT_PPM 1000
+
+// Minimum interval over which drift is estimated
+#define BC_RADIO_TDMA_DRIFT_MIN_INTERVAL 60000
+
+#define BC_RADIO_TDMA_WINDOW_MARGIN 10
+#define BC_RADIO_TDMA_RESYNC_SUPERFRAMES 6
+#define BC_RADIO_TDMA_MAX_MISSED 3
+
+// Node without slot asks gateway for it, gateway answers with beacon which lists the node as acknowledgement does,
+// unanswered requests are repeated with backoff which doubles up to search interval
+#define BC_RADIO_TDMA_GRANT_TIMEOUT 150
+#define BC_RADIO_TDMA_REQUEST_BACKOFF 10000
+#define BC_RADIO_TDMA_SEARCH_INTERVAL 300000
+
+// Fragment leaves room for relay entry header so that it can be forwarded
+#define BC_RADIO_FRAGMENT_HEADER_LENGTH 4
+#define BC_RADIO_FRAGMENT_DATA_SIZE (BC_SPIRIT1_MAX_PACKET_SIZE - 6 - BC_RADIO_FRAGMENT_HEADER_LENGTH - 1 - BC_RADIO_RELAY_ENTRY_HEADER_LENGTH)
+#define BC_RADIO_FRAGMENT_MAX_COUNT 32
+#define BC_RADIO_FRAGMENT_TRANSMIT_COUNT 0
+#define BC_RADIO_FRAGMENT_ACK_TIMEOUT 500
+#define BC_RADIO_FRAGMENT_ACK_DELAY 20
+#define BC_RADIO_FRAGMENT_MAX_RETRIES 5
+#define BC_RADIO_FRAGMENT_REASSEMBLY_TIMEOUT 10000
+#define BC_RADIO_FRAGMENT_NACK_LENGTH 10
+
+#define BC_RADIO_RELAY_MAX_HOPS 3
+#define BC_RADIO_RELAY_TRANSMIT_COUNT 2
+#define BC_RADIO_RELAY_AGGREGATION_DELAY 50
+#define BC_RADIO_RELAY_SEEN_COUNT 16
+
+// Hop counter, source device address, source message ID, payload length
+#define BC_RADIO_RELAY_ENTRY_HEADER_LENGTH 8
+
+// Gateway answers after switching to transmission, sender listens for answer over relay too
+#define BC_RADIO_ACK_DELAY 10
+#define BC_RADIO_ACK_TIMEOUT 150
+#define BC_RADIO_ACK_MAX_ENTRIES 8
+#define BC_RADIO_ACK_ENTRY_LENGTH 6
+
+// Record is sequence number, log time, message ID of lost frame, item length, check byte and item
+#ifndef BC_RADIO_LOG_RECORD_COUNT
+#define BC_RADIO_LOG_RECORD_COUNT 128
+#endif
+#define BC_RADIO_LOG_ITEM_SIZE 12
+#define BC_RADIO_LOG_RECORD_SIZE (10 + BC_RADIO_LOG_ITEM_SIZE)
+#define BC_RADIO_LOG_REPLAY_INTERVAL 5000
+#define BC_RADIO_LOG_REPLAY_BURST 4
+#define BC_RADIO_LOG_REPLAY_TRANSMIT_COUNT 0
+
+// Replay item header, sequence number, age and message ID of lost frame
+#define BC_RADIO_REPLAY_HEADER_LENGTH 9
+
+// Bulk transfer sends window of frames without repetitions, last one asks for cumulative and selective acknowledgement
+#define BC_RADIO_BULK_WINDOW 16
+#define BC_RADIO_BULK_HEADER_LENGTH 5
+#define BC_RADIO_BULK_DATA_SIZE (BC_SPIRIT1_MAX_PACKET_SIZE - 6 - BC_RADIO_BULK_HEADER_LENGTH)
+#define BC_RADIO_BULK_OPEN_LENGTH 11
+#define BC_RADIO_BULK_ACK_LENGTH 13
+#define BC_RADIO_BULK_ACK_DELAY 10
+#define BC_RADIO_BULK_ACK_TIMEOUT 150
+#define BC_RADIO_BULK_MAX_RETRIES 8
+#define BC_RADIO_BULK_RX_TIMEOUT 10000
+#define BC_RADIO_BULK_FLAG_REQUEST 0x01
+#define BC_RADIO_BULK_STATUS_OK 0
+#define BC_RADIO_BULK_STATUS_REFUSED 1
+
+// Sleeping node is told in front of acknowledgement or beacon that transfer for it waits, then it listens while frames come
+#define BC_RADIO_BULK_NOTICE_LENGTH 5
+#define BC_RADIO_BULK_LISTEN_TIME 3000
+#define BC_RADIO_BULK_NOTICE_TIMEOUT 600000
+
+// Survey samples signal level once per tick, sample above threshold counts as busy
+#define BC_RADIO_SURVEY_SAMPLE_INTERVAL 10
+#define BC_RADIO_SURVEY_BUSY_THRESHOLD -100.0f
+
+// Gateway puts header, new channel and time remaining to switch in front of beacons and acknowledgements,
+// announcement lasts over several report periods of typical remote so that sleeping ones hear it too
+#define BC_RADIO_CHANNEL_ANNOUNCE_LENGTH 6
+#define BC_RADIO_CHANNEL_ANNOUNCE_TIME 300000
+
+#define BC_RADIO_TDMA_BEACON_HEADER_LENGTH 18
+#define BC_RADIO_TDMA_BEACON_ENTRY_LENGTH 6
+#define BC_RADIO_TDMA_BEACON_ENTRIES 6
+#define BC_RADIO_TDMA_BEACON_MAX_LENGTH (BC_RADIO_CHANNEL_ANNOUNCE_LENGTH + BC_RADIO_BULK_NOTICE_LENGTH + BC_RADIO_TDMA_BEACON_HEADER_LENGTH + BC_RADIO_TDMA_BEACON_ENTRIES * BC_RADIO_TDMA_BEACON_ENTRY_LENGTH)
 
 typedef enum
 {
@@ -17,7 +122,22 @@ typedef enum
     BC_RADIO_HEADER_PUB_LUX_METER,
     BC_RADIO_HEADER_PUB_BAROMETER,
     BC_RADIO_HEADER_PUB_CO2,
-    BC_RADIO_HEADER_PUB_BUFFER
+    BC_RADIO_HEADER_PUB_BUFFER,
+    BC_RADIO_HEADER_BEACON,
+    BC_RADIO_HEADER_PUB_BUNDLE,
+    BC_RADIO_HEADER_RELAY,
+    BC_RADIO_HEADER_FRAGMENT,
+    BC_RADIO_HEADER_FRAGMENT_NACK,
+    BC_RADIO_HEADER_PUB_ALARM,
+    BC_RADIO_HEADER_ACK_REQUEST,
+    BC_RADIO_HEADER_ACK,
+    BC_RADIO_HEADER_PUB_REPLAY,
+    BC_RADIO_HEADER_CHANNEL,
+    BC_RADIO_HEADER_BULK_OPEN,
+    BC_RADIO_HEADER_BULK_DATA,
+    BC_RADIO_HEADER_BULK_ACK,
+    BC_RADIO_HEADER_BULK_NOTICE,
+    BC_RADIO_HEADER_TDMA_REQUEST
 
 } bc_radio_header_t;
 
@@ -29,34 +149,340 @@ typedef enum
 
 } bc_radio_state_t;
 
+_Static_assert(BC_RADIO_MAX_PEERS * sizeof(uint32_t) <= BC_RADIO_EEPROM_PEER_SIZE, "Peer table does not fit its EEPROM area");
+_Static_assert(BC_RADIO_LOG_RECORD_COUNT * BC_RADIO_LOG_RECORD_SIZE <= BC_RADIO_EEPROM_LOG_SIZE, "Log does not fit its EEPROM area");
+_Static_assert(BC_RADIO_EEPROM_PEER_DEVICE_ADDRESS + BC_RADIO_EEPROM_PEER_SIZE <= BC_RADIO_EEPROM_LOG, "EEPROM areas overlap");
+_Static_assert(BC_RADIO_EEPROM_LOG + BC_RADIO_EEPROM_LOG_SIZE <= BC_RADIO_EEPROM_PROFILE, "EEPROM areas overlap");
+_Static_assert(BC_RADIO_EEPROM_PROFILE + BC_RADIO_PROFILE_RECORD_SIZE <= BC_EEPROM_SIZE, "Radio records do not fit EEPROM");
+
+// Members are ordered by size so that gateway table of hundreds of peers has no padding
+typedef struct
+{
+    uint32_t device_address;
+    uint32_t message_id_window;
+
+    // Log records of peer which were already replayed
+    uint32_t replay_window;
+    uint16_t replay_sequence;
+
+    uint16_t message_id;
+
+    // TDMA slot given to peer by gateway, 0 is none
+    uint16_t slot;
+
+    bool message_id_synced;
+    bool replay_synced;
+
+} bc_radio_peer_t;
+
 static struct
 {
     bc_radio_state_t state;
     uint32_t device_address;
     uint16_t message_id;
     int transmit_count;
+    bool on_air;
+    bool tx_urgent;
+    bool preemption;
     void (*event_handler)(bc_radio_event_t, void *);
     void *event_param;
     bc_scheduler_task_id_t task_id;
     bool enroll_to_gateway;
     bool enrollment_mode;
+    bool pub_replace_latest;
 
     bc_queue_t pub_queue;
     bc_queue_t rx_queue;
-    uint8_t pub_queue_buffer[128];
-    uint8_t rx_queue_buffer[128];
+    bc_queue_t urgent_queue;
+    uint8_t pub_queue_buffer[256];
+    uint8_t rx_queue_buffer[256];
+    uint8_t urgent_queue_buffer[64];
 
-    bool peer_enrolled;
-    uint32_t peer_device_address;
-    uint16_t peer_message_id;
-    bool peer_message_id_synced;
+    bc_radio_peer_t peers[BC_RADIO_MAX_PEERS];
 
     bool listening;
 
+    bc_radio_stats_t stats;
+    uint32_t stats_rx_discarded;
+    uint32_t stats_rx_dropped;
+    uint32_t stats_rx_rejected;
+    uint32_t stats_rx_crc_error;
+    uint32_t stats_wake_up_count;
+
+    struct
+    {
+        bool enabled;
+        bc_queue_t queue;
+        uint8_t queue_buffer[256];
+        bc_tick_t tick;
+
+        struct
+        {
+            uint32_t device_address;
+            uint16_t message_id;
+
+        } seen[BC_RADIO_RELAY_SEEN_COUNT];
+
+        size_t seen_index;
+
+    } relay;
+
+    struct
+    {
+        bool active;
+        bool waiting;
+        uint8_t id;
+        uint8_t count;
+        uint32_t pending;
+        int retries;
+        bc_tick_t wait_end;
+        size_t length;
+        uint8_t buffer[BC_RADIO_BUFFER_MAX_SIZE];
+
+    } fragment_tx;
+
+    struct
+    {
+        bool active;
+        bool complete;
+        uint32_t device_address;
+        uint8_t id;
+        uint8_t count;
+        uint32_t received;
+        bc_tick_t tick;
+        bool nack;
+        bc_tick_t nack_tick;
+        size_t length;
+        uint8_t buffer[BC_RADIO_BUFFER_MAX_SIZE];
+
+    } fragment_rx;
+
+    struct
+    {
+        bool pending;
+        bool waiting;
+        uint16_t message_id;
+        bc_tick_t wait_end;
+        size_t length;
+        uint8_t buffer[BC_SPIRIT1_MAX_PACKET_SIZE];
+
+    } ack_tx;
+
+    struct
+    {
+        size_t count;
+        bc_tick_t tick;
+
+        struct
+        {
+            uint32_t device_address;
+            uint16_t message_id;
+
+        } entries[BC_RADIO_ACK_MAX_ENTRIES];
+
+    } ack_rx;
+
+    struct
+    {
+        bool active;
+        bool open;
+        bool poll;
+        bool request;
+        bool waiting;
+        uint8_t session;
+        uint32_t device_address;
+        uint32_t length;
+        uint16_t count;
+
+        // Receiver which sleeps is told about transfer before frames are sent and again once it stops answering
+        bool notice;
+        bool noticed;
+        bc_tick_t start;
+
+        // First unacknowledged frame, next new frame, frames after first one acknowledged and lost
+        uint16_t base;
+        uint16_t next;
+        uint32_t acknowledged;
+        uint32_t resend;
+
+        int retries;
+        bc_tick_t tick;
+        bc_tick_t wait_end;
+        bool (*read)(uint32_t, void *, size_t, void *);
+        void *param;
+        bc_radio_bulk_type_t type;
+
+    } bulk_tx;
+
+    struct
+    {
+        bool active;
+        bool complete;
+        uint32_t device_address;
+        uint8_t session;
+        bc_radio_bulk_type_t type;
+        uint32_t length;
+        uint16_t count;
+
+        // Frames from cumulative one on which were received, bit 0 is cumulative frame
+        uint16_t cumulative;
+        uint32_t received;
+        bc_tick_t tick;
+
+        bool ack;
+        bc_tick_t ack_tick;
+        uint32_t ack_device_address;
+        uint8_t ack_session;
+        uint8_t ack_status;
+
+        bool listen;
+        bc_tick_t listen_end;
+
+        uint32_t sink_address;
+        uint32_t sink_size;
+
+    } bulk_rx;
+
+    struct
+    {
+        bool enabled;
+
+        // Gateway acknowledged last frame, backlog can be replayed
+        bool link;
+
+        // Sequence numbers of next record, oldest record and next record to replay
+        uint16_t head;
+        uint16_t tail;
+        uint16_t replay;
+
+        // Log time continues over restarts, it is tick plus offset
+        uint32_t clock_offset;
+        bc_tick_t replay_tick;
+        uint32_t valid[(BC_RADIO_LOG_RECORD_COUNT + 31) / 32];
+
+    } log;
+
+    struct
+    {
+        bool active;
+        bool apply;
+        size_t index;
+        bc_tick_t dwell;
+        bc_tick_t channel_end;
+        float rssi_sum;
+        bc_radio_survey_t result;
+
+    } survey;
+
+    // Switch to other channel agreed with gateway
+    struct
+    {
+        bool pending;
+        uint8_t channel;
+        bc_tick_t tick;
+
+    } channel;
+
+    struct
+    {
+        bc_tick_t superframe;
+        bc_tick_t slot_length;
+
+        // Gateway side
+        bool beacon;
+        bc_tick_t epoch;
+        bc_tick_t beacon_tick;
+        size_t grant_count;
+        bc_tick_t grant_tick;
+        uint32_t grant[BC_RADIO_TDMA_BEACON_ENTRIES];
+
+        // Node side
+        bool joined;
+        bool synced;
+        bool gateway_known;
+        uint32_t gateway_address;
+        uint16_t slot;
+        int missed;
+        bc_tick_t request_backoff;
+
+        bool window;
+        bc_tick_t window_tick;
+        bc_tick_t window_length;
+        bc_tick_t window_end;
+
+        bool sync_valid;
+        bc_tick_t sync_local;
+        int64_t sync_remote;
+        bc_tick_t anchor_local;
+        int64_t anchor_remote;
+        int64_t remote_epoch;
+        int32_t drift_ppm;
+
+    } tdma;
+
 } _bc_radio;
 
 static void _bc_radio_task(void *param);
 static void _bc_radio_spirit1_event_handler(bc_spirit1_event_t event, void *event_param);
+static void _bc_radio_dispatch(uint32_t *peer_device_address, uint8_t *buffer, size_t length);
+static size_t _bc_radio_item_min_length(uint8_t header);
+static size_t _bc_radio_begin_frame(uint8_t *buffer);
+static void _bc_radio_transmit(size_t length, int transmit_count);
+static bool _bc_radio_pub_queue_put(const void *buffer, size_t length, size_t key_length, bc_radio_priority_t priority);
+static void _bc_radio_update_high_water(void);
+static bc_radio_peer_t *_bc_radio_get_peer(uint32_t device_address);
+static bc_radio_peer_t *_bc_radio_add_peer(uint32_t device_address);
+static void _bc_radio_receive(uint32_t device_address, uint16_t message_id, uint8_t *payload, size_t length, uint8_t hops);
+static bool _bc_radio_peer_is_duplicate(bc_radio_peer_t *peer, uint16_t message_id);
+static bool _bc_radio_peer_has_received(bc_radio_peer_t *peer, uint16_t message_id);
+static bool _bc_radio_window_is_duplicate(uint16_t *last, uint32_t *window, bool *synced, uint16_t number);
+static void _bc_radio_relay_forward(uint32_t device_address, uint16_t message_id, uint8_t *payload, size_t length, uint8_t hops);
+static void _bc_radio_relay_transmit(void);
+static void _bc_radio_fragment_feed(void);
+static void _bc_radio_fragment_receive(uint32_t device_address, uint8_t *buffer, size_t length);
+static void _bc_radio_fragment_send_nack(void);
+static void _bc_radio_fragment_on_nack(uint8_t id, uint32_t missing);
+static void _bc_radio_fragment_on_timeout(void);
+static uint8_t *_bc_radio_next_item(uint8_t *payload, size_t length, size_t *offset, size_t *item_length);
+static size_t _bc_radio_ack_request(uint8_t *buffer, size_t length, uint8_t header, size_t payload_length);
+static void _bc_radio_ack_queue(uint32_t device_address, uint16_t message_id);
+static void _bc_radio_ack_send(void);
+static void _bc_radio_ack_on_ack(uint8_t *buffer, size_t length);
+static void _bc_radio_ack_on_timeout(void);
+static bool _bc_radio_bulk_feed(bc_tick_t now, bc_tick_t *next);
+static void _bc_radio_bulk_finish(bool success);
+static void _bc_radio_bulk_receive(uint32_t device_address, uint8_t *payload, size_t length);
+static void _bc_radio_bulk_on_data(uint8_t *payload, size_t length);
+static void _bc_radio_bulk_on_ack(uint8_t *payload);
+static void _bc_radio_bulk_send_ack(void);
+static size_t _bc_radio_bulk_notice(uint8_t *buffer, size_t length);
+static void _bc_radio_bulk_on_notice(uint32_t device_address, uint8_t *buffer);
+static void _bc_radio_bulk_listen(void);
+static void _bc_radio_profile_load(void);
+static void _bc_radio_survey_feed(void);
+static void _bc_radio_survey_finish(void);
+static size_t _bc_radio_channel_announce(uint8_t *buffer, size_t length);
+static void _bc_radio_channel_on_announce(uint32_t device_address, uint8_t *buffer);
+static void _bc_radio_channel_switch(void);
+static void _bc_radio_log_recover(void);
+static void _bc_radio_log_append(const uint8_t *item, size_t length, uint32_t time, uint16_t message_id);
+static void _bc_radio_log_invalidate(uint16_t sequence);
+static bool _bc_radio_log_is_valid(uint16_t sequence);
+static void _bc_radio_log_feed(bc_tick_t now, bc_tick_t *next);
+static uint32_t _bc_radio_log_time(void);
+static void _bc_radio_rx_resume(void);
+static void _bc_radio_tdma_send_beacon(bc_tick_t now);
+static void _bc_radio_tdma_on_beacon(uint32_t device_address, uint8_t *buffer, size_t length);
+static void _bc_radio_tdma_on_window_timeout(void);
+static void _bc_radio_tdma_on_request(uint32_t device_address);
+static void _bc_radio_tdma_send_request(void);
+static void _bc_radio_tdma_plan_request(bc_tick_t now);
+static void _bc_radio_tdma_open_window(bc_tick_t now);
+static void _bc_radio_tdma_plan_window(int64_t remote_due);
+static bool _bc_radio_tdma_transmit_in_slot(bc_tick_t now, bc_tick_t *next);
+static int64_t _bc_radio_tdma_to_remote(bc_tick_t local);
+static uint16_t _bc_radio_tdma_free_slot(void);
+static bc_tick_t _bc_radio_tdma_to_local(int64_t remote);
 
 __attribute__((weak)) void bc_radio_on_push_button(uint32_t *peer_device_address, uint16_t *event_count) { (void) peer_device_address; (void) event_count; }
 __attribute__((weak)) void bc_radio_on_thermometer(uint32_t *peer_device_address, uint8_t *i2c, float *temperature) { (void) peer_device_address; (void) i2c; (void) temperature; }
@@ -65,6 +491,9 @@ __attribute__((weak)) void bc_radio_on_lux_meter(uint32_t *peer_device_address,
 __attribute__((weak)) void bc_radio_on_barometer(uint32_t *peer_device_address, uint8_t *i2c, float *pressure, float *altitude) { (void) peer_device_address; (void) i2c; (void) pressure; (void) altitude; }
 __attribute__((weak)) void bc_radio_on_co2(uint32_t *peer_device_address, float *concentration) { (void) peer_device_address; (void) concentration; }
 __attribute__((weak)) void bc_radio_on_buffer(uint32_t *peer_device_address, void *buffer, size_t *length) { (void) peer_device_address; (void) buffer; (void) length; }
+__attribute__((weak)) void bc_radio_on_alarm(uint32_t *peer_device_address, bc_radio_alarm_t *alarm, bool *active, float *value) { (void) peer_device_address; (void) alarm; (void) active; (void) value; }
+__attribute__((weak)) void bc_radio_on_replay(uint32_t *peer_device_address, uint32_t *age) { (void) peer_device_address; (void) age; }
+__attribute__((weak)) void bc_radio_on_bulk(uint32_t *peer_device_address, uint32_t *offset, void *buffer, size_t *length) { (void) peer_device_address; (void) offset; (void) buffer; (void) length; }
 
 
 void bc_radio_init(void)
@@ -73,13 +502,29 @@ void bc_radio_init(void)
 
     bc_queue_init(&_bc_radio.pub_queue, _bc_radio.pub_queue_buffer, sizeof(_bc_radio.pub_queue_buffer));
     bc_queue_init(&_bc_radio.rx_queue, _bc_radio.rx_queue_buffer, sizeof(_bc_radio.rx_queue_buffer));
+    bc_queue_init(&_bc_radio.urgent_queue, _bc_radio.urgent_queue_buffer, sizeof(_bc_radio.urgent_queue_buffer));
+    bc_queue_init(&_bc_radio.relay.queue, _bc_radio.relay.queue_buffer, sizeof(_bc_radio.relay.queue_buffer));
 
     bc_device_id_get(&_bc_radio.device_address, sizeof(_bc_radio.device_address));
 
     bc_spirit1_init();
     bc_spirit1_set_event_handler(_bc_radio_spirit1_event_handler, NULL);
+    bc_spirit1_set_address(BC_RADIO_NETWORK_ADDRESS);
+
+    _bc_radio_profile_load();
+
+    for (size_t i = 0; i < BC_RADIO_MAX_PEERS; i++)
+    {
+        uint32_t address = BC_RADIO_EEPROM_PEER_DEVICE_ADDRESS + i * sizeof(_bc_radio.peers[i].device_address);
+
+        bc_eeprom_read(address, &_bc_radio.peers[i].device_address, sizeof(_bc_radio.peers[i].device_address));
 
-    bc_eeprom_read(BC_RADIO_EEPROM_PEER_DEVICE_ADDRESS, &_bc_radio.peer_device_address, sizeof(_bc_radio.peer_device_address));
+        // Erased entry
+        if (_bc_radio.peers[i].device_address == 0xffffffff)
+        {
+            _bc_radio.peers[i].device_address = 0;
+        }
+    }
 
     _bc_radio.task_id = bc_scheduler_register(_bc_radio_task, NULL, BC_TICK_INFINITY);
 }
@@ -104,6 +549,112 @@ void bc_radio_sleep(void)
     bc_scheduler_plan_now(_bc_radio.task_id);
 }
 
+void bc_radio_set_network(uint8_t address)
+{
+    bc_spirit1_set_address(address);
+}
+
+bool bc_radio_set_profile(const bc_spirit1_profile_t *profile)
+{
+    if (!bc_spirit1_set_profile(profile))
+    {
+        return false;
+    }
+
+    uint8_t record[BC_RADIO_PROFILE_RECORD_SIZE];
+
+    record[0] = profile->channel;
+    record[1] = profile->datarate;
+    record[2] = profile->fec;
+    record[3] = (uint8_t) profile->power;
+
+    // Same check as log record, erased EEPROM fails it
+    record[4] = 0xa5 ^ record[0] ^ record[1] ^ record[2] ^ record[3];
+
+    return bc_eeprom_write(BC_RADIO_EEPROM_PROFILE, record, sizeof(record));
+}
+
+void bc_radio_get_profile(bc_spirit1_profile_t *profile)
+{
+    bc_spirit1_get_profile(profile);
+}
+
+bool bc_radio_survey_start(uint8_t first, uint8_t last, bc_tick_t dwell, bool apply)
+{
+    if (_bc_radio.survey.active || _bc_radio.channel.pending || last < first || last - first >= BC_RADIO_SURVEY_MAX_CHANNELS || dwell == 0)
+    {
+        return false;
+    }
+
+    memset(&_bc_radio.survey, 0, sizeof(_bc_radio.survey));
+
+    _bc_radio.survey.active = true;
+    _bc_radio.survey.apply = apply;
+    _bc_radio.survey.dwell = dwell;
+    _bc_radio.survey.channel_end = bc_tick_get() + dwell;
+    _bc_radio.survey.result.count = last - first + 1;
+
+    for (size_t i = 0; i < _bc_radio.survey.result.count; i++)
+    {
+        _bc_radio.survey.result.channels[i].channel = first + i;
+    }
+
+    // Frame on air is finished first, radio goes to sleep after it
+    if (!_bc_radio.on_air)
+    {
+        _bc_radio_rx_resume();
+    }
+
+    bc_scheduler_plan_now(_bc_radio.task_id);
+
+    return true;
+}
+
+void bc_radio_get_survey(bc_radio_survey_t *survey)
+{
+    *survey = _bc_radio.survey.result;
+}
+
+bool bc_radio_bulk_send(uint32_t device_address, bc_radio_bulk_type_t type, uint32_t length, bool (*read)(uint32_t offset, void *buffer, size_t length, void *param), void *param)
+{
+    uint32_t count = (length + BC_RADIO_BULK_DATA_SIZE - 1) / BC_RADIO_BULK_DATA_SIZE;
+
+    if (_bc_radio.bulk_tx.active || length == 0 || count > UINT16_MAX || read == NULL)
+    {
+        return false;
+    }
+
+    uint8_t session = _bc_radio.bulk_tx.session;
+
+    memset(&_bc_radio.bulk_tx, 0, sizeof(_bc_radio.bulk_tx));
+
+    // Session differs from previous one so that its late frames are not mixed in
+    _bc_radio.bulk_tx.session = session + 1;
+    _bc_radio.bulk_tx.active = true;
+    _bc_radio.bulk_tx.device_address = device_address;
+    _bc_radio.bulk_tx.type = type;
+    _bc_radio.bulk_tx.start = bc_tick_get();
+    _bc_radio.bulk_tx.length = length;
+    _bc_radio.bulk_tx.count = count;
+    _bc_radio.bulk_tx.read = read;
+    _bc_radio.bulk_tx.param = param;
+
+    bc_scheduler_plan_now(_bc_radio.task_id);
+
+    return true;
+}
+
+bc_radio_bulk_type_t bc_radio_bulk_get_type(void)
+{
+    return _bc_radio.bulk_rx.type;
+}
+
+void bc_radio_bulk_set_sink(uint32_t address, uint32_t size)
+{
+    _bc_radio.bulk_rx.sink_address = address;
+    _bc_radio.bulk_rx.sink_size = size;
+}
+
 void bc_radio_enroll_to_gateway(void)
 {
     _bc_radio.enroll_to_gateway = true;
@@ -121,41 +672,181 @@ void bc_radio_enrollment_stop(void)
     _bc_radio.enrollment_mode = false;
 }
 
-bool bc_radio_pub_push_button(uint16_t *event_count)
+void bc_radio_relay_start(void)
 {
-    uint8_t buffer[1 + sizeof(*event_count)];
+    _bc_radio.relay.enabled = true;
 
-    buffer[0] = BC_RADIO_HEADER_PUB_PUSH_BUTTON;
+    bc_radio_listen();
+}
 
-    memcpy(&buffer[1], event_count, sizeof(*event_count));
+void bc_radio_relay_stop(void)
+{
+    _bc_radio.relay.enabled = false;
+}
 
-    if (!bc_queue_put(&_bc_radio.pub_queue, buffer, sizeof(buffer)))
+bool bc_radio_tdma_start(bc_tick_t superframe, bc_tick_t slot_length)
+{
+    // Superframe and slot length are sent in beacon as 16-bit values
+    if (superframe > UINT16_MAX || slot_length == 0 || slot_length > superframe)
     {
         return false;
     }
 
+    _bc_radio.tdma.superframe = superframe;
+    _bc_radio.tdma.slot_length = slot_length;
+    _bc_radio.tdma.beacon = true;
+    _bc_radio.tdma.epoch = bc_tick_get();
+    _bc_radio.tdma.beacon_tick = _bc_radio.tdma.epoch;
+    _bc_radio.tdma.grant_count = 0;
+
+    // Slots are given in order of peer table, which holds peers in order of enrollment, so they stay the same over restarts
+    size_t slot_count = superframe / slot_length;
+    uint16_t slot = 0;
+    bool all = true;
+
+    for (size_t i = 0; i < BC_RADIO_MAX_PEERS; i++)
+    {
+        _bc_radio.peers[i].slot = 0;
+
+        if (_bc_radio.peers[i].device_address == 0)
+        {
+            continue;
+        }
+
+        // Slot 0 belongs to beacon
+        if ((size_t) slot + 1 < slot_count)
+        {
+            _bc_radio.peers[i].slot = ++slot;
+        }
+        else
+        {
+            all = false;
+        }
+    }
+
     bc_scheduler_plan_now(_bc_radio.task_id);
 
-    return true;
+    return all;
 }
 
-bool bc_radio_pub_thermometer(uint8_t i2c, float *temperature)
+void bc_radio_tdma_stop(void)
 {
-    uint8_t buffer[2 + sizeof(*temperature)];
+    _bc_radio.tdma.beacon = false;
+}
 
-    buffer[0] = BC_RADIO_HEADER_PUB_THERMOMETER;
-    buffer[1] = i2c;
+void bc_radio_tdma_join(void)
+{
+    memset(&_bc_radio.tdma, 0, sizeof(_bc_radio.tdma));
 
-    memcpy(&buffer[2], temperature, sizeof(*temperature));
+    _bc_radio.tdma.joined = true;
+    _bc_radio.tdma.request_backoff = BC_RADIO_TDMA_REQUEST_BACKOFF;
+
+    _bc_radio_tdma_plan_request(bc_tick_get());
+
+    bc_scheduler_plan_now(_bc_radio.task_id);
+}
 
-    if (!bc_queue_put(&_bc_radio.pub_queue, buffer, sizeof(buffer)))
+void bc_radio_tdma_leave(void)
+{
+    bool window = _bc_radio.tdma.window;
+
+    memset(&_bc_radio.tdma, 0, sizeof(_bc_radio.tdma));
+
+    if (window)
     {
-        return false;
+        _bc_radio_rx_resume();
     }
 
     bc_scheduler_plan_now(_bc_radio.task_id);
+}
 
-    return true;
+bool bc_radio_tdma_is_synced(void)
+{
+    return _bc_radio.tdma.synced;
+}
+
+void bc_radio_get_stats(bc_radio_stats_t *stats)
+{
+    *stats = _bc_radio.stats;
+
+    // Driver counters run freely, only difference since reset is reported
+    stats->rx_discarded = bc_spirit1_get_rx_discarded() - _bc_radio.stats_rx_discarded;
+    stats->rx_dropped = bc_spirit1_get_rx_dropped() - _bc_radio.stats_rx_dropped;
+    stats->rx_rejected = bc_spirit1_get_rx_rejected() - _bc_radio.stats_rx_rejected;
+    stats->rx_crc_error = bc_spirit1_get_rx_crc_error() - _bc_radio.stats_rx_crc_error;
+    stats->wake_up_count = bc_spirit1_get_wake_up_count() - _bc_radio.stats_wake_up_count;
+    stats->wake_up_time = bc_spirit1_get_wake_up_time();
+    stats->rx_rearm_time[0] = bc_spirit1_get_rx_rearm_time(false);
+    stats->rx_rearm_time[1] = bc_spirit1_get_rx_rearm_time(true);
+
+    stats->log_length = (uint16_t) (_bc_radio.log.head - _bc_radio.log.tail);
+
+    stats->tdma_unslotted = 0;
+
+    for (size_t i = 0; _bc_radio.tdma.beacon && i < BC_RADIO_MAX_PEERS; i++)
+    {
+        if (_bc_radio.peers[i].device_address != 0 && _bc_radio.peers[i].slot == 0)
+        {
+            stats->tdma_unslotted++;
+        }
+    }
+}
+
+void bc_radio_reset_stats(void)
+{
+    memset(&_bc_radio.stats, 0, sizeof(_bc_radio.stats));
+
+    _bc_radio.stats_rx_discarded = bc_spirit1_get_rx_discarded();
+    _bc_radio.stats_rx_dropped = bc_spirit1_get_rx_dropped();
+    _bc_radio.stats_rx_rejected = bc_spirit1_get_rx_rejected();
+    _bc_radio.stats_rx_crc_error = bc_spirit1_get_rx_crc_error();
+    _bc_radio.stats_wake_up_count = bc_spirit1_get_wake_up_count();
+
+    bc_spirit1_reset_rx_rearm_time();
+}
+
+void bc_radio_set_pub_replace_latest(bool enable)
+{
+    _bc_radio.pub_replace_latest = enable;
+}
+
+void bc_radio_set_preemption(bool enable)
+{
+    _bc_radio.preemption = enable;
+}
+
+void bc_radio_set_store_and_forward(bool enable)
+{
+    if (enable && !_bc_radio.log.enabled)
+    {
+        _bc_radio_log_recover();
+    }
+
+    _bc_radio.log.enabled = enable;
+}
+
+bool bc_radio_pub_push_button(uint16_t *event_count)
+{
+    uint8_t buffer[1 + sizeof(*event_count)];
+
+    buffer[0] = BC_RADIO_HEADER_PUB_PUSH_BUTTON;
+
+    memcpy(&buffer[1], event_count, sizeof(*event_count));
+
+    // Every event counts, never replaced, and user waits for it
+    return _bc_radio_pub_queue_put(buffer, sizeof(buffer), 0, BC_RADIO_PRIORITY_HIGH);
+}
+
+bool bc_radio_pub_thermometer(uint8_t i2c, float *temperature)
+{
+    uint8_t buffer[2 + sizeof(*temperature)];
+
+    buffer[0] = BC_RADIO_HEADER_PUB_THERMOMETER;
+    buffer[1] = i2c;
+
+    memcpy(&buffer[2], temperature, sizeof(*temperature));
+
+    return _bc_radio_pub_queue_put(buffer, sizeof(buffer), 2, BC_RADIO_PRIORITY_NORMAL);
 }
 
 bool bc_radio_pub_humidity(uint8_t i2c, float *percentage)
@@ -167,14 +858,7 @@ bool bc_radio_pub_humidity(uint8_t i2c, float *percentage)
 
     memcpy(&buffer[2], percentage, sizeof(*percentage));
 
-    if (!bc_queue_put(&_bc_radio.pub_queue, buffer, sizeof(buffer)))
-    {
-        return false;
-    }
-
-    bc_scheduler_plan_now(_bc_radio.task_id);
-
-    return true;
+    return _bc_radio_pub_queue_put(buffer, sizeof(buffer), 2, BC_RADIO_PRIORITY_NORMAL);
 }
 
 bool bc_radio_pub_luminosity(uint8_t i2c, float *lux)
@@ -186,14 +870,7 @@ bool bc_radio_pub_luminosity(uint8_t i2c, float *lux)
 
     memcpy(&buffer[2], lux, sizeof(*lux));
 
-    if (!bc_queue_put(&_bc_radio.pub_queue, buffer, sizeof(buffer)))
-    {
-        return false;
-    }
-
-    bc_scheduler_plan_now(_bc_radio.task_id);
-
-    return true;
+    return _bc_radio_pub_queue_put(buffer, sizeof(buffer), 2, BC_RADIO_PRIORITY_NORMAL);
 }
 
 bool bc_radio_pub_barometer(uint8_t i2c, float *pascal, float *meter)
@@ -206,14 +883,7 @@ bool bc_radio_pub_barometer(uint8_t i2c, float *pascal, float *meter)
     memcpy(&buffer[2], pascal, sizeof(*pascal));
     memcpy(&buffer[2 + sizeof(*pascal)], meter, sizeof(*meter));
 
-    if (!bc_queue_put(&_bc_radio.pub_queue, buffer, sizeof(buffer)))
-    {
-        return false;
-    }
-
-    bc_scheduler_plan_now(_bc_radio.task_id);
-
-    return true;
+    return _bc_radio_pub_queue_put(buffer, sizeof(buffer), 2, BC_RADIO_PRIORITY_NORMAL);
 }
 
 bool bc_radio_pub_co2(float *concentration)
@@ -224,38 +894,56 @@ bool bc_radio_pub_co2(float *concentration)
 
     memcpy(&buffer[1], concentration, sizeof(*concentration));
 
-    if (!bc_queue_put(&_bc_radio.pub_queue, buffer, sizeof(buffer)))
-    {
-        return false;
-    }
+    return _bc_radio_pub_queue_put(buffer, sizeof(buffer), 1, BC_RADIO_PRIORITY_NORMAL);
+}
 
-    bc_scheduler_plan_now(_bc_radio.task_id);
+bool bc_radio_pub_alarm(bc_radio_alarm_t alarm, bool active, float *value)
+{
+    uint8_t buffer[3 + sizeof(*value)];
 
-    return true;
+    buffer[0] = BC_RADIO_HEADER_PUB_ALARM;
+    buffer[1] = alarm;
+    buffer[2] = active;
+
+    memcpy(&buffer[3], value, sizeof(*value));
+
+    return _bc_radio_pub_queue_put(buffer, sizeof(buffer), 0, BC_RADIO_PRIORITY_HIGH);
 }
 
 bool bc_radio_pub_buffer(void *buffer, size_t length)
 {
-    uint8_t qbuffer[1 + BC_SPIRIT1_MAX_PACKET_SIZE - 6];
+    uint8_t qbuffer[BC_SPIRIT1_MAX_PACKET_SIZE - 6];
 
-    if (length > (1 + BC_SPIRIT1_MAX_PACKET_SIZE - 6))
+    if (length > sizeof(qbuffer) - 1)
     {
-        return false;
-    }
+        // Payload is split into fragments, only one fragmented transfer can run at a time
+        if (length > BC_RADIO_BUFFER_MAX_SIZE || _bc_radio.fragment_tx.active)
+        {
+            _bc_radio.stats.pub_queue_overflow++;
 
-    qbuffer[0] = BC_RADIO_HEADER_PUB_BUFFER;
+            return false;
+        }
 
-    memcpy(&qbuffer[1], buffer, length);
+        _bc_radio.fragment_tx.active = true;
+        _bc_radio.fragment_tx.waiting = false;
+        _bc_radio.fragment_tx.id++;
+        _bc_radio.fragment_tx.count = (length + BC_RADIO_FRAGMENT_DATA_SIZE - 1) / BC_RADIO_FRAGMENT_DATA_SIZE;
+        _bc_radio.fragment_tx.pending = _bc_radio.fragment_tx.count == 32 ? 0xffffffff : ((uint32_t) 1 << _bc_radio.fragment_tx.count) - 1;
+        _bc_radio.fragment_tx.retries = 0;
+        _bc_radio.fragment_tx.length = length;
 
-    if (!bc_queue_put(&_bc_radio.pub_queue, qbuffer, length + 1))
-    {
-        return false;
+        memcpy(_bc_radio.fragment_tx.buffer, buffer, length);
+
+        bc_scheduler_plan_now(_bc_radio.task_id);
+
+        return true;
     }
 
-    bc_scheduler_plan_now(_bc_radio.task_id);
+    qbuffer[0] = BC_RADIO_HEADER_PUB_BUFFER;
 
-    return true;
+    memcpy(&qbuffer[1], buffer, length);
 
+    return _bc_radio_pub_queue_put(qbuffer, length + 1, 0, BC_RADIO_PRIORITY_NORMAL);
 }
 
 static void _bc_radio_task(void *param)
@@ -264,8 +952,26 @@ static void _bc_radio_task(void *param)
 
     if (_bc_radio.state == BC_RADIO_STATE_TX)
     {
+        // Frame is still on air, task is planned again when it is sent
+        if (_bc_radio.on_air)
+        {
+            return;
+        }
+
+        // Urgent frame cuts repetitions of normal frame short
+        if (_bc_radio.transmit_count != 0 && _bc_radio.preemption && !_bc_radio.tx_urgent && !bc_queue_is_empty(&_bc_radio.urgent_queue))
+        {
+            _bc_radio.stats.preempted++;
+
+            _bc_radio.transmit_count = 0;
+        }
+
         if (_bc_radio.transmit_count != 0)
         {
+            _bc_radio.stats.retransmitted++;
+
+            _bc_radio.on_air = true;
+
             bc_spirit1_tx();
 
             return;
@@ -274,116 +980,233 @@ static void _bc_radio_task(void *param)
         _bc_radio.state = BC_RADIO_STATE_SLEEP;
     }
 
-    if (_bc_radio.enroll_to_gateway)
-    {
-        _bc_radio.enroll_to_gateway = false;
+    uint8_t queue_item_buffer[sizeof(uint32_t) + BC_SPIRIT1_MAX_PACKET_SIZE - 6];
+    size_t queue_item_length;
+
+    while (bc_queue_get(&_bc_radio.rx_queue, queue_item_buffer, &queue_item_length))
+    {
+        uint32_t peer_device_address;
+
+        memcpy(&peer_device_address, queue_item_buffer, sizeof(peer_device_address));
+
+        _bc_radio_dispatch(&peer_device_address, &queue_item_buffer[sizeof(peer_device_address)], queue_item_length - sizeof(peer_device_address));
+    }
 
+    // Nothing is sent during survey, queued frames wait until it ends
+    if (_bc_radio.survey.active)
+    {
+        _bc_radio_survey_feed();
+
+        return;
+    }
+
+    // Urgent frames go first and do not wait for TDMA slot
+    if (bc_queue_get(&_bc_radio.urgent_queue, queue_item_buffer, &queue_item_length))
+    {
         uint8_t *buffer = bc_spirit1_get_tx_buffer();
 
-        buffer[0] = _bc_radio.device_address;
-        buffer[1] = _bc_radio.device_address >> 8;
-        buffer[2] = _bc_radio.device_address >> 16;
-        buffer[3] = _bc_radio.device_address >> 24;
-        buffer[4] = _bc_radio.message_id;
-        buffer[5] = _bc_radio.message_id >> 8;
-        buffer[6] = BC_RADIO_HEADER_ENROLL;
+        size_t length = _bc_radio_begin_frame(buffer);
+
+        memcpy(buffer + length, queue_item_buffer, queue_item_length);
 
-        _bc_radio.message_id++;
+        // Repetitions outside of slot collide with frames of slot owners, so fewer are used with TDMA
+        _bc_radio_transmit(length + queue_item_length, _bc_radio.tdma.synced ? BC_RADIO_TDMA_URGENT_TRANSMIT_COUNT : BC_RADIO_TRANSMIT_COUNT);
 
-        bc_spirit1_set_tx_length(7);
+        _bc_radio.tx_urgent = true;
 
-        bc_spirit1_tx();
+        return;
+    }
 
-        _bc_radio.transmit_count = 10;
+    bc_tick_t now = bc_tick_get();
+    bc_tick_t next = BC_TICK_INFINITY;
 
-        _bc_radio.state = BC_RADIO_STATE_TX;
+    if (_bc_radio.channel.pending)
+    {
+        if (now >= _bc_radio.channel.tick)
+        {
+            _bc_radio_channel_switch();
+        }
+        else
+        {
+            next = _bc_radio.channel.tick;
+        }
     }
 
-    uint8_t queue_item_buffer[sizeof(_bc_radio.pub_queue_buffer)];
-    size_t queue_item_length;
+    // Window is extended by every repetition, frame is given up after the last one
+    if (_bc_radio.ack_tx.waiting)
+    {
+        if (now >= _bc_radio.ack_tx.wait_end)
+        {
+            _bc_radio_ack_on_timeout();
+        }
+        else
+        {
+            next = _bc_radio.ack_tx.wait_end;
+        }
+    }
 
-    while (bc_queue_get(&_bc_radio.rx_queue, queue_item_buffer, &queue_item_length))
+    if (_bc_radio.enroll_to_gateway)
+    {
+        _bc_radio.enroll_to_gateway = false;
+
+        uint8_t *buffer = bc_spirit1_get_tx_buffer();
+
+        size_t length = _bc_radio_begin_frame(buffer);
+
+        buffer[length++] = BC_RADIO_HEADER_ENROLL;
+
+        _bc_radio_transmit(length, BC_RADIO_TRANSMIT_COUNT);
+
+        return;
+    }
+
+    if (_bc_radio.tdma.beacon)
     {
-        if (queue_item_buffer[0] == BC_RADIO_HEADER_PUB_PUSH_BUTTON)
+        if (now >= _bc_radio.tdma.beacon_tick || (_bc_radio.tdma.grant_count != 0 && now >= _bc_radio.tdma.grant_tick))
         {
-            uint16_t event_count;
+            _bc_radio_tdma_send_beacon(now);
 
-            memcpy(&event_count, &queue_item_buffer[1], sizeof(event_count));
+            return;
+        }
 
-            bc_radio_on_push_button(&_bc_radio.peer_device_address, &event_count);
+        if (_bc_radio.tdma.beacon_tick < next)
+        {
+            next = _bc_radio.tdma.beacon_tick;
         }
-        else if (queue_item_buffer[0] == BC_RADIO_HEADER_PUB_THERMOMETER)
+
+        if (_bc_radio.tdma.grant_count != 0 && _bc_radio.tdma.grant_tick < next)
         {
-            float temperature;
+            next = _bc_radio.tdma.grant_tick;
+        }
+    }
 
-            memcpy(&temperature, &queue_item_buffer[2], sizeof(temperature));
+    if (_bc_radio.ack_rx.count != 0)
+    {
+        if (now >= _bc_radio.ack_rx.tick)
+        {
+            _bc_radio_ack_send();
 
-            bc_radio_on_thermometer(&_bc_radio.peer_device_address, &queue_item_buffer[1], &temperature);
+            return;
         }
-        else if (queue_item_buffer[0] == BC_RADIO_HEADER_PUB_HUMIDITY)
+
+        if (_bc_radio.ack_rx.tick < next)
         {
-            float percentage;
+            next = _bc_radio.ack_rx.tick;
+        }
+    }
 
-            memcpy(&percentage, &queue_item_buffer[2], sizeof(percentage));
+    if (_bc_radio.bulk_rx.ack)
+    {
+        if (now >= _bc_radio.bulk_rx.ack_tick)
+        {
+            _bc_radio_bulk_send_ack();
 
-            bc_radio_on_humidity(&_bc_radio.peer_device_address, &queue_item_buffer[1], &percentage);
+            return;
         }
-        else if (queue_item_buffer[0] == BC_RADIO_HEADER_PUB_LUX_METER)
+
+        if (_bc_radio.bulk_rx.ack_tick < next)
         {
-            float lux;
+            next = _bc_radio.bulk_rx.ack_tick;
+        }
+    }
 
-            memcpy(&lux, &queue_item_buffer[2], sizeof(lux));
+    if (_bc_radio.fragment_rx.nack)
+    {
+        if (now >= _bc_radio.fragment_rx.nack_tick)
+        {
+            _bc_radio_fragment_send_nack();
 
-            bc_radio_on_lux_meter(&_bc_radio.peer_device_address, &queue_item_buffer[1], &lux);
+            return;
         }
-        else if (queue_item_buffer[0] == BC_RADIO_HEADER_PUB_BAROMETER)
+
+        if (_bc_radio.fragment_rx.nack_tick < next)
         {
-            float pascal;
-            float meter;
+            next = _bc_radio.fragment_rx.nack_tick;
+        }
+    }
 
-            memcpy(&pascal, &queue_item_buffer[2], sizeof(pascal));
-            memcpy(&meter, &queue_item_buffer[2 + sizeof(pascal)], sizeof(meter));
+    if (!bc_queue_is_empty(&_bc_radio.relay.queue))
+    {
+        if (now >= _bc_radio.relay.tick)
+        {
+            _bc_radio_relay_transmit();
 
-            bc_radio_on_barometer(&_bc_radio.peer_device_address, &queue_item_buffer[1], &pascal, &meter);
+            return;
         }
-        else if (queue_item_buffer[0] == BC_RADIO_HEADER_PUB_CO2)
+
+        if (_bc_radio.relay.tick < next)
         {
-            float concentration;
+            next = _bc_radio.relay.tick;
+        }
+    }
 
-            memcpy(&concentration, &queue_item_buffer[1], sizeof(concentration));
+    if (_bc_radio.tdma.joined && !_bc_radio.tdma.window)
+    {
+        if (now >= _bc_radio.tdma.window_tick)
+        {
+            if (_bc_radio.tdma.synced)
+            {
+                _bc_radio_tdma_open_window(now);
+            }
+            // Request waits until answer to previous frame is received or given up
+            else if (!_bc_radio.ack_tx.waiting)
+            {
+                _bc_radio_tdma_send_request();
 
-            bc_radio_on_co2(&_bc_radio.peer_device_address, &concentration);
+                return;
+            }
         }
-        else if (queue_item_buffer[0] == BC_RADIO_HEADER_PUB_BUFFER)
+        else if (_bc_radio.tdma.window_tick < next)
         {
-            queue_item_length -= 1;
-            bc_radio_on_buffer(&_bc_radio.peer_device_address, &queue_item_buffer[1], &queue_item_length);
+            next = _bc_radio.tdma.window_tick;
         }
+    }
+
+    _bc_radio_fragment_feed();
+
+    _bc_radio_log_feed(now, &next);
 
+    // Bulk transfer does not wait for TDMA slot, it is meant for occasional dumps
+    if (_bc_radio_bulk_feed(now, &next))
+    {
+        return;
     }
 
-    if (bc_queue_get(&_bc_radio.pub_queue, queue_item_buffer, &queue_item_length))
+    if (_bc_radio.tdma.joined && _bc_radio.tdma.synced)
+    {
+        // Beacon windows are short, transmission waits for own slot after it
+        if (!_bc_radio.tdma.window && _bc_radio_tdma_transmit_in_slot(now, &next))
+        {
+            return;
+        }
+    }
+    else if (!_bc_radio.ack_tx.pending && !_bc_radio.bulk_tx.waiting && bc_queue_get(&_bc_radio.pub_queue, queue_item_buffer, &queue_item_length))
     {
         uint8_t *buffer = bc_spirit1_get_tx_buffer();
 
-        buffer[0] = _bc_radio.device_address;
-        buffer[1] = _bc_radio.device_address >> 8;
-        buffer[2] = _bc_radio.device_address >> 16;
-        buffer[3] = _bc_radio.device_address >> 24;
-        buffer[4] = _bc_radio.message_id;
-        buffer[5] = _bc_radio.message_id >> 8;
+        size_t length = _bc_radio_begin_frame(buffer);
 
-        _bc_radio.message_id++;
+        length = _bc_radio_ack_request(buffer, length, queue_item_buffer[0], queue_item_length);
 
-        memcpy(buffer + 6, queue_item_buffer, queue_item_length);
+        memcpy(buffer + length, queue_item_buffer, queue_item_length);
 
-        bc_spirit1_set_tx_length(6 + queue_item_length);
+        // Node waiting for slot shares channel with slot owners and with requests of other nodes
+        int transmit_count = _bc_radio.tdma.joined ? BC_RADIO_TDMA_URGENT_TRANSMIT_COUNT : BC_RADIO_TRANSMIT_COUNT;
 
-        bc_spirit1_tx();
+        // Lost fragments are recovered by selective retransmission instead of repetitions
+        if (queue_item_buffer[0] == BC_RADIO_HEADER_FRAGMENT)
+        {
+            transmit_count = BC_RADIO_FRAGMENT_TRANSMIT_COUNT;
+        }
+        // Replayed record stays in log until it is acknowledged
+        else if (queue_item_buffer[0] == BC_RADIO_HEADER_PUB_REPLAY)
+        {
+            transmit_count = BC_RADIO_LOG_REPLAY_TRANSMIT_COUNT;
+        }
 
-        _bc_radio.transmit_count = 10;
+        _bc_radio_transmit(length + queue_item_length, transmit_count);
 
-        _bc_radio.state = BC_RADIO_STATE_TX;
+        return;
     }
 
     if (_bc_radio.listening && _bc_radio.transmit_count == 0)
@@ -391,83 +1214,2565 @@ static void _bc_radio_task(void *param)
         bc_spirit1_set_rx_timeout(BC_TICK_INFINITY);
         bc_spirit1_rx();
     }
+
+    if (next != BC_TICK_INFINITY)
+    {
+        bc_scheduler_plan_current_absolute(next);
+    }
 }
 
-static void _bc_radio_spirit1_event_handler(bc_spirit1_event_t event, void *event_param)
+static void _bc_radio_dispatch(uint32_t *peer_device_address, uint8_t *buffer, size_t length)
 {
-    (void) event_param;
+    // Items are read in fixed layout of their header, short ones come from malformed bundle or replay and are dropped
+    if (length == 0 || length < _bc_radio_item_min_length(buffer[0]))
+    {
+        return;
+    }
 
-    if (event == BC_SPIRIT1_EVENT_TX_DONE)
+    if (buffer[0] == BC_RADIO_HEADER_PUB_PUSH_BUTTON)
     {
-        if (_bc_radio.transmit_count == 0)
+        uint16_t event_count;
+
+        memcpy(&event_count, &buffer[1], sizeof(event_count));
+
+        bc_radio_on_push_button(peer_device_address, &event_count);
+    }
+    else if (buffer[0] == BC_RADIO_HEADER_PUB_THERMOMETER)
+    {
+        float temperature;
+
+        memcpy(&temperature, &buffer[2], sizeof(temperature));
+
+        bc_radio_on_thermometer(peer_device_address, &buffer[1], &temperature);
+    }
+    else if (buffer[0] == BC_RADIO_HEADER_PUB_HUMIDITY)
+    {
+        float percentage;
+
+        memcpy(&percentage, &buffer[2], sizeof(percentage));
+
+        bc_radio_on_humidity(peer_device_address, &buffer[1], &percentage);
+    }
+    else if (buffer[0] == BC_RADIO_HEADER_PUB_LUX_METER)
+    {
+        float lux;
+
+        memcpy(&lux, &buffer[2], sizeof(lux));
+
+        bc_radio_on_lux_meter(peer_device_address, &buffer[1], &lux);
+    }
+    else if (buffer[0] == BC_RADIO_HEADER_PUB_BAROMETER)
+    {
+        float pascal;
+        float meter;
+
+        memcpy(&pascal, &buffer[2], sizeof(pascal));
+        memcpy(&meter, &buffer[2 + sizeof(pascal)], sizeof(meter));
+
+        bc_radio_on_barometer(peer_device_address, &buffer[1], &pascal, &meter);
+    }
+    else if (buffer[0] == BC_RADIO_HEADER_PUB_CO2)
+    {
+        float concentration;
+
+        memcpy(&concentration, &buffer[1], sizeof(concentration));
+
+        bc_radio_on_co2(peer_device_address, &concentration);
+    }
+    else if (buffer[0] == BC_RADIO_HEADER_PUB_BUFFER)
+    {
+        length -= 1;
+        bc_radio_on_buffer(peer_device_address, &buffer[1], &length);
+    }
+    else if (buffer[0] == BC_RADIO_HEADER_FRAGMENT)
+    {
+        _bc_radio_fragment_receive(*peer_device_address, buffer, length);
+    }
+    else if (buffer[0] == BC_RADIO_HEADER_PUB_ALARM)
+    {
+        bc_radio_alarm_t alarm = buffer[1];
+        bool active = buffer[2] != 0;
+        float value;
+
+        memcpy(&value, &buffer[3], sizeof(value));
+
+        bc_radio_on_alarm(peer_device_address, &alarm, &active, &value);
+    }
+    else if (buffer[0] == BC_RADIO_HEADER_PUB_REPLAY)
+    {
+        if (buffer[BC_RADIO_REPLAY_HEADER_LENGTH] == BC_RADIO_HEADER_PUB_REPLAY || buffer[BC_RADIO_REPLAY_HEADER_LENGTH] == BC_RADIO_HEADER_PUB_BUNDLE)
         {
-            bc_scheduler_plan_now(_bc_radio.task_id);
+            return;
         }
-        else
+
+        uint16_t sequence;
+        uint32_t age;
+        uint16_t message_id;
+
+        memcpy(&sequence, &buffer[1], sizeof(sequence));
+        memcpy(&age, &buffer[3], sizeof(age));
+        memcpy(&message_id, &buffer[7], sizeof(message_id));
+
+        // Frame was received but its acknowledgement was lost
+        bc_radio_peer_t *peer = _bc_radio_get_peer(*peer_device_address);
+
+        if (peer != NULL && _bc_radio_peer_has_received(peer, message_id))
         {
-            _bc_radio.transmit_count--;
+            _bc_radio.stats.duplicate++;
 
-            // TODO Use different randomizer
-            bc_scheduler_plan_relative(_bc_radio.task_id, rand() % 100);
+            return;
         }
 
-        if (_bc_radio.listening)
+        // Record is sent again when acknowledgement of replay was lost
+        if (peer != NULL && _bc_radio_window_is_duplicate(&peer->replay_sequence, &peer->replay_window, &peer->replay_synced, sequence))
         {
-            bc_spirit1_set_rx_timeout(BC_TICK_INFINITY);
-            bc_spirit1_rx();
+            _bc_radio.stats.duplicate++;
+
+            return;
         }
+
+        // Application is told which items come from log and how old they are
+        bc_radio_on_replay(peer_device_address, &age);
+
+        _bc_radio_dispatch(peer_device_address, &buffer[BC_RADIO_REPLAY_HEADER_LENGTH], length - BC_RADIO_REPLAY_HEADER_LENGTH);
+
+        bc_radio_on_replay(peer_device_address, NULL);
     }
-    else if (event == BC_SPIRIT1_EVENT_RX_DONE)
+    else if (buffer[0] == BC_RADIO_HEADER_PUB_BUNDLE)
     {
-        size_t length = bc_spirit1_get_rx_length();
+        // Bundle is sequence of length-prefixed items
+        size_t offset = 1;
 
-        if (length >= 6)
+        while (offset < length)
         {
-            uint8_t *buffer = bc_spirit1_get_rx_buffer();
+            size_t item_length = buffer[offset++];
 
-            uint32_t device_address;
+            if (item_length == 0 || offset + item_length > length || buffer[offset] == BC_RADIO_HEADER_PUB_BUNDLE)
+            {
+                break;
+            }
 
-            device_address = (uint32_t) buffer[0];
-            device_address |= (uint32_t) buffer[1] << 8;
-            device_address |= (uint32_t) buffer[2] << 16;
-            device_address |= (uint32_t) buffer[3] << 24;
+            _bc_radio_dispatch(peer_device_address, &buffer[offset], item_length);
+
+            offset += item_length;
+        }
+    }
+}
+
+static size_t _bc_radio_item_min_length(uint8_t header)
+{
+    switch (header)
+    {
+        case BC_RADIO_HEADER_PUB_PUSH_BUTTON:
+        {
+            return 1 + sizeof(uint16_t);
+        }
+        case BC_RADIO_HEADER_PUB_THERMOMETER:
+        case BC_RADIO_HEADER_PUB_HUMIDITY:
+        case BC_RADIO_HEADER_PUB_LUX_METER:
+        {
+            return 2 + sizeof(float);
+        }
+        case BC_RADIO_HEADER_PUB_BAROMETER:
+        {
+            return 2 + 2 * sizeof(float);
+        }
+        case BC_RADIO_HEADER_PUB_CO2:
+        {
+            return 1 + sizeof(float);
+        }
+        case BC_RADIO_HEADER_PUB_ALARM:
+        {
+            return 3 + sizeof(float);
+        }
+        case BC_RADIO_HEADER_FRAGMENT:
+        {
+            return BC_RADIO_FRAGMENT_HEADER_LENGTH;
+        }
+        case BC_RADIO_HEADER_PUB_REPLAY:
+        {
+            // Record carries at least header of its item
+            return BC_RADIO_REPLAY_HEADER_LENGTH + 1;
+        }
+        default:
+        {
+            return 1;
+        }
+    }
+}
+
+static size_t _bc_radio_begin_frame(uint8_t *buffer)
+{
+    buffer[0] = _bc_radio.device_address;
+    buffer[1] = _bc_radio.device_address >> 8;
+    buffer[2] = _bc_radio.device_address >> 16;
+    buffer[3] = _bc_radio.device_address >> 24;
+    buffer[4] = _bc_radio.message_id;
+    buffer[5] = _bc_radio.message_id >> 8;
+
+    _bc_radio.message_id++;
+
+    return 6;
+}
+
+static void _bc_radio_transmit(size_t length, int transmit_count)
+{
+    _bc_radio.stats.transmitted++;
+
+    _bc_radio.on_air = true;
+    _bc_radio.tx_urgent = false;
+
+    uint8_t *buffer = bc_spirit1_get_tx_buffer();
+
+    if (length > 7 && buffer[6] == BC_RADIO_HEADER_ACK_REQUEST)
+    {
+        size_t offset = 0;
+        size_t item_length;
+        uint8_t *item;
 
-            if (_bc_radio.enrollment_mode && length == 7 && buffer[6] == BC_RADIO_HEADER_ENROLL)
+        // Replayed items carry log time of their record until now, it is converted to age
+        while ((item = _bc_radio_next_item(&buffer[7], length - 7, &offset, &item_length)) != NULL)
+        {
+            if (item[0] == BC_RADIO_HEADER_PUB_REPLAY && item_length > BC_RADIO_REPLAY_HEADER_LENGTH)
             {
-                _bc_radio.peer_enrolled = true;
-                _bc_radio.peer_device_address = device_address;
-                _bc_radio.peer_message_id_synced = false;
-                _bc_radio.enrollment_mode = false;
+                uint32_t time;
+
+                memcpy(&time, &item[3], sizeof(time));
 
-                bc_eeprom_write(BC_RADIO_EEPROM_PEER_DEVICE_ADDRESS, &_bc_radio.peer_device_address, sizeof(_bc_radio.peer_device_address));
+                time = _bc_radio_log_time() - time;
 
-                if (_bc_radio.event_handler != NULL)
-                {
-                    _bc_radio.event_handler(BC_RADIO_EVENT_PAIR_SUCCESS, _bc_radio.event_param);
-                }
+                memcpy(&item[3], &time, sizeof(time));
             }
+        }
 
-            if (device_address == _bc_radio.peer_device_address)
-            {
-                uint16_t message_id;
+        _bc_radio.ack_tx.pending = true;
+        _bc_radio.ack_tx.waiting = false;
+        _bc_radio.ack_tx.message_id = (uint16_t) buffer[4] | (uint16_t) buffer[5] << 8;
+        _bc_radio.ack_tx.length = length - 7;
 
-                message_id = (uint16_t) buffer[4];
-                message_id |= (uint16_t) buffer[5] << 8;
+        memcpy(_bc_radio.ack_tx.buffer, &buffer[7], length - 7);
+    }
 
-                if (_bc_radio.peer_message_id != message_id || !_bc_radio.peer_message_id_synced)
-                {
-                    _bc_radio.peer_message_id = message_id;
+    bc_spirit1_set_tx_length(length);
 
-                    _bc_radio.peer_message_id_synced = true;
+    bc_spirit1_tx();
 
-                    if (length > 6)
-                    {
-                        bc_queue_put(&_bc_radio.rx_queue, buffer + 6, length - 6);
+    _bc_radio.transmit_count = transmit_count;
 
-                        bc_scheduler_plan_now(_bc_radio.task_id);
-                    }
-                }
-            }
+    _bc_radio.state = BC_RADIO_STATE_TX;
+}
+
+static bool _bc_radio_pub_queue_put(const void *buffer, size_t length, size_t key_length, bc_radio_priority_t priority)
+{
+    if (priority == BC_RADIO_PRIORITY_HIGH)
+    {
+        if (!bc_queue_put(&_bc_radio.urgent_queue, buffer, length))
+        {
+            _bc_radio.stats.pub_queue_overflow++;
+
+            return false;
+        }
+
+        _bc_radio.stats.queued++;
+
+        bc_scheduler_plan_now(_bc_radio.task_id);
+
+        return true;
+    }
+
+    size_t queue_length = bc_queue_get_length(&_bc_radio.pub_queue);
+
+    // Key is header and sensor address, newer reading supersedes one which was not sent yet
+    if (!_bc_radio.pub_replace_latest)
+    {
+        key_length = 0;
+    }
+
+    if (!bc_queue_put_latest(&_bc_radio.pub_queue, buffer, length, key_length))
+    {
+        _bc_radio.stats.pub_queue_overflow++;
+
+        return false;
+    }
+
+    if (bc_queue_get_length(&_bc_radio.pub_queue) == queue_length)
+    {
+        _bc_radio.stats.pub_replaced++;
+
+        return true;
+    }
+
+    _bc_radio.stats.queued++;
+
+    _bc_radio_update_high_water();
+
+    bc_scheduler_plan_now(_bc_radio.task_id);
+
+    return true;
+}
+
+static void _bc_radio_update_high_water(void)
+{
+    size_t length = bc_queue_get_length(&_bc_radio.pub_queue);
+
+    if (length > _bc_radio.stats.pub_queue_high_water)
+    {
+        _bc_radio.stats.pub_queue_high_water = length;
+    }
+
+    length = bc_queue_get_length(&_bc_radio.rx_queue);
+
+    if (length > _bc_radio.stats.rx_queue_high_water)
+    {
+        _bc_radio.stats.rx_queue_high_water = length;
+    }
+}
+
+static bc_radio_peer_t *_bc_radio_get_peer(uint32_t device_address)
+{
+    if (device_address == 0)
+    {
+        return NULL;
+    }
+
+    for (size_t i = 0; i < BC_RADIO_MAX_PEERS; i++)
+    {
+        if (_bc_radio.peers[i].device_address == device_address)
+        {
+            return &_bc_radio.peers[i];
         }
     }
+
+    return NULL;
+}
+
+static bc_radio_peer_t *_bc_radio_add_peer(uint32_t device_address)
+{
+    bc_radio_peer_t *peer = _bc_radio_get_peer(device_address);
+
+    if (peer != NULL)
+    {
+        return peer;
+    }
+
+    // Gateway running TDMA has to give slot to every peer, enrollment is refused once there is none left
+    uint16_t slot = 0;
+
+    if (_bc_radio.tdma.beacon)
+    {
+        slot = _bc_radio_tdma_free_slot();
+
+        if (slot == 0)
+        {
+            return NULL;
+        }
+    }
+
+    for (size_t i = 0; i < BC_RADIO_MAX_PEERS; i++)
+    {
+        if (_bc_radio.peers[i].device_address == 0)
+        {
+            peer = &_bc_radio.peers[i];
+
+            memset(peer, 0, sizeof(*peer));
+
+            peer->device_address = device_address;
+            peer->slot = slot;
+
+            uint32_t address = BC_RADIO_EEPROM_PEER_DEVICE_ADDRESS + i * sizeof(peer->device_address);
+
+            bc_eeprom_write(address, &peer->device_address, sizeof(peer->device_address));
+
+            return peer;
+        }
+    }
+
+    return NULL;
+}
+
+static void _bc_radio_tdma_send_beacon(bc_tick_t now)
+{
+    uint8_t *buffer = bc_spirit1_get_tx_buffer();
+
+    size_t length = _bc_radio_begin_frame(buffer);
+
+    length = _bc_radio_channel_announce(buffer, length);
+
+    length = _bc_radio_bulk_notice(buffer, length);
+
+    buffer[length++] = BC_RADIO_HEADER_BEACON;
+
+    uint32_t time = now;
+    uint16_t phase = (now - _bc_radio.tdma.epoch) % _bc_radio.tdma.superframe;
+    uint16_t superframe = _bc_radio.tdma.superframe;
+    uint16_t slot_length = _bc_radio.tdma.slot_length;
+
+    memcpy(&buffer[length], &time, sizeof(time));
+    length += sizeof(time);
+    memcpy(&buffer[length], &phase, sizeof(phase));
+    length += sizeof(phase);
+    memcpy(&buffer[length], &superframe, sizeof(superframe));
+    length += sizeof(superframe);
+    memcpy(&buffer[length], &slot_length, sizeof(slot_length));
+    length += sizeof(slot_length);
+
+    // Beacon lists only nodes which asked for slot since previous one, slot 0 tells node there is none for it
+    buffer[length++] = _bc_radio.tdma.grant_count;
+
+    for (size_t i = 0; i < _bc_radio.tdma.grant_count; i++)
+    {
+        bc_radio_peer_t *peer = _bc_radio_get_peer(_bc_radio.tdma.grant[i]);
+
+        uint16_t slot = peer != NULL ? peer->slot : 0;
+
+        memcpy(&buffer[length], &_bc_radio.tdma.grant[i], sizeof(uint32_t));
+        length += sizeof(uint32_t);
+        memcpy(&buffer[length], &slot, sizeof(slot));
+        length += sizeof(slot);
+    }
+
+    _bc_radio.tdma.grant_count = 0;
+
+    // Answer to request goes out right away, regular beacon keeps its place at start of superframe
+    while (_bc_radio.tdma.beacon_tick <= now)
+    {
+        _bc_radio.tdma.beacon_tick += _bc_radio.tdma.superframe;
+    }
+
+    _bc_radio_transmit(length, 0);
+}
+
+static void _bc_radio_tdma_on_beacon(uint32_t device_address, uint8_t *buffer, size_t length)
+{
+    if (!_bc_radio.tdma.joined || length < BC_RADIO_TDMA_BEACON_HEADER_LENGTH)
+    {
+        return;
+    }
+
+    uint32_t time;
+    uint16_t phase;
+    uint16_t superframe;
+    uint16_t slot_length;
+
+    memcpy(&time, &buffer[7], sizeof(time));
+    memcpy(&phase, &buffer[11], sizeof(phase));
+    memcpy(&superframe, &buffer[13], sizeof(superframe));
+    memcpy(&slot_length, &buffer[15], sizeof(slot_length));
+
+    if (superframe == 0 || slot_length == 0)
+    {
+        return;
+    }
+
+    bool listed = false;
+    uint16_t slot = 0;
+
+    for (size_t i = 0; i < buffer[17]; i++)
+    {
+        size_t offset = BC_RADIO_TDMA_BEACON_HEADER_LENGTH + i * BC_RADIO_TDMA_BEACON_ENTRY_LENGTH;
+
+        if (offset + BC_RADIO_TDMA_BEACON_ENTRY_LENGTH > length)
+        {
+            break;
+        }
+
+        uint32_t address;
+
+        memcpy(&address, &buffer[offset], sizeof(address));
+
+        if (address == _bc_radio.device_address)
+        {
+            listed = true;
+
+            memcpy(&slot, &buffer[offset + sizeof(address)], sizeof(slot));
+        }
+    }
+
+    // Node without slot is taken in only by answer to its request, other beacons keep synced node in time
+    if (!listed && (!_bc_radio.tdma.synced || device_address != _bc_radio.tdma.gateway_address))
+    {
+        return;
+    }
+
+    bc_tick_t now = bc_tick_get();
+
+    if (listed)
+    {
+        _bc_radio.tdma.gateway_known = true;
+        _bc_radio.tdma.gateway_address = device_address;
+        _bc_radio.tdma.slot = slot;
+
+        // Gateway has no slot left, node stays with random access and asks again much later
+        if (slot == 0)
+        {
+            _bc_radio.tdma.synced = false;
+            _bc_radio.tdma.window = false;
+            _bc_radio.tdma.window_tick = now + BC_RADIO_TDMA_SEARCH_INTERVAL;
+
+            _bc_radio_rx_resume();
+
+            bc_scheduler_plan_now(_bc_radio.task_id);
+
+            return;
+        }
+    }
+
+    // Extend 32-bit gateway time to 64 bits
+    int64_t remote = time;
+
+    if (_bc_radio.tdma.sync_valid)
+    {
+        remote = _bc_radio.tdma.sync_remote + (int32_t) (time - (uint32_t) _bc_radio.tdma.sync_remote);
+    }
+
+    int64_t remote_now = remote + bc_spirit1_get_airtime(length);
+
+    if (!_bc_radio.tdma.sync_valid || !_bc_radio.tdma.synced)
+    {
+        _bc_radio.tdma.anchor_local = now;
+        _bc_radio.tdma.anchor_remote = remote_now;
+        _bc_radio.tdma.drift_ppm = 0;
+    }
+    else if (now - _bc_radio.tdma.anchor_local >= BC_RADIO_TDMA_DRIFT_MIN_INTERVAL)
+    {
+        // Estimate drift over whole interval since anchor, tick quantization error shrinks with its length
+        int64_t local_elapsed = now - _bc_radio.tdma.anchor_local;
+        int64_t remote_elapsed = remote_now - _bc_radio.tdma.anchor_remote;
+        int64_t drift_ppm = ((remote_elapsed - local_elapsed) * 1000000) / local_elapsed;
+
+        if (drift_ppm > BC_RADIO_TDMA_MAX_DRIFT_PPM)
+        {
+            drift_ppm = BC_RADIO_TDMA_MAX_DRIFT_PPM;
+        }
+        else if (drift_ppm < -BC_RADIO_TDMA_MAX_DRIFT_PPM)
+        {
+            drift_ppm = -BC_RADIO_TDMA_MAX_DRIFT_PPM;
+        }
+
+        _bc_radio.tdma.drift_ppm = drift_ppm;
+    }
+
+    _bc_radio.tdma.sync_valid = true;
+    _bc_radio.tdma.sync_local = now;
+    _bc_radio.tdma.sync_remote = remote_now;
+    _bc_radio.tdma.remote_epoch = remote - phase;
+    _bc_radio.tdma.superframe = superframe;
+    _bc_radio.tdma.slot_length = slot_length;
+    _bc_radio.tdma.synced = true;
+    _bc_radio.tdma.missed = 0;
+    _bc_radio.tdma.request_backoff = BC_RADIO_TDMA_REQUEST_BACKOFF;
+    _bc_radio.tdma.window = false;
+
+    _bc_radio_tdma_plan_window(remote_now + (int64_t) superframe * BC_RADIO_TDMA_RESYNC_SUPERFRAMES - superframe / 2);
+
+    _bc_radio_rx_resume();
+
+    bc_scheduler_plan_now(_bc_radio.task_id);
+}
+
+static void _bc_radio_tdma_on_window_timeout(void)
+{
+    _bc_radio.tdma.window = false;
+
+    bc_tick_t now = bc_tick_get();
+
+    if (_bc_radio.tdma.synced)
+    {
+        if (++_bc_radio.tdma.missed < BC_RADIO_TDMA_MAX_MISSED)
+        {
+            // Try very next beacon, window grows with time since last sync
+            _bc_radio_tdma_plan_window(_bc_radio_tdma_to_remote(now));
+
+            return;
+        }
+
+        // Fall back to random access and ask gateway for slot again
+        _bc_radio.tdma.synced = false;
+    }
+
+    _bc_radio_tdma_plan_request(now);
+}
+
+static void _bc_radio_tdma_on_request(uint32_t device_address)
+{
+    for (size_t i = 0; i < _bc_radio.tdma.grant_count; i++)
+    {
+        if (_bc_radio.tdma.grant[i] == device_address)
+        {
+            return;
+        }
+    }
+
+    // Node asks again after backoff
+    if (_bc_radio.tdma.grant_count == BC_RADIO_TDMA_BEACON_ENTRIES)
+    {
+        return;
+    }
+
+    // Requests heard in the meantime are answered together
+    if (_bc_radio.tdma.grant_count == 0)
+    {
+        _bc_radio.tdma.grant_tick = bc_tick_get() + BC_RADIO_ACK_DELAY;
+
+        bc_scheduler_plan_absolute(_bc_radio.task_id, _bc_radio.tdma.grant_tick);
+    }
+
+    _bc_radio.tdma.grant[_bc_radio.tdma.grant_count++] = device_address;
+}
+
+static void _bc_radio_tdma_send_request(void)
+{
+    uint8_t *buffer = bc_spirit1_get_tx_buffer();
+
+    size_t length = _bc_radio_begin_frame(buffer);
+
+    buffer[length++] = BC_RADIO_HEADER_TDMA_REQUEST;
+
+    _bc_radio_transmit(length, 0);
+}
+
+static void _bc_radio_tdma_plan_request(bc_tick_t now)
+{
+    // Nodes which start or lose gateway together spread their requests
+    bc_tick_t backoff = _bc_radio.tdma.request_backoff;
+
+    // TODO Use different randomizer
+    _bc_radio.tdma.window_tick = now + backoff / 2 + rand() % (backoff / 2);
+
+    _bc_radio.tdma.request_backoff = backoff < BC_RADIO_TDMA_SEARCH_INTERVAL / 2 ? backoff * 2 : BC_RADIO_TDMA_SEARCH_INTERVAL;
+}
+
+static void _bc_radio_tdma_open_window(bc_tick_t now)
+{
+    _bc_radio.tdma.window = true;
+    _bc_radio.tdma.window_end = now + _bc_radio.tdma.window_length;
+
+    bc_spirit1_set_rx_timeout(_bc_radio.tdma.window_length);
+    bc_spirit1_rx();
+}
+
+static void _bc_radio_tdma_plan_window(int64_t remote_due)
+{
+    int64_t superframe = _bc_radio.tdma.superframe;
+
+    // Beacon is sent at the beginning of every superframe
+    int64_t n = (remote_due - _bc_radio.tdma.remote_epoch + superframe - 1) / superframe;
+
+    bc_tick_t beacon = _bc_radio_tdma_to_local(_bc_radio.tdma.remote_epoch + n * superframe);
+
+    bc_tick_t guard = BC_RADIO_TDMA_GUARD + ((beacon - _bc_radio.tdma.sync_local) * BC_RADIO_TDMA_DRIFT_MARGIN_PPM) / 1000000;
+
+    _bc_radio.tdma.window_tick = beacon > guard ? beacon - guard : 0;
+    _bc_radio.tdma.window_length = 2 * guard + bc_spirit1_get_airtime(BC_RADIO_TDMA_BEACON_MAX_LENGTH) + BC_RADIO_TDMA_WINDOW_MARGIN;
+}
+
+static bool _bc_radio_tdma_transmit_in_slot(bc_tick_t now, bc_tick_t *next)
+{
+    uint8_t queue_item_buffer[BC_SPIRIT1_MAX_PACKET_SIZE - 6];
+    size_t queue_item_length;
+
+    if (_bc_radio.ack_tx.pending || !bc_queue_peek(&_bc_radio.pub_queue, queue_item_buffer, &queue_item_length))
+    {
+        return false;
+    }
+
+    int64_t remote = _bc_radio_tdma_to_remote(now);
+    int64_t superframe = _bc_radio.tdma.superframe;
+    int64_t slot_start = _bc_radio.tdma.remote_epoch + (int64_t) _bc_radio.tdma.slot * _bc_radio.tdma.slot_length;
+
+    // Position within own slot cycle
+    int64_t offset = (remote - slot_start) % superframe;
+
+    if (offset < 0)
+    {
+        offset += superframe;
+    }
+
+    bc_tick_t airtime = bc_spirit1_get_airtime(6 + 2 + queue_item_length);
+
+    bool fits = airtime + 2 * BC_RADIO_TDMA_GUARD > _bc_radio.tdma.slot_length || offset + (int64_t) airtime + BC_RADIO_TDMA_GUARD <= (int64_t) _bc_radio.tdma.slot_length;
+
+    if (offset < BC_RADIO_TDMA_GUARD || !fits)
+    {
+        int64_t start = remote - offset + BC_RADIO_TDMA_GUARD;
+
+        if (offset >= BC_RADIO_TDMA_GUARD)
+        {
+            start += superframe;
+        }
+
+        bc_tick_t tick = _bc_radio_tdma_to_local(start);
+
+        if (tick < *next)
+        {
+            *next = tick;
+        }
+
+        return false;
+    }
+
+    bc_tick_t deadline = _bc_radio_tdma_to_local(remote - offset + _bc_radio.tdma.slot_length - BC_RADIO_TDMA_GUARD);
+
+    uint8_t *buffer = bc_spirit1_get_tx_buffer();
+
+    size_t length = _bc_radio_begin_frame(buffer);
+
+    // Item which does not fit into bundle is sent alone
+    if (length + 2 + queue_item_length > BC_SPIRIT1_MAX_PACKET_SIZE)
+    {
+        bc_queue_get(&_bc_radio.pub_queue, NULL, &queue_item_length);
+
+        length = _bc_radio_ack_request(buffer, length, queue_item_buffer[0], queue_item_length);
+
+        memcpy(buffer + length, queue_item_buffer, queue_item_length);
+
+        _bc_radio_transmit(length + queue_item_length, BC_RADIO_TDMA_TRANSMIT_COUNT);
+
+        return true;
+    }
+
+    length = _bc_radio_ack_request(buffer, length, BC_RADIO_HEADER_PUB_BUNDLE, 1 + 1 + queue_item_length);
+
+    buffer[length++] = BC_RADIO_HEADER_PUB_BUNDLE;
+
+    size_t items_start = length;
+
+    do
+    {
+        if (length + 1 + queue_item_length > BC_SPIRIT1_MAX_PACKET_SIZE)
+        {
+            break;
+        }
+
+        if (length > items_start && now + bc_spirit1_get_airtime(length + 1 + queue_item_length) > deadline)
+        {
+            break;
+        }
+
+        bc_queue_get(&_bc_radio.pub_queue, NULL, &queue_item_length);
+
+        buffer[length++] = queue_item_length;
+
+        memcpy(buffer + length, queue_item_buffer, queue_item_length);
+
+        length += queue_item_length;
+
+    } while (bc_queue_peek(&_bc_radio.pub_queue, queue_item_buffer, &queue_item_length));
+
+    _bc_radio_transmit(length, BC_RADIO_TDMA_TRANSMIT_COUNT);
+
+    return true;
+}
+
+static int64_t _bc_radio_tdma_to_remote(bc_tick_t local)
+{
+    int64_t elapsed = (int64_t) local - (int64_t) _bc_radio.tdma.sync_local;
+
+    return _bc_radio.tdma.sync_remote + elapsed + (elapsed * _bc_radio.tdma.drift_ppm) / 1000000;
+}
+
+static uint16_t _bc_radio_tdma_free_slot(void)
+{
+    size_t slot_count = _bc_radio.tdma.superframe / _bc_radio.tdma.slot_length;
+
+    // Lowest slot no peer holds, slot 0 belongs to beacon
+    for (size_t slot = 1; slot < slot_count; slot++)
+    {
+        size_t i;
+
+        for (i = 0; i < BC_RADIO_MAX_PEERS; i++)
+        {
+            if (_bc_radio.peers[i].device_address != 0 && _bc_radio.peers[i].slot == slot)
+            {
+                break;
+            }
+        }
+
+        if (i == BC_RADIO_MAX_PEERS)
+        {
+            return slot;
+        }
+    }
+
+    return 0;
+}
+
+static bc_tick_t _bc_radio_tdma_to_local(int64_t remote)
+{
+    int64_t elapsed = remote - _bc_radio.tdma.sync_remote;
+
+    int64_t local = (int64_t) _bc_radio.tdma.sync_local + (elapsed * 1000000) / (1000000 + _bc_radio.tdma.drift_ppm);
+
+    return local < 0 ? 0 : (bc_tick_t) local;
+}
+
+static void _bc_radio_spirit1_event_handler(bc_spirit1_event_t event, void *event_param)
+{
+    (void) event_param;
+
+    if (event == BC_SPIRIT1_EVENT_TX_DONE)
+    {
+        _bc_radio.on_air = false;
+
+        if (_bc_radio.transmit_count == 0)
+        {
+            bc_scheduler_plan_now(_bc_radio.task_id);
+        }
+        else
+        {
+            _bc_radio.transmit_count--;
+
+            // Urgent frame is sent outside of slot, so it is spread randomly as without TDMA
+            if (_bc_radio.tdma.synced && !_bc_radio.tx_urgent)
+            {
+                bc_scheduler_plan_relative(_bc_radio.task_id, BC_RADIO_TDMA_RETRANSMIT_DELAY);
+            }
+            else
+            {
+                // TODO Use different randomizer
+                bc_scheduler_plan_relative(_bc_radio.task_id, rand() % 100);
+            }
+        }
+
+        uint8_t *buffer = bc_spirit1_get_tx_buffer();
+
+        // Gateway answers every copy of frame, so window is opened after each one
+        if (_bc_radio.ack_tx.pending)
+        {
+            _bc_radio.ack_tx.waiting = true;
+            _bc_radio.ack_tx.wait_end = bc_tick_get() + BC_RADIO_ACK_TIMEOUT;
+        }
+
+        // Receiver answers frame which asks for it, answer is awaited before anything else is sent
+        if (_bc_radio.bulk_tx.request && (buffer[6] == BC_RADIO_HEADER_BULK_OPEN || buffer[6] == BC_RADIO_HEADER_BULK_DATA))
+        {
+            _bc_radio.bulk_tx.request = false;
+            _bc_radio.bulk_tx.waiting = true;
+            _bc_radio.bulk_tx.wait_end = bc_tick_get() + BC_RADIO_BULK_ACK_TIMEOUT;
+        }
+
+        // Receiver which heard notice stays in reception, transfer follows once it turns around
+        if (_bc_radio.bulk_tx.notice)
+        {
+            _bc_radio.bulk_tx.notice = false;
+            _bc_radio.bulk_tx.noticed = true;
+            _bc_radio.bulk_tx.tick = bc_tick_get() + BC_RADIO_BULK_ACK_DELAY;
+        }
+
+        // Gateway answers request for slot with beacon which lists the node
+        if (_bc_radio.tdma.joined && buffer[6] == BC_RADIO_HEADER_TDMA_REQUEST)
+        {
+            _bc_radio.tdma.window = true;
+            _bc_radio.tdma.window_end = bc_tick_get() + BC_RADIO_TDMA_GRANT_TIMEOUT;
+        }
+
+        // Receiver answers last fragment with list of missing ones
+        if (_bc_radio.fragment_tx.active && buffer[6] == BC_RADIO_HEADER_FRAGMENT && buffer[7] == _bc_radio.fragment_tx.id && buffer[8] == _bc_radio.fragment_tx.count - 1)
+        {
+            _bc_radio.fragment_tx.waiting = true;
+            _bc_radio.fragment_tx.wait_end = bc_tick_get() + BC_RADIO_FRAGMENT_ACK_TIMEOUT;
+        }
+
+        _bc_radio_rx_resume();
+    }
+    else if (event == BC_SPIRIT1_EVENT_RX_TIMEOUT)
+    {
+        bc_tick_t now = bc_tick_get();
+
+        if (_bc_radio.tdma.window && now >= _bc_radio.tdma.window_end)
+        {
+            _bc_radio_tdma_on_window_timeout();
+        }
+
+        if (_bc_radio.fragment_tx.waiting && now >= _bc_radio.fragment_tx.wait_end)
+        {
+            _bc_radio_fragment_on_timeout();
+        }
+
+        _bc_radio_rx_resume();
+
+        bc_scheduler_plan_now(_bc_radio.task_id);
+    }
+    else if (event == BC_SPIRIT1_EVENT_RX_DONE)
+    {
+        size_t length = bc_spirit1_get_rx_length();
+
+        if (length >= 6)
+        {
+            _bc_radio.stats.received++;
+
+            uint8_t *buffer = bc_spirit1_get_rx_buffer();
+
+            uint32_t device_address;
+
+            device_address = (uint32_t) buffer[0];
+            device_address |= (uint32_t) buffer[1] << 8;
+            device_address |= (uint32_t) buffer[2] << 16;
+            device_address |= (uint32_t) buffer[3] << 24;
+
+            // Announcement is taken off, rest of frame is handled as if it came alone
+            if (length >= 6 + BC_RADIO_CHANNEL_ANNOUNCE_LENGTH && buffer[6] == BC_RADIO_HEADER_CHANNEL)
+            {
+                _bc_radio_channel_on_announce(device_address, &buffer[6]);
+
+                memmove(&buffer[BC_RADIO_CHANNEL_ANNOUNCE_LENGTH], buffer, 6);
+
+                buffer += BC_RADIO_CHANNEL_ANNOUNCE_LENGTH;
+                length -= BC_RADIO_CHANNEL_ANNOUNCE_LENGTH;
+            }
+
+            if (length >= 6 + BC_RADIO_BULK_NOTICE_LENGTH && buffer[6] == BC_RADIO_HEADER_BULK_NOTICE)
+            {
+                _bc_radio_bulk_on_notice(device_address, &buffer[6]);
+
+                memmove(&buffer[BC_RADIO_BULK_NOTICE_LENGTH], buffer, 6);
+
+                buffer += BC_RADIO_BULK_NOTICE_LENGTH;
+                length -= BC_RADIO_BULK_NOTICE_LENGTH;
+            }
+
+            if (length >= 7 && buffer[6] == BC_RADIO_HEADER_BEACON)
+            {
+                _bc_radio_tdma_on_beacon(device_address, buffer, length);
+
+                return;
+            }
+
+            uint16_t message_id;
+
+            message_id = (uint16_t) buffer[4];
+            message_id |= (uint16_t) buffer[5] << 8;
+
+            _bc_radio_receive(device_address, message_id, buffer + 6, length - 6, 0);
+        }
+    }
+}
+
+static void _bc_radio_receive(uint32_t device_address, uint16_t message_id, uint8_t *payload, size_t length, uint8_t hops)
+{
+    if (device_address == _bc_radio.device_address)
+    {
+        return;
+    }
+
+    if (length >= 1 && payload[0] == BC_RADIO_HEADER_RELAY)
+    {
+        // Relay frame is sequence of entries, each one is handled as if heard directly
+        size_t offset = 1;
+
+        while (offset + BC_RADIO_RELAY_ENTRY_HEADER_LENGTH <= length)
+        {
+            uint8_t entry_hops = payload[offset];
+            uint32_t entry_device_address;
+            uint16_t entry_message_id;
+            size_t entry_length = payload[offset + 7];
+
+            memcpy(&entry_device_address, &payload[offset + 1], sizeof(entry_device_address));
+            memcpy(&entry_message_id, &payload[offset + 5], sizeof(entry_message_id));
+
+            offset += BC_RADIO_RELAY_ENTRY_HEADER_LENGTH;
+
+            if (offset + entry_length > length || (entry_length != 0 && payload[offset] == BC_RADIO_HEADER_RELAY))
+            {
+                break;
+            }
+
+            _bc_radio_receive(entry_device_address, entry_message_id, &payload[offset], entry_length, entry_hops + 1);
+
+            offset += entry_length;
+        }
+
+        return;
+    }
+
+    // Bulk transfer runs directly between both ends, it is neither relayed nor queued
+    if (length >= 1 && payload[0] >= BC_RADIO_HEADER_BULK_OPEN && payload[0] <= BC_RADIO_HEADER_BULK_NOTICE)
+    {
+        _bc_radio_bulk_receive(device_address, payload, length);
+
+        return;
+    }
+
+    if (_bc_radio.relay.enabled && hops < BC_RADIO_RELAY_MAX_HOPS)
+    {
+        _bc_radio_relay_forward(device_address, message_id, payload, length, hops);
+    }
+
+    if (length >= 1 && payload[0] == BC_RADIO_HEADER_ACK)
+    {
+        _bc_radio_ack_on_ack(payload, length);
+
+        return;
+    }
+
+    if (length == BC_RADIO_FRAGMENT_NACK_LENGTH && payload[0] == BC_RADIO_HEADER_FRAGMENT_NACK)
+    {
+        uint32_t destination;
+        uint32_t missing;
+
+        memcpy(&destination, &payload[1], sizeof(destination));
+        memcpy(&missing, &payload[6], sizeof(missing));
+
+        if (destination == _bc_radio.device_address)
+        {
+            _bc_radio_fragment_on_nack(payload[5], missing);
+        }
+
+        return;
+    }
+
+    if (_bc_radio.enrollment_mode && length == 1 && payload[0] == BC_RADIO_HEADER_ENROLL)
+    {
+        bc_radio_peer_t *peer = _bc_radio_add_peer(device_address);
+
+        if (peer != NULL)
+        {
+            peer->message_id_synced = false;
+            peer->replay_synced = false;
+
+            _bc_radio.enrollment_mode = false;
+        }
+
+        if (_bc_radio.event_handler != NULL)
+        {
+            _bc_radio.event_handler(peer != NULL ? BC_RADIO_EVENT_PAIR_SUCCESS : BC_RADIO_EVENT_PAIR_FAILURE, _bc_radio.event_param);
+        }
+    }
+
+    bc_radio_peer_t *peer = _bc_radio_get_peer(device_address);
+
+    if (peer == NULL)
+    {
+        _bc_radio.stats.foreign++;
+
+        return;
+    }
+
+    if (length == 1 && payload[0] == BC_RADIO_HEADER_TDMA_REQUEST)
+    {
+        if (_bc_radio.tdma.beacon)
+        {
+            _bc_radio_tdma_on_request(device_address);
+        }
+
+        return;
+    }
+
+    if (length >= 1 && payload[0] == BC_RADIO_HEADER_ACK_REQUEST)
+    {
+        // Duplicates are answered too, answer to first copy may have been lost
+        _bc_radio_ack_queue(device_address, message_id);
+
+        payload++;
+        length--;
+    }
+
+    if (_bc_radio_peer_is_duplicate(peer, message_id))
+    {
+        _bc_radio.stats.duplicate++;
+
+        return;
+    }
+
+    if (length > 0)
+    {
+        uint8_t queue_item_buffer[sizeof(device_address) + BC_SPIRIT1_MAX_PACKET_SIZE - 6];
+
+        memcpy(queue_item_buffer, &device_address, sizeof(device_address));
+        memcpy(&queue_item_buffer[sizeof(device_address)], payload, length);
+
+        if (!bc_queue_put(&_bc_radio.rx_queue, queue_item_buffer, sizeof(device_address) + length))
+        {
+            _bc_radio.stats.rx_queue_overflow++;
+
+            return;
+        }
+
+        _bc_radio_update_high_water();
+
+        bc_scheduler_plan_now(_bc_radio.task_id);
+    }
+}
+
+static bool _bc_radio_peer_is_duplicate(bc_radio_peer_t *peer, uint16_t message_id)
+{
+    // Same frame may arrive both directly and through relay, possibly out of order
+    return _bc_radio_window_is_duplicate(&peer->message_id, &peer->message_id_window, &peer->message_id_synced, message_id);
+}
+
+static bool _bc_radio_window_is_duplicate(uint16_t *last, uint32_t *window, bool *synced, uint16_t number)
+{
+    int16_t difference = number - *last;
+
+    if (!*synced || difference <= -32)
+    {
+        // First number or sender restarted
+        *last = number;
+        *window = 1;
+        *synced = true;
+
+        return false;
+    }
+
+    if (difference > 0)
+    {
+        *window = difference < 32 ? *window << difference : 0;
+        *window |= 1;
+        *last = number;
+
+        return false;
+    }
+
+    uint32_t mask = (uint32_t) 1 << -difference;
+
+    if ((*window & mask) != 0)
+    {
+        return true;
+    }
+
+    *window |= mask;
+
+    return false;
+}
+
+static bool _bc_radio_peer_has_received(bc_radio_peer_t *peer, uint16_t message_id)
+{
+    int16_t difference = message_id - peer->message_id;
+
+    // Only frames within window are known
+    if (!peer->message_id_synced || difference > 0 || difference <= -32)
+    {
+        return false;
+    }
+
+    return (peer->message_id_window & ((uint32_t) 1 << -difference)) != 0;
+}
+
+static void _bc_radio_relay_forward(uint32_t device_address, uint16_t message_id, uint8_t *payload, size_t length, uint8_t hops)
+{
+    for (size_t i = 0; i < BC_RADIO_RELAY_SEEN_COUNT; i++)
+    {
+        if (_bc_radio.relay.seen[i].device_address == device_address && _bc_radio.relay.seen[i].message_id == message_id)
+        {
+            return;
+        }
+    }
+
+    _bc_radio.relay.seen[_bc_radio.relay.seen_index].device_address = device_address;
+    _bc_radio.relay.seen[_bc_radio.relay.seen_index].message_id = message_id;
+
+    _bc_radio.relay.seen_index = (_bc_radio.relay.seen_index + 1) % BC_RADIO_RELAY_SEEN_COUNT;
+
+    // Entry has to fit into relay frame together with its header
+    if (6 + 1 + BC_RADIO_RELAY_ENTRY_HEADER_LENGTH + length > BC_SPIRIT1_MAX_PACKET_SIZE)
+    {
+        return;
+    }
+
+    uint8_t entry[BC_SPIRIT1_MAX_PACKET_SIZE];
+
+    entry[0] = hops;
+    memcpy(&entry[1], &device_address, sizeof(device_address));
+    memcpy(&entry[5], &message_id, sizeof(message_id));
+    entry[7] = length;
+    memcpy(&entry[BC_RADIO_RELAY_ENTRY_HEADER_LENGTH], payload, length);
+
+    bool empty = bc_queue_is_empty(&_bc_radio.relay.queue);
+
+    if (!bc_queue_put(&_bc_radio.relay.queue, entry, BC_RADIO_RELAY_ENTRY_HEADER_LENGTH + length))
+    {
+        _bc_radio.stats.relay_queue_overflow++;
+
+        return;
+    }
+
+    // Wait a moment for other frames which can share the same transmission
+    if (empty)
+    {
+        _bc_radio.relay.tick = bc_tick_get() + BC_RADIO_RELAY_AGGREGATION_DELAY;
+
+        bc_scheduler_plan_absolute(_bc_radio.task_id, _bc_radio.relay.tick);
+    }
+}
+
+static void _bc_radio_relay_transmit(void)
+{
+    uint8_t entry[BC_SPIRIT1_MAX_PACKET_SIZE];
+    size_t entry_length;
+
+    uint8_t *buffer = bc_spirit1_get_tx_buffer();
+
+    size_t length = _bc_radio_begin_frame(buffer);
+
+    buffer[length++] = BC_RADIO_HEADER_RELAY;
+
+    while (bc_queue_peek(&_bc_radio.relay.queue, entry, &entry_length))
+    {
+        if (length + entry_length > BC_SPIRIT1_MAX_PACKET_SIZE)
+        {
+            break;
+        }
+
+        bc_queue_get(&_bc_radio.relay.queue, NULL, &entry_length);
+
+        memcpy(buffer + length, entry, entry_length);
+
+        length += entry_length;
+    }
+
+    if (!bc_queue_is_empty(&_bc_radio.relay.queue))
+    {
+        _bc_radio.relay.tick = bc_tick_get();
+    }
+
+    _bc_radio_transmit(length, BC_RADIO_RELAY_TRANSMIT_COUNT);
+}
+
+static void _bc_radio_fragment_feed(void)
+{
+    while (_bc_radio.fragment_tx.active && !_bc_radio.fragment_tx.waiting && _bc_radio.fragment_tx.pending != 0)
+    {
+        uint8_t index = 0;
+
+        while ((_bc_radio.fragment_tx.pending & ((uint32_t) 1 << index)) == 0)
+        {
+            index++;
+        }
+
+        size_t offset = index * BC_RADIO_FRAGMENT_DATA_SIZE;
+        size_t length = _bc_radio.fragment_tx.length - offset;
+
+        if (length > BC_RADIO_FRAGMENT_DATA_SIZE)
+        {
+            length = BC_RADIO_FRAGMENT_DATA_SIZE;
+        }
+
+        uint8_t buffer[BC_RADIO_FRAGMENT_HEADER_LENGTH + BC_RADIO_FRAGMENT_DATA_SIZE];
+
+        buffer[0] = BC_RADIO_HEADER_FRAGMENT;
+        buffer[1] = _bc_radio.fragment_tx.id;
+        buffer[2] = index;
+        buffer[3] = _bc_radio.fragment_tx.count;
+
+        memcpy(&buffer[BC_RADIO_FRAGMENT_HEADER_LENGTH], &_bc_radio.fragment_tx.buffer[offset], length);
+
+        // Full queue only holds fragments back until previous ones are sent
+        if (!bc_queue_put(&_bc_radio.pub_queue, buffer, BC_RADIO_FRAGMENT_HEADER_LENGTH + length))
+        {
+            return;
+        }
+
+        _bc_radio.stats.queued++;
+
+        _bc_radio_update_high_water();
+
+        _bc_radio.fragment_tx.pending &= ~((uint32_t) 1 << index);
+    }
+}
+
+static void _bc_radio_fragment_receive(uint32_t device_address, uint8_t *buffer, size_t length)
+{
+    if (length < BC_RADIO_FRAGMENT_HEADER_LENGTH)
+    {
+        return;
+    }
+
+    uint8_t id = buffer[1];
+    uint8_t index = buffer[2];
+    uint8_t count = buffer[3];
+
+    size_t data_length = length - BC_RADIO_FRAGMENT_HEADER_LENGTH;
+    size_t offset = index * BC_RADIO_FRAGMENT_DATA_SIZE;
+
+    if (count == 0 || count > BC_RADIO_FRAGMENT_MAX_COUNT || index >= count || offset + data_length > BC_RADIO_BUFFER_MAX_SIZE)
+    {
+        return;
+    }
+
+    // All fragments except last one are full
+    if (index != count - 1 && data_length != BC_RADIO_FRAGMENT_DATA_SIZE)
+    {
+        return;
+    }
+
+    bc_tick_t now = bc_tick_get();
+
+    if (_bc_radio.fragment_rx.active && (_bc_radio.fragment_rx.device_address != device_address || _bc_radio.fragment_rx.id != id))
+    {
+        // Other sender keeps retrying until current transfer completes or times out
+        if (!_bc_radio.fragment_rx.complete && now < _bc_radio.fragment_rx.tick + BC_RADIO_FRAGMENT_REASSEMBLY_TIMEOUT)
+        {
+            return;
+        }
+
+        _bc_radio.fragment_rx.active = false;
+    }
+
+    if (!_bc_radio.fragment_rx.active)
+    {
+        _bc_radio.fragment_rx.active = true;
+        _bc_radio.fragment_rx.complete = false;
+        _bc_radio.fragment_rx.device_address = device_address;
+        _bc_radio.fragment_rx.id = id;
+        _bc_radio.fragment_rx.count = count;
+        _bc_radio.fragment_rx.received = 0;
+        _bc_radio.fragment_rx.length = 0;
+    }
+
+    if (count != _bc_radio.fragment_rx.count)
+    {
+        return;
+    }
+
+    _bc_radio.fragment_rx.tick = now;
+
+    if (!_bc_radio.fragment_rx.complete)
+    {
+        memcpy(&_bc_radio.fragment_rx.buffer[offset], &buffer[BC_RADIO_FRAGMENT_HEADER_LENGTH], data_length);
+
+        _bc_radio.fragment_rx.received |= (uint32_t) 1 << index;
+
+        if (index == count - 1)
+        {
+            _bc_radio.fragment_rx.length = offset + data_length;
+        }
+    }
+
+    uint32_t all = count == 32 ? 0xffffffff : ((uint32_t) 1 << count) - 1;
+
+    if (!_bc_radio.fragment_rx.complete && _bc_radio.fragment_rx.received == all)
+    {
+        _bc_radio.fragment_rx.complete = true;
+
+        size_t buffer_length = _bc_radio.fragment_rx.length;
+
+        bc_radio_on_buffer(&device_address, _bc_radio.fragment_rx.buffer, &buffer_length);
+    }
+
+    // Answer last fragment of every round, sender waits for it before retransmitting
+    if (index == count - 1)
+    {
+        _bc_radio.fragment_rx.nack = true;
+        _bc_radio.fragment_rx.nack_tick = now + BC_RADIO_FRAGMENT_ACK_DELAY;
+
+        bc_scheduler_plan_absolute(_bc_radio.task_id, _bc_radio.fragment_rx.nack_tick);
+    }
+}
+
+static void _bc_radio_fragment_send_nack(void)
+{
+    _bc_radio.fragment_rx.nack = false;
+
+    uint32_t all = _bc_radio.fragment_rx.count == 32 ? 0xffffffff : ((uint32_t) 1 << _bc_radio.fragment_rx.count) - 1;
+    uint32_t missing = all & ~_bc_radio.fragment_rx.received;
+
+    uint8_t *buffer = bc_spirit1_get_tx_buffer();
+
+    size_t length = _bc_radio_begin_frame(buffer);
+
+    buffer[length++] = BC_RADIO_HEADER_FRAGMENT_NACK;
+
+    memcpy(&buffer[length], &_bc_radio.fragment_rx.device_address, sizeof(uint32_t));
+    length += sizeof(uint32_t);
+
+    buffer[length++] = _bc_radio.fragment_rx.id;
+
+    memcpy(&buffer[length], &missing, sizeof(missing));
+    length += sizeof(missing);
+
+    _bc_radio_transmit(length, 0);
+}
+
+static void _bc_radio_fragment_on_nack(uint8_t id, uint32_t missing)
+{
+    if (!_bc_radio.fragment_tx.active || id != _bc_radio.fragment_tx.id)
+    {
+        return;
+    }
+
+    _bc_radio.fragment_tx.waiting = false;
+
+    if (missing == 0)
+    {
+        _bc_radio.fragment_tx.active = false;
+    }
+    else
+    {
+        // Last fragment is always repeated to trigger next answer
+        _bc_radio.fragment_tx.pending |= missing | ((uint32_t) 1 << (_bc_radio.fragment_tx.count - 1));
+    }
+
+    _bc_radio_rx_resume();
+
+    bc_scheduler_plan_now(_bc_radio.task_id);
+}
+
+static void _bc_radio_fragment_on_timeout(void)
+{
+    _bc_radio.fragment_tx.waiting = false;
+
+    if (++_bc_radio.fragment_tx.retries >= BC_RADIO_FRAGMENT_MAX_RETRIES)
+    {
+        _bc_radio.fragment_tx.active = false;
+
+        return;
+    }
+
+    _bc_radio.fragment_tx.pending |= (uint32_t) 1 << (_bc_radio.fragment_tx.count - 1);
+}
+
+static bool _bc_radio_bulk_feed(bc_tick_t now, bc_tick_t *next)
+{
+    // Frame waiting for its acknowledgement is not disturbed
+    if (!_bc_radio.bulk_tx.active || _bc_radio.ack_tx.waiting)
+    {
+        return false;
+    }
+
+    if (_bc_radio.bulk_tx.waiting)
+    {
+        if (now < _bc_radio.bulk_tx.wait_end)
+        {
+            if (_bc_radio.bulk_tx.wait_end < *next)
+            {
+                *next = _bc_radio.bulk_tx.wait_end;
+            }
+
+            return false;
+        }
+
+        // Request or answer was lost, oldest unacknowledged frame asks again
+        _bc_radio.bulk_tx.waiting = false;
+
+        if (++_bc_radio.bulk_tx.retries > BC_RADIO_BULK_MAX_RETRIES)
+        {
+            // Receiver addressed by notice may have gone to sleep, it is told again with next one
+            if (_bc_radio.bulk_tx.device_address != 0)
+            {
+                _bc_radio.bulk_tx.noticed = false;
+                _bc_radio.bulk_tx.retries = 0;
+                _bc_radio.bulk_tx.start = now;
+            }
+            else
+            {
+                _bc_radio_bulk_finish(false);
+
+                return false;
+            }
+        }
+
+        _bc_radio.bulk_tx.poll = true;
+    }
+
+    if (_bc_radio.bulk_tx.device_address != 0 && !_bc_radio.bulk_tx.noticed)
+    {
+        if (now - _bc_radio.bulk_tx.start >= BC_RADIO_BULK_NOTICE_TIMEOUT)
+        {
+            _bc_radio_bulk_finish(false);
+        }
+
+        return false;
+    }
+
+    if (now < _bc_radio.bulk_tx.tick)
+    {
+        if (_bc_radio.bulk_tx.tick < *next)
+        {
+            *next = _bc_radio.bulk_tx.tick;
+        }
+
+        return false;
+    }
+
+    uint8_t *buffer = bc_spirit1_get_tx_buffer();
+
+    size_t length = _bc_radio_begin_frame(buffer);
+
+    if (!_bc_radio.bulk_tx.open)
+    {
+        buffer[length++] = BC_RADIO_HEADER_BULK_OPEN;
+        buffer[length++] = _bc_radio.bulk_tx.session;
+
+        memcpy(&buffer[length], &_bc_radio.bulk_tx.length, sizeof(uint32_t));
+        length += sizeof(uint32_t);
+
+        memcpy(&buffer[length], &_bc_radio.bulk_tx.device_address, sizeof(uint32_t));
+        length += sizeof(uint32_t);
+
+        buffer[length++] = _bc_radio.bulk_tx.type;
+
+        _bc_radio.bulk_tx.request = true;
+
+        _bc_radio_transmit(length, 0);
+
+        return true;
+    }
+
+    uint16_t sequence;
+    bool request = false;
+
+    if (_bc_radio.bulk_tx.poll)
+    {
+        _bc_radio.bulk_tx.poll = false;
+
+        sequence = _bc_radio.bulk_tx.base;
+        request = true;
+    }
+    else if (_bc_radio.bulk_tx.resend != 0)
+    {
+        uint8_t index = 0;
+
+        while ((_bc_radio.bulk_tx.resend & ((uint32_t) 1 << index)) == 0)
+        {
+            index++;
+        }
+
+        _bc_radio.bulk_tx.resend &= ~((uint32_t) 1 << index);
+
+        sequence = _bc_radio.bulk_tx.base + index;
+    }
+    else if (_bc_radio.bulk_tx.next < _bc_radio.bulk_tx.count && (uint16_t) (_bc_radio.bulk_tx.next - _bc_radio.bulk_tx.base) < BC_RADIO_BULK_WINDOW)
+    {
+        sequence = _bc_radio.bulk_tx.next++;
+    }
+    else
+    {
+        return false;
+    }
+
+    // Last frame which can be sent now asks for acknowledgement
+    if (_bc_radio.bulk_tx.resend == 0 && (_bc_radio.bulk_tx.next == _bc_radio.bulk_tx.count || (uint16_t) (_bc_radio.bulk_tx.next - _bc_radio.bulk_tx.base) == BC_RADIO_BULK_WINDOW))
+    {
+        request = true;
+    }
+
+    uint32_t offset = (uint32_t) sequence * BC_RADIO_BULK_DATA_SIZE;
+    size_t data_length = _bc_radio.bulk_tx.length - offset < BC_RADIO_BULK_DATA_SIZE ? _bc_radio.bulk_tx.length - offset : BC_RADIO_BULK_DATA_SIZE;
+
+    buffer[length++] = BC_RADIO_HEADER_BULK_DATA;
+    buffer[length++] = _bc_radio.bulk_tx.session;
+
+    memcpy(&buffer[length], &sequence, sizeof(sequence));
+    length += sizeof(sequence);
+
+    buffer[length++] = request ? BC_RADIO_BULK_FLAG_REQUEST : 0;
+
+    if (!_bc_radio.bulk_tx.read(offset, &buffer[length], data_length, _bc_radio.bulk_tx.param))
+    {
+        _bc_radio_bulk_finish(false);
+
+        return false;
+    }
+
+    _bc_radio.bulk_tx.request = request;
+
+    _bc_radio_transmit(length + data_length, 0);
+
+    return true;
+}
+
+static void _bc_radio_bulk_finish(bool success)
+{
+    _bc_radio.bulk_tx.active = false;
+    _bc_radio.bulk_tx.waiting = false;
+    _bc_radio.bulk_tx.request = false;
+    _bc_radio.bulk_tx.notice = false;
+
+    if (_bc_radio.event_handler != NULL)
+    {
+        _bc_radio.event_handler(success ? BC_RADIO_EVENT_BULK_DONE : BC_RADIO_EVENT_BULK_FAILURE, _bc_radio.event_param);
+    }
+}
+
+static void _bc_radio_bulk_receive(uint32_t device_address, uint8_t *payload, size_t length)
+{
+    if (payload[0] == BC_RADIO_HEADER_BULK_ACK)
+    {
+        uint32_t destination;
+
+        if (length != BC_RADIO_BULK_ACK_LENGTH)
+        {
+            return;
+        }
+
+        memcpy(&destination, &payload[2], sizeof(destination));
+
+        if (destination == _bc_radio.device_address && _bc_radio.bulk_tx.active && payload[1] == _bc_radio.bulk_tx.session && (_bc_radio.bulk_tx.device_address == 0 || device_address == _bc_radio.bulk_tx.device_address))
+        {
+            _bc_radio_bulk_on_ack(payload);
+        }
+
+        return;
+    }
+
+    if (payload[0] == BC_RADIO_HEADER_BULK_NOTICE)
+    {
+        return;
+    }
+
+    bc_tick_t now = bc_tick_get();
+
+    bool current = _bc_radio.bulk_rx.active && _bc_radio.bulk_rx.device_address == device_address && _bc_radio.bulk_rx.session == payload[1];
+
+    if (payload[0] == BC_RADIO_HEADER_BULK_OPEN && length == BC_RADIO_BULK_OPEN_LENGTH)
+    {
+        uint32_t total;
+        uint32_t destination;
+
+        memcpy(&total, &payload[2], sizeof(total));
+        memcpy(&destination, &payload[6], sizeof(destination));
+
+        // Transfer without destination comes from enrolled peer, transfer for this node from its gateway
+        if (destination == 0 && _bc_radio_get_peer(device_address) == NULL)
+        {
+            _bc_radio.stats.foreign++;
+
+            return;
+        }
+
+        if (destination != 0 && (destination != _bc_radio.device_address || (_bc_radio.tdma.gateway_known && device_address != _bc_radio.tdma.gateway_address)))
+        {
+            return;
+        }
+
+        if (destination != 0)
+        {
+            _bc_radio_bulk_listen();
+        }
+
+        uint8_t status = BC_RADIO_BULK_STATUS_OK;
+
+        // Repeated request of running session keeps what was received, finished session can only be started again
+        if (current && !_bc_radio.bulk_rx.complete)
+        {
+            _bc_radio.bulk_rx.tick = now;
+        }
+        else if (_bc_radio.bulk_rx.active && !_bc_radio.bulk_rx.complete && _bc_radio.bulk_rx.device_address != device_address && now - _bc_radio.bulk_rx.tick < BC_RADIO_BULK_RX_TIMEOUT)
+        {
+            status = BC_RADIO_BULK_STATUS_REFUSED;
+        }
+        else if (total == 0 || (total + BC_RADIO_BULK_DATA_SIZE - 1) / BC_RADIO_BULK_DATA_SIZE > UINT16_MAX || (_bc_radio.bulk_rx.sink_size != 0 && total > _bc_radio.bulk_rx.sink_size))
+        {
+            status = BC_RADIO_BULK_STATUS_REFUSED;
+        }
+        else
+        {
+            _bc_radio.bulk_rx.active = true;
+            _bc_radio.bulk_rx.complete = false;
+            _bc_radio.bulk_rx.device_address = device_address;
+            _bc_radio.bulk_rx.session = payload[1];
+            _bc_radio.bulk_rx.type = payload[10];
+            _bc_radio.bulk_rx.length = total;
+            _bc_radio.bulk_rx.count = (total + BC_RADIO_BULK_DATA_SIZE - 1) / BC_RADIO_BULK_DATA_SIZE;
+            _bc_radio.bulk_rx.cumulative = 0;
+            _bc_radio.bulk_rx.received = 0;
+            _bc_radio.bulk_rx.tick = now;
+        }
+
+        _bc_radio.bulk_rx.ack = true;
+        _bc_radio.bulk_rx.ack_tick = now + BC_RADIO_BULK_ACK_DELAY;
+        _bc_radio.bulk_rx.ack_device_address = device_address;
+        _bc_radio.bulk_rx.ack_session = payload[1];
+        _bc_radio.bulk_rx.ack_status = status;
+
+        bc_scheduler_plan_now(_bc_radio.task_id);
+    }
+    else if (payload[0] == BC_RADIO_HEADER_BULK_DATA && length > BC_RADIO_BULK_HEADER_LENGTH && current)
+    {
+        _bc_radio.bulk_rx.tick = now;
+
+        if (_bc_radio.bulk_rx.listen)
+        {
+            _bc_radio_bulk_listen();
+        }
+
+        _bc_radio_bulk_on_data(payload, length);
+
+        if ((payload[4] & BC_RADIO_BULK_FLAG_REQUEST) != 0)
+        {
+            _bc_radio.bulk_rx.ack = true;
+            _bc_radio.bulk_rx.ack_tick = now + BC_RADIO_BULK_ACK_DELAY;
+            _bc_radio.bulk_rx.ack_device_address = device_address;
+            _bc_radio.bulk_rx.ack_session = payload[1];
+            _bc_radio.bulk_rx.ack_status = BC_RADIO_BULK_STATUS_OK;
+
+            bc_scheduler_plan_now(_bc_radio.task_id);
+        }
+    }
+}
+
+static void _bc_radio_bulk_on_data(uint8_t *payload, size_t length)
+{
+    uint16_t sequence;
+
+    memcpy(&sequence, &payload[2], sizeof(sequence));
+
+    uint32_t offset = (uint32_t) sequence * BC_RADIO_BULK_DATA_SIZE;
+    size_t data_length = length - BC_RADIO_BULK_HEADER_LENGTH;
+    uint16_t index = sequence - _bc_radio.bulk_rx.cumulative;
+
+    // Frame which was already received or lies beyond window is only answered
+    if (_bc_radio.bulk_rx.complete || sequence >= _bc_radio.bulk_rx.count || index >= 32 || (_bc_radio.bulk_rx.received & ((uint32_t) 1 << index)) != 0)
+    {
+        _bc_radio.stats.duplicate++;
+
+        return;
+    }
+
+    if (offset + data_length > _bc_radio.bulk_rx.length || (data_length != BC_RADIO_BULK_DATA_SIZE && offset + data_length != _bc_radio.bulk_rx.length))
+    {
+        return;
+    }
+
+    if (_bc_radio.bulk_rx.sink_size != 0)
+    {
+        bc_eeprom_write(_bc_radio.bulk_rx.sink_address + offset, &payload[BC_RADIO_BULK_HEADER_LENGTH], data_length);
+    }
+
+    bc_radio_on_bulk(&_bc_radio.bulk_rx.device_address, &offset, &payload[BC_RADIO_BULK_HEADER_LENGTH], &data_length);
+
+    _bc_radio.bulk_rx.received |= (uint32_t) 1 << index;
+
+    while ((_bc_radio.bulk_rx.received & 1) != 0)
+    {
+        _bc_radio.bulk_rx.received >>= 1;
+        _bc_radio.bulk_rx.cumulative++;
+    }
+
+    if (_bc_radio.bulk_rx.cumulative == _bc_radio.bulk_rx.count)
+    {
+        _bc_radio.bulk_rx.complete = true;
+
+        uint32_t total = _bc_radio.bulk_rx.length;
+        size_t zero = 0;
+
+        bc_radio_on_bulk(&_bc_radio.bulk_rx.device_address, &total, NULL, &zero);
+    }
+}
+
+static void _bc_radio_bulk_on_ack(uint8_t *payload)
+{
+    uint16_t cumulative;
+    uint32_t received;
+
+    memcpy(&cumulative, &payload[7], sizeof(cumulative));
+    memcpy(&received, &payload[9], sizeof(received));
+
+    if (payload[6] != BC_RADIO_BULK_STATUS_OK)
+    {
+        _bc_radio_bulk_finish(false);
+
+        _bc_radio_rx_resume();
+
+        return;
+    }
+
+    // Answer to earlier request may come late, it must not move window back
+    if ((uint16_t) (cumulative - _bc_radio.bulk_tx.base) > (uint16_t) (_bc_radio.bulk_tx.next - _bc_radio.bulk_tx.base))
+    {
+        return;
+    }
+
+    // Answer replaces poll which may be pending since opening was repeated
+    _bc_radio.bulk_tx.open = true;
+    _bc_radio.bulk_tx.poll = false;
+    _bc_radio.bulk_tx.waiting = false;
+    _bc_radio.bulk_tx.retries = 0;
+
+    // Receiver is given time to switch back to reception after its answer
+    _bc_radio.bulk_tx.tick = bc_tick_get() + BC_RADIO_BULK_ACK_DELAY;
+    _bc_radio.bulk_tx.base = cumulative;
+    _bc_radio.bulk_tx.acknowledged = received;
+
+    if (cumulative == _bc_radio.bulk_tx.count)
+    {
+        _bc_radio_bulk_finish(true);
+    }
+    else
+    {
+        // Every frame sent before request which is still missing was lost
+        uint16_t outstanding = _bc_radio.bulk_tx.next - _bc_radio.bulk_tx.base;
+        uint32_t sent = outstanding >= 32 ? 0xffffffff : ((uint32_t) 1 << outstanding) - 1;
+
+        _bc_radio.bulk_tx.resend = sent & ~received;
+    }
+
+    _bc_radio_rx_resume();
+
+    bc_scheduler_plan_now(_bc_radio.task_id);
+}
+
+static void _bc_radio_bulk_send_ack(void)
+{
+    _bc_radio.bulk_rx.ack = false;
+
+    uint8_t *buffer = bc_spirit1_get_tx_buffer();
+
+    size_t length = _bc_radio_begin_frame(buffer);
+
+    buffer[length++] = BC_RADIO_HEADER_BULK_ACK;
+    buffer[length++] = _bc_radio.bulk_rx.ack_session;
+
+    memcpy(&buffer[length], &_bc_radio.bulk_rx.ack_device_address, sizeof(uint32_t));
+    length += sizeof(uint32_t);
+
+    buffer[length++] = _bc_radio.bulk_rx.ack_status;
+
+    uint16_t cumulative = 0;
+    uint32_t received = 0;
+
+    if (_bc_radio.bulk_rx.ack_status == BC_RADIO_BULK_STATUS_OK)
+    {
+        cumulative = _bc_radio.bulk_rx.cumulative;
+        received = _bc_radio.bulk_rx.received;
+    }
+
+    memcpy(&buffer[length], &cumulative, sizeof(cumulative));
+    length += sizeof(cumulative);
+    memcpy(&buffer[length], &received, sizeof(received));
+    length += sizeof(received);
+
+    _bc_radio_transmit(length, 0);
+}
+
+static size_t _bc_radio_bulk_notice(uint8_t *buffer, size_t length)
+{
+    if (!_bc_radio.bulk_tx.active || _bc_radio.bulk_tx.noticed || _bc_radio.bulk_tx.device_address == 0)
+    {
+        return length;
+    }
+
+    _bc_radio.bulk_tx.notice = true;
+
+    buffer[length++] = BC_RADIO_HEADER_BULK_NOTICE;
+
+    memcpy(&buffer[length], &_bc_radio.bulk_tx.device_address, sizeof(uint32_t));
+
+    return length + sizeof(uint32_t);
+}
+
+static void _bc_radio_bulk_on_notice(uint32_t device_address, uint8_t *buffer)
+{
+    uint32_t destination;
+
+    memcpy(&destination, &buffer[1], sizeof(destination));
+
+    if (destination != _bc_radio.device_address || (_bc_radio.tdma.gateway_known && device_address != _bc_radio.tdma.gateway_address))
+    {
+        return;
+    }
+
+    _bc_radio_bulk_listen();
+}
+
+static void _bc_radio_bulk_listen(void)
+{
+    _bc_radio.bulk_rx.listen = true;
+    _bc_radio.bulk_rx.listen_end = bc_tick_get() + BC_RADIO_BULK_LISTEN_TIME;
+
+    _bc_radio_rx_resume();
+}
+
+static uint8_t *_bc_radio_next_item(uint8_t *payload, size_t length, size_t *offset, size_t *item_length)
+{
+    // Payload is either single item or bundle of length-prefixed items
+    if (payload[0] != BC_RADIO_HEADER_PUB_BUNDLE)
+    {
+        if (*offset != 0)
+        {
+            return NULL;
+        }
+
+        *offset = length;
+        *item_length = length;
+
+        return payload;
+    }
+
+    if (*offset == 0)
+    {
+        *offset = 1;
+    }
+
+    if (*offset >= length)
+    {
+        return NULL;
+    }
+
+    *item_length = payload[(*offset)++];
+
+    if (*item_length == 0 || *offset + *item_length > length)
+    {
+        return NULL;
+    }
+
+    uint8_t *item = &payload[*offset];
+
+    *offset += *item_length;
+
+    return item;
+}
+
+static size_t _bc_radio_ack_request(uint8_t *buffer, size_t length, uint8_t header, size_t payload_length)
+{
+    // Fragments have own acknowledgement, frame already full goes without request
+    if (!_bc_radio.log.enabled || header == BC_RADIO_HEADER_FRAGMENT || length + 1 + payload_length > BC_SPIRIT1_MAX_PACKET_SIZE)
+    {
+        return length;
+    }
+
+    buffer[length++] = BC_RADIO_HEADER_ACK_REQUEST;
+
+    return length;
+}
+
+static void _bc_radio_ack_queue(uint32_t device_address, uint16_t message_id)
+{
+    for (size_t i = 0; i < _bc_radio.ack_rx.count; i++)
+    {
+        if (_bc_radio.ack_rx.entries[i].device_address == device_address && _bc_radio.ack_rx.entries[i].message_id == message_id)
+        {
+            return;
+        }
+    }
+
+    // Sender retries with next copy of frame
+    if (_bc_radio.ack_rx.count == BC_RADIO_ACK_MAX_ENTRIES)
+    {
+        return;
+    }
+
+    // Frames heard in the meantime are acknowledged together
+    if (_bc_radio.ack_rx.count == 0)
+    {
+        _bc_radio.ack_rx.tick = bc_tick_get() + BC_RADIO_ACK_DELAY;
+
+        bc_scheduler_plan_absolute(_bc_radio.task_id, _bc_radio.ack_rx.tick);
+    }
+
+    _bc_radio.ack_rx.entries[_bc_radio.ack_rx.count].device_address = device_address;
+    _bc_radio.ack_rx.entries[_bc_radio.ack_rx.count].message_id = message_id;
+
+    _bc_radio.ack_rx.count++;
+}
+
+static void _bc_radio_ack_send(void)
+{
+    uint8_t *buffer = bc_spirit1_get_tx_buffer();
+
+    size_t length = _bc_radio_begin_frame(buffer);
+
+    length = _bc_radio_channel_announce(buffer, length);
+
+    // Notice is useful only to receiver which is awake for this acknowledgement
+    for (size_t i = 0; i < _bc_radio.ack_rx.count; i++)
+    {
+        if (_bc_radio.ack_rx.entries[i].device_address == _bc_radio.bulk_tx.device_address)
+        {
+            length = _bc_radio_bulk_notice(buffer, length);
+
+            break;
+        }
+    }
+
+    buffer[length++] = BC_RADIO_HEADER_ACK;
+
+    for (size_t i = 0; i < _bc_radio.ack_rx.count; i++)
+    {
+        memcpy(&buffer[length], &_bc_radio.ack_rx.entries[i].device_address, sizeof(uint32_t));
+        length += sizeof(uint32_t);
+        memcpy(&buffer[length], &_bc_radio.ack_rx.entries[i].message_id, sizeof(uint16_t));
+        length += sizeof(uint16_t);
+    }
+
+    _bc_radio.ack_rx.count = 0;
+
+    _bc_radio_transmit(length, 0);
+}
+
+static void _bc_radio_ack_on_ack(uint8_t *buffer, size_t length)
+{
+    bool acknowledged = false;
+
+    // Gateway acknowledges frames of several senders at once
+    for (size_t offset = 1; _bc_radio.ack_tx.pending && offset + BC_RADIO_ACK_ENTRY_LENGTH <= length; offset += BC_RADIO_ACK_ENTRY_LENGTH)
+    {
+        uint32_t device_address;
+        uint16_t message_id;
+
+        memcpy(&device_address, &buffer[offset], sizeof(device_address));
+        memcpy(&message_id, &buffer[offset + sizeof(device_address)], sizeof(message_id));
+
+        if (device_address == _bc_radio.device_address && message_id == _bc_radio.ack_tx.message_id)
+        {
+            acknowledged = true;
+
+            break;
+        }
+    }
+
+    if (!acknowledged)
+    {
+        return;
+    }
+
+    _bc_radio.ack_tx.pending = false;
+    _bc_radio.ack_tx.waiting = false;
+
+    // Remaining repetitions are not needed any more
+    _bc_radio.transmit_count = 0;
+
+    _bc_radio.log.link = true;
+
+    size_t offset = 0;
+    size_t item_length;
+    uint8_t *item;
+
+    // Replayed records are delivered, they are removed from log
+    while ((item = _bc_radio_next_item(_bc_radio.ack_tx.buffer, _bc_radio.ack_tx.length, &offset, &item_length)) != NULL)
+    {
+        if (item[0] == BC_RADIO_HEADER_PUB_REPLAY && item_length > BC_RADIO_REPLAY_HEADER_LENGTH)
+        {
+            uint16_t sequence;
+
+            memcpy(&sequence, &item[1], sizeof(sequence));
+
+            _bc_radio_log_invalidate(sequence);
+
+            _bc_radio.stats.replayed++;
+        }
+    }
+
+    _bc_radio_rx_resume();
+
+    bc_scheduler_plan_now(_bc_radio.task_id);
+}
+
+static void _bc_radio_ack_on_timeout(void)
+{
+    _bc_radio.ack_tx.pending = false;
+    _bc_radio.ack_tx.waiting = false;
+
+    _bc_radio.stats.ack_missed++;
+
+    _bc_radio.log.link = false;
+
+    uint32_t time = _bc_radio_log_time();
+    size_t offset = 0;
+    size_t item_length;
+    uint8_t *item;
+
+    // Readings are kept for replay, replayed ones are still in log
+    while ((item = _bc_radio_next_item(_bc_radio.ack_tx.buffer, _bc_radio.ack_tx.length, &offset, &item_length)) != NULL)
+    {
+        if (item[0] != BC_RADIO_HEADER_PUB_REPLAY && item[0] != BC_RADIO_HEADER_FRAGMENT && item_length <= BC_RADIO_LOG_ITEM_SIZE)
+        {
+            _bc_radio_log_append(item, item_length, time, _bc_radio.ack_tx.message_id);
+        }
+    }
+
+    // Replay starts over from oldest record once gateway answers again
+    _bc_radio.log.replay = _bc_radio.log.tail;
+}
+
+static void _bc_radio_profile_load(void)
+{
+    uint8_t record[BC_RADIO_PROFILE_RECORD_SIZE];
+
+    if (!bc_eeprom_read(BC_RADIO_EEPROM_PROFILE, record, sizeof(record)))
+    {
+        return;
+    }
+
+    // Without stored profile driver keeps compile-time one
+    if ((0xa5 ^ record[0] ^ record[1] ^ record[2] ^ record[3] ^ record[4]) != 0)
+    {
+        return;
+    }
+
+    bc_spirit1_profile_t profile;
+
+    profile.channel = record[0];
+    profile.datarate = record[1];
+    profile.fec = record[2] != 0;
+    profile.power = (int8_t) record[3];
+
+    bc_spirit1_set_profile(&profile);
+}
+
+static void _bc_radio_survey_feed(void)
+{
+    bc_tick_t now = bc_tick_get();
+    bc_radio_survey_channel_t *channel = &_bc_radio.survey.result.channels[_bc_radio.survey.index];
+    float rssi;
+
+    // Radio is not asleep yet right after start or while frame is on air
+    if (bc_spirit1_measure_rssi(channel->channel, &rssi))
+    {
+        if (channel->samples == 0 || rssi > channel->rssi_max)
+        {
+            channel->rssi_max = rssi;
+        }
+
+        if (rssi > BC_RADIO_SURVEY_BUSY_THRESHOLD)
+        {
+            channel->busy++;
+        }
+
+        channel->samples++;
+
+        _bc_radio.survey.rssi_sum += rssi;
+    }
+
+    if (now >= _bc_radio.survey.channel_end)
+    {
+        channel->rssi_average = channel->samples != 0 ? _bc_radio.survey.rssi_sum / channel->samples : 0;
+
+        _bc_radio.survey.rssi_sum = 0;
+        _bc_radio.survey.index++;
+
+        if (_bc_radio.survey.index == _bc_radio.survey.result.count)
+        {
+            _bc_radio_survey_finish();
+
+            return;
+        }
+
+        _bc_radio.survey.channel_end = now + _bc_radio.survey.dwell;
+    }
+
+    bc_scheduler_plan_current_relative(BC_RADIO_SURVEY_SAMPLE_INTERVAL);
+}
+
+static void _bc_radio_survey_finish(void)
+{
+    bc_radio_survey_t *result = &_bc_radio.survey.result;
+    bc_radio_survey_channel_t *quietest = NULL;
+    bc_spirit1_profile_t profile;
+
+    bc_radio_get_profile(&profile);
+
+    for (size_t i = 0; i < result->count; i++)
+    {
+        bc_radio_survey_channel_t *channel = &result->channels[i];
+
+        if (channel->samples == 0)
+        {
+            continue;
+        }
+
+        if (quietest == NULL)
+        {
+            quietest = channel;
+
+            continue;
+        }
+
+        // Share of busy samples decides, average level breaks ties
+        uint32_t busy = (uint32_t) channel->busy * quietest->samples;
+        uint32_t quietest_busy = (uint32_t) quietest->busy * channel->samples;
+
+        if (busy < quietest_busy || (busy == quietest_busy && channel->rssi_average < quietest->rssi_average))
+        {
+            quietest = channel;
+        }
+    }
+
+    result->quietest = quietest != NULL ? quietest->channel : profile.channel;
+
+    _bc_radio.survey.active = false;
+
+    if (_bc_radio.survey.apply && result->quietest != profile.channel)
+    {
+        _bc_radio.channel.pending = true;
+        _bc_radio.channel.channel = result->quietest;
+        _bc_radio.channel.tick = bc_tick_get() + BC_RADIO_CHANNEL_ANNOUNCE_TIME;
+    }
+
+    _bc_radio_rx_resume();
+
+    if (_bc_radio.event_handler != NULL)
+    {
+        _bc_radio.event_handler(BC_RADIO_EVENT_SURVEY_DONE, _bc_radio.event_param);
+    }
+
+    bc_scheduler_plan_current_now();
+}
+
+static size_t _bc_radio_channel_announce(uint8_t *buffer, size_t length)
+{
+    if (!_bc_radio.channel.pending)
+    {
+        return length;
+    }
+
+    bc_tick_t now = bc_tick_get();
+    uint32_t remaining = _bc_radio.channel.tick > now ? _bc_radio.channel.tick - now : 0;
+
+    buffer[length++] = BC_RADIO_HEADER_CHANNEL;
+    buffer[length++] = _bc_radio.channel.channel;
+
+    memcpy(&buffer[length], &remaining, sizeof(remaining));
+
+    return length + sizeof(remaining);
+}
+
+static void _bc_radio_channel_on_announce(uint32_t device_address, uint8_t *buffer)
+{
+    // Node with enrolled peers is gateway itself and chooses its channel alone
+    for (size_t i = 0; i < BC_RADIO_MAX_PEERS; i++)
+    {
+        if (_bc_radio.peers[i].device_address != 0)
+        {
+            return;
+        }
+    }
+
+    // Other gateway of same network may be heard too
+    if (_bc_radio.tdma.gateway_known && device_address != _bc_radio.tdma.gateway_address)
+    {
+        return;
+    }
+
+    uint32_t remaining;
+
+    memcpy(&remaining, &buffer[2], sizeof(remaining));
+
+    // Every announcement carries remaining time, so nodes switch together with gateway
+    _bc_radio.channel.pending = true;
+    _bc_radio.channel.channel = buffer[1];
+    _bc_radio.channel.tick = bc_tick_get() + remaining;
+
+    bc_scheduler_plan_now(_bc_radio.task_id);
+}
+
+static void _bc_radio_channel_switch(void)
+{
+    bc_spirit1_profile_t profile;
+
+    _bc_radio.channel.pending = false;
+
+    bc_radio_get_profile(&profile);
+
+    profile.channel = _bc_radio.channel.channel;
+
+    // Stored like any other profile change, node stays on new channel after restart
+    bc_radio_set_profile(&profile);
+}
+
+static void _bc_radio_log_recover(void)
+{
+    uint8_t record[BC_RADIO_LOG_RECORD_SIZE];
+    bool found = false;
+    uint16_t reference = 0;
+    int16_t newest = 0;
+    int16_t oldest = 0;
+    uint32_t time = 0;
+
+    memset(_bc_radio.log.valid, 0, sizeof(_bc_radio.log.valid));
+
+    // Records survive restart, log continues after newest valid one
+    for (size_t i = 0; i < BC_RADIO_LOG_RECORD_COUNT; i++)
+    {
+        if (!bc_eeprom_read(BC_RADIO_EEPROM_LOG + i * BC_RADIO_LOG_RECORD_SIZE, record, sizeof(record)))
+        {
+            break;
+        }
+
+        uint8_t check = 0xa5;
+
+        for (size_t j = 0; j < sizeof(record); j++)
+        {
+            check ^= record[j];
+        }
+
+        uint16_t sequence;
+        uint32_t record_time;
+
+        memcpy(&sequence, &record[0], sizeof(sequence));
+        memcpy(&record_time, &record[2], sizeof(record_time));
+
+        // Erased, invalidated or torn record
+        if (check != 0 || record[8] == 0 || record[8] > BC_RADIO_LOG_ITEM_SIZE || sequence % BC_RADIO_LOG_RECORD_COUNT != i)
+        {
+            continue;
+        }
+
+        if (!found)
+        {
+            found = true;
+            reference = sequence;
+            time = record_time;
+        }
+
+        int16_t difference = sequence - reference;
+
+        if (difference >= BC_RADIO_LOG_RECORD_COUNT || difference <= -BC_RADIO_LOG_RECORD_COUNT)
+        {
+            continue;
+        }
+
+        if (difference > newest)
+        {
+            newest = difference;
+        }
+
+        if (difference < oldest)
+        {
+            oldest = difference;
+        }
+
+        if ((int32_t) (record_time - time) > 0)
+        {
+            time = record_time;
+        }
+
+        _bc_radio.log.valid[i / 32] |= (uint32_t) 1 << (i % 32);
+    }
+
+    _bc_radio.log.head = found ? (uint16_t) (reference + newest + 1) : 0;
+    _bc_radio.log.tail = found ? (uint16_t) (reference + oldest) : 0;
+
+    // Span of recovered sequence numbers is checked against record positions
+    if ((uint16_t) (_bc_radio.log.head - _bc_radio.log.tail) > BC_RADIO_LOG_RECORD_COUNT)
+    {
+        _bc_radio.log.tail = _bc_radio.log.head - BC_RADIO_LOG_RECORD_COUNT;
+    }
+
+    _bc_radio.log.replay = _bc_radio.log.tail;
+    _bc_radio.log.clock_offset = found ? time + 1 - bc_tick_get() : 0;
+}
+
+static void _bc_radio_log_append(const uint8_t *item, size_t length, uint32_t time, uint16_t message_id)
+{
+    uint8_t record[BC_RADIO_LOG_RECORD_SIZE];
+    uint16_t sequence = _bc_radio.log.head;
+
+    // Full log overwrites oldest record
+    if ((uint16_t) (_bc_radio.log.head - _bc_radio.log.tail) == BC_RADIO_LOG_RECORD_COUNT)
+    {
+        if (_bc_radio_log_is_valid(_bc_radio.log.tail))
+        {
+            _bc_radio.stats.log_overflow++;
+        }
+
+        if (_bc_radio.log.replay == _bc_radio.log.tail)
+        {
+            _bc_radio.log.replay++;
+        }
+
+        _bc_radio.log.tail++;
+    }
+
+    memset(record, 0, sizeof(record));
+
+    memcpy(&record[0], &sequence, sizeof(sequence));
+    memcpy(&record[2], &time, sizeof(time));
+    memcpy(&record[6], &message_id, sizeof(message_id));
+    record[8] = length;
+    memcpy(&record[10], item, length);
+
+    // Check byte makes XOR of whole record equal to constant, erased and torn records fail it
+    uint8_t check = 0xa5;
+
+    for (size_t i = 0; i < sizeof(record); i++)
+    {
+        check ^= record[i];
+    }
+
+    record[9] = check;
+
+    size_t index = sequence % BC_RADIO_LOG_RECORD_COUNT;
+
+    if (!bc_eeprom_write(BC_RADIO_EEPROM_LOG + index * BC_RADIO_LOG_RECORD_SIZE, record, sizeof(record)))
+    {
+        _bc_radio.stats.log_overflow++;
+
+        return;
+    }
+
+    _bc_radio.log.valid[index / 32] |= (uint32_t) 1 << (index % 32);
+
+    _bc_radio.log.head++;
+
+    _bc_radio.stats.logged++;
+}
+
+static void _bc_radio_log_invalidate(uint16_t sequence)
+{
+    if ((uint16_t) (sequence - _bc_radio.log.tail) >= (uint16_t) (_bc_radio.log.head - _bc_radio.log.tail) || !_bc_radio_log_is_valid(sequence))
+    {
+        return;
+    }
+
+    size_t index = sequence % BC_RADIO_LOG_RECORD_COUNT;
+
+    // Zero length fails check of record
+    uint8_t length = 0;
+
+    bc_eeprom_write(BC_RADIO_EEPROM_LOG + index * BC_RADIO_LOG_RECORD_SIZE + 8, &length, sizeof(length));
+
+    _bc_radio.log.valid[index / 32] &= ~((uint32_t) 1 << (index % 32));
+
+    while (_bc_radio.log.tail != _bc_radio.log.head && !_bc_radio_log_is_valid(_bc_radio.log.tail))
+    {
+        if (_bc_radio.log.replay == _bc_radio.log.tail)
+        {
+            _bc_radio.log.replay++;
+        }
+
+        _bc_radio.log.tail++;
+    }
+}
+
+static bool _bc_radio_log_is_valid(uint16_t sequence)
+{
+    size_t index = sequence % BC_RADIO_LOG_RECORD_COUNT;
+
+    return (_bc_radio.log.valid[index / 32] & ((uint32_t) 1 << (index % 32))) != 0;
+}
+
+static void _bc_radio_log_feed(bc_tick_t now, bc_tick_t *next)
+{
+    // Backlog is replayed only while gateway answers and live readings go first
+    if (!_bc_radio.log.enabled || !_bc_radio.log.link || _bc_radio.ack_tx.pending || !bc_queue_is_empty(&_bc_radio.pub_queue))
+    {
+        return;
+    }
+
+    while (_bc_radio.log.replay != _bc_radio.log.head && !_bc_radio_log_is_valid(_bc_radio.log.replay))
+    {
+        _bc_radio.log.replay++;
+    }
+
+    if (_bc_radio.log.replay == _bc_radio.log.head)
+    {
+        return;
+    }
+
+    if (now < _bc_radio.log.replay_tick)
+    {
+        if (_bc_radio.log.replay_tick < *next)
+        {
+            *next = _bc_radio.log.replay_tick;
+        }
+
+        return;
+    }
+
+    for (int i = 0; i < BC_RADIO_LOG_REPLAY_BURST && _bc_radio.log.replay != _bc_radio.log.head; _bc_radio.log.replay++)
+    {
+        uint16_t sequence = _bc_radio.log.replay;
+
+        if (!_bc_radio_log_is_valid(sequence))
+        {
+            continue;
+        }
+
+        uint8_t record[BC_RADIO_LOG_RECORD_SIZE];
+
+        if (!bc_eeprom_read(BC_RADIO_EEPROM_LOG + (sequence % BC_RADIO_LOG_RECORD_COUNT) * BC_RADIO_LOG_RECORD_SIZE, record, sizeof(record)))
+        {
+            break;
+        }
+
+        if (record[8] == 0 || record[8] > BC_RADIO_LOG_ITEM_SIZE)
+        {
+            continue;
+        }
+
+        // Replay item carries log time of record, it is turned into age when frame is sent
+        uint8_t buffer[BC_RADIO_REPLAY_HEADER_LENGTH + BC_RADIO_LOG_ITEM_SIZE];
+
+        buffer[0] = BC_RADIO_HEADER_PUB_REPLAY;
+
+        memcpy(&buffer[1], &sequence, sizeof(sequence));
+        memcpy(&buffer[3], &record[2], sizeof(uint32_t));
+        memcpy(&buffer[7], &record[6], sizeof(uint16_t));
+        memcpy(&buffer[BC_RADIO_REPLAY_HEADER_LENGTH], &record[10], record[8]);
+
+        if (!bc_queue_put(&_bc_radio.pub_queue, buffer, BC_RADIO_REPLAY_HEADER_LENGTH + record[8]))
+        {
+            break;
+        }
+
+        _bc_radio.stats.queued++;
+
+        _bc_radio_update_high_water();
+
+        i++;
+    }
+
+    _bc_radio.log.replay_tick = now + BC_RADIO_LOG_REPLAY_INTERVAL;
+}
+
+static uint32_t _bc_radio_log_time(void)
+{
+    return (uint32_t) bc_tick_get() + _bc_radio.log.clock_offset;
+}
+
+static void _bc_radio_rx_resume(void)
+{
+    // Survey uses radio by itself while it sleeps
+    if (_bc_radio.survey.active)
+    {
+        bc_spirit1_sleep();
+
+        return;
+    }
+
+    if (_bc_radio.listening)
+    {
+        bc_spirit1_set_rx_timeout(BC_TICK_INFINITY);
+        bc_spirit1_rx();
+
+        return;
+    }
+
+    // Stay in reception until all open windows end
+    bc_tick_t end = 0;
+
+    if (_bc_radio.tdma.window)
+    {
+        end = _bc_radio.tdma.window_end;
+    }
+
+    if (_bc_radio.fragment_tx.waiting && _bc_radio.fragment_tx.wait_end > end)
+    {
+        end = _bc_radio.fragment_tx.wait_end;
+    }
+
+    if (_bc_radio.ack_tx.waiting && _bc_radio.ack_tx.wait_end > end)
+    {
+        end = _bc_radio.ack_tx.wait_end;
+    }
+
+    if (_bc_radio.bulk_tx.waiting && _bc_radio.bulk_tx.wait_end > end)
+    {
+        end = _bc_radio.bulk_tx.wait_end;
+    }
+
+    bc_tick_t now = bc_tick_get();
+
+    if (_bc_radio.bulk_rx.listen)
+    {
+        if (_bc_radio.bulk_rx.listen_end <= now)
+        {
+            _bc_radio.bulk_rx.listen = false;
+        }
+        else if (_bc_radio.bulk_rx.listen_end > end)
+        {
+            end = _bc_radio.bulk_rx.listen_end;
+        }
+    }
+
+    if (end == 0)
+    {
+        bc_spirit1_sleep();
+
+        return;
+    }
+
+    bc_spirit1_set_rx_timeout(end > now ? end - now : 1);
+    bc_spirit1_rx();
 }
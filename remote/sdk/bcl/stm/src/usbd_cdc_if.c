@@ -45,7 +45,7 @@
 #include "usbd_cdc_if.h"
 
 /* USER CODE BEGIN INCLUDE */
-
+#include <stdbool.h>
 /* USER CODE END INCLUDE */
 
 /** @addtogroup STM32_USB_OTG_DEVICE_LIBRARY
@@ -122,7 +122,8 @@ static int8_t CDC_Control_FS  (uint8_t cmd, uint8_t* pbuf, uint16_t length);
 static int8_t CDC_Receive_FS  (uint8_t* pbuf, uint32_t *Len);
 
 /* USER CODE BEGIN PRIVATE_FUNCTIONS_DECLARATION */
-void bc_usb_cdc_received_data(const void *buffer, size_t length);
+bool bc_usb_cdc_received_data(const void *buffer, size_t length);
+void bc_usb_cdc_received_reset(void);
 
 /* USER CODE END PRIVATE_FUNCTIONS_DECLARATION */
 
@@ -151,6 +152,7 @@ static int8_t CDC_Init_FS(void)
   /* Set Application Buffers */
 //  USBD_CDC_SetTxBuffer(&hUsbDeviceFS, UserTxBufferFS, 0);
   USBD_CDC_SetRxBuffer(&hUsbDeviceFS, UserRxBufferFS);
+  bc_usb_cdc_received_reset();
   return (USBD_OK);
   /* USER CODE END 3 */
 }
@@ -164,6 +166,7 @@ static int8_t CDC_Init_FS(void)
 static int8_t CDC_DeInit_FS(void)
 {
   /* USER CODE BEGIN 4 */
+  bc_usb_cdc_received_reset();
   return (USBD_OK);
   /* USER CODE END 4 */
 }
@@ -263,9 +266,12 @@ static int8_t CDC_Control_FS  (uint8_t cmd, uint8_t* pbuf, uint16_t length)
 static int8_t CDC_Receive_FS (uint8_t* Buf, uint32_t *Len)
 {
   /* USER CODE BEGIN 6 */
-  bc_usb_cdc_received_data(Buf, *Len);
-  USBD_CDC_SetRxBuffer(&hUsbDeviceFS, UserRxBufferFS);
-  USBD_CDC_ReceivePacket(&hUsbDeviceFS);
+  // Next packet is accepted only if there is room for it, otherwise endpoint answers NAK until data is read
+  if (bc_usb_cdc_received_data(Buf, *Len))
+  {
+    USBD_CDC_SetRxBuffer(&hUsbDeviceFS, UserRxBufferFS);
+    USBD_CDC_ReceivePacket(&hUsbDeviceFS);
+  }
   return (USBD_OK);
   /* USER CODE END 6 */
 }
@@ -304,6 +310,18 @@ uint8_t CDC_Transmit_FS(uint8_t* Buf, uint16_t Len)
 }
 
 /* USER CODE BEGIN PRIVATE_FUNCTIONS_IMPLEMENTATION */
+
+/**
+  * @brief  CDC_Receive_Resume_FS
+  *         Accept next packet after reception was held off in CDC_Receive_FS.
+  * @retval None
+  */
+void CDC_Receive_Resume_FS(void)
+{
+  USBD_CDC_SetRxBuffer(&hUsbDeviceFS, UserRxBufferFS);
+  USBD_CDC_ReceivePacket(&hUsbDeviceFS);
+}
+
 /* USER CODE END PRIVATE_FUNCTIONS_IMPLEMENTATION */
 
 /**
@@ -0,0 +1,1105 @@
+#include "sim.h"
+#include <bc_radio.h>
+#include <bc_scheduler.h>
+#include <unistd.h>
+
+#define SIM_MAX_BASES 8
+#define SIM_MAX_STEPS 64
+#define SIM_MIN_PAYLOAD 8
+
+// Survey starts once network runs, every channel is sampled for dwell time in ms
+#define SIM_SURVEY_START 10000
+#define SIM_SURVEY_DWELL 1000
+
+// Bulk transfer starts after remotes joined, its data is pattern derived from offset
+#define SIM_BULK_START 5000
+#define SIM_BULK_PATTERN(offset) ((uint8_t) ((offset) * 7 + ((offset) >> 8)))
+
+// Same chunk size as bc_radio uses, frame header and bulk header are left out
+#define SIM_BULK_DATA_SIZE (BC_SPIRIT1_MAX_PACKET_SIZE - 6 - 5)
+
+static const unsigned long _sim_datarates[BC_SPIRIT1_DATARATE_COUNT] = { 9600, 19200, 38400, 100000 };
+
+sim_config_t sim_config;
+sim_stats_t sim_stats;
+sim_time_t sim_now;
+sim_node_t *sim_nodes;
+size_t sim_node_count;
+sim_node_t *sim_current;
+
+static uint64_t _sim_random_state;
+
+static void _sim_usage(const char *name);
+static size_t _sim_parse_list(const char *text, double *values);
+static void _sim_run(void);
+static void _sim_setup_base(sim_node_t *node);
+static void _sim_setup_remote(sim_node_t *node);
+static void _sim_setup_foreign(sim_node_t *node);
+static void _sim_setup_profile(sim_node_t *node);
+static void _sim_report(sim_node_t *node);
+static void _sim_report_foreign(sim_node_t *node);
+static void _sim_alarm(sim_node_t *node);
+static void _sim_survey(sim_node_t *node);
+static void _sim_bulk(sim_node_t *node);
+static bool _sim_bulk_read(uint32_t offset, void *buffer, size_t length, void *param);
+static void _sim_radio_event_handler(bc_radio_event_t event, void *event_param);
+static void _sim_print_header(void);
+static void _sim_print_result(void);
+static void _sim_cleanup(void);
+static void _sim_append(double **values, size_t *count, size_t *size, double value);
+static int _sim_compare(const void *a, const void *b);
+static double _sim_percentile(const double *values, size_t count, double p);
+
+int main(int argc, char **argv)
+{
+    double nodes[SIM_MAX_STEPS] = { 50 };
+    double intervals[SIM_MAX_STEPS] = { 60 };
+    size_t nodes_count = 1;
+    size_t intervals_count = 1;
+
+    sim_config.bases = 1;
+    sim_config.relays = 0;
+    sim_config.duration = 3600;
+    sim_config.drain = 60;
+    sim_config.payload = SIM_MIN_PAYLOAD;
+    sim_config.loss = 0;
+    sim_config.capture = 6;
+    sim_config.radius = 100;
+    sim_config.shadowing = 6;
+    sim_config.drift = 20;
+    sim_config.seed = 1;
+    sim_config.profile.datarate = BC_SPIRIT1_DATARATE_19200;
+    sim_config.profile.power = BC_SPIRIT1_POWER_MAX;
+    sim_config.channels = 1;
+
+    int option;
+
+    while ((option = getopt(argc, argv, "n:i:b:r:X:AB:EC:W:U:K:G:D:p:l:c:R:s:d:t:Za:PFO:S:h")) != -1)
+    {
+        switch (option)
+        {
+            case 'n':
+            {
+                nodes_count = _sim_parse_list(optarg, nodes);
+                break;
+            }
+            case 'i':
+            {
+                intervals_count = _sim_parse_list(optarg, intervals);
+                break;
+            }
+            case 'b':
+            {
+                sim_config.bases = strtoul(optarg, NULL, 10);
+                break;
+            }
+            case 'r':
+            {
+                sim_config.relays = strtoul(optarg, NULL, 10);
+                break;
+            }
+            case 'X':
+            {
+                sim_config.foreign = strtoul(optarg, NULL, 10);
+                break;
+            }
+            case 'A':
+            {
+                sim_config.no_filter = true;
+                break;
+            }
+            case 'B':
+            {
+                unsigned long datarate = strtoul(optarg, NULL, 10);
+                int i;
+
+                for (i = 0; i < BC_SPIRIT1_DATARATE_COUNT && _sim_datarates[i] != datarate; i++);
+
+                if (i == BC_SPIRIT1_DATARATE_COUNT)
+                {
+                    _sim_usage(argv[0]);
+
+                    return EXIT_FAILURE;
+                }
+
+                sim_config.profile.datarate = i;
+                break;
+            }
+            case 'E':
+            {
+                sim_config.profile.fec = true;
+                break;
+            }
+            case 'C':
+            {
+                sim_config.channels = strtoul(optarg, NULL, 10);
+                break;
+            }
+            case 'W':
+            {
+                sim_config.profile.power = strtol(optarg, NULL, 10);
+                break;
+            }
+            case 'U':
+            {
+                if (sscanf(optarg, "%u,%u", &sim_config.survey_first, &sim_config.survey_last) != 2 ||
+                    sim_config.survey_last < sim_config.survey_first || sim_config.survey_last > UINT8_MAX ||
+                    sim_config.survey_last - sim_config.survey_first >= BC_RADIO_SURVEY_MAX_CHANNELS)
+                {
+                    _sim_usage(argv[0]);
+
+                    return EXIT_FAILURE;
+                }
+
+                sim_config.survey = true;
+                break;
+            }
+            case 'K':
+            {
+                sim_config.bulk = strtoul(optarg, NULL, 10);
+                break;
+            }
+            case 'G':
+            {
+                sim_config.bulk = strtoul(optarg, NULL, 10);
+                sim_config.bulk_down = true;
+                break;
+            }
+            case 'D':
+            {
+                sim_config.duration = strtod(optarg, NULL);
+                break;
+            }
+            case 'p':
+            {
+                sim_config.payload = strtoul(optarg, NULL, 10);
+                break;
+            }
+            case 'l':
+            {
+                sim_config.loss = strtod(optarg, NULL);
+                break;
+            }
+            case 'c':
+            {
+                sim_config.capture = strtod(optarg, NULL);
+                break;
+            }
+            case 'R':
+            {
+                sim_config.radius = strtod(optarg, NULL);
+                break;
+            }
+            case 's':
+            {
+                sim_config.shadowing = strtod(optarg, NULL);
+                break;
+            }
+            case 'd':
+            {
+                sim_config.drift = strtod(optarg, NULL);
+                break;
+            }
+            case 't':
+            {
+                unsigned long superframe;
+                unsigned long slot_length;
+
+                if (sscanf(optarg, "%lu,%lu", &superframe, &slot_length) != 2)
+                {
+                    _sim_usage(argv[0]);
+
+                    return EXIT_FAILURE;
+                }
+
+                sim_config.tdma = true;
+                sim_config.tdma_superframe = superframe;
+                sim_config.tdma_slot_length = slot_length;
+                break;
+            }
+            case 'Z':
+            {
+                sim_config.shutdown = true;
+                break;
+            }
+            case 'a':
+            {
+                sim_config.alarm = strtod(optarg, NULL);
+                break;
+            }
+            case 'P':
+            {
+                sim_config.preemption = true;
+                break;
+            }
+            case 'F':
+            {
+                sim_config.store_and_forward = true;
+                break;
+            }
+            case 'O':
+            {
+                if (sscanf(optarg, "%lf,%lf", &sim_config.outage_start, &sim_config.outage_length) != 2)
+                {
+                    _sim_usage(argv[0]);
+
+                    return EXIT_FAILURE;
+                }
+
+                break;
+            }
+            case 'S':
+            {
+                sim_config.seed = strtoul(optarg, NULL, 10);
+                break;
+            }
+            case 'h':
+            default:
+            {
+                _sim_usage(argv[0]);
+
+                return option == 'h' ? EXIT_SUCCESS : EXIT_FAILURE;
+            }
+        }
+    }
+
+    if (nodes_count == 0 || intervals_count == 0 || sim_config.bases == 0 || sim_config.bases > SIM_MAX_BASES ||
+        sim_config.payload < SIM_MIN_PAYLOAD || sim_config.payload > BC_RADIO_BUFFER_MAX_SIZE || sim_config.duration <= 0 ||
+        sim_config.channels == 0 || sim_config.channels > sim_config.bases ||
+        sim_config.profile.power < BC_SPIRIT1_POWER_MIN || sim_config.profile.power > BC_SPIRIT1_POWER_MAX)
+    {
+        _sim_usage(argv[0]);
+
+        return EXIT_FAILURE;
+    }
+
+    _sim_print_header();
+
+    for (size_t i = 0; i < nodes_count; i++)
+    {
+        for (size_t j = 0; j < intervals_count; j++)
+        {
+            sim_config.nodes = (size_t) nodes[i];
+            sim_config.interval = intervals[j];
+
+            if (sim_config.nodes == 0 || sim_config.nodes > BC_RADIO_MAX_PEERS || sim_config.interval <= 0)
+            {
+                fprintf(stderr, "Skipping %zu nodes at interval %g s\n", sim_config.nodes, sim_config.interval);
+
+                continue;
+            }
+
+            _sim_run();
+
+            _sim_print_result();
+
+            _sim_cleanup();
+        }
+    }
+
+    return EXIT_SUCCESS;
+}
+
+void bc_radio_on_buffer(uint32_t *peer_device_address, void *buffer, size_t *length)
+{
+    (void) peer_device_address;
+
+    uint32_t index;
+    uint32_t sequence;
+
+    if (*length < SIM_MIN_PAYLOAD)
+    {
+        return;
+    }
+
+    memcpy(&index, buffer, sizeof(index));
+    memcpy(&sequence, (uint8_t *) buffer + sizeof(index), sizeof(sequence));
+
+    if (index >= sim_node_count || sim_nodes[index].role != SIM_NODE_ROLE_REMOTE)
+    {
+        return;
+    }
+
+    sim_node_t *remote = &sim_nodes[index];
+
+    if (sequence >= remote->report.sequence)
+    {
+        return;
+    }
+
+    uint8_t base = 1 << sim_current->index;
+
+    if ((remote->report.delivered[sequence] & base) != 0)
+    {
+        sim_stats.duplicates++;
+
+        return;
+    }
+
+    if (remote->report.delivered[sequence] == 0)
+    {
+        sim_stats.delivered++;
+
+        sim_stats_latency((double) (sim_now - remote->report.generated[sequence]));
+    }
+
+    remote->report.delivered[sequence] |= base;
+}
+
+void bc_radio_on_alarm(uint32_t *peer_device_address, bc_radio_alarm_t *alarm, bool *active, float *value)
+{
+    (void) peer_device_address;
+    (void) alarm;
+    (void) active;
+
+    // Value carries index of remote
+    size_t index = (size_t) *value;
+
+    if (index >= sim_node_count || sim_nodes[index].role != SIM_NODE_ROLE_REMOTE || !sim_nodes[index].report.alarm_pending)
+    {
+        return;
+    }
+
+    sim_nodes[index].report.alarm_pending = false;
+
+    sim_stats.alarms_delivered++;
+
+    _sim_append(&sim_stats.alarm_latency, &sim_stats.alarm_latency_count, &sim_stats.alarm_latency_size, (double) (sim_now - sim_nodes[index].report.alarm_generated));
+}
+
+void bc_radio_on_bulk(uint32_t *peer_device_address, uint32_t *offset, void *buffer, size_t *length)
+{
+    (void) peer_device_address;
+
+    if (buffer == NULL)
+    {
+        sim_stats.bulk_end = sim_now;
+
+        return;
+    }
+
+    for (size_t i = 0; i < *length; i++)
+    {
+        if (((uint8_t *) buffer)[i] != SIM_BULK_PATTERN(*offset + i))
+        {
+            sim_stats.bulk_corrupted++;
+        }
+    }
+
+    sim_stats.bulk_received += *length;
+}
+
+void sim_stats_latency(double latency)
+{
+    _sim_append(&sim_stats.latency, &sim_stats.latency_count, &sim_stats.latency_size, latency);
+}
+
+double sim_random(void)
+{
+    // xorshift64*
+    _sim_random_state ^= _sim_random_state >> 12;
+    _sim_random_state ^= _sim_random_state << 25;
+    _sim_random_state ^= _sim_random_state >> 27;
+
+    return ((_sim_random_state * UINT64_C(0x2545f4914f6cdd1d)) >> 11) / 9007199254740992.0;
+}
+
+void sim_random_seed(uint64_t seed)
+{
+    _sim_random_state = seed * UINT64_C(0x9e3779b97f4a7c15) + 1;
+}
+
+static void _sim_usage(const char *name)
+{
+    fprintf(stderr,
+        "Usage: %s [options]\n"
+        "  -n LIST   numbers of remotes, comma separated (default 50)\n"
+        "  -i LIST   reporting intervals in seconds, comma separated (default 60)\n"
+        "  -b N      number of bases, at most %d (default 1)\n"
+        "  -r N      number of remotes acting as relays (default 0)\n"
+        "  -X N      number of remotes of other network on same channel (default 0)\n"
+        "  -A        disable address filtering in radio\n"
+        "  -B RATE   data rate in bps, 9600, 19200, 38400 or 100000 (default 19200)\n"
+        "  -E        enable FEC\n"
+        "  -C N      number of channels, bases and remotes are split over them (default 1)\n"
+        "  -W DBM    output power from %d to %d dBm (default %d)\n"
+        "  -U F,L    first base surveys channels F to L and moves its network to quietest one\n"
+        "  -K BYTES  first remote sends bulk transfer of BYTES to its base\n"
+        "  -G BYTES  first base sends bulk transfer of BYTES to first remote\n"
+        "  -D SEC    simulated duration in seconds (default 3600)\n"
+        "  -p BYTES  report payload length (default %d)\n"
+        "  -l P      probability of independent frame loss (default 0)\n"
+        "  -c DB     capture threshold in dB (default 6)\n"
+        "  -R M      radius of area with remotes in meters (default 100)\n"
+        "  -s DB     shadowing standard deviation in dB (default 6)\n"
+        "  -d PPM    maximum clock drift of nodes (default 20)\n"
+        "  -t SF,SL  enable TDMA with superframe and slot length in ms\n"
+        "  -Z        shut radio of remotes down between transmissions\n"
+        "  -a P      probability that report is accompanied by urgent alarm (default 0)\n"
+        "  -P        urgent alarm preempts repetitions of reports\n"
+        "  -F        remotes store unacknowledged reports and replay them\n"
+        "  -O ST,LEN outage of bases starting at ST seconds for LEN seconds\n"
+        "  -S SEED   random seed (default 1)\n",
+        name, SIM_MAX_BASES, BC_SPIRIT1_POWER_MIN, BC_SPIRIT1_POWER_MAX, BC_SPIRIT1_POWER_MAX, SIM_MIN_PAYLOAD);
+}
+
+static size_t _sim_parse_list(const char *text, double *values)
+{
+    size_t count = 0;
+
+    while (*text != '\0' && count < SIM_MAX_STEPS)
+    {
+        char *end;
+
+        values[count++] = strtod(text, &end);
+
+        if (end == text)
+        {
+            return 0;
+        }
+
+        text = *end == ',' ? end + 1 : end;
+    }
+
+    return count;
+}
+
+static void _sim_run(void)
+{
+    free(sim_stats.latency);
+    free(sim_stats.alarm_latency);
+
+    memset(&sim_stats, 0, sizeof(sim_stats));
+
+    sim_now = 0;
+    sim_current = NULL;
+
+    srand(sim_config.seed);
+    sim_random_seed(sim_config.seed);
+
+    sim_event_init();
+    sim_channel_init();
+
+    sim_node_count = sim_config.bases + sim_config.nodes + sim_config.foreign;
+    sim_nodes = calloc(sim_node_count, sizeof(sim_node_t));
+
+    if (sim_nodes == NULL)
+    {
+        fprintf(stderr, "Out of memory\n");
+
+        exit(EXIT_FAILURE);
+    }
+
+    for (size_t i = 0; i < sim_node_count; i++)
+    {
+        sim_node_t *node = &sim_nodes[i];
+
+        node->index = i;
+        node->role = i < sim_config.bases ? SIM_NODE_ROLE_BASE : i < sim_config.bases + sim_config.nodes ? SIM_NODE_ROLE_REMOTE : SIM_NODE_ROLE_FOREIGN;
+
+        // Multiplication by odd constant keeps addresses unique and non-zero
+        node->device_address = (uint32_t) ((i + 1) * UINT32_C(2654435761));
+
+        node->drift_ppm = (2 * sim_random() - 1) * sim_config.drift;
+
+        if (node->role == SIM_NODE_ROLE_BASE)
+        {
+            // First base in center, others around it
+            double angle = 2 * M_PI * i / sim_config.bases;
+            double distance = i == 0 ? 0 : sim_config.radius / 2;
+
+            node->x = distance * cos(angle);
+            node->y = distance * sin(angle);
+        }
+        else
+        {
+            // Uniformly over disc
+            double angle = 2 * M_PI * sim_random();
+            double distance = sim_config.radius * sqrt(sim_random());
+
+            node->x = distance * cos(angle);
+            node->y = distance * sin(angle);
+        }
+
+        sim_node_create(node);
+    }
+
+    for (size_t i = 0; i < sim_node_count; i++)
+    {
+        if (sim_nodes[i].role == SIM_NODE_ROLE_BASE)
+        {
+            _sim_setup_base(&sim_nodes[i]);
+        }
+        else if (sim_nodes[i].role == SIM_NODE_ROLE_FOREIGN)
+        {
+            _sim_setup_foreign(&sim_nodes[i]);
+        }
+        else
+        {
+            _sim_setup_remote(&sim_nodes[i]);
+        }
+    }
+
+    sim_time_t end = (sim_time_t) ((sim_config.duration + sim_config.drain) * 1000);
+
+    sim_time_t time;
+    sim_event_type_t type;
+    sim_node_t *node;
+    void *param;
+
+    while (sim_event_pop(&time, &type, &node, &param) && time <= end)
+    {
+        sim_now = time;
+
+        if (type == SIM_EVENT_WAKE)
+        {
+            if (node->wake_time != time)
+            {
+                continue;
+            }
+
+            node->wake_time = BC_TICK_INFINITY;
+
+            sim_node_enter(node);
+            sim_node_run(node);
+        }
+        else if (type == SIM_EVENT_TX_END)
+        {
+            sim_radio_on_tx_end(param);
+        }
+        else if (type == SIM_EVENT_RX_TIMEOUT)
+        {
+            sim_radio_on_rx_timeout(node);
+        }
+        else if (type == SIM_EVENT_REPORT)
+        {
+            _sim_report(node);
+        }
+        else if (type == SIM_EVENT_ALARM)
+        {
+            _sim_alarm(node);
+        }
+        else if (type == SIM_EVENT_SURVEY)
+        {
+            _sim_survey(node);
+        }
+        else if (type == SIM_EVENT_BULK)
+        {
+            _sim_bulk(node);
+        }
+    }
+
+    sim_now = end;
+
+    for (size_t i = 0; i < sim_node_count; i++)
+    {
+        sim_radio_finish(&sim_nodes[i]);
+    }
+
+    sim_event_free();
+    sim_channel_free();
+}
+
+static void _sim_setup_base(sim_node_t *node)
+{
+    // Remotes on channel of base are already enrolled
+    for (size_t i = sim_config.bases; i < sim_config.bases + sim_config.nodes; i++)
+    {
+        if ((i - sim_config.bases) % sim_config.channels != node->index % sim_config.channels)
+        {
+            continue;
+        }
+
+        memcpy(&node->eeprom[(i - sim_config.bases) * sizeof(uint32_t)], &sim_nodes[i].device_address, sizeof(uint32_t));
+    }
+
+    sim_node_enter(node);
+
+    bc_scheduler_init();
+
+    bc_radio_init();
+    bc_radio_listen();
+
+    _sim_setup_profile(node);
+
+    if (sim_config.no_filter)
+    {
+        bc_radio_set_network(0);
+    }
+
+    if (sim_config.tdma)
+    {
+        if (!bc_radio_tdma_start(sim_config.tdma_superframe, sim_config.tdma_slot_length))
+        {
+            fprintf(stderr, "Base %zu has no TDMA slot for some of its remotes, they use random access\n", node->index);
+        }
+    }
+
+    bc_radio_set_event_handler(_sim_radio_event_handler, NULL);
+
+    sim_node_run(node);
+
+    if (sim_config.survey && node->index == 0)
+    {
+        sim_event_push(SIM_SURVEY_START, SIM_EVENT_SURVEY, node, NULL);
+    }
+
+    if (sim_config.bulk_down && node->index == 0)
+    {
+        sim_event_push(SIM_BULK_START, SIM_EVENT_BULK, node, NULL);
+    }
+}
+
+static void _sim_setup_remote(sim_node_t *node)
+{
+    node->report.size = (size_t) (sim_config.duration / sim_config.interval) + 2;
+    node->report.generated = calloc(node->report.size, sizeof(sim_time_t));
+    node->report.delivered = calloc(node->report.size, sizeof(uint8_t));
+
+    if (node->report.generated == NULL || node->report.delivered == NULL)
+    {
+        fprintf(stderr, "Out of memory\n");
+
+        exit(EXIT_FAILURE);
+    }
+
+    sim_node_enter(node);
+
+    bc_scheduler_init();
+
+    bc_radio_init();
+
+    _sim_setup_profile(node);
+
+    if (sim_config.no_filter)
+    {
+        bc_radio_set_network(0);
+    }
+
+    if (node->index - sim_config.bases < sim_config.relays)
+    {
+        bc_radio_relay_start();
+    }
+    else if (sim_config.shutdown)
+    {
+        bc_spirit1_set_sleep_mode(BC_SPIRIT1_SLEEP_MODE_SHUTDOWN);
+    }
+
+    bc_radio_set_preemption(sim_config.preemption);
+
+    bc_radio_set_store_and_forward(sim_config.store_and_forward);
+
+    if (sim_config.tdma)
+    {
+        bc_radio_tdma_join();
+    }
+
+    bc_radio_set_event_handler(_sim_radio_event_handler, NULL);
+
+    sim_node_run(node);
+
+    if (sim_config.bulk > 0 && !sim_config.bulk_down && node->index == sim_config.bases)
+    {
+        sim_event_push(SIM_BULK_START, SIM_EVENT_BULK, node, NULL);
+    }
+
+    // Remotes are powered up at random moments
+    sim_event_push((sim_time_t) (sim_random() * sim_config.interval * 1000), SIM_EVENT_REPORT, node, NULL);
+}
+
+static void _sim_setup_foreign(sim_node_t *node)
+{
+    sim_node_enter(node);
+
+    bc_scheduler_init();
+
+    bc_radio_init();
+    bc_radio_set_network(BC_RADIO_NETWORK_ADDRESS + 1);
+
+    _sim_setup_profile(node);
+
+    sim_node_run(node);
+
+    sim_event_push((sim_time_t) (sim_random() * sim_config.interval * 1000), SIM_EVENT_REPORT, node, NULL);
+}
+
+static void _sim_setup_profile(sim_node_t *node)
+{
+    bc_spirit1_profile_t profile = sim_config.profile;
+
+    // Bases take channels in turn, remotes follow them so that each base has its share
+    size_t index = node->role == SIM_NODE_ROLE_BASE ? node->index : node->index - sim_config.bases;
+
+    profile.channel = index % sim_config.channels;
+
+    bc_radio_set_profile(&profile);
+}
+
+static void _sim_report(sim_node_t *node)
+{
+    if (node->role == SIM_NODE_ROLE_FOREIGN)
+    {
+        _sim_report_foreign(node);
+
+        return;
+    }
+
+    if (sim_now >= sim_config.duration * 1000 || node->report.sequence >= node->report.size)
+    {
+        return;
+    }
+
+    uint8_t buffer[BC_RADIO_BUFFER_MAX_SIZE];
+    uint32_t index = node->index;
+    uint32_t sequence = node->report.sequence;
+
+    memset(buffer, 0, sim_config.payload);
+    memcpy(buffer, &index, sizeof(index));
+    memcpy(&buffer[sizeof(index)], &sequence, sizeof(sequence));
+
+    node->report.generated[sequence] = sim_now;
+    node->report.sequence++;
+
+    sim_stats.generated++;
+
+    sim_node_enter(node);
+
+    if (!bc_radio_pub_buffer(buffer, sim_config.payload))
+    {
+        sim_stats.rejected++;
+    }
+
+    sim_node_run(node);
+
+    // Alarm comes within second after report, while repetitions of report are likely still running
+    if (sim_config.alarm > 0 && sim_random() < sim_config.alarm)
+    {
+        sim_event_push(sim_now + (sim_time_t) (sim_random() * 1000), SIM_EVENT_ALARM, node, NULL);
+    }
+
+    // Period of remote timer is subject to its clock drift
+    sim_time_t next = sim_node_global_time(node, sim_node_local_time(node, sim_now) + (bc_tick_t) (sim_config.interval * 1000));
+
+    sim_event_push(next, SIM_EVENT_REPORT, node, NULL);
+}
+
+static void _sim_report_foreign(sim_node_t *node)
+{
+    if (sim_now >= sim_config.duration * 1000)
+    {
+        return;
+    }
+
+    // Traffic of other network is not accounted, it only occupies channel
+    uint8_t buffer[BC_RADIO_BUFFER_MAX_SIZE];
+
+    memset(buffer, 0xff, sim_config.payload);
+
+    sim_node_enter(node);
+
+    bc_radio_pub_buffer(buffer, sim_config.payload);
+
+    sim_node_run(node);
+
+    sim_time_t next = sim_node_global_time(node, sim_node_local_time(node, sim_now) + (bc_tick_t) (sim_config.interval * 1000));
+
+    sim_event_push(next, SIM_EVENT_REPORT, node, NULL);
+}
+
+static void _sim_alarm(sim_node_t *node)
+{
+    float value = node->index;
+
+    node->report.alarm_generated = sim_now;
+    node->report.alarm_pending = true;
+
+    sim_stats.alarms_generated++;
+
+    sim_node_enter(node);
+
+    bc_radio_pub_alarm(BC_RADIO_ALARM_CO2, true, &value);
+
+    sim_node_run(node);
+}
+
+static void _sim_survey(sim_node_t *node)
+{
+    sim_node_enter(node);
+
+    bc_radio_survey_start(sim_config.survey_first, sim_config.survey_last, SIM_SURVEY_DWELL, true);
+
+    sim_node_run(node);
+}
+
+static void _sim_bulk(sim_node_t *node)
+{
+    sim_stats.bulk_start = sim_now;
+
+    sim_node_enter(node);
+
+    uint32_t device_address = sim_config.bulk_down ? sim_nodes[sim_config.bases].device_address : 0;
+
+    if (!bc_radio_bulk_send(device_address, BC_RADIO_BULK_TYPE_DATA, sim_config.bulk, _sim_bulk_read, NULL))
+    {
+        sim_stats.bulk_failed = true;
+    }
+
+    sim_node_run(node);
+}
+
+static bool _sim_bulk_read(uint32_t offset, void *buffer, size_t length, void *param)
+{
+    (void) param;
+
+    for (size_t i = 0; i < length; i++)
+    {
+        ((uint8_t *) buffer)[i] = SIM_BULK_PATTERN(offset + i);
+    }
+
+    sim_stats.bulk_frames++;
+
+    return true;
+}
+
+static void _sim_radio_event_handler(bc_radio_event_t event, void *event_param)
+{
+    (void) event_param;
+
+    if (event == BC_RADIO_EVENT_BULK_FAILURE)
+    {
+        sim_stats.bulk_failed = true;
+
+        return;
+    }
+
+    if (event != BC_RADIO_EVENT_SURVEY_DONE)
+    {
+        return;
+    }
+
+    bc_radio_survey_t survey;
+
+    bc_radio_get_survey(&survey);
+
+    printf("# survey base=%zu at=%.1fs quietest=%u", sim_current->index, sim_now / 1000.0, (unsigned) survey.quietest);
+
+    for (size_t i = 0; i < survey.count; i++)
+    {
+        bc_radio_survey_channel_t *channel = &survey.channels[i];
+
+        printf(" %u:busy=%.0f%%/avg=%.1f/max=%.1f", (unsigned) channel->channel,
+            channel->samples != 0 ? 100.0 * channel->busy / channel->samples : 0, channel->rssi_average, channel->rssi_max);
+    }
+
+    printf("\n");
+}
+
+static void _sim_print_header(void)
+{
+    printf("# bases=%zu relays=%zu foreign=%zu duration=%gs payload=%zuB loss=%g capture=%gdB radius=%gm shadowing=%gdB drift=%gppm",
+        sim_config.bases, sim_config.relays, sim_config.foreign, sim_config.duration, sim_config.payload, sim_config.loss,
+        sim_config.capture, sim_config.radius, sim_config.shadowing, sim_config.drift);
+
+    if (sim_config.tdma)
+    {
+        printf(" tdma=%" PRIu64 "/%" PRIu64 "ms", sim_config.tdma_superframe, sim_config.tdma_slot_length);
+    }
+
+    if (sim_config.shutdown)
+    {
+        printf(" shutdown");
+    }
+
+    if (sim_config.no_filter)
+    {
+        printf(" no-filter");
+    }
+
+    if (sim_config.profile.datarate != BC_SPIRIT1_DATARATE_19200 || sim_config.profile.fec || sim_config.profile.power != BC_SPIRIT1_POWER_MAX || sim_config.channels > 1)
+    {
+        printf(" datarate=%lu%s power=%ddBm channels=%zu", _sim_datarates[sim_config.profile.datarate],
+            sim_config.profile.fec ? " fec" : "", sim_config.profile.power, sim_config.channels);
+    }
+
+    if (sim_config.bulk > 0)
+    {
+        printf(" bulk=%" PRIu32 "B%s", sim_config.bulk, sim_config.bulk_down ? " down" : "");
+    }
+
+    if (sim_config.survey)
+    {
+        printf(" survey=%u-%u", sim_config.survey_first, sim_config.survey_last);
+    }
+
+    if (sim_config.alarm > 0)
+    {
+        printf(" alarm=%g%s", sim_config.alarm, sim_config.preemption ? " preemption" : "");
+    }
+
+    if (sim_config.store_and_forward)
+    {
+        printf(" store-and-forward");
+    }
+
+    if (sim_config.outage_length > 0)
+    {
+        printf(" outage=%g+%gs", sim_config.outage_start, sim_config.outage_length);
+    }
+
+    printf(" seed=%u\n", sim_config.seed);
+
+    printf("%6s %8s %9s %8s %8s %7s %8s %8s %8s %9s %9s %9s %9s %7s %8s\n",
+        "nodes", "interval", "generated", "rejected", "delivery", "dup", "p50_ms", "p90_ms", "p99_ms",
+        "tx_mJ/h", "tx_max", "rx_mJ/h", "avg_uA", "air", "collide");
+}
+
+static void _sim_print_result(void)
+{
+    double hours = (sim_config.duration + sim_config.drain) / 3600;
+    double tx_sum = 0;
+    double tx_max = 0;
+    double rx_sum = 0;
+    double charge_sum = 0;
+    double air = 0;
+    size_t remotes = 0;
+    double base_rx = 0;
+    double base_rejected = 0;
+    double base_crc_error = 0;
+
+    for (size_t i = 0; i < sim_node_count; i++)
+    {
+        sim_node_t *node = &sim_nodes[i];
+
+        // mA * V * s gives mJ
+        double tx = node->radio.state_time[SIM_RADIO_STATE_TX] / 1000.0 * SIM_CURRENT_TX * SIM_VOLTAGE / hours;
+        double rx = node->radio.state_time[SIM_RADIO_STATE_RX] / 1000.0 * SIM_CURRENT_RX * SIM_VOLTAGE / hours;
+
+        air += node->radio.state_time[SIM_RADIO_STATE_TX];
+
+        if (node->role == SIM_NODE_ROLE_BASE)
+        {
+            base_rx += node->radio.rx_count / hours / sim_config.bases;
+            base_rejected += node->radio.rx_rejected / hours / sim_config.bases;
+            base_crc_error += node->radio.rx_crc_error / hours / sim_config.bases;
+        }
+
+        if (node->role == SIM_NODE_ROLE_REMOTE)
+        {
+            remotes++;
+
+            tx_sum += tx;
+            rx_sum += rx;
+
+            // Charge in mA * ms, sleeping radio draws current of its sleep mode
+            double sleep_current = node->radio.sleep_mode == BC_SPIRIT1_SLEEP_MODE_SHUTDOWN ? SIM_CURRENT_SHUTDOWN : SIM_CURRENT_STANDBY;
+
+            charge_sum += node->radio.state_time[SIM_RADIO_STATE_TX] * SIM_CURRENT_TX;
+            charge_sum += node->radio.state_time[SIM_RADIO_STATE_RX] * SIM_CURRENT_RX;
+            charge_sum += node->radio.state_time[SIM_RADIO_STATE_SLEEP] * sleep_current;
+            charge_sum += node->radio.wake_up_count * (SIM_WAKE_UP_TIME / 1000.0) * SIM_CURRENT_READY;
+
+            if (tx > tx_max)
+            {
+                tx_max = tx;
+            }
+        }
+    }
+
+    qsort(sim_stats.latency, sim_stats.latency_count, sizeof(double), _sim_compare);
+    qsort(sim_stats.alarm_latency, sim_stats.alarm_latency_count, sizeof(double), _sim_compare);
+
+    double generated = sim_stats.generated > 0 ? sim_stats.generated : 1;
+    double delivered = sim_stats.delivered > 0 ? sim_stats.delivered : 1;
+
+    printf("%6zu %8g %9" PRIu64 " %8" PRIu64 " %7.2f%% %6.2f%% %8.0f %8.0f %8.0f %9.1f %9.1f %9.1f %9.2f %6.2f%% %8" PRIu64 "\n",
+        sim_config.nodes, sim_config.interval, sim_stats.generated, sim_stats.rejected,
+        100 * sim_stats.delivered / generated, 100 * sim_stats.duplicates / delivered,
+        _sim_percentile(sim_stats.latency, sim_stats.latency_count, 0.5),
+        _sim_percentile(sim_stats.latency, sim_stats.latency_count, 0.9),
+        _sim_percentile(sim_stats.latency, sim_stats.latency_count, 0.99),
+        tx_sum / remotes, tx_max, rx_sum / remotes,
+        1000 * charge_sum / remotes / ((sim_config.duration + sim_config.drain) * 1000),
+        100 * air / ((sim_config.duration + sim_config.drain) * 1000), sim_stats.collisions);
+
+    // Every frame handed to MCU wakes it up for readout and parsing, rejected frames only restart receiver
+    if (sim_config.foreign > 0 || sim_config.no_filter)
+    {
+        printf("# base frames/h to_mcu=%.0f rejected=%.0f crc_error=%.0f\n", base_rx, base_rejected, base_crc_error);
+    }
+
+    if (sim_config.bulk > 0)
+    {
+        // Raw rate is that of channel without any framing, acknowledgement or retransmission
+        double seconds = sim_stats.bulk_end > sim_stats.bulk_start ? (sim_stats.bulk_end - sim_stats.bulk_start) / 1000.0 : 0;
+        double goodput = seconds > 0 ? 8 * sim_stats.bulk_received / seconds : 0;
+        uint64_t count = (sim_config.bulk + SIM_BULK_DATA_SIZE - 1) / SIM_BULK_DATA_SIZE;
+
+        printf("# bulk bytes=%" PRIu32 " received=%" PRIu64 " corrupted=%" PRIu64 " time=%.2fs goodput=%.0fbps raw=%.1f%% frames=%" PRIu64 " retransmitted=%" PRIu64 "%s\n",
+            sim_config.bulk, sim_stats.bulk_received, sim_stats.bulk_corrupted, seconds, goodput,
+            100 * goodput / _sim_datarates[sim_config.profile.datarate], sim_stats.bulk_frames,
+            sim_stats.bulk_frames > count ? sim_stats.bulk_frames - count : 0, sim_stats.bulk_failed ? " failed" : "");
+    }
+
+    if (sim_config.alarm > 0)
+    {
+        double alarms = sim_stats.alarms_generated > 0 ? sim_stats.alarms_generated : 1;
+
+        printf("# alarms generated=%" PRIu64 " delivery=%.2f%% p50_ms=%.0f p90_ms=%.0f p99_ms=%.0f\n",
+            sim_stats.alarms_generated, 100 * sim_stats.alarms_delivered / alarms,
+            _sim_percentile(sim_stats.alarm_latency, sim_stats.alarm_latency_count, 0.5),
+            _sim_percentile(sim_stats.alarm_latency, sim_stats.alarm_latency_count, 0.9),
+            _sim_percentile(sim_stats.alarm_latency, sim_stats.alarm_latency_count, 0.99));
+    }
+}
+
+static void _sim_cleanup(void)
+{
+    for (size_t i = 0; i < sim_node_count; i++)
+    {
+        sim_node_destroy(&sim_nodes[i]);
+    }
+
+    free(sim_nodes);
+
+    sim_nodes = NULL;
+    sim_node_count = 0;
+}
+
+static void _sim_append(double **values, size_t *count, size_t *size, double value)
+{
+    if (*count == *size)
+    {
+        *size = *size == 0 ? 4096 : *size * 2;
+
+        *values = realloc(*values, *size * sizeof(double));
+
+        if (*values == NULL)
+        {
+            fprintf(stderr, "Out of memory\n");
+
+            exit(EXIT_FAILURE);
+        }
+    }
+
+    (*values)[(*count)++] = value;
+}
+
+static int _sim_compare(const void *a, const void *b)
+{
+    double x = *(const double *) a;
+    double y = *(const double *) b;
+
+    return (x > y) - (x < y);
+}
+
+static double _sim_percentile(const double *values, size_t count, double p)
+{
+    if (count == 0)
+    {
+        return NAN;
+    }
+
+    size_t i = (size_t) ceil(p * count);
+
+    return values[i > 0 ? i - 1 : 0];
+}
@@ -0,0 +1,267 @@
+#ifndef _SIM_H
+#define _SIM_H
+
+#include <bc_common.h>
+#include <bc_tick.h>
+#include <bc_spirit1.h>
+#include <bc_eeprom.h>
+
+// Size of internal EEPROM of STM32L083
+#define SIM_EEPROM_SIZE BC_EEPROM_SIZE
+
+// Radio currents of SPIRIT1 at +11 dBm output power in mA and supply voltage in V
+#define SIM_CURRENT_TX 21.0
+#define SIM_CURRENT_RX 9.7
+#define SIM_CURRENT_STANDBY 0.0006
+#define SIM_CURRENT_SHUTDOWN 0.0000025
+#define SIM_VOLTAGE 3.0
+
+// Wake up from shutdown spends crystal start-up and register restore at READY current, time in us
+#define SIM_CURRENT_READY 0.4
+#define SIM_WAKE_UP_TIME 1200
+
+typedef uint64_t sim_time_t;
+
+typedef enum
+{
+    SIM_RADIO_STATE_SLEEP = 0,
+    SIM_RADIO_STATE_TX = 1,
+    SIM_RADIO_STATE_RX = 2,
+    SIM_RADIO_STATE_COUNT = 3
+
+} sim_radio_state_t;
+
+typedef enum
+{
+    SIM_NODE_ROLE_BASE = 0,
+    SIM_NODE_ROLE_REMOTE = 1,
+
+    // Remote of other network which shares the channel
+    SIM_NODE_ROLE_FOREIGN = 2
+
+} sim_node_role_t;
+
+typedef struct sim_transmission_t sim_transmission_t;
+
+typedef struct
+{
+    size_t index;
+    sim_node_role_t role;
+    uint32_t device_address;
+    double x;
+    double y;
+
+    // Clock of node runs faster or slower by this ratio
+    double drift_ppm;
+
+    // Images of static state of real modules while node is switched out
+    void *radio_image;
+    void *scheduler_image;
+
+    uint8_t eeprom[SIM_EEPROM_SIZE];
+
+    sim_time_t wake_time;
+
+    struct
+    {
+        void (*event_handler)(bc_spirit1_event_t, void *);
+        void *event_param;
+        sim_radio_state_t desired_state;
+        sim_radio_state_t current_state;
+        uint8_t tx_buffer[BC_SPIRIT1_MAX_PACKET_SIZE];
+        size_t tx_length;
+        uint8_t rx_buffer[BC_SPIRIT1_MAX_PACKET_SIZE];
+        size_t rx_length;
+        bc_tick_t rx_timeout;
+        sim_time_t rx_since;
+        sim_time_t rx_deadline;
+        sim_transmission_t *transmission;
+        sim_transmission_t *lock;
+        sim_time_t state_since;
+        sim_time_t state_time[SIM_RADIO_STATE_COUNT];
+        uint32_t tx_count;
+        bc_spirit1_sleep_mode_t sleep_mode;
+        uint32_t wake_up_count;
+        uint8_t address;
+        bc_spirit1_profile_t profile;
+
+        // Frames handed to MCU and frames discarded by radio before payload was read out
+        uint32_t rx_count;
+        uint32_t rx_rejected;
+        uint32_t rx_crc_error;
+
+    } radio;
+
+    struct
+    {
+        uint32_t sequence;
+        size_t size;
+        sim_time_t *generated;
+
+        // Bit mask of bases which delivered report to application
+        uint8_t *delivered;
+
+        sim_time_t alarm_generated;
+        bool alarm_pending;
+
+    } report;
+
+} sim_node_t;
+
+struct sim_transmission_t
+{
+    sim_node_t *sender;
+    sim_time_t start;
+    sim_time_t end;
+    bool aborted;
+    uint8_t destination;
+
+    // Receiver hears frame only on same channel and at same data rate
+    bc_spirit1_profile_t profile;
+
+    size_t length;
+    uint8_t buffer[BC_SPIRIT1_MAX_PACKET_SIZE];
+    sim_transmission_t *next;
+};
+
+typedef struct
+{
+    size_t nodes;
+    size_t bases;
+    size_t relays;
+    size_t foreign;
+    double interval;
+    double duration;
+    double drain;
+    size_t payload;
+    double loss;
+    double capture;
+    double radius;
+    double shadowing;
+    double drift;
+    bool tdma;
+    bool shutdown;
+    bool preemption;
+    bool store_and_forward;
+    bool no_filter;
+
+    // Profile of all nodes, bases and remotes are split over channels round-robin
+    bc_spirit1_profile_t profile;
+    size_t channels;
+
+    // Bases neither receive nor transmit during outage, times in seconds
+    double outage_start;
+    double outage_length;
+
+    // First remote sends bulk transfer of this many bytes to its base, or first base to first remote
+    uint32_t bulk;
+    bool bulk_down;
+
+    // First base surveys channels and moves its network to quietest one
+    bool survey;
+    unsigned int survey_first;
+    unsigned int survey_last;
+
+    // Probability that report is accompanied by urgent alarm
+    double alarm;
+    bc_tick_t tdma_superframe;
+    bc_tick_t tdma_slot_length;
+    unsigned int seed;
+
+} sim_config_t;
+
+typedef struct
+{
+    uint64_t generated;
+    uint64_t rejected;
+    uint64_t delivered;
+    uint64_t duplicates;
+    uint64_t transmissions;
+    uint64_t receptions;
+    uint64_t collisions;
+    uint64_t losses;
+    uint64_t weak;
+
+    double *latency;
+    size_t latency_count;
+    size_t latency_size;
+
+    uint64_t alarms_generated;
+    uint64_t alarms_delivered;
+    double *alarm_latency;
+    size_t alarm_latency_count;
+    size_t alarm_latency_size;
+
+    // Data frames read from source include retransmissions
+    sim_time_t bulk_start;
+    sim_time_t bulk_end;
+    uint64_t bulk_received;
+    uint64_t bulk_corrupted;
+    uint64_t bulk_frames;
+    bool bulk_failed;
+
+} sim_stats_t;
+
+extern sim_config_t sim_config;
+extern sim_stats_t sim_stats;
+extern sim_time_t sim_now;
+extern sim_node_t *sim_nodes;
+extern size_t sim_node_count;
+extern sim_node_t *sim_current;
+
+// Event queue
+
+typedef enum
+{
+    SIM_EVENT_WAKE = 0,
+    SIM_EVENT_TX_END = 1,
+    SIM_EVENT_RX_TIMEOUT = 2,
+    SIM_EVENT_REPORT = 3,
+    SIM_EVENT_ALARM = 4,
+    SIM_EVENT_SURVEY = 5,
+    SIM_EVENT_BULK = 6
+
+} sim_event_type_t;
+
+void sim_event_init(void);
+void sim_event_free(void);
+void sim_event_push(sim_time_t time, sim_event_type_t type, sim_node_t *node, void *param);
+bool sim_event_pop(sim_time_t *time, sim_event_type_t *type, sim_node_t **node, void **param);
+
+// Nodes
+
+void sim_node_create(sim_node_t *node);
+void sim_node_destroy(sim_node_t *node);
+void sim_node_enter(sim_node_t *node);
+void sim_node_leave(sim_node_t *node);
+
+// Runs due tasks of entered node, applies radio state and switches node out
+void sim_node_run(sim_node_t *node);
+bc_tick_t sim_node_local_time(sim_node_t *node, sim_time_t time);
+bool sim_node_is_down(sim_node_t *node);
+sim_time_t sim_node_global_time(sim_node_t *node, bc_tick_t tick);
+
+// Radio and channel
+
+void sim_radio_init(sim_node_t *node);
+bc_tick_t sim_radio_airtime(const bc_spirit1_profile_t *profile, size_t length);
+void sim_radio_apply(sim_node_t *node);
+void sim_radio_finish(sim_node_t *node);
+void sim_radio_on_tx_end(sim_transmission_t *transmission);
+void sim_radio_on_rx_timeout(sim_node_t *node);
+void sim_radio_receive(sim_node_t *node, sim_transmission_t *transmission);
+
+void sim_channel_init(void);
+void sim_channel_free(void);
+sim_transmission_t *sim_channel_start(sim_node_t *sender, const uint8_t *buffer, size_t length, sim_time_t end);
+void sim_channel_deliver(sim_transmission_t *transmission);
+double sim_channel_rssi(sim_node_t *sender, sim_node_t *receiver);
+double sim_channel_level(sim_node_t *receiver, uint8_t channel);
+
+// Statistics and randomness
+
+void sim_stats_latency(double latency);
+double sim_random(void);
+void sim_random_seed(uint64_t seed);
+
+#endif // _SIM_H
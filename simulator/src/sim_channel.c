@@ -0,0 +1,268 @@
+#include "sim.h"
+
+// Sensitivity of SPIRIT1 at 19.2 kbps in dBm, it scales with data rate and FEC adds coding gain
+#define SIM_CHANNEL_SENSITIVITY -105.0
+#define SIM_CHANNEL_FEC_GAIN 3.0
+
+// Level measured on empty channel in dBm
+#define SIM_CHANNEL_NOISE_FLOOR -120.0
+
+// Log-distance path loss at 868 MHz, free space loss at 1 m and indoor exponent
+#define SIM_CHANNEL_PATH_LOSS_1M 31.2
+#define SIM_CHANNEL_PATH_LOSS_EXPONENT 3.0
+
+static struct
+{
+    sim_transmission_t *head;
+    sim_time_t keep;
+
+} _sim_channel;
+
+static void _sim_channel_prune(void);
+static double _sim_channel_sensitivity(const bc_spirit1_profile_t *profile);
+static double _sim_channel_shadowing(sim_node_t *a, sim_node_t *b);
+static uint64_t _sim_channel_hash(uint64_t x);
+
+void sim_channel_init(void)
+{
+    memset(&_sim_channel, 0, sizeof(_sim_channel));
+
+    // Frame may be needed for interference of any frame overlapping it, longest one is sent at lowest rate with FEC
+    bc_spirit1_profile_t slowest = { .datarate = BC_SPIRIT1_DATARATE_9600, .fec = true };
+
+    _sim_channel.keep = 2 * sim_radio_airtime(&slowest, BC_SPIRIT1_MAX_PACKET_SIZE);
+}
+
+void sim_channel_free(void)
+{
+    while (_sim_channel.head != NULL)
+    {
+        sim_transmission_t *next = _sim_channel.head->next;
+
+        free(_sim_channel.head);
+
+        _sim_channel.head = next;
+    }
+}
+
+sim_transmission_t *sim_channel_start(sim_node_t *sender, const uint8_t *buffer, size_t length, sim_time_t end)
+{
+    _sim_channel_prune();
+
+    sim_transmission_t *transmission = calloc(1, sizeof(sim_transmission_t));
+
+    if (transmission == NULL)
+    {
+        fprintf(stderr, "Out of memory\n");
+
+        exit(EXIT_FAILURE);
+    }
+
+    transmission->sender = sender;
+    transmission->start = sim_now;
+    transmission->end = end;
+    transmission->destination = sender->radio.address;
+    transmission->profile = sender->radio.profile;
+    transmission->length = length;
+
+    memcpy(transmission->buffer, buffer, length);
+
+    transmission->next = _sim_channel.head;
+    _sim_channel.head = transmission;
+
+    sim_stats.transmissions++;
+
+    // Frame of node which is down never gets on air
+    if (sim_node_is_down(sender))
+    {
+        return transmission;
+    }
+
+    // Receiver synchronizes to the first preamble it hears and stays with it until its end
+    for (size_t i = 0; i < sim_node_count; i++)
+    {
+        sim_node_t *node = &sim_nodes[i];
+
+        if (node == sender || node->radio.current_state != SIM_RADIO_STATE_RX || node->radio.lock != NULL || sim_node_is_down(node))
+        {
+            continue;
+        }
+
+        if (node->radio.profile.channel != sender->radio.profile.channel || node->radio.profile.datarate != sender->radio.profile.datarate)
+        {
+            continue;
+        }
+
+        if (sim_channel_rssi(sender, node) >= _sim_channel_sensitivity(&node->radio.profile))
+        {
+            node->radio.lock = transmission;
+        }
+    }
+
+    return transmission;
+}
+
+void sim_channel_deliver(sim_transmission_t *transmission)
+{
+    for (size_t i = 0; i < sim_node_count; i++)
+    {
+        sim_node_t *node = &sim_nodes[i];
+
+        if (node->radio.lock != transmission)
+        {
+            continue;
+        }
+
+        node->radio.lock = NULL;
+
+        if (node->radio.current_state != SIM_RADIO_STATE_RX || node->radio.rx_since > transmission->start)
+        {
+            continue;
+        }
+
+        if (transmission->aborted)
+        {
+            sim_stats.losses++;
+
+            continue;
+        }
+
+        double signal = sim_channel_rssi(transmission->sender, node);
+        double interference = 0;
+
+        for (sim_transmission_t *other = _sim_channel.head; other != NULL; other = other->next)
+        {
+            if (other == transmission || other->sender == node || other->end <= transmission->start || other->start >= transmission->end || sim_node_is_down(other->sender))
+            {
+                continue;
+            }
+
+            // Channels are far enough apart not to interfere
+            if (other->profile.channel != transmission->profile.channel)
+            {
+                continue;
+            }
+
+            interference += pow(10, sim_channel_rssi(other->sender, node) / 10);
+        }
+
+        // Capture effect lets frame through if it is enough stronger than sum of interferers
+        if (interference > 0 && signal - 10 * log10(interference) < sim_config.capture)
+        {
+            sim_stats.collisions++;
+
+            // Corrupted frame fails CRC check in radio
+            node->radio.rx_crc_error++;
+
+            continue;
+        }
+
+        if (sim_random() < sim_config.loss)
+        {
+            sim_stats.losses++;
+
+            continue;
+        }
+
+        sim_stats.receptions++;
+
+        sim_radio_receive(node, transmission);
+    }
+}
+
+double sim_channel_rssi(sim_node_t *sender, sim_node_t *receiver)
+{
+    double dx = sender->x - receiver->x;
+    double dy = sender->y - receiver->y;
+    double distance = sqrt(dx * dx + dy * dy);
+
+    if (distance < 1)
+    {
+        distance = 1;
+    }
+
+    double path_loss = SIM_CHANNEL_PATH_LOSS_1M + 10 * SIM_CHANNEL_PATH_LOSS_EXPONENT * log10(distance);
+
+    return sender->radio.profile.power - path_loss + _sim_channel_shadowing(sender, receiver);
+}
+
+double sim_channel_level(sim_node_t *receiver, uint8_t channel)
+{
+    double level = pow(10, SIM_CHANNEL_NOISE_FLOOR / 10);
+
+    for (sim_transmission_t *other = _sim_channel.head; other != NULL; other = other->next)
+    {
+        if (other->sender == receiver || other->aborted || other->start > sim_now || other->end <= sim_now || sim_node_is_down(other->sender))
+        {
+            continue;
+        }
+
+        if (other->profile.channel != channel)
+        {
+            continue;
+        }
+
+        level += pow(10, sim_channel_rssi(other->sender, receiver) / 10);
+    }
+
+    return 10 * log10(level);
+}
+
+static double _sim_channel_sensitivity(const bc_spirit1_profile_t *profile)
+{
+    static const double datarates[BC_SPIRIT1_DATARATE_COUNT] = { 9600, 19200, 38400, 100000 };
+
+    double sensitivity = SIM_CHANNEL_SENSITIVITY + 10 * log10(datarates[profile->datarate] / 19200);
+
+    return profile->fec ? sensitivity - SIM_CHANNEL_FEC_GAIN : sensitivity;
+}
+
+static void _sim_channel_prune(void)
+{
+    sim_transmission_t **transmission = &_sim_channel.head;
+
+    while (*transmission != NULL)
+    {
+        if ((*transmission)->end + _sim_channel.keep < sim_now)
+        {
+            sim_transmission_t *next = (*transmission)->next;
+
+            free(*transmission);
+
+            *transmission = next;
+        }
+        else
+        {
+            transmission = &(*transmission)->next;
+        }
+    }
+}
+
+static double _sim_channel_shadowing(sim_node_t *a, sim_node_t *b)
+{
+    if (sim_config.shadowing == 0)
+    {
+        return 0;
+    }
+
+    // Link is symmetric and keeps its shadowing for whole run
+    uint64_t low = a->index < b->index ? a->index : b->index;
+    uint64_t high = a->index < b->index ? b->index : a->index;
+
+    uint64_t hash = _sim_channel_hash(((uint64_t) sim_config.seed << 40) ^ (low << 20) ^ high);
+
+    double u1 = ((hash >> 11) + 1.0) / 9007199254740993.0;
+    double u2 = (_sim_channel_hash(hash) >> 11) / 9007199254740992.0;
+
+    return sim_config.shadowing * sqrt(-2 * log(u1)) * cos(2 * M_PI * u2);
+}
+
+static uint64_t _sim_channel_hash(uint64_t x)
+{
+    // SplitMix64 finalizer
+    x += UINT64_C(0x9e3779b97f4a7c15);
+    x = (x ^ (x >> 30)) * UINT64_C(0xbf58476d1ce4e5b9);
+    x = (x ^ (x >> 27)) * UINT64_C(0x94d049bb133111eb);
+
+    return x ^ (x >> 31);
+}
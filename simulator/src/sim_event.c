@@ -0,0 +1,120 @@
+#include "sim.h"
+
+typedef struct
+{
+    sim_time_t time;
+    uint64_t sequence;
+    sim_event_type_t type;
+    sim_node_t *node;
+    void *param;
+
+} sim_event_t;
+
+// Binary min-heap ordered by time, events at the same time keep order of insertion
+static struct
+{
+    sim_event_t *heap;
+    size_t length;
+    size_t size;
+    uint64_t sequence;
+
+} _sim_event;
+
+static bool _sim_event_before(const sim_event_t *a, const sim_event_t *b);
+
+void sim_event_init(void)
+{
+    memset(&_sim_event, 0, sizeof(_sim_event));
+}
+
+void sim_event_free(void)
+{
+    free(_sim_event.heap);
+
+    memset(&_sim_event, 0, sizeof(_sim_event));
+}
+
+void sim_event_push(sim_time_t time, sim_event_type_t type, sim_node_t *node, void *param)
+{
+    if (_sim_event.length == _sim_event.size)
+    {
+        _sim_event.size = _sim_event.size == 0 ? 1024 : _sim_event.size * 2;
+
+        _sim_event.heap = realloc(_sim_event.heap, _sim_event.size * sizeof(sim_event_t));
+
+        if (_sim_event.heap == NULL)
+        {
+            fprintf(stderr, "Out of memory\n");
+
+            exit(EXIT_FAILURE);
+        }
+    }
+
+    sim_event_t event = { time, _sim_event.sequence++, type, node, param };
+
+    size_t i = _sim_event.length++;
+
+    while (i > 0 && _sim_event_before(&event, &_sim_event.heap[(i - 1) / 2]))
+    {
+        _sim_event.heap[i] = _sim_event.heap[(i - 1) / 2];
+
+        i = (i - 1) / 2;
+    }
+
+    _sim_event.heap[i] = event;
+}
+
+bool sim_event_pop(sim_time_t *time, sim_event_type_t *type, sim_node_t **node, void **param)
+{
+    if (_sim_event.length == 0)
+    {
+        return false;
+    }
+
+    *time = _sim_event.heap[0].time;
+    *type = _sim_event.heap[0].type;
+    *node = _sim_event.heap[0].node;
+    *param = _sim_event.heap[0].param;
+
+    sim_event_t last = _sim_event.heap[--_sim_event.length];
+
+    size_t i = 0;
+
+    for (;;)
+    {
+        size_t child = 2 * i + 1;
+
+        if (child >= _sim_event.length)
+        {
+            break;
+        }
+
+        if (child + 1 < _sim_event.length && _sim_event_before(&_sim_event.heap[child + 1], &_sim_event.heap[child]))
+        {
+            child++;
+        }
+
+        if (!_sim_event_before(&_sim_event.heap[child], &last))
+        {
+            break;
+        }
+
+        _sim_event.heap[i] = _sim_event.heap[child];
+
+        i = child;
+    }
+
+    _sim_event.heap[i] = last;
+
+    return true;
+}
+
+static bool _sim_event_before(const sim_event_t *a, const sim_event_t *b)
+{
+    if (a->time != b->time)
+    {
+        return a->time < b->time;
+    }
+
+    return a->sequence < b->sequence;
+}
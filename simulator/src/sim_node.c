@@ -0,0 +1,146 @@
+#include "sim.h"
+
+// Real modules are built into this unit so that their static state can be switched between nodes
+#include "bc_scheduler.c"
+#include "bc_radio.c"
+
+// Spins in a row after which task planning itself for now is given a tick to breathe
+#define SIM_NODE_MAX_SPINS 1000
+
+void sim_node_create(sim_node_t *node)
+{
+    node->radio_image = calloc(1, sizeof(_bc_radio));
+    node->scheduler_image = calloc(1, sizeof(_bc_scheduler));
+
+    if (node->radio_image == NULL || node->scheduler_image == NULL)
+    {
+        fprintf(stderr, "Out of memory\n");
+
+        exit(EXIT_FAILURE);
+    }
+
+    node->wake_time = BC_TICK_INFINITY;
+
+    // Erased EEPROM
+    memset(node->eeprom, 0xff, sizeof(node->eeprom));
+}
+
+void sim_node_destroy(sim_node_t *node)
+{
+    free(node->radio_image);
+    free(node->scheduler_image);
+
+    free(node->report.generated);
+    free(node->report.delivered);
+}
+
+void sim_node_enter(sim_node_t *node)
+{
+    memcpy(&_bc_radio, node->radio_image, sizeof(_bc_radio));
+    memcpy(&_bc_scheduler, node->scheduler_image, sizeof(_bc_scheduler));
+
+    sim_current = node;
+}
+
+void sim_node_leave(sim_node_t *node)
+{
+    memcpy(node->radio_image, &_bc_radio, sizeof(_bc_radio));
+    memcpy(node->scheduler_image, &_bc_scheduler, sizeof(_bc_scheduler));
+
+    sim_current = NULL;
+}
+
+void sim_node_run(sim_node_t *node)
+{
+    // Same as one pass of bc_scheduler_run, repeated while some task is due
+    for (int spin = 0; spin < SIM_NODE_MAX_SPINS; spin++)
+    {
+        bool due = false;
+
+        _bc_scheduler.tick_spin = bc_tick_get();
+
+        for (bc_scheduler_task_id_t id = 0; id <= _bc_scheduler.max_task_id; id++)
+        {
+            if (_bc_scheduler.pool[id].task != NULL && _bc_scheduler.tick_spin >= _bc_scheduler.pool[id].tick_execution)
+            {
+                due = true;
+
+                _bc_scheduler.current_task_id = id;
+
+                _bc_scheduler.pool[id].tick_execution = BC_TICK_INFINITY;
+
+                _bc_scheduler.pool[id].task(_bc_scheduler.pool[id].param);
+            }
+        }
+
+        if (!due)
+        {
+            break;
+        }
+    }
+
+    // Radio driver task would run in the same spin
+    sim_radio_apply(node);
+
+    bc_tick_t next = BC_TICK_INFINITY;
+
+    for (bc_scheduler_task_id_t id = 0; id <= _bc_scheduler.max_task_id; id++)
+    {
+        if (_bc_scheduler.pool[id].task != NULL && _bc_scheduler.pool[id].tick_execution < next)
+        {
+            next = _bc_scheduler.pool[id].tick_execution;
+        }
+    }
+
+    sim_node_leave(node);
+
+    if (next == BC_TICK_INFINITY)
+    {
+        node->wake_time = BC_TICK_INFINITY;
+
+        return;
+    }
+
+    sim_time_t wake_time = sim_node_global_time(node, next);
+
+    if (wake_time <= sim_now)
+    {
+        wake_time = sim_now + 1;
+    }
+
+    // Event planned before becomes stale
+    if (wake_time != node->wake_time)
+    {
+        node->wake_time = wake_time;
+
+        sim_event_push(wake_time, SIM_EVENT_WAKE, node, NULL);
+    }
+}
+
+bool sim_node_is_down(sim_node_t *node)
+{
+    return node->role == SIM_NODE_ROLE_BASE && sim_now >= sim_config.outage_start * 1000 && sim_now < (sim_config.outage_start + sim_config.outage_length) * 1000;
+}
+
+bc_tick_t sim_node_local_time(sim_node_t *node, sim_time_t time)
+{
+    return time + (int64_t) llround((double) time * node->drift_ppm / 1e6);
+}
+
+sim_time_t sim_node_global_time(sim_node_t *node, bc_tick_t tick)
+{
+    sim_time_t time = (sim_time_t) floor((double) tick / (1.0 + node->drift_ppm / 1e6));
+
+    // First global time at which local clock reaches tick
+    while (time > 0 && sim_node_local_time(node, time - 1) >= tick)
+    {
+        time--;
+    }
+
+    while (sim_node_local_time(node, time) < tick)
+    {
+        time++;
+    }
+
+    return time;
+}
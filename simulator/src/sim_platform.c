@@ -0,0 +1,81 @@
+#include "sim.h"
+#include <bc_device_id.h>
+#include <bc_eeprom.h>
+#include <bc_module_core.h>
+
+// Platform functions used by real modules, answered on behalf of current node
+
+bc_tick_t bc_tick_get(void)
+{
+    if (sim_current == NULL)
+    {
+        return sim_now;
+    }
+
+    return sim_node_local_time(sim_current, sim_now);
+}
+
+void bc_device_id_get(void *destination, size_t size)
+{
+    memset(destination, 0, size);
+
+    memcpy(destination, &sim_current->device_address, size < sizeof(uint32_t) ? size : sizeof(uint32_t));
+}
+
+bool bc_eeprom_write(uint32_t address, const void *buffer, size_t length)
+{
+    if (address + length > SIM_EEPROM_SIZE)
+    {
+        return false;
+    }
+
+    memcpy(&sim_current->eeprom[address], buffer, length);
+
+    return true;
+}
+
+bool bc_eeprom_read(uint32_t address, void *buffer, size_t length)
+{
+    if (address + length > SIM_EEPROM_SIZE)
+    {
+        return false;
+    }
+
+    memcpy(buffer, &sim_current->eeprom[address], length);
+
+    return true;
+}
+
+size_t bc_eeprom_get_size(void)
+{
+    return SIM_EEPROM_SIZE;
+}
+
+void bc_module_core_init()
+{
+}
+
+void bc_module_core_sleep()
+{
+}
+
+void bc_module_core_pll_enable()
+{
+}
+
+void bc_module_core_pll_disable()
+{
+}
+
+void bc_module_core_deep_sleep_disable(void)
+{
+}
+
+void bc_module_core_deep_sleep_enable(void)
+{
+}
+
+uint32_t bc_module_core_get_clk()
+{
+    return 32000000;
+}
@@ -0,0 +1,364 @@
+#include "sim.h"
+
+// Same air parameters as bc_spirit1 uses
+#define SIM_RADIO_FRAME_PREAMBLE (4 + 4)
+#define SIM_RADIO_FRAME_OVERHEAD (1 + 1 + 2)
+
+static const uint32_t _sim_radio_datarates[BC_SPIRIT1_DATARATE_COUNT] = { 9600, 19200, 38400, 100000 };
+
+static void _sim_radio_set_state(sim_node_t *node, sim_radio_state_t state);
+static void _sim_radio_arm_timeout(sim_node_t *node);
+
+// Implementation of bc_spirit1 interface on behalf of current node
+
+void bc_spirit1_init(void)
+{
+    sim_radio_init(sim_current);
+}
+
+void bc_spirit1_set_event_handler(void (*event_handler)(bc_spirit1_event_t, void *), void *event_param)
+{
+    sim_current->radio.event_handler = event_handler;
+    sim_current->radio.event_param = event_param;
+}
+
+void *bc_spirit1_get_tx_buffer(void)
+{
+    return sim_current->radio.tx_buffer;
+}
+
+void bc_spirit1_set_tx_length(size_t length)
+{
+    sim_current->radio.tx_length = length;
+}
+
+void *bc_spirit1_get_rx_buffer(void)
+{
+    return sim_current->radio.rx_buffer;
+}
+
+size_t bc_spirit1_get_rx_length(void)
+{
+    return sim_current->radio.rx_length;
+}
+
+void bc_spirit1_set_rx_timeout(bc_tick_t timeout)
+{
+    sim_current->radio.rx_timeout = timeout;
+
+    // Apply new timeout also to reception which is already running
+    if (sim_current->radio.current_state == SIM_RADIO_STATE_RX)
+    {
+        _sim_radio_arm_timeout(sim_current);
+    }
+}
+
+uint32_t bc_spirit1_get_spi_bytes_transferred(void)
+{
+    return 0;
+}
+
+uint32_t bc_spirit1_get_spi_bytes_saved(void)
+{
+    return 0;
+}
+
+void bc_spirit1_set_sleep_mode(bc_spirit1_sleep_mode_t mode)
+{
+    sim_current->radio.sleep_mode = mode;
+}
+
+bool bc_spirit1_set_profile(const bc_spirit1_profile_t *profile)
+{
+    if (profile->datarate >= BC_SPIRIT1_DATARATE_COUNT || profile->power < BC_SPIRIT1_POWER_MIN || profile->power > BC_SPIRIT1_POWER_MAX)
+    {
+        return false;
+    }
+
+    sim_current->radio.profile = *profile;
+
+    return true;
+}
+
+void bc_spirit1_get_profile(bc_spirit1_profile_t *profile)
+{
+    *profile = sim_current->radio.profile;
+}
+
+bool bc_spirit1_measure_rssi(uint8_t channel, float *rssi)
+{
+    if (sim_current->radio.current_state != SIM_RADIO_STATE_SLEEP || sim_current->radio.desired_state != SIM_RADIO_STATE_SLEEP)
+    {
+        return false;
+    }
+
+    // Listening for a millisecond is below tick resolution, it is not accounted in energy
+    *rssi = sim_channel_level(sim_current, channel);
+
+    return true;
+}
+
+uint32_t bc_spirit1_get_wake_up_count(void)
+{
+    return sim_current->radio.wake_up_count;
+}
+
+uint32_t bc_spirit1_get_wake_up_time(void)
+{
+    return SIM_WAKE_UP_TIME;
+}
+
+// Simulated receiver is armed again right at end of frame
+uint32_t bc_spirit1_get_rx_rearm_time(bool deferred)
+{
+    (void) deferred;
+
+    return 0;
+}
+
+void bc_spirit1_reset_rx_rearm_time(void)
+{
+}
+
+uint32_t bc_spirit1_get_rx_discarded(void)
+{
+    return 0;
+}
+
+uint32_t bc_spirit1_get_rx_dropped(void)
+{
+    return 0;
+}
+
+void bc_spirit1_set_address(uint8_t address)
+{
+    sim_current->radio.address = address;
+}
+
+uint8_t bc_spirit1_get_address(void)
+{
+    return sim_current->radio.address;
+}
+
+uint32_t bc_spirit1_get_rx_rejected(void)
+{
+    return sim_current->radio.rx_rejected;
+}
+
+uint32_t bc_spirit1_get_rx_crc_error(void)
+{
+    return sim_current->radio.rx_crc_error;
+}
+
+bc_tick_t bc_spirit1_get_airtime(size_t length)
+{
+    return sim_radio_airtime(&sim_current->radio.profile, length);
+}
+
+void bc_spirit1_tx(void)
+{
+    sim_current->radio.desired_state = SIM_RADIO_STATE_TX;
+}
+
+void bc_spirit1_rx(void)
+{
+    sim_current->radio.desired_state = SIM_RADIO_STATE_RX;
+}
+
+void bc_spirit1_sleep(void)
+{
+    sim_current->radio.desired_state = SIM_RADIO_STATE_SLEEP;
+}
+
+// Radio state machine driven by simulator
+
+void sim_radio_init(sim_node_t *node)
+{
+    sim_time_t state_time[SIM_RADIO_STATE_COUNT];
+    uint32_t tx_count = node->radio.tx_count;
+    uint32_t wake_up_count = node->radio.wake_up_count;
+    uint32_t rx_count = node->radio.rx_count;
+    uint32_t rx_rejected = node->radio.rx_rejected;
+    uint32_t rx_crc_error = node->radio.rx_crc_error;
+    bc_spirit1_sleep_mode_t sleep_mode = node->radio.sleep_mode;
+
+    // Energy accounting survives re-initialization
+    sim_radio_finish(node);
+
+    memcpy(state_time, node->radio.state_time, sizeof(state_time));
+
+    memset(&node->radio, 0, sizeof(node->radio));
+
+    memcpy(node->radio.state_time, state_time, sizeof(state_time));
+
+    node->radio.tx_count = tx_count;
+    node->radio.wake_up_count = wake_up_count;
+    node->radio.rx_count = rx_count;
+    node->radio.rx_rejected = rx_rejected;
+    node->radio.rx_crc_error = rx_crc_error;
+    node->radio.sleep_mode = sleep_mode;
+    node->radio.state_since = sim_now;
+    node->radio.rx_since = BC_TICK_INFINITY;
+    node->radio.rx_deadline = BC_TICK_INFINITY;
+
+    node->radio.profile.datarate = BC_SPIRIT1_DATARATE_19200;
+    node->radio.profile.power = BC_SPIRIT1_POWER_MAX;
+}
+
+bc_tick_t sim_radio_airtime(const bc_spirit1_profile_t *profile, size_t length)
+{
+    uint32_t datarate = _sim_radio_datarates[profile->datarate];
+    size_t bytes = SIM_RADIO_FRAME_PREAMBLE + (profile->fec ? 2 : 1) * (SIM_RADIO_FRAME_OVERHEAD + length);
+
+    return ((bytes * 8 * 1000) + datarate - 1) / datarate;
+}
+
+void sim_radio_apply(sim_node_t *node)
+{
+    if (node->radio.desired_state == node->radio.current_state)
+    {
+        return;
+    }
+
+    // State change aborts frame which is on air
+    if (node->radio.transmission != NULL)
+    {
+        node->radio.transmission->aborted = true;
+        node->radio.transmission = NULL;
+    }
+
+    // Wake up takes about a millisecond, it is accounted in energy only as it is below tick resolution
+    if (node->radio.current_state == SIM_RADIO_STATE_SLEEP && node->radio.sleep_mode == BC_SPIRIT1_SLEEP_MODE_SHUTDOWN)
+    {
+        node->radio.wake_up_count++;
+    }
+
+    _sim_radio_set_state(node, node->radio.desired_state);
+
+    if (node->radio.current_state == SIM_RADIO_STATE_TX)
+    {
+        sim_time_t end = sim_now + sim_radio_airtime(&node->radio.profile, node->radio.tx_length);
+
+        node->radio.tx_count++;
+
+        node->radio.transmission = sim_channel_start(node, node->radio.tx_buffer, node->radio.tx_length, end);
+
+        sim_event_push(end, SIM_EVENT_TX_END, node, node->radio.transmission);
+    }
+    else if (node->radio.current_state == SIM_RADIO_STATE_RX)
+    {
+        _sim_radio_arm_timeout(node);
+    }
+}
+
+void sim_radio_finish(sim_node_t *node)
+{
+    node->radio.state_time[node->radio.current_state] += sim_now - node->radio.state_since;
+    node->radio.state_since = sim_now;
+}
+
+void sim_radio_on_tx_end(sim_transmission_t *transmission)
+{
+    sim_node_t *node = transmission->sender;
+
+    sim_channel_deliver(transmission);
+
+    if (transmission->aborted || node->radio.transmission != transmission)
+    {
+        return;
+    }
+
+    node->radio.transmission = NULL;
+
+    _sim_radio_set_state(node, SIM_RADIO_STATE_SLEEP);
+
+    node->radio.desired_state = SIM_RADIO_STATE_SLEEP;
+
+    sim_node_enter(node);
+
+    if (node->radio.event_handler != NULL)
+    {
+        node->radio.event_handler(BC_SPIRIT1_EVENT_TX_DONE, node->radio.event_param);
+    }
+
+    sim_node_run(node);
+}
+
+void sim_radio_on_rx_timeout(sim_node_t *node)
+{
+    if (node->radio.current_state != SIM_RADIO_STATE_RX || node->radio.rx_deadline != sim_now)
+    {
+        return;
+    }
+
+    node->radio.rx_deadline = BC_TICK_INFINITY;
+
+    sim_node_enter(node);
+
+    if (node->radio.event_handler != NULL)
+    {
+        node->radio.event_handler(BC_SPIRIT1_EVENT_RX_TIMEOUT, node->radio.event_param);
+    }
+
+    sim_node_run(node);
+}
+
+void sim_radio_receive(sim_node_t *node, sim_transmission_t *transmission)
+{
+    // Address filter of radio drops frame without waking up MCU for its payload
+    if (node->radio.address != 0 && transmission->destination != node->radio.address)
+    {
+        node->radio.rx_rejected++;
+
+        return;
+    }
+
+    node->radio.rx_count++;
+
+    memcpy(node->radio.rx_buffer, transmission->buffer, transmission->length);
+
+    node->radio.rx_length = transmission->length;
+
+    sim_node_enter(node);
+
+    if (node->radio.event_handler != NULL)
+    {
+        node->radio.event_handler(BC_SPIRIT1_EVENT_RX_DONE, node->radio.event_param);
+    }
+
+    sim_node_run(node);
+}
+
+static void _sim_radio_set_state(sim_node_t *node, sim_radio_state_t state)
+{
+    sim_radio_finish(node);
+
+    node->radio.current_state = state;
+    node->radio.lock = NULL;
+
+    if (state == SIM_RADIO_STATE_RX)
+    {
+        node->radio.rx_since = sim_now;
+    }
+    else
+    {
+        node->radio.rx_since = BC_TICK_INFINITY;
+        node->radio.rx_deadline = BC_TICK_INFINITY;
+    }
+}
+
+static void _sim_radio_arm_timeout(sim_node_t *node)
+{
+    if (node->radio.rx_timeout == 0 || node->radio.rx_timeout == BC_TICK_INFINITY)
+    {
+        node->radio.rx_deadline = BC_TICK_INFINITY;
+
+        return;
+    }
+
+    bc_tick_t tick = sim_node_local_time(node, sim_now) + node->radio.rx_timeout;
+
+    node->radio.rx_deadline = sim_node_global_time(node, tick);
+
+    sim_event_push(node->radio.rx_deadline, SIM_EVENT_RX_TIMEOUT, node, NULL);
+}